@@ -6,12 +6,28 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <string.h>
+
 #include "BeamApp.h"
+#include "BmProfiler.h"
 
-int main()
+int main( int argc, char** argv)
 {
-	BeamApplication* app = new BeamApplication( BM_APP_SIG);
+	// startup is always profiled, with --profile-startup Beam quits as soon as
+	// the main-window is ready (in order to keep track of the startup time):
+	BmProfiler::CreateInstance();
+	for( int i=1; i<argc; ++i) {
+		if (!strcmp( argv[i], BmProfiler::PROFILE_STARTUP_ARG))
+			TheProfiler->ExitAfterStartup( true);
+	}
+	TheProfiler->BeginPhase( BmProfiler::STARTUP_PHASE);
+	BeamApplication* app;
+	{	// scope for profile-span
+		BM_PROFILE_SPAN( "BeamApplication()");
+		app = new BeamApplication( BM_APP_SIG);
+	}
 	app->Run();
 	delete app;
+	delete TheProfiler;
 }
 
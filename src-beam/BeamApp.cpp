@@ -34,12 +34,15 @@ using namespace regexx;
 #include "BmImapAccount.h"
 #include "BmJobStatusWin.h"
 #include "BmLogHandler.h"
+#include "BmMailDedupIndex.h"
 #include "BmMailEditWin.h"
 #include "BmMailFactory.h"
 #include "BmMailFolderList.h"
+#include "BmMailIndexer.h"
 #include "BmMailMonitor.h"
 #include "BmMailMover.h"
 #include "BmMailRef.h"
+#include "BmMailRefList.h"
 #include "BmMailView.h"
 #include "BmMailViewWin.h"
 #include "BmMainWindow.h"
@@ -50,6 +53,7 @@ using namespace regexx;
 #include "BmPopAccount.h"
 #include "BmPrefs.h"
 #include "BmPrefsWin.h"
+#include "BmProfiler.h"
 #include "BmResources.h"
 #include "BmSignature.h"
 #include "BmSmtpAccount.h"
@@ -668,8 +672,11 @@ BeamApplication::BeamApplication( const char* sig)
 		BeamGuiRoster = new BmGuiRoster();
 
 		// load/determine all needed resources:
-		BmResources::CreateInstance();
-		TheResources->InitializeWithPrefs();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "resources");
+			BmResources::CreateInstance();
+			TheResources->InitializeWithPrefs();
+		}
 
 		ColumnListView::SetExtendedSelectionPolicy( 
 									ThePrefs->GetBool( "ListviewLikeTracker", false));
@@ -680,7 +687,10 @@ BeamApplication::BeamApplication( const char* sig)
 		BmBusyView::SetErrorIcon( TheResources->IconByName("Error"));
 
 		// init charset-tables:
-		BmEncoding::InitCharsetMap();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "charset-tables");
+			BmEncoding::InitCharsetMap();
+		}
 
 		BM_LOG( BM_LogApp, BmString(B_UTF8_ELLIPSIS "setting up foreign-keys" B_UTF8_ELLIPSIS));
 		// now setup all foreign-key connections between these list-models:
@@ -701,18 +711,33 @@ BeamApplication::BeamApplication( const char* sig)
 		TheIdentityList->AddForeignKey( BmFilterAddon::FK_IDENTITY,
 												  TheFilterList.Get());
 
-		// create the node-monitor looper and the stored action flusher:
-		BmMailMonitor::CreateInstance();
-		BmStoredActionFlusher::CreateInstance();
+		// create the node-monitor looper, the stored action flusher, the
+		// manager that keeps the memory used by mailref-lists in check,
+		// the indexer that maintains the full-text index of all mails and
+		// the index that is used to skip duplicates of received mails:
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "mail-monitor & helpers");
+			BmMailMonitor::CreateInstance();
+			BmStoredActionFlusher::CreateInstance();
+			BmMailRefListResidency::CreateInstance();
+			BmMailIndexer::CreateInstance();
+			BmMailDedupIndex::CreateInstance();
+		}
 
 		// create the job status window:
-		BmJobStatusWin::CreateInstance();
-		TheJobStatusWin->Hide();
-		TheJobStatusWin->Show();
-		TheJobMetaController = TheJobStatusWin;
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "job-status-window");
+			BmJobStatusWin::CreateInstance();
+			TheJobStatusWin->Hide();
+			TheJobStatusWin->Show();
+			TheJobMetaController = TheJobStatusWin;
+		}
 
-		BmPeopleMonitor::CreateInstance();
-		BmPeopleList::CreateInstance();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "people-monitor");
+			BmPeopleMonitor::CreateInstance();
+			BmPeopleList::CreateInstance();
+		}
 
 		bm_plain_font = *be_plain_font;
 		bm_bold_font = *be_bold_font;
@@ -724,7 +749,10 @@ BeamApplication::BeamApplication( const char* sig)
 		add_system_beep_event( BM_BEEP_EVENT);
 
 		BM_LOG( BM_LogApp, BmString(B_UTF8_ELLIPSIS "creating main-window" B_UTF8_ELLIPSIS));
-		BmMainWindow::CreateInstance();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "main-window");
+			BmMainWindow::CreateInstance();
+		}
 		
 		TheBubbleHelper->EnableHelp( ThePrefs->GetBool( "ShowTooltips", true));
 
@@ -741,9 +769,14 @@ BeamApplication::BeamApplication( const char* sig)
 		-	standard destructor
 \*------------------------------------------------------------------------------*/
 BeamApplication::~BeamApplication() {
+	BM_PROFILE_SPAN( "BeamApplication teardown");
 	RemoveDeskbarItem();
 	ThePeopleMonitor = NULL;
 	TheStoredActionFlusher = NULL;
+	delete TheMailRefListResidency;
+	TheMailRefListResidency = NULL;
+	delete TheMailIndexer;
+	delete TheMailDedupIndex;
 	TheMailMonitor = NULL;
 	ThePeopleList = NULL;
 	delete mPrintSetup;
@@ -751,6 +784,29 @@ BeamApplication::~BeamApplication() {
 	delete BeamGuiRoster;
 }
 
+/*------------------------------------------------------------------------------*\
+	EndStartupProfile()
+		-	waits until the main-window is ready (has read the mail-folders) 
+			and then reports the startup-profile
+		-	if Beam has been started with --profile-startup, it quits afterwards
+		-	this is a thread-entry func.
+\*------------------------------------------------------------------------------*/
+static int32 EndStartupProfile( void*)
+{
+	{	// scope for folder-list reference
+		BmRef<BmMailFolderList> folderList( TheMailFolderList.Get());
+		while( !beamApp->IsQuitting() && folderList 
+		&& !folderList->IsJobCompleted())
+			snooze( 50*1000);
+	}
+	// if the user has quit early, the shutdown-phase is running by now,
+	// which is none of our business:
+	if (TheProfiler->EndPhase( BmProfiler::STARTUP_PHASE)
+	&& TheProfiler->ExitAfterStartup())
+		beamApp->PostMessage( B_QUIT_REQUESTED);
+	return B_OK;
+}
+
 /*------------------------------------------------------------------------------*\
 	ReadyToRun()
 		-	ensures that main-window is visible
@@ -764,6 +820,14 @@ void BeamApplication::ReadyToRun() {
 		TheMainWindow->SendBehind( mMailWin);
 		mMailWin = NULL;
 	}
+	if (TheProfiler && TheProfiler->IsRecording()) {
+		// the main-window only is ready once it shows the mail-folders, which
+		// are being read in the background, so we wait for that elsewhere:
+		thread_id tid = spawn_thread( &EndStartupProfile, "StartupProfiler", 
+												B_LOW_PRIORITY, NULL);
+		if (tid < 0 || resume_thread( tid) != B_OK)
+			EndStartupProfile( NULL);
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -789,8 +853,10 @@ thread_id BeamApplication::Run() {
 			// Now wait until Test-thread allows us to start...
 			snooze( 200*1000);
 			mStartupLocker->Lock();
-		} else if (ThePrefs->GetBool( "UseDeskbar"))
+		} else if (ThePrefs->GetBool( "UseDeskbar")) {
+			BM_PROFILE_SPAN( "deskbar-item");
 			InstallDeskbarItem();
+		}
 
 		// start most of our list-models:
 		BM_LOG( BM_LogApp, BmString(B_UTF8_ELLIPSIS "reading receving accounts" B_UTF8_ELLIPSIS));
@@ -816,10 +882,15 @@ thread_id BeamApplication::Run() {
 		ThePeopleList->StartJobInNewThread();
 
 		BM_LOG( BM_LogApp, BmString("Showing main window."));
-		TheMainWindow->Show();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "showing main-window");
+			TheMainWindow->Show();
+		}
 
 		tid = inherited::Run();
 
+		BM_PROFILE_SPAN( "storing prefs & lists");
+
 		ThePrefs->Store();
 			// always store prefs since it contains references to
 			// list-items that are tracked via foreign-keys. If the
@@ -839,6 +910,23 @@ thread_id BeamApplication::Run() {
 		ThePeopleList->StoreIfNeeded();
 			// store people-list since new known addresses may have
 			// been added
+		// the mailref-lists are stored by a couple of threads, such that 
+		// quitting isn't held up by storing one list after the other. Only
+		// these may miss the deadline, as their caches can be rebuilt from
+		// the mail-files (the lists above are small, but can't be rebuilt):
+		vector< BmRef< BmListModel> > lists;
+		if (TheMailRefListResidency)
+			TheMailRefListResidency->CollectLoadedLists( lists);
+			// store all mailref-lists that have changed
+		int32 missedCount = BmListModel::StoreInParallel( 
+			lists, ThePrefs->GetInt( "ShutdownStoreThreads", 4),
+			bigtime_t( ThePrefs->GetInt( "ShutdownStoreDeadline", 5)) * 1000*1000
+		);
+		if (missedCount)
+			BM_LOG( BM_LogApp, 
+					  BmString() << missedCount 
+					  		<< " mailref-lists could not be stored in time, "
+					  			"their caches will be rebuilt.");
 	} catch( BM_error &e) {
 		BM_SHOWERR( e.what());
 		exit(10);
@@ -883,6 +971,8 @@ void BeamApplication::RemoveDeskbarItem() {
 bool BeamApplication::QuitRequested() {
 	BM_LOG( BM_LogApp, "App: quit requested, checking state" B_UTF8_ELLIPSIS);
 	mIsQuitting = true;
+	if (TheProfiler)
+		TheProfiler->BeginPhase( BmProfiler::SHUTDOWN_PHASE);
 	bool shouldQuit = true;
 	if (TheMailMonitor->LockLooper()) {
 
@@ -915,8 +1005,19 @@ bool BeamApplication::QuitRequested() {
 			TheMailMonitor->UnlockLooper();
 			mIsQuitting = false;
 		} else {
-			TheStoredActionFlusher->Quit();
-			TheMailMonitor->Quit();
+			{	// scope for profile-span
+				BM_PROFILE_SPAN( "stored-action flusher");
+				TheStoredActionFlusher->Quit();
+			}
+			if (TheMailIndexer) {
+				BM_PROFILE_SPAN( "mail-indexer");
+				TheMailIndexer->Quit();
+			}
+			{	// scope for profile-span
+				BM_PROFILE_SPAN( "mail-monitor");
+				TheMailMonitor->Quit();
+			}
+			BM_PROFILE_SPAN( "closing windows");
 			for( int32 i=count-1; i>=0; --i) {
 				BWindow* win = beamApp->WindowAt( i);
 				if (win) {
@@ -930,6 +1031,8 @@ bool BeamApplication::QuitRequested() {
 		// there might be slaves running, give them some more time to stop.
 	BM_LOG( BM_LogApp, 
 			  shouldQuit ? "ok, app is quitting" : "no, app isn't quitting");
+	if (!shouldQuit && TheProfiler)
+		TheProfiler->CancelPhase();
 	return shouldQuit;
 }
 
@@ -937,10 +1040,17 @@ bool BeamApplication::QuitRequested() {
 	ArgvReceived( argc, argv)
 		-	first argument is interpreted to be a destination mail-address, so a 
 			new mail is generated for if an argument has been provided
+		-	--profile-startup is skipped, as that is handled by main()
 \*------------------------------------------------------------------------------*/
 void BeamApplication::ArgvReceived( int32 argc, char** argv) {
 	if (argc>1 && !BeamInTestMode) {
 		BmString arg( argv[1]);
+		if (arg == BmProfiler::PROFILE_STARTUP_ARG) {
+			// handled by main(), the address (if any) follows:
+			if (argc < 3)
+				return;
+			arg = argv[2];
+		}
 		if (arg.ICompare("mailto:",7)==0)
 			LaunchURL( arg);
 		else {
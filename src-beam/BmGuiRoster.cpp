@@ -32,6 +32,7 @@ using namespace regexx;
 #include "BmMail.h"
 #include "BmMailEditWin.h"
 #include "BmMailFolderList.h"
+#include "BmMailIndexer.h"
 #include "BmMailRefFilterControl.h"
 #include "BmMailRefViewFilterControl.h"
 #include "BmMenuControllerBase.h"
@@ -557,9 +558,10 @@ void BmGuiRoster::RebuildMailRefViewFilterMenu( BmMenuControllerBase* menu)
 	for( int i=0; choices[i]; ++i) {
 		BMessage* msg = new BMessage(*(menu->MsgTemplate()));
 		BMenuItem* item = new BMenuItem(choices[i], msg);
-// TODO: remove, once it is implemented
-if (i==1)
-	item->SetEnabled(false);
+		// searching the mail-text requires the index:
+		if (choices[i] == BmMailRefItemFilter::FILTER_MAILTEXT 
+		&& !TheMailIndexer)
+			item->SetEnabled(false);
 		item->SetTarget( menu->MsgTarget());
 		menu->AddItem( item);
 	}
@@ -43,6 +43,27 @@ BmViewItemFilter::~BmViewItemFilter()
 {
 }
 
+/*------------------------------------------------------------------------------*\
+	Narrows(previousFilter)
+		-	returns true if every item matched by this filter is matched by the
+			given previous filter, too (e.g. because the filter text has just
+			been extended). In that case, only the items that passed the
+			previous filter need to be checked.
+\*------------------------------------------------------------------------------*/
+bool BmViewItemFilter::Narrows(const BmViewItemFilter* /*previousFilter*/) const
+{
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	AppliedToAllItems()
+		-	hook that is called once the filter has been applied to all items,
+			from then on the filter will only be used for items added later
+\*------------------------------------------------------------------------------*/
+void BmViewItemFilter::AppliedToAllItems()
+{
+}
+
 
 
 /********************************************************************************\
@@ -149,6 +170,7 @@ void BmListViewItem::SetTextCols( int16 firstTextCol, const char** content) {
 BmViewItemManager::BmViewItemManager()
 	:	mLocker("ViewItemManagerLock")
 	,	mFilter(NULL)
+	,	mFilterIsComplete(true)
 {
 }
 
@@ -260,17 +282,27 @@ bool BmViewItemManager::ApplyFilter(BmViewItemFilter* filter,
 				"BmViewItemManager::ApplyFilter(): Unable to get lock"
 			);
 	
+		// if the new filter narrows the one that has been completely applied
+		// before, all items that are hidden now will stay hidden:
+		bool onlyVisibleItems = filter && mFilter && mFilterIsComplete
+											&& filter->Narrows(mFilter);
 		if (filter != mFilter) {
 			delete mFilter;
 			mFilter = filter;
 		}
+		mFilterIsComplete = false;
 	
 		for(iter = mViewModelMap.begin(); iter != mViewModelMap.end(); ++iter) {
 			viewItem = iter->second;
 			if (!viewItem || !continueCallback())
 				return false;
+			if (onlyVisibleItems && viewItem->ShouldBeHidden())
+				continue;
 			viewItem->ShouldBeHidden(mFilter && !mFilter->Matches(viewItem));
 		}
+		mFilterIsComplete = true;
+		if (mFilter)
+			mFilter->AppliedToAllItems();
 	}
 	
 	/* The result of filter application will be changes to the shouldBeHidden
@@ -105,6 +105,8 @@ public:
 	virtual ~BmViewItemFilter();
 	
 	virtual bool Matches(const BmListViewItem* viewItem) const = 0;
+	virtual bool Narrows(const BmViewItemFilter* previousFilter) const;
+	virtual void AppliedToAllItems();
 
 private:
 };
@@ -141,6 +143,8 @@ private:
 	BmViewModelMap mViewModelMap;
 	mutable BLocker mLocker;
 	mutable BmViewItemFilter* mFilter;
+	bool mFilterIsComplete;
+							// true if mFilter has been applied to all items
 };
 
 /*------------------------------------------------------------------------------*\
@@ -17,6 +17,7 @@
 #include "BmJobStatusWin.h"
 #include "BmLogHandler.h"
 #include "BmMailFolder.h"
+#include "BmMailFolderCompressor.h"
 #include "BmMailFolderList.h"
 #include "BmMailFolderView.h"
 #include "BmMailMover.h"
@@ -509,6 +510,18 @@ void BmMailFolderView::MessageReceived( BMessage* msg) {
 					mPartnerMailRefView->StartJob();
 				break;
 			}
+			case BMM_COMPRESS_MAILFOLDER: {
+				folder = CurrentFolder();
+				if (!folder)
+					return;
+				// converting the mails may take a while, so we do that
+				// in the background (the job keeps itself alive):
+				BmRef<BmMailFolderCompressor> compressor 
+					= new BmMailFolderCompressor( folder.Get(), 
+															!folder->IsCompressed());
+				compressor->StartJobInNewThread();
+				break;
+			}
 			case BMM_CONNECT_LAYOUT: {
 				folder = CurrentFolder();
 				if (!folder)
@@ -654,6 +667,13 @@ void BmMailFolderView::ShowMenu( BPoint point) {
 									 new BMessage( BMM_RECACHE_MAILFOLDER));
 		item->SetTarget( this);
 		theMenu->AddItem( item);
+
+		item = new BMenuItem( "Compress mails", 
+									 new BMessage( BMM_COMPRESS_MAILFOLDER));
+		if (folder->IsCompressed())
+			item->SetMarked( true);
+		item->SetTarget( this);
+		theMenu->AddItem( item);
 	}
 
    ConvertToScreen(&point);
@@ -15,7 +15,10 @@
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmMailFolder.h"
+#include "BmMailFolderList.h"
+#include "BmMailMonitor.h"
 #include "BmMailMover.h"
+#include "BmStorageUtil.h"
 #include "BmUtil.h"
 
 // standard logfile-name for this class:
@@ -24,6 +27,9 @@
 
 static const float GRAIN = 1.0f;
 
+// number of mails after which the mailref-lists are updated:
+static const int32 BATCH_SIZE = 100;
+
 const char* const BmMailMover::MSG_MOVER = 		"bm:mover";
 const char* const BmMailMover::MSG_DELTA = 		"bm:delta";
 const char* const BmMailMover::MSG_TRAILING = 	"bm:trailing";
@@ -69,6 +75,10 @@ bool BmMailMover::StartJob() {
 	BEntry entry;
 	node_ref destNodeRef;
 	destDir.GetNodeRef( &destNodeRef);
+	node_ref nref;
+	node_ref srcNodeRef;
+	BmString srcKey;
+	bool srcIsKnown = false;
 	// move each mailref into the destination folder:
 	try {
 		int32 i;
@@ -82,6 +92,24 @@ bool BmMailMover::StartJob() {
 				BM_THROW_RUNTIME( BmString("couldn't create entry for <")
 											<< ref->name << "> \n\nError:" 
 											<< strerror(err));
+			if (ref->directory != srcNodeRef.node 
+			|| ref->device != srcNodeRef.device || !srcKey.Length()) {
+				// mails may come from outside of the mailbox (e.g. when
+				// dropped from Tracker), those are left to the mail-monitor:
+				srcNodeRef.device = ref->device;
+				srcNodeRef.node = ref->directory;
+				srcKey = BM_REFKEY( srcNodeRef);
+				srcIsKnown 
+					= TheMailFolderList 
+						&& TheMailFolderList->FindItemByKey( srcKey);
+			}
+			bool updateRefLists 
+				= srcIsKnown && TheMailMonitor && entry.GetNodeRef( &nref) == B_OK;
+			// the move-event may well be handled before MoveTo() returns, so
+			// we have to register the mail beforehand (and unregister it if 
+			// the move fails):
+			if (updateRefLists)
+				TheMailMonitor->IgnoreMailMove( nref);
 			err = entry.MoveTo( &destDir);
 			if ( err == B_FILE_EXISTS) {
 				// increment counter until we have found a unique name:
@@ -92,25 +120,40 @@ bool BmMailMover::StartJob() {
 				)) == B_FILE_EXISTS)
 					;
 			}
-			if (err != B_OK)
+			if (err != B_OK) {
+				if (updateRefLists)
+					TheMailMonitor->UnignoreMailMove( nref);
 				throw BM_runtime_error(
 					BmString("couldn't move <") << ref->name << "> \n\nError:" 
 						<< strerror(err)
 				);
+			}
+			if (updateRefLists) {
+				BmMailFileInfo info;
+				if (entry.GetRef( &info.eref) == B_OK 
+				&& entry.GetStat( &info.st) == B_OK)
+					mAddedFiles.push_back( info);
+				mRemovedRefs[srcKey].push_back( nref);
+				if (mAddedFiles.size() >= uint32(BATCH_SIZE))
+					_UpdateRefLists();
+			}
 			if ((i+1)%(int)GRAIN == 0) {
 				entry.GetName( filename);
 				BmString currentCount = BmString()<<i<<" of "<<mRefCount;
 				UpdateStatus( delta, filename, currentCount.String());
 			}
-			snooze( 20*1000);
-							// give node-monitor a chance to keep up... 
-							// (it will drop messages if we go too fast)
 		}
+		_UpdateRefLists();
 		entry.GetName( filename);
 		BmString currentCount = BmString()<<i<<" of "<<mRefCount;
 		UpdateStatus( delta, filename, currentCount.String());
 	}
 	catch( BM_runtime_error &err) {
+		// the mails that have been moved so far still need to be updated:
+		try {
+			_UpdateRefLists();
+		} catch( BM_error&) {
+		}
 		// a problem occurred, we tell the user:
 		BmString errstr = err.what();
 		BmString text = Name() << "\n\n" << errstr;
@@ -120,6 +163,28 @@ bool BmMailMover::StartJob() {
 	return true;
 }
 
+/*------------------------------------------------------------------------------*\
+	_UpdateRefLists()
+		-	removes the mails moved since the last call from the mailref-lists
+			of their source folders and adds them to the list of the 
+			destination folder, locking each list only once
+\*------------------------------------------------------------------------------*/
+void BmMailMover::_UpdateRefLists() {
+	RemovedRefsMap::iterator iter;
+	for( iter = mRemovedRefs.begin(); iter != mRemovedRefs.end(); ++iter) {
+		BmRef<BmListModelItem> item 
+			= TheMailFolderList->FindItemByKey( iter->first);
+		BmMailFolder* srcFolder = dynamic_cast< BmMailFolder*>( item.Get());
+		if (srcFolder)
+			srcFolder->RemoveMailRefs( iter->second);
+	}
+	mRemovedRefs.clear();
+	if (!mAddedFiles.empty()) {
+		mDestFolder->AddMailRefs( mAddedFiles);
+		mAddedFiles.clear();
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	UpdateStatus()
 		-	informs the interested party about a change in the current state
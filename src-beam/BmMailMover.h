@@ -9,11 +9,18 @@
 #ifndef _BmMailMover_h
 #define _BmMailMover_h
 
+#include <map>
+#include <vector>
+
 #include <Message.h>
 
 #include "BmDataModel.h"
+#include "BmMailRefList.h"
 #include "BmUtil.h"
 
+using std::map;
+using std::vector;
+
 enum {
 	BM_JOBWIN_MOVEMAILS = 'bmec'
 						// sent to JobMetaController in order to move mails
@@ -26,6 +33,9 @@ class BmMailFolder;
 		-	implements the moving of mails inside the file-system
 		-	in general, each BmMailMover is started as a thread which exits when 
 			the moving-operation has ended
+		-	mails are moved in batches, after each batch the mailref-lists of
+			the folders involved are updated directly (the corresponding 
+			node-monitor events are ignored by the mail-monitor)
 \*------------------------------------------------------------------------------*/
 class BmMailMover : public BmJobModel {
 	typedef BmJobModel inherited;
@@ -51,11 +61,18 @@ public:
 private:
 	void UpdateStatus( const float delta, const char* filename, 
 							 const char* currentCount);
+	void _UpdateRefLists();
 	
 	entry_ref* mRefs;
 	int32 mRefCount;
 	BmMailFolder* mDestFolder;
 
+	typedef map< BmString, vector< node_ref> > RemovedRefsMap;
+	RemovedRefsMap mRemovedRefs;
+							// mails moved out of each source folder (by folder-key)
+	BmMailFileInfoVect mAddedFiles;
+							// mails moved into the destination folder
+
 	// Hide copy-constructor and assignment:
 	BmMailMover( const BmMailMover&);
 	BmMailMover operator=( const BmMailMover&);
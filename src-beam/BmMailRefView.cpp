@@ -224,6 +224,36 @@ void BmMailRefItem::UpdateView( BmUpdFlags flags, bool redraw,
 	inherited::UpdateView( flags, redraw, updColBitmap);
 }
 
+/*------------------------------------------------------------------------------*\
+	CompareItems()
+		-	compares the text-columns that have a collation-key via these keys,
+			all other columns are handled by the base-class
+\*------------------------------------------------------------------------------*/
+int BmMailRefItem::CompareItems( const CLVListItem *a_Item1, 
+											const CLVListItem *a_Item2, 
+											int32 KeyColumn, int32 col_flags) {
+	BmMailRef::BmCollationField field;
+	switch( KeyColumn) {
+		case COL_SUBJECT:		field = BmMailRef::COLL_SUBJECT; break;
+		case COL_FROM:			field = BmMailRef::COLL_FROM; break;
+		case COL_TO:			field = BmMailRef::COLL_TO; break;
+		case COL_CC:			field = BmMailRef::COLL_CC; break;
+		case COL_REPLY_TO:	field = BmMailRef::COLL_REPLY_TO; break;
+		case COL_NAME:			field = BmMailRef::COLL_NAME; break;
+		default:
+			return CLVEasyItem::CompareItems( a_Item1, a_Item2, KeyColumn, 
+														 col_flags);
+	}
+	const BmMailRefItem* item1 = static_cast<const BmMailRefItem*>( a_Item1);
+	const BmMailRefItem* item2 = static_cast<const BmMailRefItem*>( a_Item2);
+	BmMailRef* ref1 = item1 ? item1->ModelItem() : NULL;
+	BmMailRef* ref2 = item2 ? item2->ModelItem() : NULL;
+	if (!ref1 || !ref2)
+		return 0;
+	return strcmp( ref1->CollationKey( field).String(), 
+						ref2->CollationKey( field).String());
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -232,15 +262,17 @@ const int32 BmMailRefItem::GetNumValueForColumn( int32 column_index) const {
 	BmMailRef* ref( ModelItem());
 	if (column_index == COL_STATUS_I || column_index == COL_STATUS) {
 		// status
-		BmString st = ref->Status();
-		return st == BM_MAIL_STATUS_NEW			? 0 :
-				 st == BM_MAIL_STATUS_DRAFT		? 1 :
-				 st == BM_MAIL_STATUS_PENDING		? 2 :
-				 st == BM_MAIL_STATUS_READ			? 3 :
-				 st == BM_MAIL_STATUS_SENT			? 4 : 
-				 st == BM_MAIL_STATUS_FORWARDED	? 5 :
-				 st == BM_MAIL_STATUS_REPLIED		? 6 :
-				 st == BM_MAIL_STATUS_REDIRECTED	? 7 : 99;
+		switch( ref->StatusCode()) {
+			case BmMailRef::STATUS_NEW:			return 0;
+			case BmMailRef::STATUS_DRAFT:			return 1;
+			case BmMailRef::STATUS_PENDING:		return 2;
+			case BmMailRef::STATUS_READ:			return 3;
+			case BmMailRef::STATUS_SENT:			return 4;
+			case BmMailRef::STATUS_FORWARDED:	return 5;
+			case BmMailRef::STATUS_REPLIED:		return 6;
+			case BmMailRef::STATUS_REDIRECTED:	return 7;
+			default:										return 99;
+		}
 	} else if (column_index == COL_ATTACHMENTS_I 
 	|| column_index == COL_ATTACHMENTS) {
 		return ref->HasAttachments() ? 0 : 1;	
@@ -303,7 +335,8 @@ const char* BmMailRefItem::GetUserText(int32 colIdx, float colWidth) const {
 		text = mWhenStringAdjuster( colIdx, ref->When());
 		break;
 	case COL_SIZE:
-		text = ref->SizeString().String();
+		mFormattedText = ref->SizeString();
+		text = mFormattedText.String();
 		break;
 	case COL_CC:
 		text = ref->Cc().String();
@@ -343,13 +376,14 @@ const char* BmMailRefItem::GetUserText(int32 colIdx, float colWidth) const {
 		break;
 	case COL_CLASSIFICATION:
 		if (ThePrefs->GetBool("MapClassificationGenuineToTofu", true)
-		&& ref->Classification() == BM_MAIL_CLASS_TOFU)
+		&& ref->ClassificationCode() == BmMailRef::CLASS_TOFU)
 			text = "Tofu";
 		else
 			text = ref->Classification().String();
 		break;
 	case COL_RATIO_SPAM:
-		text = ref->RatioSpamString().String();
+		mFormattedText = ref->RatioSpamString();
+		text = mFormattedText.String();
 		break;
 	default:
 		return "";
@@ -499,7 +533,7 @@ BmMailRefView::BmMailRefView( int32 width, int32 height)
 	AddColumn( new CLVColumn( "RatioSpam", 100.0, flags | CLV_COLDATA_NUMBER 
 										| CLV_RIGHT_JUSTIFIED| CLV_COLTYPE_USERTEXT, 
 									  40.0));
-	SetSortFunction( CLVEasyItem::CompareItems);
+	SetSortFunction( BmMailRefItem::CompareItems);
 	SetSortKey( COL_WHEN_CREATED);
 	SetSortMode( COL_WHEN_CREATED, Descending, false);
 	int32 displayOrder[] = {
@@ -65,6 +65,10 @@ public:
 	void FitDateIntoColumn(int32 colIdx, time_t utc, 
 								  BmString& dateStr) const;
 
+	static int CompareItems( const CLVListItem *a_Item1, 
+									 const CLVListItem *a_Item2,
+									 int32 KeyColumn, int32 col_flags);
+
 	// overrides of CLVEasyItem base:
 	const int32 GetNumValueForColumn( int32 column_index) const;
 	const time_t GetDateValueForColumn( int32 column_index) const;
@@ -74,6 +78,8 @@ public:
 private:
 	mutable BmDateWidthAdjuster mWhenStringAdjuster;
 	mutable BmDateWidthAdjuster mWhenCreatedStringAdjuster;
+	mutable BmString mFormattedText;
+							// buffer for texts that are formatted on demand
 
 	// Hide copy-constructor and assignment:
 	BmMailRefItem( const BmMailRefItem&);
@@ -93,9 +93,14 @@ void BmMailRefViewFilterControl::MessageReceived(BMessage* msg) {
 						= content.Length() > 0
 							? new BmMailRefItemFilter(kind, content)
 							: NULL;
-					StartJob(
-						new BmMailRefViewFilterJob(filter, mPartnerMailRefView)
-					);
+					if (filter && kind == BmMailRefItemFilter::FILTER_MAILTEXT)
+						StartJob(
+							new BmMailRefViewSearchJob(filter, mPartnerMailRefView)
+						);
+					else
+						StartJob(
+							new BmMailRefViewFilterJob(filter, mPartnerMailRefView)
+						);
 					mLastKind = kind;
 					mLastContent = content;
 				}
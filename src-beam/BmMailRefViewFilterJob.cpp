@@ -11,7 +11,9 @@
 
 #include "BmBasics.h"
 #include "BmLogHandler.h"
+#include "BmMailIndexer.h"
 #include "BmMailRef.h"
+#include "BmMailRefList.h"
 #include "BmMailRefViewFilterJob.h"
 
 				
@@ -32,6 +34,7 @@ BmMailRefItemFilter::BmMailRefItemFilter(const BmString& filterKind,
 													  const BmString& filterText)
 	:	mFilterKind(filterKind)
 	,	mFilterText(filterText)
+	,	mHaveCandidates(false)
 {
 }
 
@@ -43,6 +46,20 @@ BmMailRefItemFilter::~BmMailRefItemFilter()
 {
 }
 
+/*------------------------------------------------------------------------------*\
+	SetCandidateNodes(nodes)
+		-	sets the nodes of the only mails that can match:
+			for FILTER_MAILTEXT, these are the mails that have been found by 
+			searching the mail-text index;
+			for FILTER_SUBJECT_OR_ADDRESS, these are the mails that contain
+			all trigrams of the filter text (which still have to be checked)
+\*------------------------------------------------------------------------------*/
+void BmMailRefItemFilter::SetCandidateNodes(const set<ino_t>& nodes)
+{
+	mCandidateNodes = nodes;
+	mHaveCandidates = true;
+}
+
 /*------------------------------------------------------------------------------*\
 	Matches(viewItem)
 		-	applies the filter against the given item and returns true if the
@@ -57,16 +74,51 @@ bool BmMailRefItemFilter::Matches(const BmListViewItem* viewItem) const
 			// case no filter at all should have been created in the first place
 			return true;
 		}
+		if (mHaveCandidates 
+		&& mCandidateNodes.find(ref->NodeRef().node) == mCandidateNodes.end())
+			return false;
 		if (mFilterKind == FILTER_SUBJECT_OR_ADDRESS) {
 			if (ref->Subject().IFindFirst(mFilterText) >= 0
 			|| ref->From().IFindFirst(mFilterText) >= 0
 			|| ref->To().IFindFirst(mFilterText) >= 0
 			|| ref->Cc().IFindFirst(mFilterText) >= 0)
 				return true;
-		}
+		} else if (mFilterKind == FILTER_MAILTEXT)
+			return mHaveCandidates;
 	}
 	return false;
 }
+
+/*------------------------------------------------------------------------------*\
+	Narrows(previousFilter)
+		-	a subject/address-filter narrows any other such filter whose text 
+			it contains (which is what happens while the user is typing)
+\*------------------------------------------------------------------------------*/
+bool BmMailRefItemFilter::Narrows(const BmViewItemFilter* previousFilter) const
+{
+	const BmMailRefItemFilter* previous 
+		= dynamic_cast<const BmMailRefItemFilter*>(previousFilter);
+	return previous 
+		&& mFilterKind == FILTER_SUBJECT_OR_ADDRESS
+		&& previous->mFilterKind == FILTER_SUBJECT_OR_ADDRESS
+		&& previous->mFilterText.Length() > 0
+		&& mFilterText.IFindFirst(previous->mFilterText) >= 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	AppliedToAllItems()
+		-	the candidates of a subject/address-filter are only valid for the 
+			mails that existed when they were determined, so they are dropped
+			once the filter has been applied, such that mails that are added
+			later are checked completely
+\*------------------------------------------------------------------------------*/
+void BmMailRefItemFilter::AppliedToAllItems()
+{
+	if (mFilterKind == FILTER_SUBJECT_OR_ADDRESS) {
+		mCandidateNodes.clear();
+		mHaveCandidates = false;
+	}
+}
 			
 
 
@@ -113,6 +165,22 @@ bool BmMailRefViewFilterJob::StartJob() {
 	};
 
 	try {
+		// let the trigram-index of the mailref-list narrow down the mails 
+		// that have to be checked by a subject/address-filter:
+		BmMailRefItemFilter* refFilter 
+			= dynamic_cast<BmMailRefItemFilter*>(mFilter);
+		if (refFilter 
+		&& refFilter->FilterKind() 
+			== BmMailRefItemFilter::FILTER_SUBJECT_OR_ADDRESS) {
+			BmRef<BmDataModel> model = mMailRefView->DataModel();
+			BmMailRefList* refList = dynamic_cast<BmMailRefList*>(model.Get());
+			set<ino_t> nodes;
+			if (refList 
+			&& refList->FindFilterCandidates(refFilter->FilterText(), nodes))
+				refFilter->SetCandidateNodes(nodes);
+			if (!ShouldContinue())
+				return false;
+		}
 		ContinueCallback callback(this);
 		return mMailRefView->ApplyViewItemFilter(mFilter, callback);
 	}
@@ -122,3 +190,48 @@ bool BmMailRefViewFilterJob::StartJob() {
 	}
 	return false;
 }
+
+
+
+/********************************************************************************\
+	BmMailRefViewSearchJob
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefViewSearchJob()
+		-	contructor
+\*------------------------------------------------------------------------------*/
+BmMailRefViewSearchJob::BmMailRefViewSearchJob(BmMailRefItemFilter* filter, 
+															  BmMailRefView* mailRefView)
+	:	BmMailRefViewFilterJob(filter, mailRefView)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailRefViewSearchJob()
+		-	destructor
+\*------------------------------------------------------------------------------*/
+BmMailRefViewSearchJob::~BmMailRefViewSearchJob() { 
+}
+
+/*------------------------------------------------------------------------------*\
+	StartJob()
+		-	the job, searches the mail-text index and then applies the filter
+			on all given mail-refs
+\*------------------------------------------------------------------------------*/
+bool BmMailRefViewSearchJob::StartJob() {
+	BmMailRefItemFilter* searchFilter 
+		= dynamic_cast<BmMailRefItemFilter*>(mFilter);
+	if (!searchFilter)
+		return inherited::StartJob();
+	set<ino_t> nodes;
+	if (!TheMailIndexer || !TheMailIndexer->Search(searchFilter->FilterText(),
+																  nodes)) {
+		BM_LOG( BM_LogGui, 
+				  "BmMailRefViewSearchJob: mail-text index is not available");
+	}
+	if (!ShouldContinue())
+		return false;
+	searchFilter->SetCandidateNodes(nodes);
+	return inherited::StartJob();
+}
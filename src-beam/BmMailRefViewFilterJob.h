@@ -9,9 +9,13 @@
 #ifndef _BmMailRefViewFilterJob_h
 #define _BmMailRefViewFilterJob_h
 
+#include <set>
+
 #include "BmListController.h"
 #include "BmMailRefView.h"
 
+using std::set;
+
 /*------------------------------------------------------------------------------*\
 	BmRefItemFilter
 		-	
@@ -22,8 +26,19 @@ public:
 	BmMailRefItemFilter(const BmString& filterKind, const BmString& filterText);
 	virtual ~BmMailRefItemFilter();
 	
+	// native methods:
+	void SetCandidateNodes(const set<ino_t>& nodes);
+
 	// overrides of base
 	virtual bool Matches(const BmListViewItem* viewItem) const;
+	virtual bool Narrows(const BmViewItemFilter* previousFilter) const;
+	virtual void AppliedToAllItems();
+
+	// getters:
+	inline const BmString& FilterKind() const
+													{ return mFilterKind; }
+	inline const BmString& FilterText() const
+													{ return mFilterText; }
 
 	static const char* const FILTER_SUBJECT_OR_ADDRESS;
 	static const char* const FILTER_MAILTEXT;
@@ -31,6 +46,10 @@ public:
 private:
 	BmString mFilterKind;
 	BmString mFilterText;
+	set<ino_t> mCandidateNodes;
+							// mails found by searching the mail-text index or
+							// the trigram-index of the mailref-list
+	bool mHaveCandidates;
 };
 
 /*------------------------------------------------------------------------------*\
@@ -50,13 +69,37 @@ public:
 	// overrides of BmJobModel base:
 	bool StartJob();
 
-private:
+protected:
 	BmViewItemFilter* mFilter;
 	BmMailRefView* mMailRefView;
 
+private:
+
 	// Hide copy-constructor and assignment:
 	BmMailRefViewFilterJob( const BmMailRefViewFilterJob&);
 	BmMailRefViewFilterJob operator=( const BmMailRefViewFilterJob&);
 };
 
+/*------------------------------------------------------------------------------*\
+	BmMailRefViewSearchJob
+		-	searches the mail-text index for the filter's text and then
+			applies the filter (which now knows the matching mails) to the view
+\*------------------------------------------------------------------------------*/
+class BmMailRefViewSearchJob : public BmMailRefViewFilterJob {
+	typedef BmMailRefViewFilterJob inherited;
+
+public:
+	BmMailRefViewSearchJob(BmMailRefItemFilter* filter,
+								  BmMailRefView* mailRefView);
+	virtual ~BmMailRefViewSearchJob();
+
+	// overrides of BmJobModel base:
+	bool StartJob();
+
+private:
+	// Hide copy-constructor and assignment:
+	BmMailRefViewSearchJob( const BmMailRefViewSearchJob&);
+	BmMailRefViewSearchJob operator=( const BmMailRefViewSearchJob&);
+};
+
 #endif
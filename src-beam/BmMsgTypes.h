@@ -23,6 +23,7 @@ enum {
 	BMM_PRINT						= 'bMaf',
 	BMM_PREFERENCES				= 'bMag',
 	BMM_SHOW_LOGFILE				= 'bMah',
+	BMM_COMPRESS_MAILFOLDER		= 'bMai',
 	
 	BMM_FIND							= 'bMba',
 	BMM_FIND_MESSAGES				= 'bMbb',
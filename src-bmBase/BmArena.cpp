@@ -0,0 +1,174 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <cstdlib>
+
+#include <OS.h>
+
+#include "BmArena.h"
+
+/*------------------------------------------------------------------------------*\
+	every chunk is preceded by this header, which tells Free() where the
+	chunk came from (a NULL arena means the chunk lives on the heap).
+	The header is padded such that chunks are 16-byte aligned.
+\*------------------------------------------------------------------------------*/
+union BmArenaChunkHeader {
+	BmArena* arena;
+	char padding[16];
+};
+
+static const size_t nHeaderSize = sizeof(BmArenaChunkHeader);
+
+static inline size_t AlignedSize( size_t size) {
+	return (size + 15) & ~(size_t)15;
+}
+
+BmArena::Stats BmArena::nGlobalStats;
+
+/*------------------------------------------------------------------------------*\
+	BmArena( blockSize)
+		-	c'tor
+		-	the creator owns a reference, which has to be given up via Release()
+\*------------------------------------------------------------------------------*/
+BmArena::BmArena( uint32 blockSize)
+	:	mCurrPos( NULL)
+	,	mBytesLeft( 0)
+	,	mBlockSize( blockSize)
+	,	mRefCount( 1)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmArena()
+		-	d'tor, frees all blocks at once
+\*------------------------------------------------------------------------------*/
+BmArena::~BmArena() {
+	for( uint32 i=0; i<mBlocks.size(); ++i)
+		free( mBlocks[i]);
+}
+
+/*------------------------------------------------------------------------------*\
+	Release()
+		-	the owner gives up its reference to the arena, the memory will be
+			freed as soon as the last chunk has been deleted
+\*------------------------------------------------------------------------------*/
+void BmArena::Release() {
+	_RemoveRef();
+}
+
+/*------------------------------------------------------------------------------*\
+	GlobalStats()
+		-	returns the accumulated statistics of all arenas
+\*------------------------------------------------------------------------------*/
+BmArena::Stats BmArena::GlobalStats() {
+	return nGlobalStats;
+}
+
+/*------------------------------------------------------------------------------*\
+	StatsString( stats, since)
+		-	returns the given statistics formatted for the log
+		-	if since is given, only the difference to it is shown (e.g. the
+			usage of a job, when since has been fetched via GlobalStats() 
+			at its start)
+\*------------------------------------------------------------------------------*/
+BmString BmArena::StatsString( const Stats& stats, const Stats& since) {
+	return BmString() << stats.allocCount - since.allocCount << " objects, " 
+		<< stats.bytesAllocated - since.bytesAllocated << " bytes in "
+		<< stats.blockCount - since.blockCount << " blocks (" 
+		<< stats.bytesReserved - since.bytesReserved << " bytes reserved)";
+}
+
+/*------------------------------------------------------------------------------*\
+	Allocate( arena, size)
+		-	allocates a chunk of the given size from the given arena or from
+			the heap (if arena is NULL)
+		-	throws std::bad_alloc if no memory is left, as operator new should
+\*------------------------------------------------------------------------------*/
+void* BmArena::Allocate( BmArena* arena, size_t size) {
+	BmArenaChunkHeader* header;
+	if (arena)
+		header = static_cast<BmArenaChunkHeader*>(
+			arena->_Allocate( nHeaderSize + AlignedSize( size))
+		);
+	else
+		header = static_cast<BmArenaChunkHeader*>(
+			malloc( nHeaderSize + size)
+		);
+	if (!header)
+		throw std::bad_alloc();
+	header->arena = arena;
+	return reinterpret_cast<char*>( header) + nHeaderSize;
+}
+
+/*------------------------------------------------------------------------------*\
+	Free( ptr)
+		-	frees the given chunk (heap) or drops the arena's reference for it
+\*------------------------------------------------------------------------------*/
+void BmArena::Free( void* ptr) {
+	if (!ptr)
+		return;
+	BmArenaChunkHeader* header = reinterpret_cast<BmArenaChunkHeader*>(
+		static_cast<char*>( ptr) - nHeaderSize
+	);
+	if (header->arena)
+		header->arena->_RemoveRef();
+	else
+		free( header);
+}
+
+/*------------------------------------------------------------------------------*\
+	_Allocate( size)
+		-	hands out the given number of bytes from the current block,
+			starting a new block if required
+		-	chunks larger than a quarter of the blocksize get a block of
+			their own, such that the current block isn't wasted
+\*------------------------------------------------------------------------------*/
+void* BmArena::_Allocate( size_t size) {
+	char* chunk;
+	if (size > mBlockSize/4) {
+		chunk = static_cast<char*>( malloc( size));
+		if (!chunk)
+			return NULL;
+		mBlocks.push_back( chunk);
+		mStats.bytesReserved += size;
+		atomic_add64( &nGlobalStats.bytesReserved, size);
+		atomic_add64( &nGlobalStats.blockCount, 1);
+	} else {
+		if (size > mBytesLeft) {
+			mCurrPos = static_cast<char*>( malloc( mBlockSize));
+			if (!mCurrPos) {
+				mBytesLeft = 0;
+				return NULL;
+			}
+			mBlocks.push_back( mCurrPos);
+			mBytesLeft = mBlockSize;
+			mStats.bytesReserved += mBlockSize;
+			atomic_add64( &nGlobalStats.bytesReserved, mBlockSize);
+			atomic_add64( &nGlobalStats.blockCount, 1);
+		}
+		chunk = mCurrPos;
+		mCurrPos += size;
+		mBytesLeft -= size;
+	}
+	mStats.blockCount = mBlocks.size();
+	mStats.allocCount++;
+	mStats.bytesAllocated += size;
+	atomic_add64( &nGlobalStats.allocCount, 1);
+	atomic_add64( &nGlobalStats.bytesAllocated, size);
+	atomic_add( &mRefCount, 1);
+	return chunk;
+}
+
+/*------------------------------------------------------------------------------*\
+	_RemoveRef()
+		-	drops one reference, deleting the arena when the last one is gone
+\*------------------------------------------------------------------------------*/
+void BmArena::_RemoveRef() {
+	if (atomic_add( &mRefCount, -1) == 1)
+		delete this;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmArena_h
+#define _BmArena_h
+
+#include <SupportDefs.h>
+
+#include <new>
+#include <vector>
+
+#include "BmBase.h"
+#include "BmString.h"
+
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	class BmArena
+		-	a monotonic allocator that hands out memory from large blocks and
+			releases all of it in one go.
+		-	every chunk carries a pointer to its arena, so objects can be
+			deleted normally (which is a no-op with respect to the memory).
+			The blocks are freed once the owner has called Release() *and*
+			all chunks have been deleted, so objects may safely outlive
+			the owner of the arena.
+		-	allocation is not thread-safe (only the owner's thread may
+			allocate), deletion is.
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmArena {
+
+public:
+	struct Stats {
+		Stats()
+			:	allocCount( 0)
+			,	bytesAllocated( 0)
+			,	bytesReserved( 0)
+			,	blockCount( 0)					{}
+		int64 allocCount;
+		int64 bytesAllocated;
+		int64 bytesReserved;
+		int64 blockCount;
+	};
+
+	BmArena( uint32 blockSize = 16384);
+
+	// native methods:
+	void Release();
+	//
+	static void* Allocate( BmArena* arena, size_t size);
+	static void Free( void* ptr);
+
+	// getters:
+	inline const Stats& ArenaStats() const
+													{ return mStats; }
+	static Stats GlobalStats();
+	static BmString StatsString( const Stats& stats, 
+										  const Stats& since = Stats());
+
+private:
+	~BmArena();
+	void* _Allocate( size_t size);
+	void _RemoveRef();
+
+	typedef vector< char*> BlockVect;
+	BlockVect mBlocks;
+	char* mCurrPos;
+	size_t mBytesLeft;
+	uint32 mBlockSize;
+	int32 mRefCount;
+	Stats mStats;
+
+	static Stats nGlobalStats;
+
+	// Hide copy-constructor and assignment:
+	BmArena( const BmArena&);
+	BmArena operator=( const BmArena&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BM_ARENA_ALLOCATABLE
+		-	declares class-specific new/delete, such that instances of the class
+			can be allocated from an arena (via "new (arena) Class(...)").
+			A plain "new Class(...)" (or passing a NULL arena) still allocates
+			from the heap.
+\*------------------------------------------------------------------------------*/
+#define BM_ARENA_ALLOCATABLE \
+	static void* operator new( size_t size) \
+		{ return BmArena::Allocate( NULL, size); } \
+	static void* operator new( size_t size, BmArena* arena) \
+		{ return BmArena::Allocate( arena, size); } \
+	static void operator delete( void* ptr) \
+		{ BmArena::Free( ptr); } \
+	static void operator delete( void* ptr, BmArena*) \
+		{ BmArena::Free( ptr); }
+
+#endif
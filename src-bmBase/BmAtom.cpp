@@ -0,0 +1,164 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <map>
+
+#include <Autolock.h>
+#include <Locker.h>
+#include <OS.h>
+
+#include "BmAtom.h"
+
+using std::map;
+
+/*------------------------------------------------------------------------------*\
+	the shared copy of an atom's string
+\*------------------------------------------------------------------------------*/
+struct BmAtom::Entry {
+	Entry( const char* s)
+		:	str( s)
+		,	refCount( 1)						{}
+	BmString str;
+	int32 refCount;
+};
+
+typedef map< BmString, BmAtom::Entry*> BmAtomMap;
+
+/*------------------------------------------------------------------------------*\
+	AtomTable()
+		-	returns the table of all atoms (and the locker protecting it), both 
+			are created on first use, as atoms may be used by static 
+			initializers
+\*------------------------------------------------------------------------------*/
+static BmAtomMap& AtomTable( BLocker** locker = NULL) {
+	static BmAtomMap* atomMap = new BmAtomMap;
+	static BLocker* atomLocker = new BLocker( "AtomTable");
+	if (locker)
+		*locker = atomLocker;
+	return *atomMap;
+}
+
+static const BmString nEmptyString;
+
+/*------------------------------------------------------------------------------*\
+	BmAtom()
+		-	c'tors and d'tor
+\*------------------------------------------------------------------------------*/
+BmAtom::BmAtom()
+	:	mEntry( NULL)
+{
+}
+
+BmAtom::BmAtom( const BmString& str)
+	:	mEntry( _Intern( str.String()))
+{
+}
+
+BmAtom::BmAtom( const char* str)
+	:	mEntry( _Intern( str))
+{
+}
+
+BmAtom::BmAtom( const BmAtom& atom)
+	:	mEntry( atom.mEntry)
+{
+	if (mEntry)
+		atomic_add( &mEntry->refCount, 1);
+}
+
+BmAtom::~BmAtom() {
+	_Release( mEntry);
+}
+
+/*------------------------------------------------------------------------------*\
+	operator=()
+		-	assignment operators
+\*------------------------------------------------------------------------------*/
+BmAtom& BmAtom::operator=( const BmAtom& atom) {
+	if (mEntry != atom.mEntry) {
+		if (atom.mEntry)
+			atomic_add( &atom.mEntry->refCount, 1);
+		_Release( mEntry);
+		mEntry = atom.mEntry;
+	}
+	return *this;
+}
+
+BmAtom& BmAtom::operator=( const BmString& str) {
+	return *this = str.String();
+}
+
+BmAtom& BmAtom::operator=( const char* str) {
+	if (mEntry && mEntry->str == str)
+		return *this;
+	Entry* entry = _Intern( str);
+	_Release( mEntry);
+	mEntry = entry;
+	return *this;
+}
+
+/*------------------------------------------------------------------------------*\
+	String()
+		-	returns the string this atom stands for
+\*------------------------------------------------------------------------------*/
+const BmString& BmAtom::String() const {
+	return mEntry ? mEntry->str : nEmptyString;
+}
+
+/*------------------------------------------------------------------------------*\
+	CountAtoms()
+		-	returns the number of distinct (non-empty) atoms that currently exist
+\*------------------------------------------------------------------------------*/
+int32 BmAtom::CountAtoms() {
+	BLocker* locker;
+	BmAtomMap& atomMap = AtomTable( &locker);
+	BAutolock lock( locker);
+	return atomMap.size();
+}
+
+/*------------------------------------------------------------------------------*\
+	_Intern( str)
+		-	returns the entry for the given string (with an added reference),
+			creating it if necessary
+		-	returns NULL for the empty string
+\*------------------------------------------------------------------------------*/
+BmAtom::Entry* BmAtom::_Intern( const char* str) {
+	if (!str || !*str)
+		return NULL;
+	BLocker* locker;
+	BmAtomMap& atomMap = AtomTable( &locker);
+	BAutolock lock( locker);
+	BmAtomMap::iterator iter = atomMap.find( str);
+	if (iter != atomMap.end()) {
+		atomic_add( &iter->second->refCount, 1);
+		return iter->second;
+	}
+	Entry* entry = new Entry( str);
+	atomMap[entry->str] = entry;
+	return entry;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Release( entry)
+		-	drops a reference to the given entry, which is removed from the 
+			table when its last reference is gone
+		-	N.B.: the reference is dropped while holding the table's lock, such
+			that a concurrent _Intern() can't resurrect an entry that is 
+			being deleted
+\*------------------------------------------------------------------------------*/
+void BmAtom::_Release( Entry* entry) {
+	if (!entry)
+		return;
+	BLocker* locker;
+	BmAtomMap& atomMap = AtomTable( &locker);
+	BAutolock lock( locker);
+	if (atomic_add( &entry->refCount, -1) == 1) {
+		atomMap.erase( entry->str);
+		delete entry;
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmAtom_h
+#define _BmAtom_h
+
+#include <SupportDefs.h>
+
+#include "BmBase.h"
+#include "BmString.h"
+
+/*------------------------------------------------------------------------------*\
+	class BmAtom
+		-	an interned string: all atoms with equal contents share a single,
+			reference-counted copy of the string
+		-	meant for values that occur very often but take only a handful
+			of distinct values (like account- or identity-names), since 
+			an atom is not larger than a pointer
+		-	comparing two atoms is just a pointer comparison
+		-	creating an atom locks the (global) table of atoms, copying and
+			reading an atom does not
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmAtom {
+
+public:
+	struct Entry;
+							// the shared string (opaque)
+
+	BmAtom();
+	BmAtom( const BmString& str);
+	BmAtom( const char* str);
+	BmAtom( const BmAtom& atom);
+	~BmAtom();
+
+	BmAtom& operator=( const BmAtom& atom);
+	BmAtom& operator=( const BmString& str);
+	BmAtom& operator=( const char* str);
+
+	inline bool operator==( const BmAtom& atom) const
+													{ return mEntry == atom.mEntry; }
+	inline bool operator!=( const BmAtom& atom) const
+													{ return mEntry != atom.mEntry; }
+
+	// getters:
+	const BmString& String() const;
+	inline int32 Length() const			{ return String().Length(); }
+
+	static int32 CountAtoms();
+
+private:
+	static Entry* _Intern( const char* str);
+	static void _Release( Entry* entry);
+
+	Entry* mEntry;
+							// NULL for the empty string
+};
+
+#endif
@@ -78,6 +78,9 @@ public:
 	virtual bool Execute( BmMsgContext* msgContext, 
 								 const BMessage* jobSpecs = NULL) = 0;
 	virtual void Initialize()				{}
+	virtual bool IsReentrant() const		{ return false; }
+							// add-ons that can filter several mails at once 
+							// (from different threads) return true here
 	virtual bool SanityCheck( BmString& complaint, BmString& fieldName) = 0;
 	virtual status_t Archive( BMessage* archive, bool deep = true) const = 0;
 	virtual BmString ErrorString() const = 0;
@@ -348,6 +348,15 @@ void BmStringOBuf::Reset() {
 	mCurrPos = 0;
 }
 
+/*------------------------------------------------------------------------------*\
+	Truncate( len)
+		-	drops all data beyond the given length
+\*------------------------------------------------------------------------------*/
+void BmStringOBuf::Truncate( uint32 len) {
+	if (len < mCurrPos)
+		mCurrPos = len;
+}
+
 /*------------------------------------------------------------------------------*\
 	GrowBufferToFit( len)
 		-	makes sure that the buffer is big enough to write the given number
@@ -169,6 +169,7 @@ public:
 																	: (char)mBuf[pos];
 													}
 	void Reset();
+	void Truncate( uint32 len);
 
 	uint32 Write( const char* data, uint32 len);
 	uint32 Write( BmMemIBuf* input, uint32 blockSize=BmMemFilter::nBlockSize);
@@ -26,6 +26,7 @@ using namespace regexx;
 #include "BmFilter.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
+#include "BmMailDedupIndex.h"
 #include "BmNetEndpointRoster.h"
 #include "BmImapAccount.h"
 #include "BmImap.h"
@@ -821,26 +822,36 @@ void BmImap::StateRetrieve()
 		BmRef<BmMail> mail = new BmMail( mAnswerText, mImapAccount->Name());
 		if (mail->InitCheck() != B_OK)
 			goto CLEAN_UP;
-		// ...set IMAP UID - TODO: Use serverUID instead?
-		mail->ImapUID(mMsgUIDs[i]);
-		// ...set the message flags
-		uint32 flags = mMsgFlags[i];
-		if (flags & FLAG_ANSWERED)
-			mail->MarkAs("Replied");
-		else if (flags & FLAG_SEEN)
-			mail->MarkAs("Read");
-		else if (flags & FLAG_DRAFT)
-			mail->MarkAs("Draft");
-		// ...set default folder according to pop-account settings...
-		mail->SetDestFolderName( mImapAccount->HomeFolder());
-		// ...execute mail-filters for this mail...
-		BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
-		mail->ApplyInboundFilters();
-		// ...and store mail on disk:
-		BM_LOG2( BM_LogRecv, "...storing mail...");
-		if (!mail->Store())
-			goto CLEAN_UP;
-		BM_LOG2( BM_LogRecv, "...done");
+		if (TheMailDedupIndex && TheMailDedupIndex->Contains( mail.Get())) {
+			// we have seen this mail before, so we skip it (but still
+			// treat it as being received):
+			BM_LOG2( BM_LogRecv, "...mail is a duplicate, skipping it");
+			TheMailDedupIndex->AddSavings( mAnswerText.Length());
+		} else {
+			bigtime_t startTime = system_time();
+			// ...set IMAP UID - TODO: Use serverUID instead?
+			mail->ImapUID(mMsgUIDs[i]);
+			// ...set the message flags
+			uint32 flags = mMsgFlags[i];
+			if (flags & FLAG_ANSWERED)
+				mail->MarkAs("Replied");
+			else if (flags & FLAG_SEEN)
+				mail->MarkAs("Read");
+			else if (flags & FLAG_DRAFT)
+				mail->MarkAs("Draft");
+			// ...set default folder according to pop-account settings...
+			mail->SetDestFolderName( mImapAccount->HomeFolder());
+			// ...execute mail-filters for this mail...
+			BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
+			mail->ApplyInboundFilters();
+			// ...and store mail on disk:
+			BM_LOG2( BM_LogRecv, "...storing mail...");
+			if (!mail->Store())
+				goto CLEAN_UP;
+			BM_LOG2( BM_LogRecv, "...done");
+			if (TheMailDedupIndex)
+				TheMailDedupIndex->AddProcessingTime( system_time()-startTime);
+		}
 		mImapAccount->MarkUIDAsDownloaded( mMsgUIDs[i]);
 		//	delete the retrieved message if required to do so immediately:
 		BmString log;
@@ -856,6 +867,8 @@ void BmImap::StateRetrieve()
 	if (mNewMsgCount)
 		UpdateMailStatus( 100.0, "done", mNewMsgCount);
 CLEAN_UP:
+	if (TheMailDedupIndex)
+		TheMailDedupIndex->Store();
 	mCurrMailNr = 0;
 }
 
@@ -25,6 +25,8 @@ using namespace regexx;
 #include "BmFilter.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
+#include "BmMailDedupIndex.h"
+#include "BmMailStorer.h"
 #include "BmNetEndpointRoster.h"
 #include "BmPopAccount.h"
 #include "BmPopper.h"
@@ -689,73 +691,154 @@ void BmPopper::StateCleanup() {
 /*------------------------------------------------------------------------------*\
 	StateRetrieve()
 		-	retrieves all new mails from server
+		-	received mails are handed to a mail-storer, which commits them to
+			disk in groups while we go on downloading. A mail is only marked
+			as downloaded (and deleted from the server) once it has been
+			committed
 \*------------------------------------------------------------------------------*/
 void BmPopper::StateRetrieve() {
 	UpdateMailStatus( -1, NULL, 0);
 	BmString cmd;
+	BmMailStorer storer( Name());
+	map< BmString, int32> msgNums;
+	bool ok = true;
+	BmArena::Stats arenaStats = BmArena::GlobalStats();
 	mCurrMailNr = 1;
-	for( int32 i=0; mNewMsgCount>0 && i<mMsgCount; ++i) {
-		if (mPopAccount->IsUIDDownloaded( mMsgUIDs[i])) {
-			// msg is old (according to known UID), we skip it:
-			continue;
-		}
-		cmd = BmString("RETR ") << i+1;
-		SendCommand( cmd);
-		time_t before = time(NULL);
-		if (!CheckForPositiveAnswer( mNewMsgSizes[mCurrMailNr-1], true, true))
-			goto CLEAN_UP;
-		if (mAnswerText.Length() > ThePrefs->GetInt("LogSpeedThreshold",
-																  100*1024)) {
-			time_t after = time(NULL);
-			time_t duration = after-before > 0 ? after-before : 1;
-			// log speed for mails that exceed a certain size:
-			BM_LOG( BM_LogRecv,
-					  BmString("Received mail of size ")<<mAnswerText.Length()
-							<< " bytes in " << duration << " seconds => "
-							<< mAnswerText.Length()/duration/1024.0 << "KB/s");
-		}
-		if (mAnswerText.Length() != mNewMsgSizes[mCurrMailNr-1]) {
-			// as this actually happens (what the heck?) we simply
-			// log it if in verbose mode:
-			BM_LOG2( BM_LogRecv,
-						BmString("Received mail has ") << mAnswerText.Length()
-							<< " bytes but it was announced to have "
-							<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
-			);
+	try {
+		for( int32 i=0; mNewMsgCount>0 && i<mMsgCount; ++i) {
+			if (mPopAccount->IsUIDDownloaded( mMsgUIDs[i])) {
+				// msg is old (according to known UID), we skip it:
+				continue;
+			}
+			cmd = BmString("RETR ") << i+1;
+			SendCommand( cmd);
+			time_t before = time(NULL);
+			if (!CheckForPositiveAnswer( mNewMsgSizes[mCurrMailNr-1], true, 
+												  true)) {
+				ok = false;
+				break;
+			}
+			if (mAnswerText.Length() > ThePrefs->GetInt("LogSpeedThreshold",
+																	  100*1024)) {
+				time_t after = time(NULL);
+				time_t duration = after-before > 0 ? after-before : 1;
+				// log speed for mails that exceed a certain size:
+				BM_LOG( BM_LogRecv,
+						  BmString("Received mail of size ")<<mAnswerText.Length()
+								<< " bytes in " << duration << " seconds => "
+								<< mAnswerText.Length()/duration/1024.0 << "KB/s");
+			}
+			if (mAnswerText.Length() != mNewMsgSizes[mCurrMailNr-1]) {
+				// as this actually happens (what the heck?) we simply
+				// log it if in verbose mode:
+				BM_LOG2( BM_LogRecv,
+							BmString("Received mail has ") << mAnswerText.Length()
+								<< " bytes but it was announced to have "
+								<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
+				);
+			}
+			// now create a mail from the received data...
+			BM_LOG2( BM_LogRecv, "Creating mail...");
+			BmRef<BmMail> mail = new BmMail( mAnswerText, mPopAccount->Name());
+			if (mail->InitCheck() != B_OK) {
+				ok = false;
+				break;
+			}
+			msgNums[mMsgUIDs[i]] = i+1;
+			if (TheMailDedupIndex 
+			&& TheMailDedupIndex->Contains( mail.Get())) {
+				// we have seen this mail before, so we skip it (but still
+				// treat it as being received):
+				BM_LOG2( BM_LogRecv, "...mail is a duplicate, skipping it");
+				TheMailDedupIndex->AddSavings( mAnswerText.Length());
+				if (!storer.Add( NULL, mMsgUIDs[i])
+				|| !CommitStoredMails( storer, msgNums)) {
+					ok = false;
+					break;
+				}
+				mCurrMailNr++;
+				continue;
+			}
+			bigtime_t startTime = system_time();
+			// ...set default folder according to pop-account settings...
+			mail->SetDestFolderName( mPopAccount->HomeFolder());
+			// ...execute mail-filters for this mail...
+			BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
+			mail->ApplyInboundFilters();
+			// ...and hand mail over to the storer:
+			BM_LOG2( BM_LogRecv, "...storing mail...");
+			if (!storer.Add( mail.Get(), mMsgUIDs[i])
+			|| !CommitStoredMails( storer, msgNums)) {
+				ok = false;
+				break;
+			}
+			if (TheMailDedupIndex)
+				TheMailDedupIndex->AddProcessingTime( system_time()-startTime);
+			BM_LOG2( BM_LogRecv, "...done");
+			mCurrMailNr++;
 		}
-		// now create a mail from the received data...
-		BM_LOG2( BM_LogRecv, "Creating mail...");
-		BmRef<BmMail> mail = new BmMail( mAnswerText, mPopAccount->Name());
-		if (mail->InitCheck() != B_OK)
-			goto CLEAN_UP;
-		// ...set default folder according to pop-account settings...
-		mail->SetDestFolderName( mPopAccount->HomeFolder());
-		// ...execute mail-filters for this mail...
-		BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
-		mail->ApplyInboundFilters();
-		// ...and store mail on disk:
-		BM_LOG2( BM_LogRecv, "...storing mail...");
-		if (!mail->Store())
-			goto CLEAN_UP;
-		BM_LOG2( BM_LogRecv, "...done");
-		mPopAccount->MarkUIDAsDownloaded( mMsgUIDs[i]);
-		//	delete the retrieved message if required to do so immediately:
+		// wait for the last group to be committed:
+		ok = storer.Flush() && CommitStoredMails( storer, msgNums) && ok;
+	} catch(...) {
+		// mails that made it to disk must not be fetched again, but we 
+		// do not talk to the server anymore:
+		storer.Flush();
+		CommitStoredMails( storer, msgNums, false);
+		if (TheMailDedupIndex)
+			TheMailDedupIndex->Store();
+		mCurrMailNr = 0;
+		throw;
+	}
+	if (TheMailDedupIndex)
+		TheMailDedupIndex->Store();
+	if (ok && mNewMsgCount)
+		UpdateMailStatus( 100.0, "done", mNewMsgCount);
+	if (mNewMsgCount) {
+		BmArena::Stats totalStats = BmArena::GlobalStats();
+		BM_LOG( BM_LogRecv, 
+				  BmString("Parse-arenas of received mails: ") 
+				  		<< BmArena::StatsString( totalStats, arenaStats)
+				  		<< ", total: " << BmArena::StatsString( totalStats));
+	}
+	mCurrMailNr = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	CommitStoredMails( storer, msgNums, mayDelete)
+		-	marks all mails that have been committed by the given storer as 
+			being downloaded
+		-	if mayDelete is set, the committed mails are deleted from the 
+			server if the account is configured to do so
+		-	msgNums maps each UID to the message-number on the server
+		-	returns false if the server refused to delete a mail
+\*------------------------------------------------------------------------------*/
+bool BmPopper::CommitStoredMails( BmMailStorer& storer, 
+											 const map< BmString, int32>& msgNums,
+											 bool mayDelete) {
+	vector< BmString> uids;
+	storer.FetchCommittedUIDs( uids);
+	for( uint32 i=0; i<uids.size(); ++i)
+		mPopAccount->MarkUIDAsDownloaded( uids[i]);
+	if (!mayDelete)
+		return true;
+	//	delete the committed messages if required to do so immediately:
+	BmString cmd;
+	for( uint32 i=0; i<uids.size(); ++i) {
 		BmString log;
 		bool shouldBeDeleted
-			= mPopAccount->ShouldUIDBeDeletedFromServer(mMsgUIDs[i], log);
+			= mPopAccount->ShouldUIDBeDeletedFromServer( uids[i], log);
 		BM_LOG2( BM_LogRecv, log);
 		if (shouldBeDeleted) {
-			cmd = BmString("DELE ") << i+1;
+			map< BmString, int32>::const_iterator iter = msgNums.find( uids[i]);
+			if (iter == msgNums.end())
+				continue;
+			cmd = BmString("DELE ") << iter->second;
 			SendCommand( cmd);
 			if (!CheckForPositiveAnswer())
-				goto CLEAN_UP;
+				return false;
 		}
-		mCurrMailNr++;
 	}
-	if (mNewMsgCount)
-		UpdateMailStatus( 100.0, "done", mNewMsgCount);
-CLEAN_UP:
-	mCurrMailNr = 0;
+	return true;
 }
 
 /*------------------------------------------------------------------------------*\
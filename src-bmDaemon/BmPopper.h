@@ -9,6 +9,7 @@
 #ifndef _BmPopper_h
 #define _BmPopper_h
 
+#include <map>
 #include <memory>
 
 #include <Message.h>
@@ -17,6 +18,9 @@
 
 #include "BmNetJobModel.h"
 
+using std::map;
+
+class BmMailStorer;
 class BmPopAccount;
 
 enum {
@@ -98,6 +102,10 @@ private:
 	void StateRetrieve();
 	void StateDisconnect();
 
+	bool CommitStoredMails( BmMailStorer& storer, 
+							  const map< BmString, int32>& msgNums,
+							  bool mayDelete = true);
+
 	void Quit( bool WaitForAnswer=false);
 	void UpdatePOPStatus( const float, const char*, bool failed=false, 
 								 bool stopped=false);
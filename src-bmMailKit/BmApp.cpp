@@ -21,6 +21,7 @@
 #include "BmMailFolderList.h"
 #include "BmRecvAccount.h"
 #include "BmPrefs.h"
+#include "BmProfiler.h"
 #include "BmRoster.h"
 #include "BmSignature.h"
 #include "BmSmtpAccount.h"
@@ -172,15 +173,22 @@ BmApplication::BmApplication( const char* sig, bool testModeRequested)
 		BmLogHandler::CreateInstance( 1, &nref);
 
 		// create the info-roster:
-		BeamRoster = new BmRoster();
-		time_t appModTime;
-		appFile.GetModificationTime( &appModTime);
-		UpdateMimeTypeFile( sig, appModTime);
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "roster");
+			BeamRoster = new BmRoster();
+			time_t appModTime;
+			appFile.GetModificationTime( &appModTime);
+			UpdateMimeTypeFile( sig, appModTime);
+		}
 
 		// load the preferences set by user (if any):
-		BmPrefs::CreateInstance();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "prefs");
+			BmPrefs::CreateInstance();
+		}
 
 		// create most of our list-models:
+		BM_PROFILE_SPAN( "list-models");
 		BmSignatureList::CreateInstance();
 
 		BmFilterList::CreateInstance();
@@ -209,18 +217,25 @@ BmApplication::BmApplication( const char* sig, bool testModeRequested)
 \*------------------------------------------------------------------------------*/
 BmApplication::~BmApplication() 
 {
-	TheSignatureList = NULL;
-	TheIdentityList = NULL;
-	TheSmtpAccountList = NULL;
-	TheRecvAccountList = NULL;
-	TheMailFolderList = NULL;
-	TheFilterChainList = NULL;
-	TheFilterList = NULL;
+	{	// scope for profile-span
+		BM_PROFILE_SPAN( "list-models");
+		TheSignatureList = NULL;
+		TheIdentityList = NULL;
+		TheSmtpAccountList = NULL;
+		TheRecvAccountList = NULL;
+		TheMailFolderList = NULL;
+							// stores the folder-cache and all mailref-lists
+		TheFilterChainList = NULL;
+		TheFilterList = NULL;
 
 #ifdef BM_REF_DEBUGGING
-	BmRefObj::PrintRefsLeft();
+		BmRefObj::PrintRefsLeft();
 #endif
-	BmRefObj::CleanupObjectLists();
+		BmRefObj::CleanupObjectLists();
+	}
+	// shutdown is done as far as the profiler is concerned:
+	if (TheProfiler)
+		TheProfiler->EndPhase();
 
 	delete ThePrefs;
 	BmLogHandler::Shutdown();
@@ -242,7 +257,10 @@ BmApplication::Run()
 	}
 	thread_id tid = 0;
 	try {
-		CreateRequiredIndices();
+		{	// scope for profile-span
+			BM_PROFILE_SPAN( "indices");
+			CreateRequiredIndices();
+		}
 
 		if (BeamInTestMode)
 			mStartupLocker->Unlock();
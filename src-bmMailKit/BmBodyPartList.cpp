@@ -393,7 +393,8 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 			mBodyLength = length - (mStartInRawText-start);
 		}
 		BM_LOG2( BM_LogMailParse, BmString("MIME-Header found: ") << headerText);
-		header = new BmMailHeader( headerText, NULL);
+		header = new (body ? body->ParseArena() : NULL) 
+			BmMailHeader( headerText, NULL);
 	} else {
 		mStartInRawText = start;
 		mBodyLength = length;
@@ -587,8 +588,9 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 				int32 len = std::max((long)0,nPos-msgtext.String()-startOffs-2);
 							// -2 in order to leave out \r\n before boundary
 				BmBodyPart *subPart 
-					= new BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
-										   msgtext, startOffs, len,
+					= new (body ? body->ParseArena() : NULL) 
+						BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
+										msgtext, startOffs, len,
 											defaultCharset, NULL, this);
 				BmAutolockCheckGlobal lock( ListModel()->ModelLocker());
 				if (!lock.IsLocked())
@@ -605,8 +607,9 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 						BM_LOG2( BM_LogMailParse, 
 									"Subpart of multipart found will be added to array");
 						BmBodyPart *subPart 
-							= new BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
-												   msgtext, startOffs, 
+							= new (body ? body->ParseArena() : NULL) 
+								BmBodyPart( (BmBodyPartList*)ListModel().Get(), 
+												msgtext, startOffs, 
 													start+length-startOffs, 
 													defaultCharset, NULL, this);
 						BmAutolockCheckGlobal lock( ListModel()->ModelLocker());
@@ -1141,6 +1144,7 @@ BmBodyPartList::BmBodyPartList( BmMail* mail)
 	:	inherited( BmString("BodyPartList_") << mail->ModelName(), 
 					  BM_LogMailParse)
 	,	mMail( mail)
+	,	mParseArena( NULL)
 	,	mEditableTextBody( NULL)
 	,	mInitCheck( B_NO_INIT)
 {
@@ -1161,11 +1165,16 @@ void BmBodyPartList::ParseMail() {
 	mEditableTextBody = NULL;
 	Cleanup();
 	if (mMail && mMail->HeaderLength() >= 2) {
+		// all bodyparts created during parsing are allocated from the mail's
+		// arena (any parts added later, e.g. during editing, live on the heap):
+		mParseArena = mMail->Arena();
 		const BmString& msgText = mMail->RawText();
 		BmBodyPart* bodyPart 
-			= new BmBodyPart( this, msgText, mMail->HeaderLength()+2, 
-									MAX(msgText.Length()-mMail->HeaderLength()-2, 0), 
-									mMail->DefaultCharset(),	mMail->Header());
+			= new (mParseArena) 
+				BmBodyPart( this, msgText, mMail->HeaderLength()+2, 
+								MAX(msgText.Length()-mMail->HeaderLength()-2, 0), 
+								mMail->DefaultCharset(),	mMail->Header());
+		mParseArena = NULL;
 		AddItemToList( bodyPart);
 	}
 	mInitCheck = B_OK;
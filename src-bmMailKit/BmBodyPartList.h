@@ -13,6 +13,7 @@
 
 #include <Entry.h>
 
+#include "BmArena.h"
 #include "BmDataModel.h"
 #include "BmMailHeader.h"
 #include "BmMemIO.h"
@@ -71,6 +72,8 @@ class IMPEXPBMMAILKIT BmBodyPart : public BmListModelItem {
 	friend class BmBodyPartList;
 
 public:
+	BM_ARENA_ALLOCATABLE
+
 	// c'tors and d'tor:
 	BmBodyPart( BmBodyPartList* model, const BmString& msgtext, int32 s, int32 l,
 					const BmString& defaultCharset,
@@ -207,6 +210,8 @@ class IMPEXPBMMAILKIT BmBodyPartList : public BmListModel {
 	static const int16 nArchiveVersion = 1;
 
 public:
+	BM_ARENA_ALLOCATABLE
+
 	// c'tors and d'tor
 	BmBodyPartList( BmMail* mail);
 	virtual ~BmBodyPartList();
@@ -235,6 +240,7 @@ public:
 	inline const BmString& Signature() const	
 													{ return mSignature; }
 	inline BmMail* Mail() const			{ return mMail; }
+	inline BmArena* ParseArena() const	{ return mParseArena; }
 	bool IsMultiPart() const;
 
 	// setters:
@@ -245,6 +251,9 @@ public:
 
 private:
 	BmMail* mMail;
+	BmArena* mParseArena;
+							// arena that bodyparts (and their headers) are
+							// allocated from while the mail is being parsed
 	BmRef<BmBodyPart> mEditableTextBody;
 	status_t mInitCheck;
 	BmString mSignature;						// signature (as found in mail-text)
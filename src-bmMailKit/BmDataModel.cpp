@@ -7,6 +7,7 @@
  */
 
 #include <Application.h>
+#include <Autolock.h>
 #include <DataIO.h>
 #include <Messenger.h>
 #include <File.h>
@@ -16,6 +17,7 @@
 #include "BmDataModel.h"
 #include "BmLogHandler.h"
 #include "BmPrefs.h"
+#include "BmProfiler.h"
 #include "BmStorageUtil.h"
 #include "BmUtil.h"
 
@@ -793,6 +795,7 @@ const char* const BmListModel::MSG_PARENTKEY 	= 	"bm:pkey";
 const char* const BmListModel::MSG_MODELITEM 	= 	"bm:item";
 const char* const BmListModel::MSG_UPD_FLAGS		= 	"bm:updflags";
 const char* const BmListModel::MSG_OLD_KEY		= 	"bm:oldkey";
+const char* const BmListModel::MSG_JOURNAL_SEQ	= 	"bm:jseq";
 
 /*------------------------------------------------------------------------------*\
 	ListModel()
@@ -847,6 +850,122 @@ bool BmListModel::FlushStoredActions() {
 	return mStoredActionManager.Flush();
 }
 
+/*------------------------------------------------------------------------------*\
+	JournalNeedsCompaction()
+		-	
+\*------------------------------------------------------------------------------*/
+bool BmListModel::JournalNeedsCompaction() {
+	return mStoredActionManager.JournalNeedsCompaction();
+}
+
+/*------------------------------------------------------------------------------*\
+	CompactJournal()
+		-	folds the journal into the cache-file by storing the list
+		-	if the list has not been read yet, it is read temporarily (which 
+			replays the journal)
+\*------------------------------------------------------------------------------*/
+void BmListModel::CompactJournal() {
+	bool wasLoaded = InitCheck() == B_OK;
+	if (!wasLoaded)
+		StartJobInThisThread();
+	BmAutolockCheckGlobal lock( mModelLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( ModelNameNC() << ":CompactJournal(): Unable to get lock");
+	if (InitCheck() != B_OK)
+		return;
+	Store();
+	if (!wasLoaded && !HasControllers())
+		Cleanup();
+}
+
+/*------------------------------------------------------------------------------*\
+	BmParallelStoreState
+		-	the lists to be stored by StoreInParallel() and the progress of
+			the threads that are storing them
+\*------------------------------------------------------------------------------*/
+struct BmParallelStoreState {
+	const vector< BmRef< BmListModel> >* lists;
+	uint32 nextIndex;
+	bigtime_t deadline;
+	BLocker locker;
+	BmParallelStoreState()
+		:	locker( "ParallelStoreLock")			{}
+};
+
+/*------------------------------------------------------------------------------*\
+	ParallelStoreThread( data)
+		-	stores one list after the other until all lists have been handed
+			out or the deadline has passed
+		-	this is a thread-entry func.
+\*------------------------------------------------------------------------------*/
+static int32 ParallelStoreThread( void* data) {
+	BmParallelStoreState* state = static_cast< BmParallelStoreState*>( data);
+	while( 1) {
+		uint32 index;
+		{	// scope for autolock
+			BAutolock lock( state->locker);
+			if (state->nextIndex >= state->lists->size()
+			|| system_time() > state->deadline)
+				break;
+			index = state->nextIndex++;
+		}
+		BmListModel* list = (*state->lists)[index].Get();
+		try {
+			if (list)
+				list->StoreOnShutdown();
+		} catch( BM_error &e) {
+			BM_LOGERR( e.what());
+		}
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	StoreInParallel( lists, threadCount, timeout)
+		-	stores the given list-models (via StoreOnShutdown()) with a pool of
+			threads, such that quitting isn't held up by storing one list 
+			after the other
+		-	when the timeout has passed, no more lists are started, the lists
+			that have been left out are marked as stale (such that their 
+			caches will be rebuilt instead of being trusted), so only lists 
+			whose caches *can* be rebuilt (mailref-lists) may be passed in
+		-	a list that is being stored when the timeout passes is completed,
+			as stopping halfway would leave a corrupted cache behind
+		-	returns the number of lists that have been left out
+\*------------------------------------------------------------------------------*/
+int32 BmListModel::StoreInParallel( const vector< BmRef< BmListModel> >& lists,
+												int32 threadCount, bigtime_t timeout) {
+	BmParallelStoreState state;
+	state.lists = &lists;
+	state.nextIndex = 0;
+	state.deadline = system_time() + timeout;
+	vector< thread_id> threads;
+	for( int32 i=0; i<threadCount && i<(int32)lists.size(); ++i) {
+		thread_id tid = spawn_thread( &ParallelStoreThread, "ParallelStorer", 
+												B_NORMAL_PRIORITY, &state);
+		if (tid >= 0 && resume_thread( tid) == B_OK)
+			threads.push_back( tid);
+	}
+	if (threads.empty())
+		// no threads, we do the work ourselves:
+		ParallelStoreThread( &state);
+	for( uint32 i=0; i<threads.size(); ++i) {
+		status_t exitValue;
+		wait_for_thread( threads[i], &exitValue);
+	}
+	int32 missedCount = 0;
+	for( uint32 i=state.nextIndex; i<lists.size(); ++i) {
+		if (lists[i]) {
+			BM_LOG( BM_LogModelController, 
+					  BmString("ListModel <") << lists[i]->ModelName() 
+					  		<< "> could not be stored in time, marking it as stale");
+			lists[i]->MarkCacheAsStale();
+			missedCount++;
+		}
+	}
+	return missedCount;
+}
+
 /*------------------------------------------------------------------------------*\
 	AddItemToList( item, parent)
 		-	adds given item to given parent-item
@@ -1294,7 +1413,6 @@ void BmListModel::StoreIfNeeded() {
 \*------------------------------------------------------------------------------*/
 bool BmListModel::Store() {
 	BMessage archive;
-	BmBackedFile arcFile;
 	status_t err;
 
 	if (mInitCheck != B_OK)
@@ -1304,17 +1422,24 @@ bool BmListModel::Store() {
 		if (!lock.IsLocked())
 			BM_THROW_RUNTIME( ModelNameNC() << ":Store(): Unable to get lock");
 		BmString filename = SettingsFileName();
-		if (this->Archive( &archive, true) != B_OK)
+		if (this->Archive( &archive, true) != B_OK
+		|| archive.AddInt64( MSG_JOURNAL_SEQ, 
+									mStoredActionManager.LastSequence()) != B_OK)
 			BM_THROW_RUNTIME( 
 				BmString("Unable to archive list-model ")<<ModelName()
 			);
-		if ((err = arcFile.SetTo( filename.String())) != B_OK) {
-			BM_THROW_RUNTIME( BmString("Could not create settings-file\n\t<") 
-										<< filename << ">\n\n Result: " << strerror(err));
+		{	// scope for backed file, which is synced when it goes out of scope
+			BmBackedFile arcFile;
+			if ((err = arcFile.SetTo( filename.String())) != B_OK) {
+				BM_THROW_RUNTIME( BmString("Could not create settings-file\n\t<") 
+											<< filename << ">\n\n Result: " << strerror(err));
+			}
+			if ((err = archive.Flatten( &arcFile.File())) != B_OK)
+				BM_THROW_RUNTIME( BmString("Could not store settings into file\n\t<") 
+											<< filename << ">\n\n Result: " << strerror(err));
 		}
-		if ((err = archive.Flatten( &arcFile.File())) != B_OK)
-			BM_THROW_RUNTIME( BmString("Could not store settings into file\n\t<") 
-										<< filename << ">\n\n Result: " << strerror(err));
+		// the cache-file contains all actions now, so the journal can go:
+		mStoredActionManager.RemoveJournal();
 	} catch( BM_error &e) {
 		BM_SHOWERR( e.what());
 		return false;
@@ -1349,6 +1474,10 @@ BMessage* BmListModel::Restore( BDataIO* dataIO) {
 void BmListModel::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* /*headerMsg*/) {
 	BM_LOG2( mLogTerrain, BmString("Start of InstantiateItems() for ") << Name());
 	std::auto_ptr<BMessage> archive( Restore( dataIO));
+	int64 journalSeq;
+	if (archive.get() 
+	&& archive->FindInt64( MSG_JOURNAL_SEQ, &journalSeq) == B_OK)
+		mStoredActionManager.BaseSequence( journalSeq);
 	InstantiateItems(archive.get());
 }
 
@@ -1400,6 +1529,25 @@ bool BmListModel::RestoreAndExecuteActionsFrom(BDataIO* dataIO)
 	return count > 0;
 }
 
+/*------------------------------------------------------------------------------*\
+	ReplayJournal()
+		-	executes all actions from the journal that are not yet contained
+			in the cache-file.
+		-	the journal is kept as it is (it will be folded into the cache-file
+			when the list is stored or when the journal is compacted), so 
+			replaying the actions does not make the list need a store
+\*------------------------------------------------------------------------------*/
+int32 BmListModel::ReplayJournal()
+{
+	BmAutolockCheckGlobal lock( mModelLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( ModelNameNC() << ":ReplayJournal(): Unable to get lock");
+	bool needsStore = mNeedsStore;
+	int32 count = mStoredActionManager.ReplayJournal();
+	mNeedsStore = needsStore;
+	return count;
+}
+
 /*------------------------------------------------------------------------------*\
 	ExecuteAction()
 		-	
@@ -1427,6 +1575,8 @@ bool BmListModel::StartJob() {
 		return true;
 	}
 
+	BM_PROFILE_SPAN( ModelName());
+
 	Freeze();
 	try {
 		// flush any pending to-be-stored actions
@@ -1437,7 +1587,10 @@ bool BmListModel::StartJob() {
 		if (err == B_OK) {
 			// read archive(s) from cache/settings-file:
 			InstantiateItemsFromStream(&file);
+			// cache-files written by older versions may have actions appended:
 			RestoreAndExecuteActionsFrom(&file);
+			if (mInitCheck == B_OK)
+				ReplayJournal();
 		}
 		if (mInitCheck != B_OK) {
 			// no cache file found, or it couldn't be read, we fetch the 
@@ -330,10 +330,16 @@ public:
 	//
 	virtual bool Store();
 	void StoreIfNeeded();
+	virtual void StoreOnShutdown()		{ StoreIfNeeded(); }
+	virtual void MarkCacheAsStale()		{ }
+	static int32 StoreInParallel( const vector< BmRef< BmListModel> >& lists,
+											int32 threadCount, bigtime_t timeout);
 	void MarkAsChanged()						{ mNeedsStore = true; }
 	virtual void MarkCacheAsDirty()		{ }
 	
 	bool FlushStoredActions();
+	bool JournalNeedsCompaction();
+	void CompactJournal();
 	virtual const BmString SettingsFileName() = 0;
 	virtual void InitializeItems()		{ mInitCheck = B_OK; }
 	virtual void InstantiateItemsFromStream( BDataIO* dataIO, BMessage* headerMsg = NULL);
@@ -356,6 +362,7 @@ public:
 	BMessage* Restore( BDataIO* dataIO);
 	bool StoreAction(BMessage* action);
 	bool RestoreAndExecuteActionsFrom(BDataIO* dataIO);
+	int32 ReplayJournal();
 	virtual void ExecuteAction(BMessage* action);
 
 	bool ForEachItem(BmListModelItem::Collector& collector) const;
@@ -387,6 +394,7 @@ public:
 
 protected:
 	static const char* const MSG_VERSION;
+	static const char* const MSG_JOURNAL_SEQ;
 
 	// overrides of job-model base:
 	void TellJobIsDone( bool completed=true);
@@ -6,6 +6,7 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <Autolock.h>
 #include <FindDirectory.h>
 #include <Directory.h>
 #include <Message.h>
@@ -18,6 +19,7 @@
 #include "BmFilter.h"
 #include "BmLogHandler.h"
 #include "BmMailFilter.h"
+#include "BmProfiler.h"
 #include "BmRosterBase.h"
 #include "BmStorageUtil.h"
 #include "BmUtil.h"
@@ -43,6 +45,7 @@ BmFilter::BmFilter( const char* name, const BmString& kind, BmFilterList* model)
 	:	inherited( name, model, (BmListModelItem*)NULL)
 	,	mAddon( NULL)
 	,	mKind( kind)
+	,	mExecLocker( NULL)
 {
 	SetupAddonPart();
 }
@@ -56,6 +59,7 @@ BmFilter::BmFilter( BMessage* archive, BmFilterList* model)
 	:	inherited( FindMsgString( archive, MSG_NAME), model, 
 					  (BmListModelItem*)NULL)
 	,	mAddon( NULL)
+	,	mExecLocker( NULL)
 {
 	int16 version;
 	if (archive->FindInt16( MSG_VERSION, &version) != B_OK)
@@ -90,6 +94,7 @@ void BmFilter::SetupAddonPart() {
 		mKind.CapitalizeEachWord();
 		BmInstantiateFilterFunc instFunc 
 			= FilterAddonMap[mKind].instantiateFilterFunc;
+		mExecLocker = FilterAddonMap[mKind].execLocker;
 		if (instFunc 
 		&& (mAddon = (*instFunc)( Key(), &mAddonArchive, mKind)) != NULL) {
 			BM_LOG2( BM_LogFilter, 
@@ -147,6 +152,12 @@ bool BmFilter::Execute( BmMsgContext* msgContext)
 {
 	if (!mAddon)
 		return false;
+	if (mAddon->IsReentrant() || !mExecLocker)
+		return mAddon->Execute( msgContext, &mJobSpecifier);
+	// mail-filters may run in several threads at once, so we make sure that 
+	// the add-on only sees one mail at a time (across all of its filters, as
+	// add-ons may well keep global state, like the spam-filter does):
+	BAutolock lock( mExecLocker);
 	return mAddon->Execute( msgContext, &mJobSpecifier);
 }
 
@@ -230,6 +241,7 @@ void BmFilterList::LoadAddons() {
 	BEntry entry;
 	status_t err;
 
+	BM_PROFILE_SPAN( "loading filter-addons");
 	BM_LOG2( BM_LogFilter, BmString("Start of LoadAddons() for FilterList"));
 
 	// determine the path to the user-config-directory:
@@ -302,6 +314,7 @@ void BmFilterList::LoadAddons() {
 			}
 #endif
 			// now we add the addon to our map (one entry per filter-kind):
+			ao.execLocker = new BLocker( "FilterAddonExecLocker");
 			while( *filterKinds) {
 				BmString kind(*filterKinds);
 				FilterAddonMap[*filterKinds++] = ao;
@@ -335,11 +348,19 @@ void BmFilterList::LoadAddons() {
 void BmFilterList::UnloadAddons() {
 	mLearnAsSpamFilter = NULL;
 	mLearnAsTofuFilter = NULL;
+	// the exec-lockers are shared by all kinds of an add-on:
+	set< BLocker*> execLockers;
 	BmFilterAddonMap::const_iterator iter;
 	for( iter = FilterAddonMap.begin(); iter != FilterAddonMap.end(); ++iter) {
 		unload_add_on( iter->second.image);
+		if (iter->second.execLocker)
+			execLockers.insert( iter->second.execLocker);
 	}
 	FilterAddonMap.clear();
+	set< BLocker*>::const_iterator lockerIter;
+	for( lockerIter = execLockers.begin(); lockerIter != execLockers.end(); 
+		  ++lockerIter)
+		delete *lockerIter;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -12,6 +12,7 @@
 #include "BmMailKit.h"
 
 #include <Archivable.h>
+#include <Locker.h>
 #include <Message.h>
 
 #include "BmFilterAddon.h"
@@ -36,7 +37,8 @@ struct IMPEXPBMMAILKIT BmFilterAddonDescr {
 		:	image( 0)
 		,	instantiateFilterFunc( NULL)
 		,	instantiateFilterPrefsFunc( NULL)
-		,	addonPrefsView( NULL)			{}
+		,	addonPrefsView( NULL)
+		,	execLocker( NULL)					{}
 
 	image_id image;
 	BmString name;
@@ -44,6 +46,10 @@ struct IMPEXPBMMAILKIT BmFilterAddonDescr {
 	BmInstantiateFilterFunc instantiateFilterFunc;
 	BmInstantiateFilterPrefsFunc instantiateFilterPrefsFunc;
 	BmFilterAddonPrefsView* addonPrefsView;
+	BLocker* execLocker;
+							// serializes the execution of all filters of this
+							// add-on (if it isn't reentrant), shared by all 
+							// the filter-kinds the add-on implements
 };
 
 /*------------------------------------------------------------------------------*\
@@ -97,6 +103,9 @@ protected:
 	BMessage mJobSpecifier;
 							// specific job-types (learnAsSpam) can be specified here
 							// normally, this is empty
+	BLocker* mExecLocker;
+							// the exec-locker of the add-on (owned by the 
+							// add-on's entry in FilterAddonMap)
 private:
 	BmFilter();									// hide default constructor
 	
@@ -22,6 +22,8 @@ using namespace regexx;
 #include "BmIdentity.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
+#include "BmMailCompression.h"
+#include "BmMailDedupIndex.h"
 #include "BmMailFilter.h"
 #include "BmMailFolder.h"
 #include "BmMailFolderList.h"
@@ -59,6 +61,8 @@ const char* BM_MAIL_ATTR_IDENTITY		= "MAIL:beam/identity";
 const char* BM_MAIL_ATTR_MARGIN	 		= "MAIL:beam/margin";
 const char* BM_MAIL_ATTR_WHEN_CREATED = "MAIL:beam/when-created";
 const char* BM_MAIL_ATTR_IMAP_UID	 	= "MAIL:beam/imap-uid";
+const char* BM_MAIL_ATTR_MESSAGE_ID	= "MAIL:beam/message-id";
+const char* BM_MAIL_ATTR_REFERENCES	= "MAIL:beam/references";
 
 const char* BM_FIELD_BCC 					= "Bcc";
 const char* BM_FIELD_CC 					= "Cc";
@@ -153,6 +157,7 @@ BmMail::BmMail( bool outbound)
 	,	mMailRef( NULL)
 	,	mHeader( NULL)
 	,	mBody( NULL)
+	,	mArena( NULL)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( outbound)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
@@ -188,6 +193,7 @@ BmMail::BmMail( const BmString &msgText, const BmString account)
 	,	mHeader( NULL)
 	,	mBody( NULL)
 	,	mMailRef( NULL)
+	,	mArena( NULL)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( false)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
@@ -212,6 +218,7 @@ BmMail::BmMail( BmMailRef* ref)
 	,	mHeader( NULL)
 	,	mBody( NULL)
 	,	mMailRef( ref)
+	,	mArena( NULL)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( false)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
@@ -230,6 +237,12 @@ BmMail::BmMail( BmMailRef* ref)
 	-	standard d'tor
 \*------------------------------------------------------------------------------*/
 BmMail::~BmMail() {
+	if (mArena) {
+		BM_LOG2( BM_LogMailParse, 
+					BmString("Parse-arena: ") 
+						<< BmArena::StatsString( mArena->ArenaStats()));
+		mArena->Release();
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -246,7 +259,16 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 	text.ConvertLinebreaksToCRLF(&_text);
 	text.ReplaceAll( 0, 32);
 	BM_LOG2( BM_LogMailParse, "done (Converting Linebreaks to CRLF)");
+	AdoptCanonicalText( text, account);
+}
 
+/*------------------------------------------------------------------------------*\
+	AdoptCanonicalText( text, account)
+		-	initializes mail-object from the given text, which must already 
+			be in canonical form (CRLF-linebreaks and no binary nulls)
+		-	the text is adopted (text will be empty afterwards)
+\*------------------------------------------------------------------------------*/
+void BmMail::AdoptCanonicalText( BmString &text, const BmString& account) {
 	// find end of header (and start of body):
 	int32 headerLen = text.FindFirst( "\r\n\r\n");
 							// STD11: empty-line seperates header from body
@@ -262,15 +284,22 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 	BM_LOG2( BM_LogMailParse, "...done (Adopting mailtext)");
 	mAccountName = account;
 
+	// header and bodyparts are allocated from an arena of their own, such that 
+	// they can be released in one go (objects from an earlier parse may still 
+	// be referenced elsewhere, they keep the old arena alive): 
+	if (mArena)
+		mArena->Release();
+	mArena = new BmArena();
+
 	BM_LOG2( BM_LogMailParse, "setting header-string...");
 	BmString header;
 	header.SetTo( mText, headerLen);
 	BM_LOG2( BM_LogMailParse, "...init header from header-string...");
-	mHeader = new BmMailHeader( header, this);
+	mHeader = new (mArena) BmMailHeader( header, this);
 	BM_LOG2( BM_LogMailParse, "...done (header)");
 
 	BM_LOG2( BM_LogMailParse, "init of body...");
-	mBody = new BmBodyPartList( this);
+	mBody = new (mArena) BmBodyPartList( this);
 	mBody->ParseMail();
 	BM_LOG2( BM_LogMailParse, "done (init of body)");
 
@@ -329,69 +358,224 @@ bool BmMail::StartJob() {
 		
 		// ...ok, mail-file found, we fetch the mail from it:
 		BmString mailText;
+		bool isCanonical = false;
+		bigtime_t startTime = system_time();
 		// read special attributes for mail-state...
 		mailFile.ReadAttr( BM_MAIL_ATTR_MARGIN, B_INT32_TYPE, 0, 
 								 &mRightMargin, sizeof(int32));
 		// ...and read file contents:
-		off_t mailSize;
-		if ((err = mailFile.GetSize( &mailSize)) != B_OK)
-			BM_THROW_RUNTIME( 
-				BmString("Could not get size of mail-file <") << eref.name 
-					<< "> \n\nError:" << strerror(err)
-			);
-		BM_LOG2( BM_LogMailParse, 
-					BmString("...should be reading ") << mailSize << " bytes");
-		char* buf = mailText.LockBuffer( int32(mailSize));
-		if (!buf)
-			throw BM_runtime_error( BmString("Not enough memory for mail from "
-														"file\n\t<") << eref.name << ">");
-		off_t realSize = 0;
-		const size_t blocksize = 65536;
-		for(  int32 offs=0; 
-				(skipChecks || ShouldContinue()) && offs < mailSize; ) {
-			char* pos = buf+offs;
-			ssize_t read = mailFile.Read( 
-				pos, 
-				mailSize-offs < blocksize 
-					? size_t(mailSize-offs)
-					: blocksize
-			);
-			BM_LOG3( BM_LogMailParse, 
-						BmString("...read a block of ") << read << " bytes");
-			if (read < 0)
-				throw BM_runtime_error( BmString("Could not fetch mail from "
-															"file\n\t<") 
+		if (ThePrefs->GetBool( "MapMailFilesIntoMemory", true)) {
+			BmMappedFile mappedFile;
+			if ((err = mappedFile.SetTo( &eref)) != B_OK)
+				throw BM_runtime_error( BmString("Could not map mail-file\n\t<") 
 													<< eref.name << ">\n\n Result: " 
-													<< strerror(read));
-			if (!read)
-				break;
-			realSize += read;
-			offs += read;
-		}
+													<< strerror(err));
+			BM_LOG2( BM_LogMailParse, 
+						BmString("...mapped ") << mappedFile.Size() << " bytes");
+			if (!skipChecks && !ShouldContinue())
+				return false;
+			if (BmMailCompression::IsCompressed( mappedFile.Data(), 
+															 mappedFile.Size())) {
+				// mail lives in a compressed folder, we inflate it right
+				// from the mapping into the mail-text:
+				InflateMailText( mappedFile.Data(), mappedFile.Size(), eref, 
+									  mailText);
+				isCanonical 
+					= IsCanonicalText( mailText.String(), mailText.Length());
+			} else {
+				// Mails that have been written by Beam are already in 
+				// canonical form, so we can take them over with a single copy
+				// (without converting linebreaks and without looking for 
+				// nulls again):
+				isCanonical 
+					= IsCanonicalText( mappedFile.Data(), mappedFile.Size());
+				// we copy the complete mapping (SetTo() would stop at the 
+				// first binary null):
+				int32 size = int32(mappedFile.Size());
+				char* buf = mailText.LockBuffer( size);
+				if (!buf)
+					throw BM_runtime_error( 
+						BmString("Not enough memory for mail from file\n\t<") 
+							<< eref.name << ">");
+				memcpy( buf, mappedFile.Data(), size);
+				buf[size] = '\0';
+				mailText.UnlockBuffer( size);
+			}
+			// take care to remove all binary nulls (canonical texts have none):
+			if (!isCanonical)
+				mailText.ReplaceAll( 0, 32);
+		} else
+			ReadMailText( mailFile, eref, mailText, skipChecks);
 		if (!skipChecks && !ShouldContinue())
 			return false;
 		BM_LOG2( BM_LogMailParse, 
-					BmString("...real size is ") << realSize << " bytes");
-		if (realSize > mailSize)
-			throw BM_runtime_error( BmString("Real size is ") << realSize 
-							<< " bytes but expected size was only " << mailSize 
-							<< " bytes!?!");
-		buf[realSize] = '\0';
-		mailText.UnlockBuffer( int32(realSize));
-		// take care to remove all binary nulls:
-		mailText.ReplaceAll( 0, 32);
+					BmString("...read mail-text in ") 
+						<< int32((system_time()-startTime)/1000) << " ms");
 		// we initialize the BmMail-internals from the plain text:
 		BM_LOG2( BM_LogMailParse, BmString("initializing BmMail from msgtext"));
 		mIdentityName = mMailRef->Identity();
 		mImapUID = mMailRef->ImapUID();
-		SetTo( mailText, mMailRef->Account());
-		BM_LOG2( BM_LogMailParse, BmString("Done, mail is initialized"));
+		if (isCanonical)
+			AdoptCanonicalText( mailText, mMailRef->Account());
+		else
+			SetTo( mailText, mMailRef->Account());
+		BM_LOG2( BM_LogMailParse, 
+					BmString("Done, mail is initialized after ") 
+						<< int32((system_time()-startTime)/1000) << " ms");
 	} catch (BM_error &e) {
 		BM_SHOWERR( e.what());
 	}
 	return InitCheck() == B_OK;
 }
 
+/*------------------------------------------------------------------------------*\
+	ReadMailText( mailFile, eref, mailText, skipChecks)
+		-	reads the contents of the given mail-file blockwise into mailText
+		-	compressed mail-files are inflated while being read
+		-	binary nulls are replaced by spaces
+\*------------------------------------------------------------------------------*/
+void BmMail::ReadMailText( BFile& mailFile, const entry_ref& eref, 
+									BmString& mailText, bool skipChecks) {
+	status_t err;
+	off_t mailSize;
+	if ((err = mailFile.GetSize( &mailSize)) != B_OK)
+		BM_THROW_RUNTIME( 
+			BmString("Could not get size of mail-file <") << eref.name 
+				<< "> \n\nError:" << strerror(err)
+		);
+	char header[BmMailCompression::nHeaderSize];
+	if (mailFile.ReadAt( 0, header, sizeof(header)) == (ssize_t)sizeof(header)
+	&& BmMailCompression::IsCompressed( header, sizeof(header))) {
+		ReadCompressedMailText( mailFile, eref, mailText, skipChecks,
+										BmMailCompression::UncompressedSize( 
+											header, sizeof(header)));
+		mailText.ReplaceAll( 0, 32);
+		return;
+	}
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...should be reading ") << mailSize << " bytes");
+	char* buf = mailText.LockBuffer( int32(mailSize));
+	if (!buf)
+		throw BM_runtime_error( BmString("Not enough memory for mail from "
+													"file\n\t<") << eref.name << ">");
+	off_t realSize = 0;
+	const size_t blocksize = 65536;
+	for(  int32 offs=0; 
+			(skipChecks || ShouldContinue()) && offs < mailSize; ) {
+		char* pos = buf+offs;
+		ssize_t read = mailFile.Read( 
+			pos, 
+			mailSize-offs < blocksize 
+				? size_t(mailSize-offs)
+				: blocksize
+		);
+		BM_LOG3( BM_LogMailParse, 
+					BmString("...read a block of ") << read << " bytes");
+		if (read < 0)
+			throw BM_runtime_error( BmString("Could not fetch mail from "
+														"file\n\t<") 
+												<< eref.name << ">\n\n Result: " 
+												<< strerror(read));
+		if (!read)
+			break;
+		realSize += read;
+		offs += read;
+	}
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...real size is ") << realSize << " bytes");
+	if (realSize > mailSize)
+		throw BM_runtime_error( BmString("Real size is ") << realSize 
+						<< " bytes but expected size was only " << mailSize 
+						<< " bytes!?!");
+	buf[realSize] = '\0';
+	mailText.UnlockBuffer( int32(realSize));
+	// take care to remove all binary nulls:
+	mailText.ReplaceAll( 0, 32);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadCompressedMailText( mailFile, eref, mailText, skipChecks, textSize)
+		-	reads the given compressed mail-file blockwise and inflates each 
+			block into mailText right away
+		-	textSize is the size of the uncompressed mail-text
+\*------------------------------------------------------------------------------*/
+void BmMail::ReadCompressedMailText( BFile& mailFile, const entry_ref& eref, 
+												 BmString& mailText, bool skipChecks,
+												 uint32 textSize) {
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...should be inflating ") << textSize << " bytes");
+	char* buf = mailText.LockBuffer( int32(textSize));
+	if (!buf)
+		throw BM_runtime_error( BmString("Not enough memory for mail from "
+													"file\n\t<") << eref.name << ">");
+	BmMailInflater inflater( buf, textSize);
+	const size_t blocksize = 65536;
+	vector< char> block( blocksize);
+	off_t offs = BmMailCompression::nHeaderSize;
+	while( (skipChecks || ShouldContinue()) && !inflater.IsComplete()
+	&& !inflater.HasFailed()) {
+		ssize_t read = mailFile.ReadAt( offs, &block[0], blocksize);
+		if (read < 0)
+			throw BM_runtime_error( BmString("Could not fetch mail from "
+														"file\n\t<") 
+												<< eref.name << ">\n\n Result: " 
+												<< strerror(read));
+		if (!read)
+			break;
+		offs += read;
+		inflater.Feed( &block[0], read);
+	}
+	int32 realSize = int32(inflater.OutLength());
+	buf[realSize] = '\0';
+	mailText.UnlockBuffer( realSize);
+	if ((skipChecks || ShouldContinue()) 
+	&& (!inflater.IsComplete() || realSize != int32(textSize)))
+		throw BM_runtime_error( BmString("Compressed mail-file\n\t<") 
+											<< eref.name << ">\n\nis corrupt!");
+}
+
+/*------------------------------------------------------------------------------*\
+	InflateMailText( data, size, eref, mailText)
+		-	inflates the given contents of a compressed mail-file into mailText
+\*------------------------------------------------------------------------------*/
+void BmMail::InflateMailText( const char* data, off_t size, 
+										const entry_ref& eref, BmString& mailText) {
+	uint32 textSize = BmMailCompression::UncompressedSize( data, size);
+	char* buf = mailText.LockBuffer( int32(textSize));
+	if (!buf)
+		throw BM_runtime_error( BmString("Not enough memory for mail from "
+													"file\n\t<") << eref.name << ">");
+	bool ok = BmMailCompression::Decompress( data, size, buf, textSize);
+	buf[ok ? textSize : 0] = '\0';
+	mailText.UnlockBuffer( ok ? int32(textSize) : 0);
+	if (!ok)
+		throw BM_runtime_error( BmString("Compressed mail-file\n\t<") 
+											<< eref.name << ">\n\nis corrupt!");
+	BM_LOG2( BM_LogMailParse, 
+				BmString("...inflated ") << size << " bytes into " << textSize
+					<< " bytes");
+}
+
+/*------------------------------------------------------------------------------*\
+	IsCanonicalText( data, size)
+		-	checks whether the given text contains only CRLF-linebreaks and
+			no binary nulls, i.e. whether it can be used without conversion
+\*------------------------------------------------------------------------------*/
+bool BmMail::IsCanonicalText( const char* data, off_t size) {
+	if (!data)
+		return true;
+	if (memchr( data, '\0', size_t(size)) != NULL)
+		return false;
+	const char* end = data+size;
+	for( const char* pos = data; 
+			(pos = (const char*)memchr( pos, '\n', size_t(end-pos))) != NULL; 
+			++pos) {
+		if (pos == data || pos[-1] != '\r')
+			return false;
+	}
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	ResyncFromDisk()
 		-	
@@ -412,16 +596,19 @@ BmMailRef* BmMail::MailRef() const
 
 // #pragma mark - Storing
 /*------------------------------------------------------------------------------*\
-	Store()
+	Store( syncToDisk)
 		-	determines where this mail should be living and the stores it there
+		-	if syncToDisk is false, the caller is responsible for syncing
+			the mail-file (see BmMailStorer)
 \*------------------------------------------------------------------------------*/
-bool BmMail::Store() {
+bool BmMail::Store( bool syncToDisk) {
 	status_t err = B_NO_INIT;
 	BmString status;
 	bigtime_t whenCreated;
 	BmString filename;
 	BEntry backupEntry;
 	BDirectory destDir;
+	bool isNew = false;
 
 	try {
 		// Find out where mail shall be living:
@@ -456,6 +643,7 @@ bool BmMail::Store() {
 			backupEntry = mEntry;
 		} else {
 			// this mail has never been stored before
+			isNew = true;
 			whenCreated = real_time_clock_usecs();
 			status = DefaultStatus();
 		}
@@ -468,7 +656,8 @@ bool BmMail::Store() {
 				BmString("Could not set up a directory for mail <") << filename
 					<< ">.\n\n Result: " << strerror(err)
 			);
-		StoreIntoFile( &destDir, filename, status, whenCreated, &backupEntry);
+		StoreIntoFile( &destDir, filename, status, whenCreated, &backupEntry,
+							syncToDisk);
 		// ...and fetch resulting entry-ref
 		entry_ref eref;
 		if ((err = mEntry.GetRef( &eref)) != B_OK) {
@@ -485,6 +674,10 @@ bool BmMail::Store() {
 		// create a (new) mail-ref for the freshly saved mail:
 		mMailRef = BmMailRef::CreateInstance( eref);
 
+		// remember new incoming mails, such that duplicates can be skipped:
+		if (isNew && !mOutbound && TheMailDedupIndex)
+			TheMailDedupIndex->Add( this);
+
 		// set new status for any mail(s) this one is based on:
 		for( uint32 i=0; i<mBaseRefVect.size(); ++i) {
 			mBaseRefVect[i]->MarkAs( mNewBaseStatus.String());
@@ -503,7 +696,7 @@ bool BmMail::Store() {
 \*------------------------------------------------------------------------------*/
 void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename, 
 									 const BmString& status, bigtime_t whenCreated, 
-									 BEntry* backupEntry) {
+									 BEntry* backupEntry, bool syncToDisk) {
 	status_t err = B_NO_INIT;
 	ssize_t res;
 
@@ -541,8 +734,23 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 		}
 	}
 
+	// in compressed folders, the mail-text is stored deflated (the 
+	// attributes are not touched, so listing the folder costs the same):
+	string compressedText;
+	const char* data = mText.String();
+	int32 len = mText.Length();
+	if (BmMailFolder::IsCompressedFolder( destDir)) {
+		if (!BmMailCompression::Compress( data, len, compressedText))
+			BM_THROW_RUNTIME( 
+				BmString("Could not compress mail-file <") << filename << ">"
+			);
+		data = compressedText.data();
+		len = compressedText.size();
+	}
+
 	// we create/open the new mailfile (keeping a backup)...
 	BmBackedFile mailFile;
+	mailFile.SyncOnFinish( syncToDisk);
 	err = mailFile.SetTo( mEntry, "text/x-email", backupEntry);
 	if (err != B_OK)
 		BM_THROW_RUNTIME( 
@@ -557,8 +765,7 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 
 	// ...and finally write the raw mail into the file:
 	BM_LOG2( BM_LogMailParse, "storing mail-data...");
-	int32 len = mText.Length();
-	if ((res = mailFile.Write( mText.String(), len)) < len) {
+	if ((res = mailFile.Write( data, len)) < len) {
 		if (res < 0) {
 			BM_THROW_RUNTIME( BmString("Unable to write to mailfile <") 
 										<< filename << ">\n\n Result: " 
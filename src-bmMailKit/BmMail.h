@@ -19,12 +19,14 @@
 #include <Path.h>
 #include "BmString.h"
 
+#include "BmArena.h"
 #include "BmBodyPartList.h"
 #include "BmDataModel.h"
 #include "BmMailFolder.h"
 #include "BmMailRef.h"
 #include "BmUtil.h"
 
+class BFile;
 class BmIdentity;
 
 // mail-attribute types:
@@ -52,6 +54,8 @@ extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_IDENTITY;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_MARGIN;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_WHEN_CREATED;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_IMAP_UID;
+extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_MESSAGE_ID;
+extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_REFERENCES;
 
 extern IMPEXPBMMAILKIT const char* BM_FIELD_BCC;
 extern IMPEXPBMMAILKIT const char* BM_FIELD_CC;
@@ -145,10 +149,10 @@ public:
 	void ApplyOutboundFilters();
 	void ApplyInboundFilters();
 	bool Send( bool now=true);
-	bool Store();
+	bool Store( bool syncToDisk = true);
 	void StoreIntoFile( BDirectory* destDir, BmString filename, 
 							  const BmString& status, bigtime_t whenCreated, 
-							  BEntry* backupEntry = NULL);
+							  BEntry* backupEntry = NULL, bool syncToDisk = true);
 	void ResyncFromDisk();
 	//
 	const BmString& GetFieldVal( const BmString fieldName);
@@ -187,6 +191,7 @@ public:
 	// getters:
 	inline const status_t InitCheck() const	
 													{ return mInitCheck; }
+	inline BmArena* Arena() const		{ return mArena; }
 	inline const BmString& AccountName(){ return mAccountName; }
 	BmBodyPartList* Body() const;
 	BmMailHeader* Header() const;
@@ -237,6 +242,15 @@ protected:
 
 private:
 	void SetDefaultHeaders( const BmString& defaultHeaders);
+	void AdoptCanonicalText( BmString& text, const BmString& account);
+	void ReadMailText( BFile& mailFile, const entry_ref& eref, 
+							 BmString& mailText, bool skipChecks);
+	void ReadCompressedMailText( BFile& mailFile, const entry_ref& eref, 
+										  BmString& mailText, bool skipChecks,
+										  uint32 textSize);
+	static void InflateMailText( const char* data, off_t size, 
+										  const entry_ref& eref, BmString& mailText);
+	static bool IsCanonicalText( const char* data, off_t size);
 	BmMail();
 	
 	const BmString& DefaultStatus() const;
@@ -287,6 +301,9 @@ private:
 	BmString mImapUID;
 							// UID for this mail as retrieved from the IMAP
 							// server.
+	BmArena* mArena;
+							// arena for all objects created while parsing
+							// the mail (header, bodyparts and their headers)
 	status_t mInitCheck;
 
 	// Hide copy-constructor and assignment:
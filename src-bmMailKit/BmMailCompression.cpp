@@ -0,0 +1,201 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <string.h>
+
+#include <zlib.h>
+
+#include "BmMailCompression.h"
+
+// the magic at the start of every compressed mail-file, the first byte
+// is not a valid character in a mail-header, so plain mails never match:
+static const char nMagic[] = "\x89" "BMZ";
+static const size_t nMagicLen = 4;
+
+// inflating is done in chunks of this size (zlib can't handle more than
+// 4GB per call anyway):
+static const size_t nChunkSize = 1024*1024;
+
+//******************************************************************************
+// #pragma mark -	BmMailCompression
+//******************************************************************************
+
+const size_t BmMailCompression::nHeaderSize;
+
+/*------------------------------------------------------------------------------*\
+	IsCompressed( data, size)
+		-	returns whether the given data is the contents of a compressed
+			mail-file (at least its start)
+\*------------------------------------------------------------------------------*/
+bool BmMailCompression::IsCompressed( const char* data, size_t size)
+{
+	return data && size >= nHeaderSize && !memcmp( data, nMagic, nMagicLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	UncompressedSize( data, size)
+		-	returns the size of the mail-text contained in the given compressed
+			data (as found in the header)
+\*------------------------------------------------------------------------------*/
+uint32_t BmMailCompression::UncompressedSize( const char* data, size_t size)
+{
+	if (!IsCompressed( data, size))
+		return 0;
+	// the size is stored little-endian, independent of the platform:
+	const unsigned char* sz
+		= reinterpret_cast< const unsigned char*>( data + nMagicLen);
+	return sz[0] | (sz[1] << 8) | (sz[2] << 16) | ((uint32_t)sz[3] << 24);
+}
+
+/*------------------------------------------------------------------------------*\
+	Compress( data, size, outData, level)
+		-	compresses the given mail-text into the format of a compressed
+			mail-file (header & deflated text)
+		-	level is the zlib-compression-level (1 = fastest, 9 = best)
+\*------------------------------------------------------------------------------*/
+bool BmMailCompression::Compress( const char* data, size_t size,
+											 string& outData, int level)
+{
+	outData.erase();
+	if (!data || size > 0xFFFFFFFFUL)
+		return false;
+	uLongf compressedSize = compressBound( size);
+	outData.resize( nHeaderSize + compressedSize);
+	memcpy( &outData[0], nMagic, nMagicLen);
+	for( size_t i=0; i<4; ++i)
+		outData[nMagicLen+i] = char( (size >> (8*i)) & 0xFF);
+	int res = compress2( reinterpret_cast< Bytef*>( &outData[nHeaderSize]),
+								&compressedSize,
+								reinterpret_cast< const Bytef*>( data), size, level);
+	if (res != Z_OK) {
+		outData.erase();
+		return false;
+	}
+	outData.resize( nHeaderSize + compressedSize);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	Decompress( data, size, outBuf, outSize)
+		-	decompresses the given contents of a compressed mail-file into the
+			given buffer, which must be exactly as large as the mail-text
+			(as returned by UncompressedSize())
+\*------------------------------------------------------------------------------*/
+bool BmMailCompression::Decompress( const char* data, size_t size,
+												char* outBuf, size_t outSize)
+{
+	if (!IsCompressed( data, size) || UncompressedSize( data, size) != outSize)
+		return false;
+	BmMailInflater inflater( outBuf, outSize);
+	inflater.Feed( data + nHeaderSize, size - nHeaderSize);
+	return inflater.IsComplete() && inflater.OutLength() == outSize;
+}
+
+/*------------------------------------------------------------------------------*\
+	Decompress( data, size, outText)
+		-	decompresses the given contents of a compressed mail-file into
+			outText
+\*------------------------------------------------------------------------------*/
+bool BmMailCompression::Decompress( const char* data, size_t size,
+												string& outText)
+{
+	outText.erase();
+	uint32_t outSize = UncompressedSize( data, size);
+	if (!outSize)
+		return IsCompressed( data, size);
+	outText.resize( outSize);
+	if (!Decompress( data, size, &outText[0], outSize)) {
+		outText.erase();
+		return false;
+	}
+	return true;
+}
+
+//******************************************************************************
+// #pragma mark -	BmMailInflater
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMailInflater( outBuf, outSize)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailInflater::BmMailInflater( char* outBuf, size_t outSize)
+	:	mStream( new z_stream)
+	,	mOutSize( outSize)
+	,	mComplete( false)
+	,	mFailed( false)
+{
+	memset( mStream, 0, sizeof( z_stream));
+	mStream->next_out = reinterpret_cast< Bytef*>( outBuf);
+	mStream->avail_out = 0;
+	if (inflateInit( mStream) != Z_OK)
+		mFailed = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailInflater()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailInflater::~BmMailInflater()
+{
+	inflateEnd( mStream);
+	delete mStream;
+}
+
+/*------------------------------------------------------------------------------*\
+	Feed( data, size)
+		-	inflates the given chunk of deflated data into the buffer
+		-	once the buffer is full, any remaining data is only checked for
+			the end of the stream (which contains the checksum)
+		-	returns false if the data is corrupt
+\*------------------------------------------------------------------------------*/
+bool BmMailInflater::Feed( const char* data, size_t size)
+{
+	if (mFailed)
+		return false;
+	mStream->next_in = reinterpret_cast< Bytef*>( const_cast< char*>( data));
+	mStream->avail_in = 0;
+	while( !mComplete && (size || mStream->avail_in)) {
+		if (!mStream->avail_in) {
+			mStream->avail_in = size < nChunkSize ? size : nChunkSize;
+			size -= mStream->avail_in;
+		}
+		size_t outLeft = mOutSize - OutLength();
+		mStream->avail_out = outLeft < nChunkSize ? outLeft : nChunkSize;
+		int res = inflate( mStream, Z_NO_FLUSH);
+		if (res == Z_STREAM_END)
+			mComplete = true;
+		else if (res == Z_BUF_ERROR && !outLeft)
+			break;
+							// buffer is full, the rest of the data isn't needed
+		else if (res != Z_OK && res != Z_BUF_ERROR) {
+			mFailed = true;
+			break;
+		}
+	}
+	return !mFailed;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsDone()
+		-	returns whether feeding more data is pointless (since the stream
+			has ended, the buffer is full or the data is corrupt)
+\*------------------------------------------------------------------------------*/
+bool BmMailInflater::IsDone() const
+{
+	return mComplete || mFailed || OutLength() == mOutSize;
+}
+
+/*------------------------------------------------------------------------------*\
+	OutLength()
+		-	returns the number of bytes that have been inflated so far
+\*------------------------------------------------------------------------------*/
+size_t BmMailInflater::OutLength() const
+{
+	return mStream->total_out;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailCompression_h
+#define _BmMailCompression_h
+
+/*
+ * This file (and BmMailCompression.cpp) deliberately does not use any of
+ * the BeAPI or BmBase, such that compressed mail-files can be read on any
+ * system (see src-tools/MailExporter.cpp).
+ */
+
+#if defined(__BEOS__) || defined(__HAIKU__)
+#include "BmMailKit.h"
+#else
+#define IMPEXPBMMAILKIT
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+using std::string;
+
+struct z_stream_s;
+
+/*------------------------------------------------------------------------------*\
+	class BmMailCompression
+		-	converts mail-texts to and from the format used for mail-files in
+			compressed folders
+		-	a compressed mail-file starts with a header of nHeaderSize bytes
+			(a magic and the size of the uncompressed text), followed by the
+			deflated mail-text (zlib-format)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailCompression {
+
+public:
+	static bool IsCompressed( const char* data, size_t size);
+	static uint32_t UncompressedSize( const char* data, size_t size);
+	static bool Compress( const char* data, size_t size, string& outData,
+								 int level = 6);
+	static bool Decompress( const char* data, size_t size, char* outBuf,
+									size_t outSize);
+	static bool Decompress( const char* data, size_t size, string& outText);
+
+	static const size_t nHeaderSize = 8;
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMailInflater
+		-	inflates the deflated part of a compressed mail-file chunk by
+			chunk into the given buffer, such that a mail-file can be
+			decompressed while it is being read
+		-	inflating stops when the buffer is full, so the buffer may as
+			well be smaller than the complete mail-text (e.g. if only the
+			header is needed)
+		-	the mail-text is only known to be intact once IsComplete()
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailInflater {
+
+public:
+	BmMailInflater( char* outBuf, size_t outSize);
+	~BmMailInflater();
+
+	bool Feed( const char* data, size_t size);
+
+	// getters:
+	size_t OutLength() const;
+	bool IsDone() const;
+	inline bool IsComplete() const		{ return mComplete; }
+	inline bool HasFailed() const			{ return mFailed; }
+
+private:
+	struct z_stream_s* mStream;
+	size_t mOutSize;
+	bool mComplete;
+							// end of stream reached (and checksum verified)
+	bool mFailed;
+
+	// Hide copy-constructor and assignment:
+	BmMailInflater( const BmMailInflater&);
+	BmMailInflater operator=( const BmMailInflater&);
+};
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <algorithm>
+#include <time.h>
+#include <vector>
+
+#include <Autolock.h>
+#include <File.h>
+#include <Message.h>
+
+#include "BmBasics.h"
+#include "BmLogHandler.h"
+#include "BmMail.h"
+#include "BmMailDedupIndex.h"
+#include "BmMailThreader.h"
+#include "BmPrefs.h"
+#include "BmRoster.h"
+
+using std::vector;
+
+//******************************************************************************
+// #pragma mark -	BmMailDedupIndex
+//******************************************************************************
+BmMailDedupIndex* BmMailDedupIndex::theInstance = NULL;
+
+const char* const BmMailDedupIndex::MSG_VERSION = 		"bm:version";
+const char* const BmMailDedupIndex::MSG_ENTRIES = 		"bm:entries";
+const char* const BmMailDedupIndex::MSG_SAVED_COUNT = 	"bm:savedcount";
+const char* const BmMailDedupIndex::MSG_SAVED_BYTES = 	"bm:savedbytes";
+const char* const BmMailDedupIndex::MSG_SAVED_TIME = 	"bm:savedtime";
+const int16 BmMailDedupIndex::nArchiveVersion = 1;
+
+// on-disk layout of a single entry:
+struct BmDedupEntry {
+	uint64 key;
+	uint32 lastSeen;
+};
+
+/*------------------------------------------------------------------------------*\
+	CreateInstance()
+		-	creator-func
+		-	if the user doesn't want duplicates to be skipped, no instance
+			is created at all
+\*------------------------------------------------------------------------------*/
+BmMailDedupIndex* BmMailDedupIndex::CreateInstance() {
+	if (!theInstance && ThePrefs->GetBool( "DedupRetrievedMails", true))
+		theInstance = new BmMailDedupIndex();
+	return theInstance;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmMailDedupIndex()
+		-	c'tor, reads the index from disk
+\*------------------------------------------------------------------------------*/
+BmMailDedupIndex::BmMailDedupIndex()
+	:	mMaxEntries( std::max( ThePrefs->GetInt( "DedupIndexMaxEntries",
+																20000),
+									  (int32)100))
+	,	mMaxAge( std::max( ThePrefs->GetInt( "DedupIndexMaxAge", 60),
+								 (int32)1) * 24*60*60)
+	,	mSavedCount( 0)
+	,	mSavedBytes( 0)
+	,	mSavedTime( 0)
+	,	mAvgProcessingTime( 0)
+	,	mModified( false)
+	,	mLocker( "DedupIndexLocker")
+{
+	_Load();
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailDedupIndex()
+		-	d'tor, writes the index to disk
+\*------------------------------------------------------------------------------*/
+BmMailDedupIndex::~BmMailDedupIndex() {
+	Store();
+	theInstance = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Contains( mail)
+		-	returns whether the given mail is a duplicate of a mail that has
+			been received (and stored) before
+		-	the mail is *not* added to the index, this is done by BmMail::Store()
+			once the mail actually lives on disk
+\*------------------------------------------------------------------------------*/
+bool BmMailDedupIndex::Contains( const BmMail* mail) {
+	return _Lookup( mail, false);
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( mail)
+		-	adds the given mail to the index (or refreshes its entry)
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::Add( const BmMail* mail) {
+	_Lookup( mail, true);
+}
+
+/*------------------------------------------------------------------------------*\
+	ContainsKey( key)
+		-	returns whether the given content-key is contained in the index
+		-	the entry is not refreshed
+\*------------------------------------------------------------------------------*/
+bool BmMailDedupIndex::ContainsKey( uint64 key) {
+	BAutolock lock( mLocker);
+	return mEntries.find( key) != mEntries.end();
+}
+
+/*------------------------------------------------------------------------------*\
+	AddKey( key, lastSeen)
+		-	adds the given content-key to the index, pretending it has last been
+			seen at the given time (in seconds since the epoch)
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::AddKey( uint64 key, uint32 lastSeen) {
+	BAutolock lock( mLocker);
+	mEntries[key] = lastSeen;
+	mModified = true;
+	if ((int32)mEntries.size() > mMaxEntries + mMaxEntries/8)
+		_Prune();
+}
+
+/*------------------------------------------------------------------------------*\
+	AddProcessingTime( duration)
+		-	tells the index how long filtering and storing a (non-duplicate)
+			mail took, the average is used to estimate the time saved by
+			skipping duplicates
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::AddProcessingTime( bigtime_t duration) {
+	BAutolock lock( mLocker);
+	if (!mAvgProcessingTime)
+		mAvgProcessingTime = duration;
+	else
+		mAvgProcessingTime = (mAvgProcessingTime*7 + duration) / 8;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddSavings( bytes)
+		-	records that a duplicate of the given size has been skipped
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::AddSavings( int32 bytes) {
+	BAutolock lock( mLocker);
+	mSavedCount++;
+	mSavedBytes += bytes;
+	mSavedTime += mAvgProcessingTime;
+	mModified = true;
+	BM_LOG2( BM_LogRecv,
+				BmString("DedupIndex: skipped duplicate of ") << bytes
+					<< " bytes, saved so far: " << mSavedCount << " mails, "
+					<< mSavedBytes << " bytes, " << mSavedTime/1000 << " ms");
+}
+
+/*------------------------------------------------------------------------------*\
+	Store()
+		-	drops all outdated entries and writes the index to disk (if it has
+			been modified)
+		-	returns false if the index could not be written
+\*------------------------------------------------------------------------------*/
+bool BmMailDedupIndex::Store() {
+	BAutolock lock( mLocker);
+	_Prune();
+	if (!mModified)
+		return true;
+	BmString filename = _IndexFileName();
+	try {
+		vector< BmDedupEntry> entries;
+		entries.reserve( mEntries.size());
+		EntryMap::const_iterator iter;
+		for( iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+			BmDedupEntry entry;
+			entry.key = iter->first;
+			entry.lastSeen = iter->second;
+			entries.push_back( entry);
+		}
+		BMessage archive;
+		status_t ret
+			= archive.AddInt16( MSG_VERSION, nArchiveVersion)
+				| archive.AddInt32( MSG_SAVED_COUNT, mSavedCount)
+				| archive.AddInt64( MSG_SAVED_BYTES, mSavedBytes)
+				| archive.AddInt64( MSG_SAVED_TIME, mSavedTime);
+		if (ret == B_OK && entries.size())
+			ret = archive.AddData( MSG_ENTRIES, B_RAW_TYPE, &entries[0],
+										  entries.size() * sizeof( BmDedupEntry));
+		BFile indexFile;
+		if (ret == B_OK)
+			ret = indexFile.SetTo( filename.String(),
+										  B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+		if (ret == B_OK)
+			ret = archive.Flatten( &indexFile);
+		if (ret != B_OK)
+			BM_THROW_RUNTIME( BmString("Could not store dedup-index into\n\t<")
+										<< filename << ">\n\n Result: " << strerror(ret));
+		mModified = false;
+		BM_LOG( BM_LogRecv,
+				  BmString("DedupIndex: stored index with ") << mEntries.size()
+						<< " entries");
+	} catch( BM_error &e) {
+		BM_LOGERR( e.what());
+		return false;
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ContentKey( text, length, headerLength, outKey)
+		-	computes the content-key of the given mail-text, which combines the
+			hash of the message-id with a hash of the body
+		-	carriage-returns and trailing whitespace of the body are ignored,
+			since servers are known to mess with them
+		-	returns false if the mail has no message-id
+\*------------------------------------------------------------------------------*/
+bool BmMailDedupIndex::ContentKey( const char* text, int32 length,
+											  int32 headerLength, uint64& outKey) {
+	if (!text || headerLength > length)
+		return false;
+	BmString messageID, references;
+	BmMailThreader::ExtractIDsFromHeader( text, headerLength, messageID,
+													  references);
+	if (!messageID.Length())
+		return false;
+	const char* body = text + headerLength;
+	const char* end = text + length;
+	while( end > body && (end[-1] == ' ' || end[-1] == '\t'
+	|| end[-1] == '\r' || end[-1] == '\n'))
+		end--;
+	// FNV-1a, seeded with the hash of the message-id:
+	uint64 hash
+		= BmMailThreader::HashID( messageID.String(), messageID.Length());
+	for( const char* p = body; p < end; ++p) {
+		if (*p == '\r')
+			continue;
+		hash ^= (uint8)*p;
+		hash *= 1099511628211ULL;
+	}
+	outKey = hash;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Lookup( mail, addIfMissing)
+		-	returns whether the given mail is contained in the index
+		-	the entry is refreshed (or created if addIfMissing is set)
+\*------------------------------------------------------------------------------*/
+bool BmMailDedupIndex::_Lookup( const BmMail* mail, bool addIfMissing) {
+	if (!mail)
+		return false;
+	const BmString& text = mail->RawText();
+	uint64 key;
+	if (!ContentKey( text.String(), text.Length(), mail->HeaderLength(), key))
+		return false;
+	BAutolock lock( mLocker);
+	uint32 now = time( NULL);
+	EntryMap::iterator iter = mEntries.find( key);
+	if (iter != mEntries.end()) {
+		iter->second = now;
+		mModified = true;
+		return true;
+	}
+	if (addIfMissing) {
+		mEntries[key] = now;
+		mModified = true;
+		if ((int32)mEntries.size() > mMaxEntries + mMaxEntries/8)
+			_Prune();
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Load()
+		-	reads the index from disk, a missing or damaged index-file just
+			leaves the index empty
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::_Load() {
+	BmString filename = _IndexFileName();
+	BFile indexFile;
+	BMessage archive;
+	if (indexFile.SetTo( filename.String(), B_READ_ONLY) != B_OK
+	|| archive.Unflatten( &indexFile) != B_OK
+	|| archive.FindInt16( MSG_VERSION) != nArchiveVersion)
+		return;
+	mSavedCount = archive.FindInt32( MSG_SAVED_COUNT);
+	mSavedBytes = archive.FindInt64( MSG_SAVED_BYTES);
+	mSavedTime = archive.FindInt64( MSG_SAVED_TIME);
+	const void* data;
+	ssize_t size;
+	if (archive.FindData( MSG_ENTRIES, B_RAW_TYPE, &data, &size) == B_OK) {
+		const BmDedupEntry* entries = static_cast< const BmDedupEntry*>( data);
+		int32 count = size / sizeof( BmDedupEntry);
+		for( int32 i=0; i<count; ++i)
+			mEntries[entries[i].key] = entries[i].lastSeen;
+	}
+	_Prune();
+	BM_LOG( BM_LogRecv,
+			  BmString("DedupIndex: loaded index with ") << mEntries.size()
+					<< " entries");
+}
+
+/*------------------------------------------------------------------------------*\
+	_Prune()
+		-	drops all entries that haven't been seen within the maximum age
+		-	if there still are too many entries, the oldest ones are dropped
+\*------------------------------------------------------------------------------*/
+void BmMailDedupIndex::_Prune() {
+	uint32 now = time( NULL);
+	uint32 minTime = now > mMaxAge ? now - mMaxAge : 0;
+	vector< uint32> times;
+	times.reserve( mEntries.size());
+	EntryMap::iterator iter;
+	for( iter = mEntries.begin(); iter != mEntries.end(); ) {
+		if (iter->second < minTime) {
+			mEntries.erase( iter++);
+			mModified = true;
+		} else
+			times.push_back( (iter++)->second);
+	}
+	int32 excess = mEntries.size() - mMaxEntries;
+	if (excess <= 0)
+		return;
+	// find the time that separates the oldest entries from the rest:
+	std::nth_element( times.begin(), times.begin() + excess, times.end());
+	uint32 cutoff = times[excess];
+	for( iter = mEntries.begin(); iter != mEntries.end() && excess > 0; ) {
+		if (iter->second < cutoff) {
+			mEntries.erase( iter++);
+			excess--;
+		} else
+			++iter;
+	}
+	// entries seen at the very same time as the cutoff:
+	for( iter = mEntries.begin(); iter != mEntries.end() && excess > 0; ) {
+		if (iter->second == cutoff) {
+			mEntries.erase( iter++);
+			excess--;
+		} else
+			++iter;
+	}
+	mModified = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_IndexFileName()
+		-
+\*------------------------------------------------------------------------------*/
+const BmString BmMailDedupIndex::_IndexFileName() const {
+	return BmString( BeamRoster->SettingsPath()) << "/" << "Mail Dedup Index";
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailDedupIndex_h
+#define _BmMailDedupIndex_h
+
+#include <map>
+
+#include <Locker.h>
+
+#include "BmMailKit.h"
+
+#include "BmString.h"
+
+using std::map;
+
+class BmMail;
+
+/*------------------------------------------------------------------------------*\
+	BmMailDedupIndex
+		-	remembers the content-keys of all mails that have been received
+			recently, such that duplicates (cross-posts to several mailing-
+			lists or mails redelivered by the server) can be skipped before
+			they are filtered and stored
+		-	a mail is only added to the index once it has been stored
+			successfully, checking a retrieved mail never adds it, otherwise
+			a mail whose storing failed would be skipped as a duplicate of
+			itself the next time it is fetched (and might even be deleted
+			from the server)
+		-	the content-key of a mail is a hash of its message-id and its
+			body, so mails that only differ in their headers (Received-lines,
+			list-tags) are detected, too. Mails without a message-id are
+			never considered duplicates
+		-	entries that haven't been seen for a while are dropped and the
+			number of entries is limited, the oldest ones go first
+		-	the index keeps track of how many bytes (and how much processing
+			time) have been saved by skipping duplicates
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailDedupIndex {
+
+	typedef map< uint64, uint32> EntryMap;
+							// maps content-key to time last seen
+
+public:
+	static BmMailDedupIndex* CreateInstance();
+	~BmMailDedupIndex();
+
+	// native methods:
+	bool Contains( const BmMail* mail);
+	void Add( const BmMail* mail);
+	bool ContainsKey( uint64 key);
+	void AddKey( uint64 key, uint32 lastSeen);
+	void AddProcessingTime( bigtime_t duration);
+	void AddSavings( int32 bytes);
+	bool Store();
+
+	// getters:
+	inline int32 EntryCount() const		{ return mEntries.size(); }
+	inline int32 MaxEntries() const		{ return mMaxEntries; }
+	inline uint32 MaxAge() const			{ return mMaxAge; }
+	inline int32 SavedCount() const		{ return mSavedCount; }
+	inline int64 SavedBytes() const		{ return mSavedBytes; }
+	inline bigtime_t SavedTime() const	{ return mSavedTime; }
+
+	// static functions:
+	static bool ContentKey( const char* text, int32 length,
+									int32 headerLength, uint64& outKey);
+
+	static BmMailDedupIndex* theInstance;
+
+	static const char* const MSG_VERSION;
+	static const char* const MSG_ENTRIES;
+	static const char* const MSG_SAVED_COUNT;
+	static const char* const MSG_SAVED_BYTES;
+	static const char* const MSG_SAVED_TIME;
+	static const int16 nArchiveVersion;
+
+private:
+	BmMailDedupIndex();
+	bool _Lookup( const BmMail* mail, bool addIfMissing);
+	void _Load();
+	void _Prune();
+	const BmString _IndexFileName() const;
+
+	EntryMap mEntries;
+	int32 mMaxEntries;
+	uint32 mMaxAge;
+							// in seconds
+	int32 mSavedCount;
+	int64 mSavedBytes;
+	bigtime_t mSavedTime;
+							// estimated from the average processing time
+	bigtime_t mAvgProcessingTime;
+							// average time spent filtering & storing a mail
+	bool mModified;
+	BLocker mLocker;
+							// protects all of the above
+
+	// Hide copy-constructor and assignment:
+	BmMailDedupIndex( const BmMailDedupIndex&);
+	BmMailDedupIndex operator=( const BmMailDedupIndex&);
+};
+
+#define TheMailDedupIndex BmMailDedupIndex::theInstance
+
+#endif
@@ -6,6 +6,8 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <map>
 
 #include "regexx.hh"
@@ -17,6 +19,7 @@ using namespace regexx;
 #include "BmLogHandler.h"
 #include "BmMailFactory.h"
 #include "BmMailHeader.h"
+#include "BmMemIO.h"
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 
@@ -204,214 +207,437 @@ void BmMailFactory::ExpandIntroMacros( BmRef<BmMail> mail, BmString& intro,
 
 /*------------------------------------------------------------------------------*\
 	QuoteText()
-		-	
+		-	quotes (and possibly rewraps) the given text according to the 
+			current quoting preferences
 \*------------------------------------------------------------------------------*/
 int32 BmMailFactory::QuoteText( const BmString& in, BmString& out, 
-								 const BmString inQuoteString, int maxLineLen) 
+								 const BmString quoteString, int maxLineLen) 
 {
-	out = "";
-	if (!in.Length())
-		return maxLineLen;
-	BmString quoteString;
-	quoteString.ConvertTabsToSpaces( ThePrefs->GetInt( "SpacesPerTab", 4), 
-												&inQuoteString);
+	BmQuoteFormatter formatter( quoteString, maxLineLen);
+	return formatter.Quote( in, out);
+}
+
+
+
+/******************************************************************************/
+// #pragma mark --- BmQuoteFormatter ---
+/******************************************************************************/
+
+// the default expressions as set in BmPrefs, these are handled by the
+// builtin scanners, any other expression is handed to the regex-engine:
+static const char* const nDefaultQuotingLevelRX 
+	= "^((?:\\w?\\w?\\w?[>|]|[ \\t]*)*)(.*?)$";
+static const char* const nDefaultEmptyLineRX = "^[ \\t]*$";
+static const char* const nDefaultListLineRX = "^[*+\\-\\d]+.*?$";
+
+static inline bool IsWordChar( char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') 
+		|| (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool IsBlank( const char* str, int32 len) {
+	for( int32 i=0; i<len; ++i)
+		if (str[i] != ' ' && str[i] != '\t')
+			return false;
+	return true;
+}
+
+static inline int32 CountUtf8Chars( const char* str, int32 len) {
+	int32 count = 0;
+	for( int32 i=0; i<len; ++i)
+		if ((str[i] & 0xC0) != 0x80)
+			count++;
+	return count;
+}
+
+/*------------------------------------------------------------------------------*\
+	StartsWithUrl( str, len)
+		-	checks whether the given string starts with an URL (ignoring 
+			leading whitespace)
+\*------------------------------------------------------------------------------*/
+static bool StartsWithUrl( const char* str, int32 len) {
+	static const char* const urlPrefixes[] = {
+		"http://", "https://", "ftp://", "nntp://", "file://", "mailto:", NULL
+	};
+	int32 pos = 0;
+	while( pos<len && isspace( (unsigned char)str[pos]))
+		pos++;
+	for( int32 i=0; urlPrefixes[i]; ++i) {
+		int32 prefixLen = strlen( urlPrefixes[i]);
+		if (len-pos >= prefixLen 
+		&& strncasecmp( str+pos, urlPrefixes[i], prefixLen) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmQuoteFormatter( quoteString, maxLineLen)
+		-	c'tor, fetches all relevant preferences and compiles any 
+			user-defined expressions
+\*------------------------------------------------------------------------------*/
+BmQuoteFormatter::BmQuoteFormatter( const BmString& quoteString, 
+												int maxLineLen)
+	:	mMaxLineLen( maxLineLen)
+	,	mSpacesPerTab( ThePrefs->GetInt( "SpacesPerTab", 4))
+	,	mMinLenForWrappedLine( ThePrefs->GetInt( "MinLenForWrappedLine", 50))
+	,	mQuotingLevelRX( NULL)
+	,	mEmptyLineRX( NULL)
+	,	mListLineRX( NULL)
+{
+	mQuoteString.ConvertTabsToSpaces( mSpacesPerTab, &quoteString);
+	mQuoteStringChars = mQuoteString.CountChars();
+
 	BmString qStyle = ThePrefs->GetString( "QuoteFormatting");
-	if (qStyle == BM_QUOTE_AUTO_WRAP)
-		return QuoteTextWithReWrap( in, out, quoteString, maxLineLen);
-	BmString quote;
-	BmString text;
-	Regexx rx;
-	rx.str( in);
-	rx.expr( ThePrefs->GetString( "QuotingLevelRX"));
-	int modifiedMaxLen = maxLineLen;
-	int maxTextLen;
-	// cache a few preference values
-	int32 spacesPerTab = ThePrefs->GetInt( "SpacesPerTab", 4);
-	int32 count = rx.exec( Regexx::study | Regexx::global | Regexx::newline);
-	for( int32 i=0; i<count; ++i) {
-		BmString q(rx.match[i].atom[0]);
-		quote.ConvertTabsToSpaces( spacesPerTab, &q);
-		// limit the quote chars to a sane length (as otherwise we might
-		// loop endlessly when trying to wrap the content lines)
-		if (quote.Length() > maxLineLen / 2)
-			quote.Truncate(maxLineLen / 2);
-		if (qStyle == BM_QUOTE_SIMPLE) {
-			// always respect maxLineLen, wrap when lines exceed right margin.
-			// This results in a combing-effect when long lines are wrapped
-			// around, producing a very short next line.
-			maxTextLen 
-				= MAX( 0, 
-						 maxLineLen - quote.CountChars() - quoteString.CountChars());
-		} else {
-			// qStyle == BM_QUOTE_PUSH_MARGIN
-			// push right margin for new quote-string, if needed, in effect 
-			// leaving the mail-formatting intact more often (but possibly
-			// exceeding 80 chars per line):
-			maxTextLen = MAX( 0, maxLineLen - quote.CountChars());
-		}
-		text = rx.match[i].atom[1];
-		int32 len = text.Length();
-		// trim trailing spaces:
-		while( len>0 && text[len-1]==' ')
-			len--;
-		text.Truncate( len);
-		int32 newLen = AddQuotedText( text, out, quote, quoteString, maxTextLen);
-		modifiedMaxLen = MAX( newLen, modifiedMaxLen);
+	if (qStyle == BmMailFactory::BM_QUOTE_AUTO_WRAP)
+		mStyle = AUTO_WRAP;
+	else if (qStyle == BmMailFactory::BM_QUOTE_SIMPLE)
+		mStyle = SIMPLE;
+	else
+		mStyle = PUSH_MARGIN;
+
+	BmString rx = ThePrefs->GetString( "QuotingLevelRX");
+	if (rx != nDefaultQuotingLevelRX) {
+		mQuotingLevelRX = new Regexx();
+		mQuotingLevelRX->expr( rx);
+	}
+	rx = ThePrefs->GetString( "QuotingLevelEmptyLineRX", nDefaultEmptyLineRX);
+	if (rx != nDefaultEmptyLineRX) {
+		mEmptyLineRX = new Regexx();
+		mEmptyLineRX->expr( rx);
+	}
+	rx = ThePrefs->GetString( "QuotingLevelListLineRX", nDefaultListLineRX);
+	if (rx != nDefaultListLineRX) {
+		mListLineRX = new Regexx();
+		mListLineRX->expr( rx);
 	}
-	// now remove trailing empty lines:
-	BmString emptyLinesAtEndRX 
-		= BmString("(?:") << "\\Q" << quoteString << "\\E" 
-								<< "(" << "\\Q" << quote << "\\E" 
-								<< ")?[ \\t]*\\n)+\\z";
-	out = rx.replace( out, emptyLinesAtEndRX, "", 
-							Regexx::newline|Regexx::global|Regexx::noatom);
-	return modifiedMaxLen;
 }
 
 /*------------------------------------------------------------------------------*\
-	QuoteText()
-		-	
+	~BmQuoteFormatter()
+		-	d'tor
 \*------------------------------------------------------------------------------*/
-int32 BmMailFactory::QuoteTextWithReWrap( const BmString& in, BmString& out, 
-											  BmString quoteString, int maxLineLen)
+BmQuoteFormatter::~BmQuoteFormatter()
 {
-	out = "";
+	delete mQuotingLevelRX;
+	delete mEmptyLineRX;
+	delete mListLineRX;
+}
+
+/*------------------------------------------------------------------------------*\
+	Quote( in, out)
+		-	quotes the given text, writing the result into out
+		-	the text is processed line by line in a single pass, all output
+			goes into one buffer that grows geometrically
+		-	returns the line-length needed to leave the formatting intact
+\*------------------------------------------------------------------------------*/
+int32 BmQuoteFormatter::Quote( const BmString& in, BmString& out)
+{
+	out.Truncate( 0);
 	if (!in.Length())
-		return maxLineLen;
-	Regexx rx;
-	rx.str( in);
+		return mMaxLineLen;
+	BmStringOBuf outBuf( in.Length() + in.Length()/4 + 256, 1.5);
+	BmString lastQuote;
+	int32 newLineLen 
+		= mStyle == AUTO_WRAP
+			? _QuoteAndReWrap( in, outBuf, lastQuote)
+			: _QuoteLines( in, outBuf, lastQuote);
+	out.Adopt( outBuf.TheString());
+	_RemoveTrailingEmptyLines( out, lastQuote);
+	return newLineLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	_QuoteLines( in, out, lastQuote)
+		-	quotes every line of the given text, wrapping lines that exceed the
+			right margin (modes "Simple" and "Push margin")
+\*------------------------------------------------------------------------------*/
+int32 BmQuoteFormatter::_QuoteLines( const BmString& in, BmStringOBuf& out,
+												 BmString& quote)
+{
+	int32 modifiedMaxLen = mMaxLineLen;
+	int32 maxTextLen;
+	int32 textStart, textLen;
+	const char* text = in.String();
+	const char* end = text + in.Length();
+	for( const char* line = text; line <= end; ) {
+		const char* eol = static_cast<const char*>( 
+			memchr( line, '\n', end-line)
+		);
+		if (!eol)
+			eol = end;
+		if (_SplitLine( line, eol-line, quote, textStart, textLen)) {
+			if (mStyle == SIMPLE) {
+				// always respect maxLineLen, wrap when lines exceed right 
+				// margin. This results in a combing-effect when long lines 
+				// are wrapped around, producing a very short next line.
+				maxTextLen = MAX( 0, mMaxLineLen - quote.CountChars() 
+												- mQuoteStringChars);
+			} else {
+				// mStyle == PUSH_MARGIN
+				// push right margin for new quote-string, if needed, in effect 
+				// leaving the mail-formatting intact more often (but possibly
+				// exceeding 80 chars per line):
+				maxTextLen = MAX( 0, mMaxLineLen - quote.CountChars());
+			}
+			// trim trailing spaces:
+			while( textLen>0 && line[textStart+textLen-1]==' ')
+				textLen--;
+			int32 newLen = _AddQuotedText( line+textStart, textLen, out, quote, 
+													 maxTextLen);
+			modifiedMaxLen = MAX( newLen, modifiedMaxLen);
+		}
+		line = eol+1;
+	}
+	return modifiedMaxLen;
+}
 
-	rx.expr( ThePrefs->GetString( "QuotingLevelRX"));
-	BmString currQuote;
-	BmString text;
-	BmString line;
+/*------------------------------------------------------------------------------*\
+	_QuoteAndReWrap( in, out, currQuote)
+		-	joins consecutive lines of the same quoting level into paragraphs,
+			which are then quoted and wrapped at the right margin
+			(mode "Auto wrap")
+\*------------------------------------------------------------------------------*/
+int32 BmQuoteFormatter::_QuoteAndReWrap( const BmString& in, 
+													  BmStringOBuf& out,
+													  BmString& currQuote)
+{
 	BmString quote;
-	Regexx rxl;
-	int maxTextLen;
-	int minLenForWrappedLine = ThePrefs->GetInt( "MinLenForWrappedLine", 50);
+	BmStringOBuf para( 256, 2.0);
+	int32 maxTextLen;
+	int32 textStart, textLen;
 	bool lastWasSpecialLine = true;
+	bool isFirstLine = true;
 	int32 lastLineLen = 0;
-	// cache a few preference values
-	int32 spacesPerTab = ThePrefs->GetInt( "SpacesPerTab", 4);
-	BmString quotingLevelEmptyLineRX
-		= ThePrefs->GetString( "QuotingLevelEmptyLineRX", "^[ \\t]*$");
-	BmString quotingLevelListLineRX
-		= ThePrefs->GetString( "QuotingLevelListLineRX",  "^[*+\\-\\d]+.*?$");
-	int32 count = rx.exec( Regexx::study | Regexx::global | Regexx::newline);
-	for( int32 i=0; i<count; ++i) {
-		BmString q(rx.match[i].atom[0]);
-		quote.ConvertTabsToSpaces( spacesPerTab, &q);
-		// limit the quote chars to a sane length (as otherwise we might
-		// loop endlessly when trying to wrap the content lines)
-		if (quote.Length() > maxLineLen / 2)
-			quote.Truncate(maxLineLen / 2);
-		line = rx.match[i].atom[1];
-		if ((line.CountChars() < minLenForWrappedLine && lastWasSpecialLine)
-		|| rxl.exec( line, quotingLevelEmptyLineRX)
-		|| rxl.exec( line, quotingLevelListLineRX)) {
-			if (i != 0) {
-				maxTextLen = MAX( 0, 
-							 			maxLineLen - currQuote.CountChars() 
-							 				- quoteString.CountChars());
-				AddQuotedText( text, out, currQuote, quoteString, maxTextLen);
-				text.Truncate(0);
+	const char* text = in.String();
+	const char* end = text + in.Length();
+	for( const char* line = text; line <= end; ) {
+		const char* eol = static_cast<const char*>( 
+			memchr( line, '\n', end-line)
+		);
+		if (!eol)
+			eol = end;
+		if (_SplitLine( line, eol-line, quote, textStart, textLen)) {
+			const char* lineText = line+textStart;
+			int32 lineChars = CountUtf8Chars( lineText, textLen);
+			bool flush = false;
+			if ((lineChars < mMinLenForWrappedLine && lastWasSpecialLine)
+			|| _IsSpecialLine( lineText, textLen)) {
+				flush = true;
+				lastWasSpecialLine = true;
+			} else if (lastWasSpecialLine || currQuote != quote 
+			|| lastLineLen < mMinLenForWrappedLine) {
+				flush = true;
+				lastWasSpecialLine = false;
+			}
+			if (flush && !isFirstLine) {
+				maxTextLen = MAX( 0, mMaxLineLen - currQuote.CountChars() 
+												- mQuoteStringChars);
+				_AddQuotedText( para.Buffer(), para.CurrPos(), out, currQuote, 
+									 maxTextLen);
+				para.Reset();
 			}
-			lastWasSpecialLine = true;
-		} else if (lastWasSpecialLine || currQuote != quote 
-		|| lastLineLen < minLenForWrappedLine) {
-			if (i != 0) {
-				maxTextLen = MAX( 0, 
-										maxLineLen - currQuote.CountChars() 
-											- quoteString.CountChars());
-				AddQuotedText( text, out, currQuote, quoteString, maxTextLen);
-				text.Truncate(0);
+			isFirstLine = false;
+			currQuote = quote;
+			lastLineLen = lineChars;
+			if (para.CurrPos()) {
+				// trim trailing spaces before joining the lines:
+				while( para.CurrPos() && para.ByteAt( para.CurrPos()-1) == ' ')
+					para.Truncate( para.CurrPos()-1);
+				para.Write( " ", 1);
 			}
-			lastWasSpecialLine = false;
+			para.Write( lineText, textLen);
 		}
-		currQuote = quote;
-		lastLineLen = line.CountChars();
-		if (!text.Length())
-			text = line;
-		else {
-			int32 len = text.Length();
-			// trim trailing spaces:
-			while( len>0 && text[len-1]==' ')
-				len--;
-			text.Truncate( len);
-			text << " " << line;
+		line = eol+1;
+	}
+	maxTextLen = MAX( 0, mMaxLineLen - currQuote.CountChars() 
+									- mQuoteStringChars);
+	_AddQuotedText( para.Buffer(), para.CurrPos(), out, currQuote, maxTextLen);
+	return mMaxLineLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	_SplitLine( line, len, quote, textStart, textLen)
+		-	splits the given line into quote and text
+		-	the quote is returned with tabs converted and limited to a sane 
+			length (as otherwise we might loop endlessly when trying to wrap 
+			the content lines)
+		-	returns false if a user-defined quoting-level expression does not 
+			match the line (such lines are skipped)
+\*------------------------------------------------------------------------------*/
+bool BmQuoteFormatter::_SplitLine( const char* line, int32 len, 
+											  BmString& quote, 
+											  int32& textStart, int32& textLen)
+{
+	int32 quoteStart = 0;
+	int32 quoteLen = 0;
+	if (mQuotingLevelRX) {
+		mLineBuf.SetTo( line, len);
+		mQuotingLevelRX->str( mLineBuf);
+		if (!mQuotingLevelRX->exec( Regexx::study | Regexx::newline))
+			return false;
+		const RegexxMatch& match = mQuotingLevelRX->match[0];
+		if (match.atom.size() >= 2) {
+			quoteStart = match.atom[0].start();
+			quoteLen = match.atom[0].Length();
+			textStart = match.atom[1].start();
+			textLen = match.atom[1].Length();
+		} else {
+			textStart = 0;
+			textLen = len;
 		}
+	} else {
+		// builtin equivalent of nDefaultQuotingLevelRX: any sequence of 
+		// whitespace and up to three word-chars followed by '>' or '|':
+		int32 pos = 0;
+		for(;;) {
+			while( pos<len && (line[pos]==' ' || line[pos]=='\t'))
+				pos++;
+			int32 wordLen = 0;
+			while( wordLen<3 && pos+wordLen<len && IsWordChar( line[pos+wordLen]))
+				wordLen++;
+			if (pos+wordLen<len 
+			&& (line[pos+wordLen]=='>' || line[pos+wordLen]=='|'))
+				pos += wordLen+1;
+			else
+				break;
+		}
+		quoteLen = pos;
+		textStart = pos;
+		textLen = len-pos;
 	}
-	maxTextLen = MAX( 0, 
-							maxLineLen - currQuote.CountChars() 
-								- quoteString.CountChars());
-	AddQuotedText( text, out, currQuote, quoteString, maxTextLen);
-	// now remove trailing empty lines:
-	BmString emptyLinesAtEndRX 
-		= BmString("(?:") << "\\Q" << quoteString << "\\E" 
-								<< "(" << "\\Q" << currQuote << "\\E" 
-								<< ")?[ \\t]*\\n)+\\z";
-	out = rx.replace( out, emptyLinesAtEndRX, "", 
-							Regexx::newline|Regexx::global|Regexx::noatom);
-	return maxLineLen;
+	if (memchr( line+quoteStart, '\t', quoteLen)) {
+		mLineBuf.SetTo( line+quoteStart, quoteLen);
+		quote.ConvertTabsToSpaces( mSpacesPerTab, &mLineBuf);
+	} else
+		quote.SetTo( line+quoteStart, quoteLen);
+	if (quote.Length() > mMaxLineLen / 2)
+		quote.Truncate( mMaxLineLen / 2);
+	return true;
 }
 
 /*------------------------------------------------------------------------------*\
-	AddQuotedLine()
-		-	
+	_IsSpecialLine( text, len)
+		-	returns whether the given line is empty or part of a list, in which
+			case it must not be joined with other lines when rewrapping
+\*------------------------------------------------------------------------------*/
+bool BmQuoteFormatter::_IsSpecialLine( const char* text, int32 len)
+{
+	if (mEmptyLineRX || mListLineRX)
+		mLineBuf.SetTo( text, len);
+	if (mEmptyLineRX) {
+		mEmptyLineRX->str( mLineBuf);
+		if (mEmptyLineRX->exec( Regexx::study | Regexx::nomatch))
+			return true;
+	} else if (IsBlank( text, len))
+		return true;
+	if (mListLineRX) {
+		mListLineRX->str( mLineBuf);
+		return mListLineRX->exec( Regexx::study | Regexx::nomatch) > 0;
+	}
+	return len > 0 
+		&& (text[0] == '*' || text[0] == '+' || text[0] == '-' 
+			|| (text[0] >= '0' && text[0] <= '9'));
+}
+
+/*------------------------------------------------------------------------------*\
+	_AddQuotedText( text, len, out, quote, maxTextLen)
+		-	adds the given text to out, prefixed by quote-string and quote, 
+			wrapping it at the given text-length
+		-	URLs are never wrapped
+		-	returns the length of the longest line written
 		-	N.B.: We use the character-count in order to determine line-lengths, 
 			which for some charsets (e.g. iso-2022-jp) results in lines longer than
 			78 *byte* hard-limit (it just respects a limit of 78 *characters*).
 			This probably violates the RFC, but I believe it just makes more sense
 			for the users (since characters is what they see on screen, not bytes).
 \*------------------------------------------------------------------------------*/
-int32 BmMailFactory::AddQuotedText( const BmString& inText, BmString& out, 
-									  const BmString& quote,
-									  const BmString& quoteString,
-								     int maxTextLen) {
+int32 BmQuoteFormatter::_AddQuotedText( const char* text, int32 len, 
+													 BmStringOBuf& out, 
+													 const BmString& quote,
+													 int32 maxTextLen)
+{
+	if (len && memchr( text, '\t', len)) {
+		mLineBuf.SetTo( text, len);
+		mTextBuf.ConvertTabsToSpaces( mSpacesPerTab, &mLineBuf);
+		text = mTextBuf.String();
+		len = mTextBuf.Length();
+	}
 	int32 modifiedMaxLen = 0;
-	BmString tmp;
-	BmString text;
-	bool isUrl = false;
-	Regexx rxUrl;
+	int32 prefixChars = mQuoteStringChars + quote.CountChars();
+	int32 charsLeft = CountUtf8Chars( text, len);
+	int32 pos = 0;
 	maxTextLen = MAX( 0, maxTextLen);
-	text.ConvertTabsToSpaces( ThePrefs->GetInt( "SpacesPerTab", 4), &inText);
-	int32 charsLeft = text.CountChars();
 	while( charsLeft > maxTextLen) {
+		bool isUrl = StartsWithUrl( text+pos, len-pos);
 		int32 wrapPos = B_ERROR;
-		int32 idx=0;
-		isUrl = rxUrl.exec(
-			text, "^\\s*(https?://|ftp://|nntp://|file://|mailto:)", 
-			Regexx::nocase
-		);
-		for(  int32 charCount=0; 
-				charCount<maxTextLen || (isUrl && wrapPos==B_ERROR && text[idx]); 
-			   ++charCount) {
+		int32 wrapChars = 0;
+		int32 idx = pos;
+		int32 charCount = 0;
+		for( ; idx<len && (charCount<maxTextLen || (isUrl && wrapPos==B_ERROR)); 
+			  ++charCount) {
 			if (IS_UTF8_STARTCHAR(text[idx])) {
 				idx++;
-				while( IS_WITHIN_UTF8_MULTICHAR(text[idx]))
+				while( idx<len && IS_WITHIN_UTF8_MULTICHAR(text[idx]))
 					idx++;
 			} else {
-				if (text[idx]==B_SPACE)
-					wrapPos = idx+1;
-				if (text[idx]=='\n')
+				if (text[idx]==B_SPACE || text[idx]=='\n') {
 					wrapPos = idx+1;
+					wrapChars = charCount+1;
+				}
 				idx++;
 			}
 		}
-		text.MoveInto( tmp, 0, wrapPos!=B_ERROR ? wrapPos : idx);
-		charsLeft -= tmp.CountChars();
-		tmp.Prepend( quoteString + quote);
-		modifiedMaxLen = MAX( tmp.CountChars(), modifiedMaxLen);
-		out << tmp << "\n";
+		int32 chunkEnd = wrapPos!=B_ERROR ? wrapPos : idx;
+		int32 chunkChars = wrapPos!=B_ERROR ? wrapChars : charCount;
+		if (chunkEnd == pos)
+			break;
+		out << mQuoteString << quote;
+		out.Write( text+pos, chunkEnd-pos);
+		out.Write( "\n", 1);
+		modifiedMaxLen = MAX( prefixChars+chunkChars, modifiedMaxLen);
+		charsLeft -= chunkChars;
+		pos = chunkEnd;
 	}
-	if (!inText.Length() || text.Length()) {
-		tmp = quoteString + quote + text;
-		modifiedMaxLen = MAX( tmp.CountChars(), modifiedMaxLen);
-		out << tmp << "\n";
+	if (!len || pos<len) {
+		out << mQuoteString << quote;
+		out.Write( text+pos, len-pos);
+		out.Write( "\n", 1);
+		modifiedMaxLen = MAX( prefixChars+charsLeft, modifiedMaxLen);
 	}
 	return modifiedMaxLen;
 }
 
+/*------------------------------------------------------------------------------*\
+	_RemoveTrailingEmptyLines( out, quote)
+		-	removes all lines from the end of out that contain nothing but 
+			the quote-string (optionally followed by the given quote)
+\*------------------------------------------------------------------------------*/
+void BmQuoteFormatter::_RemoveTrailingEmptyLines( BmString& out, 
+																  const BmString& quote)
+{
+	const char* buf = out.String();
+	int32 end = out.Length();
+	int32 qsLen = mQuoteString.Length();
+	while( end > 0 && buf[end-1] == '\n') {
+		int32 lineStart = end-1;
+		while( lineStart > 0 && buf[lineStart-1] != '\n')
+			lineStart--;
+		const char* line = buf+lineStart;
+		int32 lineLen = end-1-lineStart;
+		if (lineLen < qsLen || memcmp( line, mQuoteString.String(), qsLen) != 0)
+			break;
+		line += qsLen;
+		lineLen -= qsLen;
+		if (!IsBlank( line, lineLen)
+		&& (lineLen < quote.Length() 
+			|| memcmp( line, quote.String(), quote.Length()) != 0
+			|| !IsBlank( line+quote.Length(), lineLen-quote.Length())))
+			break;
+		end = lineStart;
+	}
+	out.Truncate( end);
+}
 
 
 /******************************************************************************/
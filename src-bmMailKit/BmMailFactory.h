@@ -21,6 +21,66 @@ const bool BM_IS_FORWARD = true;
 const bool BM_IS_REPLY = false;
 
 typedef vector< BmRef< BmMail> > BmMailVect;
+
+class BmStringOBuf;
+namespace regexx {
+	class Regexx;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmQuoteFormatter
+		-	quotes (and optionally rewraps) a multiline text, processing the 
+			lines in a single pass
+		-	all relevant preferences are fetched on construction (and 
+			user-defined expressions are compiled only once), so a formatter
+			can be used from any thread and for any number of texts
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmQuoteFormatter {
+
+public:
+	BmQuoteFormatter( const BmString& quoteString, int maxLineLen);
+	~BmQuoteFormatter();
+
+	// native methods:
+	int32 Quote( const BmString& in, BmString& out);
+
+private:
+	enum Style {
+		SIMPLE = 0,
+		PUSH_MARGIN,
+		AUTO_WRAP
+	};
+
+	int32 _QuoteLines( const BmString& in, BmStringOBuf& out, 
+							 BmString& lastQuote);
+	int32 _QuoteAndReWrap( const BmString& in, BmStringOBuf& out, 
+								  BmString& lastQuote);
+	bool _SplitLine( const char* line, int32 len, BmString& quote, 
+						  int32& textStart, int32& textLen);
+	bool _IsSpecialLine( const char* text, int32 len);
+	int32 _AddQuotedText( const char* text, int32 len, BmStringOBuf& out,
+								 const BmString& quote, int32 maxTextLen);
+	void _RemoveTrailingEmptyLines( BmString& out, const BmString& quote);
+
+	BmString mQuoteString;
+	int32 mQuoteStringChars;
+	int32 mMaxLineLen;
+	Style mStyle;
+	int32 mSpacesPerTab;
+	int32 mMinLenForWrappedLine;
+	regexx::Regexx* mQuotingLevelRX;
+	regexx::Regexx* mEmptyLineRX;
+	regexx::Regexx* mListLineRX;
+							// user-defined expressions (NULL if the default
+							// expression is used, which has a builtin scanner)
+	BmString mLineBuf;
+	BmString mTextBuf;
+
+	// Hide copy-constructor and assignment:
+	BmQuoteFormatter( const BmQuoteFormatter&);
+	BmQuoteFormatter operator=( const BmQuoteFormatter&);
+};
+
 /*------------------------------------------------------------------------------*\
 	BmMailFactory
 		-	this class encapsulates the generation of new mails that are based
@@ -51,18 +111,12 @@ protected:
 	void ExpandIntroMacros( BmRef<BmMail> mail, BmString& intro, 
 									bool usePersonalPhrase);
 
-	// Static functions that try to reformat & quote a given multiline text
+	// Static function that tries to reformat & quote a given multiline text
 	// in a way that avoids the usual (ugly) quoting-mishaps.
 	// The resulting int is the line-length needed to leave 
 	// the formatting intact.
 	static int32 QuoteText( const BmString& in, BmString& out, 
 									const BmString quote, int maxLen);
-	static int32 QuoteTextWithReWrap( const BmString& in, BmString& out, 
-											    BmString quoteString, int maxLineLen);
-	static int32 AddQuotedText( const BmString& text, BmString& out, 
-										 const BmString& quote, 
-										 const BmString& quoteString,
-								 		 int maxTextLen);
 	BmMailRefVect mBaseRefVect;
 							// the mailref(s) that created us (via forward/reply)
 };
@@ -9,6 +9,8 @@
 #include <memory>
 #include <stdio.h>
 
+#include <Autolock.h>
+
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmFilter.h"
@@ -16,6 +18,7 @@
 #include "BmMail.h"
 #include "BmMailFilter.h"
 #include "BmMailHeader.h"
+#include "BmPrefs.h"
 #include "BmRecvAccount.h"
 #include "BmSmtpAccount.h"
 #include "BmUtil.h"
@@ -26,6 +29,13 @@
 
 static const float GRAIN = 1.0;
 
+// the filter-threads are only used for jobs with at least this many mails:
+static const int32 nMinCountForThreads = 20;
+// number of mails each filter-thread may be ahead of the committer:
+static const int32 nSlotsPerThread = 4;
+// status-updates are sent at most this often (in microseconds):
+static const bigtime_t nStatusInterval = 100*1000;
+
 const char* const BmMailFilter::MSG_FILTER = 	"bm:filter";
 const char* const BmMailFilter::MSG_DELTA = 		"bm:delta";
 const char* const BmMailFilter::MSG_TRAILING = 	"bm:trailing";
@@ -42,6 +52,13 @@ BmMailFilter::BmMailFilter( const BmString& name, BmFilter* filter,
 	,	mFilter( filter)
 	,	mMailRefs( NULL)
 	,	mExecuteInMem( executeInMem)
+	,	mSlotLocker( "FilterSlotLock")
+	,	mNextIndex( 0)
+	,	mFreeSlotSem( -1)
+	,	mFilteredSem( -1)
+	,	mStopFiltering( false)
+	,	mPendingDelta( 0)
+	,	mLastStatusTime( 0)
 {
 	NeedControllersToContinue( needControllers);
 }
@@ -89,6 +106,8 @@ bool BmMailFilter::ShouldContinue() {
 /*------------------------------------------------------------------------------*\
 	StartJob()
 		-	the job, executes the filter on all given mail-refs
+		-	larger amounts of mail-refs are read and filtered by several 
+			threads at once (see _FilterMailRefsInParallel())
 \*------------------------------------------------------------------------------*/
 bool BmMailFilter::StartJob() {
 	try {
@@ -98,18 +117,27 @@ bool BmMailFilter::StartJob() {
 			count += mMailRefs->size();
 		BM_LOG2( BM_LogFilter, 
 					BmString("Starting filter-job for ") << count << " mails.");
+		BmArena::Stats arenaStats = BmArena::GlobalStats();
 		const float delta =  100.0f / (float(count) / GRAIN);
+		mPendingDelta = 0;
+		mLastStatusTime = 0;
 		if (mMailRefs) {
-			BmRef<BmMail> mail;
-			for( uint32 i=0; ShouldContinue() && i<mMailRefs->size(); ++i) {
-				mail = BmMail::CreateInstance( (*mMailRefs)[i].Get());
-				if (mail) {
-					mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
-					if (mail->InitCheck() == B_OK)
-					Execute( mail.Get());
+			int32 threadCount = ThePrefs->GetInt( "FilterThreads", 4);
+			if (threadCount < 2 
+			|| (int32)mMailRefs->size() < nMinCountForThreads
+			|| !_FilterMailRefsInParallel( threadCount, delta, count, c)) {
+				BmRef<BmMail> mail;
+				for( uint32 i=0; ShouldContinue() && i<mMailRefs->size(); ++i) {
+					mail = BmMail::CreateInstance( (*mMailRefs)[i].Get());
+					if (mail) {
+						mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+						if (mail->InitCheck() == B_OK)
+						Execute( mail.Get());
+					}
+					BmString currentCount = BmString()<<++c<<" of "<<count;
+					UpdateStatus( delta, mail ? mail->Name().String() : "", 
+									  currentCount.String());
 				}
-				BmString currentCount = BmString()<<++c<<" of "<<count;
-				UpdateStatus( delta, mail->Name().String(), currentCount.String());
 			}
 			mMailRefs->clear();
 		}
@@ -123,11 +151,20 @@ bool BmMailFilter::StartJob() {
 		}
 		mMails.clear();
 		BmString currentCount = BmString()<<c<<" of "<<count;
-		UpdateStatus( delta, "", currentCount.String());
+		UpdateStatus( delta, "", currentCount.String(), true);
 		if (ShouldContinue())
 			BM_LOG2( BM_LogFilter, "Filter-job has finished.");
 		else
 			BM_LOG2( BM_LogFilter, "Filter-job has been stopped.");
+		if (mMailRefs) {
+			// only batches are reported, as the inbound filters run a job
+			// for every received mail (the popper reports those):
+			BmArena::Stats totalStats = BmArena::GlobalStats();
+			BM_LOG( BM_LogFilter, 
+					  BmString("Parse-arenas of filter-job: ") 
+					  		<< BmArena::StatsString( totalStats, arenaStats)
+					  		<< ", total: " << BmArena::StatsString( totalStats));
+		}
 		return true;
 	}
 	catch( BM_runtime_error &err) {
@@ -139,6 +176,168 @@ bool BmMailFilter::StartJob() {
 	return false;
 }
 
+/*------------------------------------------------------------------------------*\
+	_FilterMailRefsInParallel( threadCount, delta, count, c)
+		-	reads and filters the mail-refs with the given number of 
+			filter-threads, while the results are committed (in the order of 
+			the mail-refs) by the current thread
+		-	the filter-threads are never more than nSlotsPerThread mails per 
+			thread ahead of the committer
+		-	returns false if no filter-threads could be started (in which case 
+			no mail has been touched)
+\*------------------------------------------------------------------------------*/
+bool BmMailFilter::_FilterMailRefsInParallel( int32 threadCount, float delta,
+															 int32 count, int32& c) {
+	uint32 refCount = mMailRefs->size();
+	uint32 slotCount = threadCount * nSlotsPerThread;
+	mFreeSlotSem = create_sem( slotCount, "bm_filter_free");
+	mFilteredSem = create_sem( 0, "bm_filter_done");
+	vector< thread_id> threads;
+	if (mFreeSlotSem >= 0 && mFilteredSem >= 0) {
+		mSlots.clear();
+		mSlots.resize( slotCount);
+		mNextIndex = 0;
+		mStopFiltering = false;
+		for( int32 t=0; t<threadCount; ++t) {
+			thread_id tid = spawn_thread( &_FilterThread, "bm_mail_filter",
+													B_NORMAL_PRIORITY, this);
+			if (tid < 0)
+				break;
+			threads.push_back( tid);
+			resume_thread( tid);
+		}
+	}
+	if (threads.empty()) {
+		_StopFilterThreads( threads);
+		return false;
+	}
+	BM_LOG2( BM_LogFilter, 
+				BmString("Filtering in ") << int32(threads.size()) << " threads.");
+	try {
+		for( uint32 i=0; ShouldContinue() && i<refCount; ++i) {
+			BmFilterSlot& slot = mSlots[i % slotCount];
+			// wait until the filter-threads are done with this mail:
+			while( 1) {
+				{	// scope for autolock
+					BAutolock lock( mSlotLocker);
+					if (slot.filtered)
+						break;
+				}
+				acquire_sem( mFilteredSem);
+			}
+			BmRef<BmMail> mail;
+			BmMsgContext* msgContext;
+			bool needsCommit;
+			{	// scope for autolock
+				BAutolock lock( mSlotLocker);
+				mail = slot.mail;
+				msgContext = slot.msgContext;
+				needsCommit = slot.needsCommit;
+				slot = BmFilterSlot();
+			}
+			std::auto_ptr<BmMsgContext> msgContextDeleter( msgContext);
+			if (needsCommit)
+				_CommitResults( mail.Get(), msgContext);
+			BmString currentCount = BmString()<<++c<<" of "<<count;
+			UpdateStatus( delta, mail ? mail->Name().String() : "", 
+							  currentCount.String());
+			release_sem( mFreeSlotSem);
+		}
+	}
+	catch( ...) {
+		_StopFilterThreads( threads);
+		throw;
+	}
+	_StopFilterThreads( threads);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_StopFilterThreads( threads)
+		-	stops the given filter-threads (mails that have been filtered but
+			not committed are dropped) and frees the resources of the 
+			parallel mode
+\*------------------------------------------------------------------------------*/
+void BmMailFilter::_StopFilterThreads( vector< thread_id>& threads) {
+	if (threads.size()) {
+		{	// scope for autolock
+			BAutolock lock( mSlotLocker);
+			mStopFiltering = true;
+		}
+		release_sem_etc( mFreeSlotSem, threads.size(), 0);
+		status_t exitVal;
+		for( uint32 t=0; t<threads.size(); ++t)
+			wait_for_thread( threads[t], &exitVal);
+		threads.clear();
+	}
+	for( uint32 i=0; i<mSlots.size(); ++i)
+		delete mSlots[i].msgContext;
+	mSlots.clear();
+	if (mFreeSlotSem >= 0)
+		delete_sem( mFreeSlotSem);
+	if (mFilteredSem >= 0)
+		delete_sem( mFilteredSem);
+	mFreeSlotSem = mFilteredSem = -1;
+}
+
+/*------------------------------------------------------------------------------*\
+	_FilterThread( data)
+		-	
+\*------------------------------------------------------------------------------*/
+int32 BmMailFilter::_FilterThread( void* data) {
+	BmMailFilter* mailFilter = static_cast< BmMailFilter*>( data);
+	if (mailFilter)
+		mailFilter->_FilterMailRefs();
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	_FilterMailRefs()
+		-	main loop of every filter-thread: picks the next mail-ref (as soon
+			as there is a free slot), reads the mail and applies the filters
+			to it
+		-	the results are left in the mail's slot for the committer
+\*------------------------------------------------------------------------------*/
+void BmMailFilter::_FilterMailRefs() {
+	while( 1) {
+		while( acquire_sem( mFreeSlotSem) == B_INTERRUPTED)
+			;
+		uint32 index;
+		{	// scope for autolock
+			BAutolock lock( mSlotLocker);
+			if (mStopFiltering || mNextIndex >= mMailRefs->size())
+				return;
+			index = mNextIndex++;
+		}
+		BmRef<BmMail> mail;
+		BmMsgContext* msgContext = new BmMsgContext;
+		bool needsCommit = false;
+		try {
+			mail = BmMail::CreateInstance( (*mMailRefs)[index].Get());
+			if (mail) {
+				mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+				if (mail->InitCheck() == B_OK) {
+					msgContext->mail = mail.Get();
+					needsCommit = _ApplyFilters( mail.Get(), msgContext);
+				}
+			}
+		} catch( BM_error &err) {
+			BM_LOGERR( BmString("Could not filter mail <")
+								<< (*mMailRefs)[index]->TrackerName() 
+								<< ">\n\nError:" << err.what());
+		}
+		{	// scope for autolock
+			BAutolock lock( mSlotLocker);
+			BmFilterSlot& slot = mSlots[index % mSlots.size()];
+			slot.mail = mail;
+			slot.msgContext = msgContext;
+			slot.needsCommit = needsCommit;
+			slot.filtered = true;
+		}
+		release_sem( mFilteredSem);
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	Execute()
 		-	applies mail-filtering to a single given mail
@@ -146,7 +345,19 @@ bool BmMailFilter::StartJob() {
 void BmMailFilter::Execute( BmMail* mail) {
 	BmMsgContext msgContext;
 	msgContext.mail = mail;
+	if (_ApplyFilters( mail, &msgContext))
+		_CommitResults( mail, &msgContext);
+}
 
+/*------------------------------------------------------------------------------*\
+	_ApplyFilters( mail, msgContext)
+		-	executes the filter(-chain) for the given mail, collecting the
+			results in the given message-context
+		-	this does not change the mail on disk, so it may be called by
+			several filter-threads at once
+		-	returns false if there's nothing to commit (no chain found)
+\*------------------------------------------------------------------------------*/
+bool BmMailFilter::_ApplyFilters( BmMail* mail, BmMsgContext* msgContext) {
 	BmRef< BmListModelItem> accItem 
 		= TheRecvAccountList->FindItemByKey( mail->AccountName());
 	BmRecvAccount* recvAcc = dynamic_cast< BmRecvAccount*>( accItem.Get());
@@ -178,85 +389,110 @@ void BmMailFilter::Execute( BmMail* mail) {
 			BM_LOG2( BM_LogFilter, 
 						BmString("...found chain ") << chain->DisplayKey() 
 							<< ", applying all its filters...");
-			// execute all the chain's filters:
-			BmAutolockCheckGlobal lock( chain->ModelLocker());
-			if (!lock.IsLocked())
-				BM_THROW_RUNTIME( chain->ModelNameNC() << ": Unable to get lock");
-			BmFilterPosVect::const_iterator iter;
-			for( iter = chain->posBegin(); iter != chain->posEnd(); ++iter) {
-				BmChainedFilter* chainedFilter = *iter;
-				BmRef< BmListModelItem> filterItem 
-					= TheFilterList->FindItemByKey( chainedFilter->Key());
-				BmFilter* filter = dynamic_cast< BmFilter*>( filterItem.Get());
-				if (filter) {
-					if (!ExecuteFilter( mail, filter, &msgContext))
-						break;
+			// fetch all the chain's filters:
+			vector< BmRef< BmFilter> > filters;
+			{	// scope for autolock
+				BmAutolockCheckGlobal lock( chain->ModelLocker());
+				if (!lock.IsLocked())
+					BM_THROW_RUNTIME( 
+						chain->ModelNameNC() << ": Unable to get lock"
+					);
+				BmFilterPosVect::const_iterator iter;
+				for( iter = chain->posBegin(); iter != chain->posEnd(); ++iter) {
+					BmChainedFilter* chainedFilter = *iter;
+					BmRef< BmListModelItem> filterItem 
+						= TheFilterList->FindItemByKey( chainedFilter->Key());
+					BmFilter* filter = dynamic_cast< BmFilter*>( filterItem.Get());
+					if (filter)
+						filters.push_back( filter);
 				}
 			}
+			// ...and execute them without holding the chain's lock, such that
+			// other filter-threads can use the chain, too:
+			for( uint32 i=0; i<filters.size(); ++i) {
+				if (!ExecuteFilter( mail, filters[i].Get(), msgContext))
+					break;
+			}
 		} else {
 			BM_LOG2( BM_LogFilter, "...no chain found -> nothing to do.");
-			return;
+			return false;
 		}
 	} else
-		ExecuteFilter( mail, mFilter.Get(), &msgContext);
+		ExecuteFilter( mail, mFilter.Get(), msgContext);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_CommitResults( mail, msgContext)
+		-	applies the results of filtering (as found in the given
+			message-context) to the given mail, storing or moving it if needed
+		-	learning spam/tofu is done here, too, since it changes the state
+			of the spam-filter
+		-	N.B.: In parallel mode, the filter-threads are up to
+			FilterThreads*nSlotsPerThread mails ahead of the commit, so these
+			mails have been classified before the spam-filter has learned
+			from the current one (SpamTest::ConvergenceTest checks that
+			training still converges)
+\*------------------------------------------------------------------------------*/
+void BmMailFilter::_CommitResults( BmMail* mail, BmMsgContext* msgContext) {
 	bool needToStore = false;
-	bool learnAsSpam = msgContext.GetBool("LearnAsSpam");
+	bool learnAsSpam = msgContext->GetBool("LearnAsSpam");
 	if (learnAsSpam) {
 		BmRef<BmFilter> learnAsSpamFilter = TheFilterList->LearnAsSpamFilter();
 		if (learnAsSpamFilter)
-			learnAsSpamFilter->Execute( &msgContext);
+			learnAsSpamFilter->Execute( msgContext);
 		needToStore = true;
 	}
-	bool learnAsTofu = msgContext.GetBool("LearnAsTofu");
+	bool learnAsTofu = msgContext->GetBool("LearnAsTofu");
 	if (learnAsTofu) {
 		BmRef<BmFilter> learnAsTofuFilter = TheFilterList->LearnAsTofuFilter();
 		if (learnAsTofuFilter)
-			learnAsTofuFilter->Execute( &msgContext);
+			learnAsTofuFilter->Execute( msgContext);
 		needToStore = true;
 	}
-	BmString newIdentity = msgContext.GetString("Identity");
+	BmString newIdentity = msgContext->GetString("Identity");
 	if (newIdentity.Length() && newIdentity != mail->IdentityName()) {
 		mail->IdentityName( newIdentity);
 		needToStore = true;
 	}
-	BmString newListId = msgContext.GetString("ListId");
+	BmString newListId = msgContext->GetString("ListId");
 	if (newListId.Length() && newListId != mail->GetFieldVal(BM_FIELD_LIST_ID)) {
 		mail->SetFieldVal(BM_FIELD_LIST_ID, newListId);
 		mail->ReconstructRawText();
 		needToStore = true;
 	}
-	BmString newStatus = msgContext.GetString("Status");
+	BmString newStatus = msgContext->GetString("Status");
 	if (newStatus.Length() && newStatus != mail->Status()) {
 		mail->MarkAs( newStatus.String());
 		needToStore = true;
 	}
-	BmString rejectMsg = msgContext.GetString("RejectMsg");
+	BmString rejectMsg = msgContext->GetString("RejectMsg");
 	if (rejectMsg.Length()) {
 		// ToDo (maybe): implement sending of MDN
 	}
-	bool moveToTrash = msgContext.GetBool("MoveToTrash");
+	bool moveToTrash = msgContext->GetBool("MoveToTrash");
 	if (moveToTrash) {
 		mail->MoveToTrash( true);
 		needToStore = true;
 	}
-	if (msgContext.HasField("RatioSpam")) {
-		double ratioSpam = msgContext.GetDouble("RatioSpam");
+	if (msgContext->HasField("RatioSpam")) {
+		double ratioSpam = msgContext->GetDouble("RatioSpam");
 		if (ratioSpam != mail->RatioSpam()) {
 			mail->RatioSpam(float(ratioSpam));
 			needToStore = true;
 		}
 	}
-	bool isSpam = msgContext.GetBool("IsSpam");
+	bool isSpam = msgContext->GetBool("IsSpam");
 	if (isSpam && !mail->IsMarkedAsSpam()) {
 		mail->MarkAsSpam();
 		needToStore = true;
 	}
-	bool isTofu = msgContext.GetBool("IsTofu");
+	bool isTofu = msgContext->GetBool("IsTofu");
 	if (isTofu && !mail->IsMarkedAsTofu()) {
 		mail->MarkAsTofu();
 		needToStore = true;
 	}
-	BmString newFolderName = msgContext.GetString("FolderName");
+	BmString newFolderName = msgContext->GetString("FolderName");
 	if (newFolderName.Length()) {
 		if (mail->SetDestFolderName( newFolderName)) {
 			if (!needToStore && !mExecuteInMem) {
@@ -342,13 +578,22 @@ bool BmMailFilter::ExecuteFilter( BmMail* mail, BmFilter* filter,
 /*------------------------------------------------------------------------------*\
 	UpdateStatus()
 		-	informs the interested party about a change in the current state
+		-	in order to not flood the controllers with messages when filtering
+			lots of mails, updates are only sent every nStatusInterval (the
+			deltas of any skipped updates are accumulated)
 \*------------------------------------------------------------------------------*/
 void BmMailFilter::UpdateStatus( const float delta, const char* filename, 
-										   const char* currentCount) {
+										   const char* currentCount, bool force) {
+	mPendingDelta += delta;
+	bigtime_t now = system_time();
+	if (!force && ShouldContinue() && now - mLastStatusTime < nStatusInterval)
+		return;
+	mLastStatusTime = now;
 	std::auto_ptr<BMessage> msg( new BMessage( BM_JOB_UPDATE_STATE));
 	msg->AddString( MSG_FILTER, Name().String());
 	msg->AddString( BmJobModel::MSG_DOMAIN, "statbar");
-	msg->AddFloat( MSG_DELTA, delta);
+	msg->AddFloat( MSG_DELTA, mPendingDelta);
+	mPendingDelta = 0;
 	msg->AddString( MSG_LEADING, filename);
 	if (!ShouldContinue())
 		msg->AddString( MSG_TRAILING, 
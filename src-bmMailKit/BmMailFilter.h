@@ -13,7 +13,9 @@
 
 #include <vector>
 
+#include <Locker.h>
 #include <Message.h>
+#include <OS.h>
 
 #include "BmMailRef.h"
 #include "BmUtil.h"
@@ -30,6 +32,18 @@ class IMPEXPBMMAILKIT BmMailFilter : public BmJobModel {
 
 	typedef vector< BmRef< BmMail> > BmMailVect;
 	typedef vector< const char**> BmHeaderVect;
+
+	struct BmFilterSlot {
+		BmFilterSlot()
+			:	msgContext( NULL)
+			,	needsCommit( false)
+			,	filtered( false)				{}
+		BmRef< BmMail> mail;
+		BmMsgContext* msgContext;
+		bool needsCommit;
+		bool filtered;
+	};
+	typedef vector< BmFilterSlot> BmFilterSlotVect;
 	
 public:
 	//	message component definitions for status-msgs:
@@ -60,7 +74,14 @@ private:
 	bool ExecuteFilter( BmMail* mail, BmFilter* filter,
 							  BmMsgContext* msgContext);
 	void UpdateStatus( const float delta, const char* filename, 
-							 const char* currentCount);
+							 const char* currentCount, bool force = false);
+	bool _ApplyFilters( BmMail* mail, BmMsgContext* msgContext);
+	void _CommitResults( BmMail* mail, BmMsgContext* msgContext);
+	bool _FilterMailRefsInParallel( int32 threadCount, float delta,
+											  int32 count, int32& c);
+	static int32 _FilterThread( void* data);
+	void _StopFilterThreads( vector< thread_id>& threads);
+	void _FilterMailRefs();
 
 	BmRef<BmFilter> mFilter;
 							// the actual SIEVE-filter
@@ -72,6 +93,24 @@ private:
 							// indicates whether the mail shall be stored
 							// after the filtering process (false) or not (true).
 
+	// state of the parallel mode (see _FilterMailRefsInParallel()):
+	BmFilterSlotVect mSlots;
+							// ring-buffer of the mails that are being filtered
+							// but have not been committed yet
+	BLocker mSlotLocker;
+	uint32 mNextIndex;
+							// index of the next mail-ref to be picked by a
+							// filter-thread
+	sem_id mFreeSlotSem;
+							// counts the free slots
+	sem_id mFilteredSem;
+							// released whenever a mail has been filtered
+	bool mStopFiltering;
+
+	float mPendingDelta;
+							// progress that has not been reported yet
+	bigtime_t mLastStatusTime;
+
 	// Hide copy-constructor and assignment:
 	BmMailFilter( const BmMailFilter&);
 	BmMailFilter operator=( const BmMailFilter&);
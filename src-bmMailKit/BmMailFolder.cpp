@@ -9,12 +9,15 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <stdlib.h>
+
 #include <Directory.h>
 #include <NodeMonitor.h>
 #include <Path.h>
 
 #include "BmBasics.h"
 #include "BmLogHandler.h"
+#include "BmMail.h"
 #include "BmMailFolder.h"
 #include "BmMailFolderList.h"
 #include "BmMailMonitor.h"
@@ -32,6 +35,7 @@ const char* const BmMailFolder::MSG_LASTMODIFIED = "bm:lmod";
 const char* const BmMailFolder::MSG_MAILCOUNT = 	"bm:mcnt";
 const char* const BmMailFolder::MSG_SELECTED_KEY =	"bm:selk";
 const char* const BmMailFolder::MSG_STATEINFO_CONNECTED = "bm:sicn";
+const char* const BmMailFolder::MSG_SPECIAL_NODES = "bm:spcn";
 
 //	message component definitions for status-msgs:
 const char* const BmMailFolder::MSG_NAME = 			"bm:fname";
@@ -47,7 +51,21 @@ const char* BmMailFolder::OUT_FOLDER_NAME			= "out";
 const char* BmMailFolder::QUARANTINE_FOLDER_NAME= "quarantine";
 const char* BmMailFolder::SPAM_FOLDER_NAME		= "spam";
 
-const int16 BmMailFolder::nArchiveVersion = 4;
+const int16 BmMailFolder::nArchiveVersion = 5;
+
+enum {
+	BM_FOLDER_MAILCOUNT			= 'bmfc',
+		// the number of mails in a folder has changed
+	BM_FOLDER_ADD_SPECIAL		= 'bmfa',
+		// a mail in a folder has become special (new or pending)
+	BM_FOLDER_REMOVE_SPECIAL	= 'bmfr'
+		// a mail in a folder is no longer special
+};
+
+static const char* const MSG_REFKEY = "bm:rkey";
+
+// attribute of the folder's directory that marks compressed folders:
+static const char* const BM_FOLDER_ATTR_COMPRESSED = "BEAM:compressed";
 
 /*------------------------------------------------------------------------------*\
 	IsSystemFolderSubPath( subPath)
@@ -121,6 +139,19 @@ BmMailFolder::BmMailFolder( BMessage* archive, BmMailFolderList* model,
 		if (version > 3)
 			mRefListStateInfoConnectedToParent 
 				= FindMsgBool( archive, MSG_STATEINFO_CONNECTED);
+		if (version > 4) {
+			// the special mails as they were when the folder-cache was written
+			// (will be validated by the folder-list in the background):
+			const void* data;
+			ssize_t size;
+			if (archive->FindData( MSG_SPECIAL_NODES, B_RAW_TYPE, 
+										  &data, &size) == B_OK) {
+				const int64* nodes = static_cast< const int64*>( data);
+				int32 count = size / sizeof( int64);
+				for( int32 i=0; i<count; ++i)
+					mSpecialMailRefSet.insert( BmString() << nodes[i]);
+			}
+		}
 		StartNodeMonitor();
 	} catch (BM_error &e) {
 		BM_SHOWERR( e.what());
@@ -161,6 +192,52 @@ bool BmMailFolder::Exists() const {
 	return entry.Exists();
 }
 
+/*------------------------------------------------------------------------------*\
+	IsCompressed()
+		-	returns whether the mails in this folder are stored compressed
+\*------------------------------------------------------------------------------*/
+bool BmMailFolder::IsCompressed() const {
+	BDirectory dir( &mEntryRef);
+	return IsCompressedFolder( &dir);
+}
+
+/*------------------------------------------------------------------------------*\
+	Compressed( compressed)
+		-	switches this folder into or out of compressed mode, which affects
+			all mails stored into this folder from now on
+		-	existing mails are converted by BmMailFolderCompressor
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::Compressed( bool compressed) {
+	BNode node( &mEntryRef);
+	status_t err;
+	if ((err = node.InitCheck()) != B_OK)
+		BM_THROW_RUNTIME( BmString("Could not access folder <") << Name()
+									<< ">\n\n Result: " << strerror(err));
+	if (compressed) {
+		ssize_t res = node.WriteAttr( BM_FOLDER_ATTR_COMPRESSED, B_BOOL_TYPE, 0,
+												&compressed, sizeof(compressed));
+		if (res < 0)
+			BM_THROW_RUNTIME( BmString("Could not mark folder <") << Name()
+										<< "> as compressed\n\n Result: " 
+										<< strerror(res));
+	} else
+		node.RemoveAttr( BM_FOLDER_ATTR_COMPRESSED);
+}
+
+/*------------------------------------------------------------------------------*\
+	IsCompressedFolder( folderNode)
+		-	returns whether the given folder-directory has been marked as 
+			compressed (used when storing mails, where only the directory
+			is known)
+\*------------------------------------------------------------------------------*/
+bool BmMailFolder::IsCompressedFolder( BNode* folderNode) {
+	bool compressed = false;
+	if (folderNode && folderNode->InitCheck() == B_OK)
+		folderNode->ReadAttr( BM_FOLDER_ATTR_COMPRESSED, B_BOOL_TYPE, 0,
+									 &compressed, sizeof(compressed));
+	return compressed;
+}
+
 /*------------------------------------------------------------------------------*\
 	Archive( archive)
 		-	archives this folder into the given message-archive
@@ -177,6 +254,16 @@ status_t BmMailFolder::Archive( BMessage* archive, bool deep) const {
 		|| archive->AddString( MSG_SELECTED_KEY, mSelectedRefKey.String())
 		|| archive->AddBool( MSG_STATEINFO_CONNECTED, 
 									mRefListStateInfoConnectedToParent);
+	if (ret == B_OK && !mSpecialMailRefSet.empty()) {
+		vector< int64> nodes;
+		nodes.reserve( mSpecialMailRefSet.size());
+		SpecialMailRefSet::const_iterator iter;
+		for( iter = mSpecialMailRefSet.begin(); 
+			  iter != mSpecialMailRefSet.end(); ++iter)
+			nodes.push_back( strtoll( iter->String(), NULL, 10));
+		ret = archive->AddData( MSG_SPECIAL_NODES, B_RAW_TYPE, &nodes[0],
+										nodes.size() * sizeof( int64));
+	}
 	if (deep && ret == B_OK) {
 		BmModelItemMap::const_iterator pos;
 		for( pos = begin(); pos != end(); ++pos) {
@@ -257,6 +344,25 @@ bool BmMailFolder::CheckIfModifiedSince( time_t when, time_t* storeNewModTime) {
 		-	
 \*------------------------------------------------------------------------------*/
 void BmMailFolder::AddSpecialFlagForMailRef(const BmString& key) {
+	if (_AddSpecialFlag( key))
+		_JournalAction( BM_FOLDER_ADD_SPECIAL, key);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveSpecialFlagForMailRef(key)
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::RemoveSpecialFlagForMailRef(const BmString& key) {
+	if (_RemoveSpecialFlag( key))
+		_JournalAction( BM_FOLDER_REMOVE_SPECIAL, key);
+}
+
+/*------------------------------------------------------------------------------*\
+	_AddSpecialFlag(key)
+		-	marks the mail-ref with the given key as special
+		-	returns whether the mail-ref has been special before
+\*------------------------------------------------------------------------------*/
+bool BmMailFolder::_AddSpecialFlag(const BmString& key) {
 	int32 oldCount = 	mSpecialMailRefSet.size();
 	mSpecialMailRefSet.insert(key);
 	int32 offset = mSpecialMailRefSet.size() - oldCount;
@@ -270,13 +376,15 @@ void BmMailFolder::AddSpecialFlagForMailRef(const BmString& key) {
 		if (parent)
 			parent->BumpSpecialMailCountForSubfolders( offset);
 	}
+	return offset != 0;
 }
 
 /*------------------------------------------------------------------------------*\
-	RemoveSpecialFlagForMailRef(key)
-		-	
+	_RemoveSpecialFlag(key)
+		-	unmarks the mail-ref with the given key
+		-	returns whether the mail-ref has been special before
 \*------------------------------------------------------------------------------*/
-void BmMailFolder::RemoveSpecialFlagForMailRef(const BmString& key) {
+bool BmMailFolder::_RemoveSpecialFlag(const BmString& key) {
 	int32 oldCount = 	mSpecialMailRefSet.size();
 	mSpecialMailRefSet.erase(key);
 	int32 offset = mSpecialMailRefSet.size() - oldCount;
@@ -290,6 +398,108 @@ void BmMailFolder::RemoveSpecialFlagForMailRef(const BmString& key) {
 		if (parent)
 			parent->BumpSpecialMailCountForSubfolders( offset);
 	}
+	return offset != 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	SyncSpecialMailRefs( foundKeys)
+		-	replaces the set of special mail-refs (as read from the folder-cache)
+			by the given set (as found by the special-mail-query)
+		-	a mail is only unflagged if it still isn't new or pending when
+			checked under the folder-list's lock, all changes are journaled
+		-	returns the number of mail-refs that had to be changed
+\*------------------------------------------------------------------------------*/
+int32 BmMailFolder::SyncSpecialMailRefs( const SpecialMailRefSet& foundKeys) {
+	BmAutolockCheckGlobal lock( TheMailFolderList->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			BmString("SyncSpecialMailRefs(): Unable to get lock on folder-list")
+		);
+	set< BmString> staleKeys;
+	SpecialMailRefSet::const_iterator iter;
+	for( iter = mSpecialMailRefSet.begin(); 
+		  iter != mSpecialMailRefSet.end(); ++iter) {
+		if (foundKeys.find( *iter) == foundKeys.end())
+			staleKeys.insert( *iter);
+	}
+	// the status of a mail may have changed since the query has looked at it,
+	// so we check the mails once more before we clear their flags:
+	SpecialMailRefSet stillSpecialKeys;
+	if (!staleKeys.empty())
+		_CollectSpecialMails( staleKeys, stillSpecialKeys);
+	int32 changeCount = 0;
+	for( iter = mSpecialMailRefSet.begin(); 
+		  iter != mSpecialMailRefSet.end(); ) {
+		// removing the flag invalidates the iterator:
+		BmString key = *iter++;
+		if (foundKeys.find( key) != foundKeys.end()
+		|| stillSpecialKeys.find( key) != stillSpecialKeys.end())
+			continue;
+		RemoveSpecialFlagForMailRef( key);
+		changeCount++;
+	}
+	for( iter = foundKeys.begin(); iter != foundKeys.end(); ++iter) {
+		if (mSpecialMailRefSet.find( *iter) == mSpecialMailRefSet.end()) {
+			AddSpecialFlagForMailRef( *iter);
+			changeCount++;
+		}
+	}
+	return changeCount;
+}
+
+/*------------------------------------------------------------------------------*\
+	_CollectSpecialMails( keys, outSpecialKeys)
+		-	looks for the mails with the given keys in this folder and collects
+			the keys of those that are new or pending
+		-	the keys that have been found are removed from the given set
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::_CollectSpecialMails( set< BmString>& keys, 
+													 SpecialMailRefSet& outSpecialKeys) {
+	BDirectory dir( &mEntryRef);
+	if (dir.InitCheck() != B_OK)
+		return;
+	char buf[4096];
+	int32 count;
+	node_ref nref;
+	while( !keys.empty()
+	&& (count = dir.GetNextDirents( (dirent* )buf, sizeof(buf))) > 0) {
+		dirent* dent = (dirent* )buf;
+		while( count-- > 0) {
+			nref.device = dent->d_dev;
+			nref.node = dent->d_ino;
+			if (keys.erase( BM_REFKEY( nref))) {
+				entry_ref eref( dent->d_pdev, dent->d_pino, dent->d_name);
+				BNode node( &eref);
+				BmString status;
+				BmReadStringAttr( &node, BM_MAIL_ATTR_STATUS, status);
+				if (status == BM_MAIL_STATUS_NEW 
+				|| status == BM_MAIL_STATUS_PENDING)
+					outSpecialKeys.insert( BM_REFKEY( nref));
+			}
+			// Bump the dirent-pointer by length of the dirent just handled:
+			dent = (dirent* )((char* )dent + dent->d_reclen);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	SumUpSpecialMailCounts()
+		-	recomputes the new-mail-in-subfolders counter of this folder and all
+			its subfolders (used after the folders have been read from cache)
+		-	returns the number of special mails in this folder and all its
+			subfolders
+\*------------------------------------------------------------------------------*/
+int32 BmMailFolder::SumUpSpecialMailCounts() {
+	mSpecialMailCountForSubfolders = 0;
+	BmModelItemMap::const_iterator iter;
+	for( iter = begin(); iter != end(); ++iter) {
+		BmMailFolder* subFolder = dynamic_cast< BmMailFolder*>( 
+			iter->second.Get()
+		);
+		if (subFolder)
+			mSpecialMailCountForSubfolders += subFolder->SumUpSpecialMailCounts();
+	}
+	return mSpecialMailCountForSubfolders + mSpecialMailRefSet.size();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -303,6 +513,7 @@ void BmMailFolder::BumpMailCount( int32 offset) {
 	if (offset) {
 		mMailCount += offset;
 		TellModelItemUpdated( UPD_TOTAL_COUNT);
+		_JournalAction( BM_FOLDER_MAILCOUNT);
 	}
 }
 
@@ -315,9 +526,52 @@ void BmMailFolder::MailCount( int32 count) {
 	if (mMailCount != count) {
 		mMailCount = count;
 		TellModelItemUpdated( UPD_TOTAL_COUNT);
+		_JournalAction( BM_FOLDER_MAILCOUNT);
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	_JournalAction( what, refKey)
+		-	appends the given change of this folder's summary to the journal of
+			the folder-list, such that the folder-cache is up-to-date even if
+			Beam should crash
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::_JournalAction( uint32 what, const BmString& refKey) {
+	BmRef<BmMailFolderList> folderList( TheMailFolderList.Get());
+	if (!folderList || !folderList->JournalsFolderSummary())
+		return;
+	BMessage action( what);
+	action.AddString( BmListModel::MSG_ITEMKEY, Key().String());
+	if (what == BM_FOLDER_MAILCOUNT)
+		action.AddInt32( MSG_MAILCOUNT, mMailCount);
+	else
+		action.AddString( MSG_REFKEY, refKey.String());
+	folderList->StoreAction( &action);
+}
+
+/*------------------------------------------------------------------------------*\
+	ExecuteAction( action)
+		-	applies a journaled change of this folder's summary (the folder-list
+			is frozen while the journal is being replayed and the counters for
+			subfolders are summed up afterwards, so no one needs to be told)
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::ExecuteAction( BMessage* action) {
+	switch( action->what) {
+		case BM_FOLDER_MAILCOUNT: {
+			mMailCount = action->FindInt32( MSG_MAILCOUNT);
+			break;
+		}
+		case BM_FOLDER_ADD_SPECIAL: {
+			mSpecialMailRefSet.insert( action->FindString( MSG_REFKEY));
+			break;
+		}
+		case BM_FOLDER_REMOVE_SPECIAL: {
+			mSpecialMailRefSet.erase( action->FindString( MSG_REFKEY));
+			break;
+		}
+	};
+}
+
 /*------------------------------------------------------------------------------*\
 	BumpSpecialMailCountForSubfolders()
 		-	increases this folder's new-mail-in-subfolders counter by the given 
@@ -435,6 +689,49 @@ void BmMailFolder::RemoveMailRef( const node_ref& nref) {
 		mMailCount = -1;
 }
 
+/*------------------------------------------------------------------------------*\
+	AddMailRefs( files)
+		-	adds mail-refs for all the given mail-files to this folder's 
+			mailref-list in one go
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::AddMailRefs( const BmMailFileInfoVect& files) {
+	BM_LOG2( BM_LogMailTracking, 
+				Name()+" adding " << int32(files.size()) << " mail-refs");
+	BmRef<BmMailRefList> refList = MailRefList();
+	if (refList) {
+		vector< BmRef<BmMailRef> > addedRefs;
+		refList->AddMailRefs( files, addedRefs);
+		for( uint32 i=0; i<addedRefs.size(); ++i) {
+			if (addedRefs[i]->IsSpecial())
+				AddSpecialFlagForMailRef( addedRefs[i]->Key());
+		}
+	} else
+		// ref-list couldn't be created (?!?) we mark the mail-count as unknown:
+		mMailCount = -1;
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMailRefs( nrefs)
+		-	removes the mail-refs specified by the given nodes from this folder's
+			mailref-list in one go
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::RemoveMailRefs( const vector< node_ref>& nrefs) {
+ 	BM_LOG2( BM_LogMailTracking, 
+ 				Name()+" removing " << int32(nrefs.size()) << " mail-refs");
+	BmRef<BmMailRefList> refList = MailRefList();
+	if (refList) {
+		vector< BmString> keys;
+		keys.reserve( nrefs.size());
+		for( uint32 i=0; i<nrefs.size(); ++i)
+			keys.push_back( BM_REFKEY( nrefs[i]));
+		refList->RemoveMailRefs( keys);
+		for( uint32 i=0; i<keys.size(); ++i)
+			RemoveSpecialFlagForMailRef( keys[i]);
+	} else
+		// ref-list couldn't be created (?!?) we mark the mail-count as unknown:
+		mMailCount = -1;
+}
+
 /*------------------------------------------------------------------------------*\
 	RemoveMailRef( node)
 		-	removes the mail-ref specified by the given node from this folder's
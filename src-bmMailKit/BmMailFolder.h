@@ -21,6 +21,7 @@
 
 class BmMailFolder;
 class BmMailFolderList;
+class BNode;
 
 /*------------------------------------------------------------------------------*\
 	BmMailFolder
@@ -31,9 +32,10 @@ class IMPEXPBMMAILKIT BmMailFolder : public BmListModelItem {
 
 	static const int16 nArchiveVersion;
 
+public:
 	typedef set<BmString> SpecialMailRefSet;
 
-public:
+
 	BmMailFolder( BmMailFolderList* model, entry_ref &eref, ino_t node,
 					  BmMailFolder* parent, time_t &modified);
 	BmMailFolder( BMessage* archive, BmMailFolderList* model, 
@@ -45,6 +47,8 @@ public:
 	void RemoveSpecialFlagForMailRef( const BmString& key);
 	void BumpMailCount( int32 offset=1);
 	void BumpSpecialMailCountForSubfolders( int32 offset=1);
+	int32 SumUpSpecialMailCounts();
+	int32 SyncSpecialMailRefs( const SpecialMailRefSet& foundKeys);
 	bool HasSpecialMail() const			{ return mSpecialMailRefSet.size()>0 
 															|| mSpecialMailCountForSubfolders>0; }
 	bool HasSpecialMailInSubfolders() const	
@@ -54,6 +58,8 @@ public:
 	void RecreateCache();
 	void AddMailRef( entry_ref& eref, struct stat& st);
 	void RemoveMailRef( const node_ref& nref);
+	void AddMailRefs( const BmMailFileInfoVect& files);
+	void RemoveMailRefs( const vector< node_ref>& nrefs);
 	void UpdateMailRef( const node_ref& nref);
 	void UpdateName( const entry_ref &eref);
 	void CreateSubFolder( BmString name);
@@ -61,9 +67,12 @@ public:
 	void MoveToTrash();
 	bool IsOutbound();
 	bool Exists() const;
+	bool IsCompressed() const;
+	void Compressed( bool compressed);
 
 	// overrides of listmodel-item base:
 	const BmString& DisplayKey() const	{ return mName; }
+	void ExecuteAction( BMessage* action);
 
 	// overrides of archivable base:
 	status_t Archive( BMessage* archive, bool deep = true) const;
@@ -101,6 +110,7 @@ public:
 													{ mRefListStateInfoConnectedToParent = b; }
 
 	static bool IsSystemFolderSubPath( const BmString& subPath);
+	static bool IsCompressedFolder( BNode* folderNode);
 
 	// archival-fieldnames:
 	static const char* const MSG_ENTRYREF;
@@ -109,6 +119,7 @@ public:
 	static const char* const MSG_MAILCOUNT;
 	static const char* const MSG_SELECTED_KEY;
 	static const char* const MSG_STATEINFO_CONNECTED;
+	static const char* const MSG_SPECIAL_NODES;
 
 	//	message component definitions for status-msgs:
 	static const char* const MSG_NAME;
@@ -127,6 +138,11 @@ public:
 protected:
 	void StartNodeMonitor();
 	void StopNodeMonitor();
+	bool _AddSpecialFlag( const BmString& key);
+	bool _RemoveSpecialFlag( const BmString& key);
+	void _CollectSpecialMails( set< BmString>& keys, 
+										SpecialMailRefSet& outSpecialKeys);
+	void _JournalAction( uint32 what, const BmString& refKey = BmString());
 
 	// the following members will be archived as part of BmFolderList:
 	entry_ref mEntryRef;
@@ -135,12 +151,12 @@ protected:
 	int32 mMailCount;
 	BmString mSelectedRefKey;
 	bool mRefListStateInfoConnectedToParent;
+	SpecialMailRefSet mSpecialMailRefSet;
 
 	// the following members will be archived into their own files:
 	BmRef< BmMailRefList> mMailRefList;
 
 	// the following members will NOT be archived at all:
-	SpecialMailRefSet mSpecialMailRefSet;
 	int32 mSpecialMailCountForSubfolders;
 	BmString mName;
 
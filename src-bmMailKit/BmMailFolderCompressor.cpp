@@ -0,0 +1,229 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <set>
+#include <unistd.h>
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <File.h>
+#include <Locker.h>
+
+#include "BmBasics.h"
+#include "BmLogHandler.h"
+#include "BmMail.h"
+#include "BmMailCompression.h"
+#include "BmMailFolderCompressor.h"
+#include "BmMailRef.h"
+#include "BmStorageUtil.h"
+
+#undef BM_LOGNAME
+#define BM_LOGNAME "MailTracker"
+
+// keys of the folders that are currently being converted:
+static std::set< BmString> nActiveFolders;
+static BLocker nActiveFoldersLocker( "ActiveCompressorsLocker");
+
+/*------------------------------------------------------------------------------*\
+	BmMailFolderCompressor( folder, compress)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailFolderCompressor::BmMailFolderCompressor( BmMailFolder* folder,
+																bool compress)
+	:	BmJobModel( BmString(compress ? "Compressing " : "Decompressing ")
+							<< (folder ? folder->Name() : BmString()))
+	,	mFolder( folder)
+	,	mCompress( compress)
+	,	mConvertedCount( 0)
+	,	mFailedCount( 0)
+	,	mSizeBefore( 0)
+	,	mSizeAfter( 0)
+	,	mReadTimeBefore( 0)
+	,	mReadTimeAfter( 0)
+{
+	NeedControllersToContinue( false);
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailFolderCompressor()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailFolderCompressor::~BmMailFolderCompressor() {
+}
+
+/*------------------------------------------------------------------------------*\
+	StartJob()
+		-	converts the folder, unless another compressor is already busy
+			with it
+\*------------------------------------------------------------------------------*/
+bool BmMailFolderCompressor::StartJob() {
+	if (!mFolder)
+		return false;
+	BmString folderKey = mFolder->Key();
+	{
+		BAutolock lock( nActiveFoldersLocker);
+		if (!nActiveFolders.insert( folderKey).second) {
+			BmString msg = Name() << ":\n\nThis folder is already being " 
+									"converted, please wait until that is done.";
+			BM_LOG( BM_LogMailTracking, msg);
+			ShowAlertWithType( msg, B_INFO_ALERT);
+			return false;
+		}
+	}
+	bool result = _ConvertFolder();
+	BAutolock lock( nActiveFoldersLocker);
+	nActiveFolders.erase( folderKey);
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ConvertFolder()
+		-	marks the folder and converts all the mails living in it
+\*------------------------------------------------------------------------------*/
+bool BmMailFolderCompressor::_ConvertFolder() {
+	try {
+		// mark the folder first, such that new mails arriving during the
+		// conversion are stored in the new format, too:
+		mFolder->Compressed( mCompress);
+
+		// collect the mails first, as converting a mail creates a new entry
+		// (which we would otherwise meet again while iterating):
+		BDirectory dir( mFolder->EntryRefPtr());
+		BEntry entry;
+		entry_ref eref;
+		vector< entry_ref> refs;
+		while( dir.GetNextEntry( &entry) == B_OK) {
+			if (entry.IsFile() && entry.GetRef( &eref) == B_OK)
+				refs.push_back( eref);
+		}
+		BM_LOG( BM_LogMailTracking,
+				  Name() << ": converting up to " << int32(refs.size()) << " mails");
+		for( uint32 i=0; ShouldContinue() && i<refs.size(); ++i) {
+			if (_ConvertMail( refs[i]))
+				mConvertedCount++;
+		}
+		// commit all converted mails at once:
+		sync();
+	} catch( BM_error &e) {
+		BM_SHOWERR( e.what());
+		return false;
+	}
+	_LogResults();
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ConvertMail( eref)
+		-	stores the given mail in the format of its folder, unless it already
+			has that format
+		-	returns whether the mail has been converted
+\*------------------------------------------------------------------------------*/
+bool BmMailFolderCompressor::_ConvertMail( entry_ref& eref) {
+	char header[BmMailCompression::nHeaderSize];
+	BFile file( &eref, B_READ_ONLY);
+	if (file.InitCheck() != B_OK)
+		return false;
+	bool isCompressed
+		= file.ReadAt( 0, header, sizeof(header)) == (ssize_t)sizeof(header)
+			&& BmMailCompression::IsCompressed( header, sizeof(header));
+	file.Unset();
+	if (isCompressed == mCompress)
+		return false;
+
+	off_t sizeBefore;
+	bigtime_t timeBefore = _TimeRead( eref, sizeBefore);
+
+	// we let the mail store itself, which writes the new format (keeping
+	// a backup of the old file until the new one is complete):
+	BmRef<BmMailRef> ref = BmMailRef::CreateInstance( eref);
+	if (!ref || ref->InitCheck() != B_OK)
+		return false;
+	BmRef<BmMail> mail = BmMail::CreateInstance( ref.Get());
+	if (mail)
+		mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+	if (!mail || mail->InitCheck() != B_OK || !mail->Store( false)
+	|| !mail->MailRef()) {
+		BM_LOGERR( Name() << ": unable to convert mail <" << eref.name << ">");
+		mFailedCount++;
+		return false;
+	}
+
+	off_t sizeAfter;
+	bigtime_t timeAfter = _TimeRead( mail->MailRef()->EntryRef(), sizeAfter);
+	mSizeBefore += sizeBefore;
+	mSizeAfter += sizeAfter;
+	mReadTimeBefore += timeBefore;
+	mReadTimeAfter += timeAfter;
+	BM_LOG2( BM_LogMailTracking,
+				Name() << ": converted mail <" << eref.name << "> from "
+					<< sizeBefore << " to " << sizeAfter << " bytes");
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_TimeRead( eref, outSize)
+		-	reads the given mail-file just like BmMail does and returns the
+			time that took
+		-	outSize is set to the size of the file on disk
+\*------------------------------------------------------------------------------*/
+bigtime_t BmMailFolderCompressor::_TimeRead( const entry_ref& eref,
+															off_t& outSize) {
+	outSize = 0;
+	bigtime_t startTime = system_time();
+	BmMappedFile mappedFile;
+	if (mappedFile.SetTo( &eref) != B_OK)
+		return 0;
+	outSize = mappedFile.Size();
+	BmString mailText;
+	if (BmMailCompression::IsCompressed( mappedFile.Data(),
+													 mappedFile.Size())) {
+		uint32 textSize
+			= BmMailCompression::UncompressedSize( mappedFile.Data(),
+																mappedFile.Size());
+		char* buf = mailText.LockBuffer( textSize);
+		if (buf) {
+			BmMailCompression::Decompress( mappedFile.Data(), mappedFile.Size(),
+													 buf, textSize);
+			mailText.UnlockBuffer( textSize);
+		}
+	} else
+		mailText.SetTo( mappedFile.Data(), int32(mappedFile.Size()));
+	return system_time() - startTime;
+}
+
+/*------------------------------------------------------------------------------*\
+	_LogResults()
+		-	tells the user how much space has been saved and how much longer
+			(or shorter) reading the mails takes now
+\*------------------------------------------------------------------------------*/
+void BmMailFolderCompressor::_LogResults() const {
+	BmString result( Name());
+	result << ":\n\n";
+	if (!mConvertedCount)
+		result << "No mails needed to be converted.";
+	else {
+		// sizes are given in KB, since folders may well exceed 2GB:
+		int32 kbBefore = int32(mSizeBefore / 1024);
+		int32 kbAfter = int32(mSizeAfter / 1024);
+		int32 ratio = mSizeBefore
+							? int32((100 * mSizeAfter) / mSizeBefore)
+							: 100;
+		result << mConvertedCount << " mails have been converted.\n\n"
+				 << "Size on disk: " << kbBefore << " KB -> " << kbAfter 
+				 << " KB (" << ratio << "%, saved " << kbBefore - kbAfter 
+				 << " KB).\n"
+				 << "Average time to read a mail: "
+				 << int32(mReadTimeBefore / mConvertedCount) << " -> "
+				 << int32(mReadTimeAfter / mConvertedCount) << " microseconds.";
+	}
+	if (mFailedCount)
+		result << "\n\n" << mFailedCount
+				 << " mails could not be converted (see the error-log).";
+	BM_LOG( BM_LogMailTracking, result);
+	ShowAlertWithType( result, B_INFO_ALERT);
+}
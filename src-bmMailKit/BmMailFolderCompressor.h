@@ -0,0 +1,64 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailFolderCompressor_h
+#define _BmMailFolderCompressor_h
+
+#include "BmMailKit.h"
+
+#include <Entry.h>
+
+#include "BmDataModel.h"
+#include "BmMailFolder.h"
+
+/*------------------------------------------------------------------------------*\
+	BmMailFolderCompressor
+		-	switches a mail-folder into (or out of) compressed mode and
+			converts all the mails that already live in that folder
+		-	runs in the background (without any controllers), when done, it
+			logs the space saved and how reading the mails has been affected
+		-	only one compressor may work on a folder at any time, any other
+			one started for the same folder refuses to run
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailFolderCompressor : public BmJobModel {
+	typedef BmJobModel inherited;
+
+public:
+	BmMailFolderCompressor( BmMailFolder* folder, bool compress);
+	virtual ~BmMailFolderCompressor();
+
+	// overrides of BmJobModel base:
+	bool StartJob();
+
+	// getters:
+	inline BmString Name() const			{ return ModelName(); }
+
+private:
+	bool _ConvertFolder();
+	bool _ConvertMail( entry_ref& eref);
+	static bigtime_t _TimeRead( const entry_ref& eref, off_t& outSize);
+	void _LogResults() const;
+
+	BmRef<BmMailFolder> mFolder;
+	bool mCompress;
+							// true: compress folder, false: decompress folder
+	int32 mConvertedCount;
+	int32 mFailedCount;
+	off_t mSizeBefore;
+	off_t mSizeAfter;
+							// on-disk size of the converted mails
+	bigtime_t mReadTimeBefore;
+	bigtime_t mReadTimeAfter;
+							// time spent reading the converted mails
+
+	// Hide copy-constructor and assignment:
+	BmMailFolderCompressor( const BmMailFolderCompressor&);
+	BmMailFolderCompressor operator=( const BmMailFolderCompressor&);
+};
+
+#endif
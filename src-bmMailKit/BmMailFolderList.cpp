@@ -49,6 +49,9 @@ BmMailFolderList* BmMailFolderList::CreateInstance() {
 BmMailFolderList::BmMailFolderList()
 	:	BmListModel( "MailFolderList", BM_LogMailTracking)
 	,	mMailboxPathHasChanged( false)
+	,	mSummaryRestored( false)
+	,	mJournalsFolderSummary( false)
+	,	mValidationThread( -1)
 {
 }
 
@@ -57,6 +60,10 @@ BmMailFolderList::BmMailFolderList()
 		-	standard d'tor
 \*------------------------------------------------------------------------------*/
 BmMailFolderList::~BmMailFolderList() {
+	if (mValidationThread >= 0) {
+		status_t exitValue;
+		wait_for_thread( mValidationThread, &exitValue);
+	}
 	theInstance = NULL;
 }
 
@@ -194,13 +201,60 @@ BmRef<BmMailRef> BmMailFolderList::FindMailRefByKey( const node_ref& nref) {
 \*------------------------------------------------------------------------------*/
 bool BmMailFolderList::StartJob() {
 	if (inherited::StartJob()) {
-		if (!mSpecialMailQuery.IsLive())
-			QueryForSpecialMails();
+		if (!mSpecialMailQuery.IsLive()) {
+			if (mSummaryRestored) {
+				// the changes found by the validation need to be journaled:
+				mJournalsFolderSummary = true;
+				_StartSpecialMailValidation();
+			} else
+				QueryForSpecialMails();
+		}
+		mJournalsFolderSummary = true;
 		return true;
 	} else
 		return false;
 }
 
+/*------------------------------------------------------------------------------*\
+	_StartSpecialMailValidation()
+		-	the special mails have been read from the folder-cache (and the 
+			journal), so we show them right away and leave it to a background
+			thread to validate them via the special-mail-query
+\*------------------------------------------------------------------------------*/
+void BmMailFolderList::_StartSpecialMailValidation() {
+	{	// scope for autolock
+		BmAutolockCheckGlobal lock( mModelLocker);
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( 
+				ModelNameNC() << ":_StartSpecialMailValidation(): Unable to get lock"
+			);
+		if (mTopFolder)
+			mTopFolder->SumUpSpecialMailCounts();
+	}
+	mValidationThread = spawn_thread( &_SpecialMailValidationThread, 
+												 "FolderValidator", B_LOW_PRIORITY, 
+												 this);
+	if (mValidationThread < 0 || resume_thread( mValidationThread) != B_OK) {
+		// no thread, no background:
+		mValidationThread = -1;
+		QueryForSpecialMails();
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_SpecialMailValidationThread( data)
+		-	thread-func that runs the special-mail-query (in validation mode)
+\*------------------------------------------------------------------------------*/
+int32 BmMailFolderList::_SpecialMailValidationThread( void* data) {
+	BmMailFolderList* folderList = static_cast< BmMailFolderList*>( data);
+	try {
+		folderList->QueryForSpecialMails();
+	} catch( BM_error &e) {
+		BM_SHOWERR( e.what());
+	}
+	return 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	InitializeItems()
 		-	
@@ -215,6 +269,7 @@ void BmMailFolderList::InitializeItems() {
 	time_t mtime;
 
 	BM_LOG( BM_LogMailTracking, "Start of initFolders");
+	mSummaryRestored = false;
 
 	mailDir.SetTo( mailDirName.String());
 	if ((err = mailDir.GetModificationTime( &mtime)) != B_OK)
@@ -346,6 +401,7 @@ void BmMailFolderList::InstantiateItems( BMessage* archive) {
 		BM_LOG( BM_LogMailTracking, 
 				  BmString("End of reading folder-cache (") << folderCount 
 				  		<< " folders found)");
+		mSummaryRestored = true;
 		mInitCheck = B_OK;
 	}
 }
@@ -391,7 +447,10 @@ int BmMailFolderList::InstantiateSubFolders( BmMailFolder* folder,
 
 /*------------------------------------------------------------------------------*\
 	QueryForSpecialMails()
-		-	
+		-	starts the live query for special (new or pending) mails
+		-	if the special mails have been read from the folder-cache, the 
+			results of the query are used to validate the folders' special mails
+			(and only the differences are applied)
 \*------------------------------------------------------------------------------*/
 void BmMailFolderList::QueryForSpecialMails() {
 	int32 count, specialCount=0;
@@ -403,6 +462,9 @@ void BmMailFolderList::QueryForSpecialMails() {
 
 	typedef set<BmMailFolder*> BmFolderSet;
 	BmFolderSet foldersWithSpecialMail;
+	typedef map<BmString, BmMailFolder::SpecialMailRefSet> BmFoundMap;
+	BmFoundMap foundSpecialMails;
+	bool validate = mSummaryRestored;
 
 	BmAutolockCheckGlobal lock( mModelLocker);
 	if (!lock.IsLocked())
@@ -427,7 +489,8 @@ void BmMailFolderList::QueryForSpecialMails() {
 		);
 	if ((err = mSpecialMailQuery.Fetch()) != B_OK)
 		BM_THROW_RUNTIME( BmString("Fetch(): ") << strerror(err));
-	Freeze();
+	if (!validate)
+		Freeze();
 	while ((count = mSpecialMailQuery.GetNextDirents((dirent* )buf, 4096)) > 0) {
 		dent = (dirent* )buf;
 		while (count-- > 0) {
@@ -437,11 +500,46 @@ void BmMailFolderList::QueryForSpecialMails() {
 			nref.device = dent->d_dev;
 			nref.node = dent->d_ino;
 			
-			foldersWithSpecialMail.insert( AddSpecialFlag( pnref, nref));
+			if (validate)
+				foundSpecialMails[BM_REFKEY( pnref)].insert( BM_REFKEY( nref));
+			else
+				foldersWithSpecialMail.insert( AddSpecialFlag( pnref, nref));
 			// Bump the dirent-pointer by length of the dirent just handled:
 			dent = (dirent* )((char* )dent + dent->d_reclen);
 		}
 	}
+	if (validate) {
+		// compare the query-results with what the folder-cache told us:
+		struct FolderCollector : public BmListModelItem::Collector {
+			typedef vector< BmMailFolder*> FolderVect;
+			virtual ~FolderCollector()		{}
+			virtual bool operator() (BmListModelItem* listItem) 
+			{
+				BmMailFolder* folder = dynamic_cast<BmMailFolder*>( listItem);
+				if (folder)
+					folderVect.push_back(folder);
+				return true;
+			}
+			FolderVect folderVect;
+		};
+		FolderCollector collector;
+		ForEachItem( collector);
+		BmMailFolder::SpecialMailRefSet noSpecialMails;
+		int32 changeCount = 0;
+		for( uint32 i=0; i<collector.folderVect.size(); ++i) {
+			BmMailFolder* folder = collector.folderVect[i];
+			BmFoundMap::const_iterator found 
+				= foundSpecialMails.find( folder->Key());
+			changeCount += folder->SyncSpecialMailRefs( 
+				found != foundSpecialMails.end() ? found->second : noSpecialMails
+			);
+		}
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("End of special-mail-validation (") << specialCount 
+				  		<< " special mails found, " << changeCount 
+				  		<< " differed from folder-cache)");
+		return;
+	}
 	Thaw();
 	BmFolderSet::const_iterator iter;
 	BmFolderSet::const_iterator end = foldersWithSpecialMail.end();
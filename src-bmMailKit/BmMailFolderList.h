@@ -67,11 +67,14 @@ public:
 	
 	// getters:
 	BmMailFolder* TopFolder() const		{ return mTopFolder.Get(); }
+	bool JournalsFolderSummary() const	{ return mJournalsFolderSummary; }
 
 	static BmRef< BmMailFolderList> theInstance;
 	
 private:
 	// native methods:
+	void _StartSpecialMailValidation();
+	static int32 _SpecialMailValidationThread( void* data);
 
 	// overrides of listmodel base:
 	int16 ArchiveVersion() const			{ return nArchiveVersion; }
@@ -82,6 +85,12 @@ private:
 	// the following members will NOT be archived at all:
 	BQuery mSpecialMailQuery;
 	bool mMailboxPathHasChanged;
+	bool mSummaryRestored;
+							// folder-summaries (counts & special mails) have
+							// been read from the folder-cache
+	bool mJournalsFolderSummary;
+							// changes of folder-summaries are journaled
+	thread_id mValidationThread;
 
 	// Hide copy-constructor and assignment:
 	BmMailFolderList( const BmMailFolderList&);
@@ -21,6 +21,7 @@ using namespace regexx;
 #include "BmLogHandler.h"
 #include "BmMail.h"
 #include "BmMailHeader.h"
+#include "BmMailThreader.h"
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmSmtpAccount.h"
@@ -1292,6 +1293,14 @@ void BmMailHeader::StoreAttributes( BFile& mailFile) {
 	&& !ParseDateTime( mHeaders[BM_FIELD_DATE], t))
 		time( &t);
 	mailFile.WriteAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, &t, sizeof(t));
+	// the ids needed for threading:
+	s = BmMailThreader::NormalizedMessageID( mHeaders[BM_FIELD_MESSAGE_ID]);
+	mailFile.WriteAttr( BM_MAIL_ATTR_MESSAGE_ID, B_STRING_TYPE, 0, s.String(), 
+							  s.Length()+1);
+	s = BmMailThreader::NormalizedReferences( mHeaders[BM_FIELD_REFERENCES],
+															mHeaders[BM_FIELD_IN_REPLY_TO]);
+	mailFile.WriteAttr( BM_MAIL_ATTR_REFERENCES, B_STRING_TYPE, 0, s.String(), 
+							  s.Length()+1);
 }
 
 /*------------------------------------------------------------------------------*\
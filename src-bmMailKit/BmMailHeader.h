@@ -14,6 +14,7 @@
 #include <map>
 #include <vector>
 
+#include "BmArena.h"
 #include "BmBasics.h"
 #include "BmFilterAddon.h"
 #include "BmIdentity.h"
@@ -177,6 +178,8 @@ private:
 	typedef map< BmString, BmAddressList> BmAddrMap;
 	
 public:
+	BM_ARENA_ALLOCATABLE
+
 	// c'tors and d'tor:
 	BmMailHeader( const BmString &headerText, BmMail* mail);
 	~BmMailHeader();
@@ -0,0 +1,366 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <algorithm>
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <File.h>
+
+#include "BmBasics.h"
+#include "BmLogHandler.h"
+#include "BmMailCompression.h"
+#include "BmMailFolderList.h"
+#include "BmMailIndexer.h"
+#include "BmMailMonitor.h"
+#include "BmMailRef.h"
+#include "BmPrefs.h"
+#include "BmRoster.h"
+
+// the index is written at most once per minute while Beam is running:
+static const bigtime_t nStoreInterval = 60*1000*1000;
+
+// maximum depth of folders that is being walked during catch-up:
+static const int32 nMaxFolderDepth = 64;
+
+//******************************************************************************
+// #pragma mark -	BmMailIndexer
+//******************************************************************************
+BmMailIndexer* BmMailIndexer::theInstance = NULL;
+
+/*------------------------------------------------------------------------------*\
+	CreateInstance()
+		-	creator-func
+		-	if the user doesn't want the mail-text to be indexed, no instance
+			is created at all
+\*------------------------------------------------------------------------------*/
+BmMailIndexer* BmMailIndexer::CreateInstance() {
+	if (!theInstance && ThePrefs->GetBool( "IndexMailText", true))
+		theInstance = new BmMailIndexer();
+	return theInstance;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmMailIndexer()
+		-	standard c'tor
+\*------------------------------------------------------------------------------*/
+BmMailIndexer::BmMailIndexer()
+	:	mIndexLocker( "MailIndex")
+	,	mLocker( "MailIndexer")
+	,	mShouldRun( false)
+	,	mIsReady( false)
+	,	mThreadId( -1)
+	,	mLastStoreTime( 0)
+{
+	Run();
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailIndexer()
+		-	standard d'tor
+\*------------------------------------------------------------------------------*/
+BmMailIndexer::~BmMailIndexer() {
+	Quit();
+	theInstance = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Run()
+		-
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Run() {
+	mShouldRun = true;
+	// start new thread for worker:
+	BmString tname( "MailIndexer");
+	mThreadId = spawn_thread( BmMailIndexer::_ThreadEntry, tname.String(),
+									  B_LOW_PRIORITY, this);
+	if (mThreadId < 0)
+		throw BM_runtime_error("MailIndexer::Run(): Could not spawn thread");
+	resume_thread( mThreadId);
+}
+
+/*------------------------------------------------------------------------------*\
+	Quit()
+		-	stops the indexer-thread and writes the index to disk
+		-	any mails that are still waiting to be indexed will be picked up
+			during the catch-up after the next start
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Quit() {
+	if (mThreadId < 0)
+		return;
+	mShouldRun = false;
+	status_t exitVal;
+	wait_for_thread( mThreadId, &exitVal);
+	mThreadId = -1;
+	if (mIsReady)
+		_StoreIndex();
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThreadEntry()
+		-
+\*------------------------------------------------------------------------------*/
+int32 BmMailIndexer::_ThreadEntry( void* data) {
+	BmMailIndexer* indexer = static_cast<BmMailIndexer*>( data);
+	if (indexer)
+		indexer->_Loop();
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Loop()
+		-	loads the index, catches up with the mailbox and then works on
+			the queued tasks whenever the mail-monitor is idle
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_Loop() {
+	{
+		BAutolock lock( mIndexLocker);
+		if (!mIndex.Load( _IndexFileName().String()))
+			BM_LOG( BM_LogMailTracking,
+					  "MailIndexer: no usable index found, starting from scratch");
+		BM_LOG( BM_LogMailTracking,
+				  BmString("MailIndexer: index contains ")
+				  		<< mIndex.DocumentCount() << " mails");
+	}
+	mIsReady = true;
+	mLastStoreTime = system_time();
+	_CatchUp();
+	while( mShouldRun) {
+		bool haveTask = false;
+		Task task( TASK_ADD, 0);
+		if (TheMailMonitor->IsIdle() && mLocker.Lock()) {
+			if (!mTaskQueue.empty()) {
+				task = mTaskQueue.front();
+				mTaskQueue.pop_front();
+				haveTask = true;
+			}
+			mLocker.Unlock();
+		}
+		if (haveTask) {
+			_HandleTask( task);
+			continue;
+		}
+		if (system_time() - mLastStoreTime > nStoreInterval)
+			_StoreIndex();
+		snooze( 200*1000);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_CatchUp()
+		-	queues all mails of the mailbox that are not contained in the index
+			and drops all mails from the index that do not exist anymore
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_CatchUp() {
+	entry_ref mailboxRef;
+	BmString mailboxPath = ThePrefs->GetString( "MailboxPath");
+	if (get_ref_for_path( mailboxPath.String(), &mailboxRef) != B_OK)
+		return;
+	BmTextIndex::DocKeyVect nodes;
+	_CollectMails( mailboxRef, nodes, 0);
+	if (!mShouldRun)
+		return;
+	std::sort( nodes.begin(), nodes.end());
+	BmTextIndex::DocKeyVect indexedNodes;
+	{
+		BAutolock lock( mIndexLocker);
+		mIndex.AllDocuments( indexedNodes);
+	}
+	BAutolock lock( mLocker);
+	for( uint32 i=0; i<indexedNodes.size(); ++i) {
+		if (!std::binary_search( nodes.begin(), nodes.end(), indexedNodes[i]))
+			mTaskQueue.push_back( Task( TASK_REMOVE, indexedNodes[i]));
+	}
+	BM_LOG( BM_LogMailTracking,
+			  BmString("MailIndexer: catch-up has queued ")
+			  		<< mTaskQueue.size() << " tasks");
+}
+
+/*------------------------------------------------------------------------------*\
+	_CollectMails( folderRef, nodes, depth)
+		-	walks the given folder (recursively) and collects the nodes of all
+			mails found in there
+		-	every mail that isn't part of the index yet is queued for being
+			added
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_CollectMails( const entry_ref& folderRef,
+											  BmTextIndex::DocKeyVect& nodes,
+											  int32 depth) {
+	BDirectory dir( &folderRef);
+	if (dir.InitCheck() != B_OK || depth > nMaxFolderDepth)
+		return;
+	BEntry entry;
+	entry_ref eref;
+	struct stat st;
+	while( mShouldRun && dir.GetNextEntry( &entry) == B_OK) {
+		if (entry.GetStat( &st) != B_OK || entry.GetRef( &eref) != B_OK)
+			continue;
+		if (S_ISDIR( st.st_mode))
+			_CollectMails( eref, nodes, depth+1);
+		else if (S_ISREG( st.st_mode)) {
+			nodes.push_back( st.st_ino);
+			bool isIndexed;
+			{
+				BAutolock lock( mIndexLocker);
+				isIndexed = mIndex.HasDocument( st.st_ino);
+			}
+			if (!isIndexed) {
+				BAutolock lock( mLocker);
+				mTaskQueue.push_back( Task( TASK_ADD, st.st_ino, &eref));
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_HandleTask( task)
+		-
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_HandleTask( const Task& task) {
+	try {
+		if (task.kind == TASK_ADD)
+			_IndexMail( task.eref, task.node);
+		else if (task.kind == TASK_UPDATE) {
+			// we only get the node of a changed mail, so we have to look for
+			// the mail-ref in order to find the file:
+			node_ref nref;
+			nref.node = task.node;
+			nref.device = ThePrefs->MailboxVolume.Device();
+			BmRef<BmMailRef> ref = TheMailFolderList->FindMailRefByKey( nref);
+			if (ref)
+				_IndexMail( ref->EntryRef(), task.node);
+		} else {
+			BAutolock lock( mIndexLocker);
+			mIndex.RemoveDocument( task.node);
+		}
+		BAutolock lock( mIndexLocker);
+		if (mIndex.NeedsCompaction()) {
+			BM_LOG( BM_LogMailTracking, "MailIndexer: compacting index");
+			mIndex.Compact();
+		}
+	}
+	catch( BM_error &err) {
+		BM_LOGERR( BmString("MailIndexer: ") << err.what());
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_IndexMail( eref, node)
+		-	reads the given mail-file (inflating it if it is compressed) and 
+			adds its text to the index
+		-	the text is extracted without holding the index-lock, such that
+			searches aren't blocked by the parsing of large mails
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_IndexMail( const entry_ref& eref, ino_t node) {
+	BFile file( &eref, B_READ_ONLY);
+	off_t size;
+	if (file.InitCheck() != B_OK || file.GetSize( &size) != B_OK)
+		return;
+	string mailText;
+	mailText.resize( size);
+	ssize_t readSize = file.Read( &mailText[0], size);
+	if (readSize < 0)
+		return;
+	mailText.resize( readSize);
+	if (BmMailCompression::IsCompressed( mailText.data(), mailText.size())) {
+		string inflatedText;
+		if (!BmMailCompression::Decompress( mailText.data(), mailText.size(),
+														inflatedText))
+			return;
+		mailText.swap( inflatedText);
+	}
+	string text;
+	BmTextIndex::ExtractMailText( mailText, text);
+	BM_LOG3( BM_LogMailTracking,
+				BmString("MailIndexer: indexing mail <") << eref.name
+					<< "," << node << ">");
+	BAutolock lock( mIndexLocker);
+	mIndex.AddDocument( node, text);
+}
+
+/*------------------------------------------------------------------------------*\
+	_StoreIndex()
+		-	writes the index to disk if it has been modified
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::_StoreIndex() {
+	BAutolock lock( mIndexLocker);
+	mLastStoreTime = system_time();
+	if (!mIndex.IsModified())
+		return;
+	if (mIndex.Store( _IndexFileName().String())) {
+		mIndex.ResetModified();
+		BM_LOG( BM_LogMailTracking,
+				  BmString("MailIndexer: stored index with ")
+				  		<< mIndex.DocumentCount() << " mails");
+	} else
+		BM_LOGERR( BmString("MailIndexer: could not store index into ")
+						<< _IndexFileName());
+}
+
+/*------------------------------------------------------------------------------*\
+	_IndexFileName()
+		-
+\*------------------------------------------------------------------------------*/
+const BmString BmMailIndexer::_IndexFileName() const {
+	return BmString( BeamRoster->SettingsPath()) << "/" << "Mail Text Index";
+}
+
+/*------------------------------------------------------------------------------*\
+	MailAdded( nref, eref)
+		-	queues the given (new) mail for being indexed
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::MailAdded( const node_ref& nref, const entry_ref& eref) {
+	BAutolock lock( mLocker);
+	mTaskQueue.push_back( Task( TASK_ADD, nref.node, &eref));
+}
+
+/*------------------------------------------------------------------------------*\
+	MailChanged( nref)
+		-	queues the given mail for being re-indexed
+		-	subsequent changes of the same mail are only queued once
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::MailChanged( const node_ref& nref) {
+	BAutolock lock( mLocker);
+	if (!mTaskQueue.empty() && mTaskQueue.back().node == nref.node
+	&& mTaskQueue.back().kind != TASK_REMOVE)
+		return;
+	mTaskQueue.push_back( Task( TASK_UPDATE, nref.node));
+}
+
+/*------------------------------------------------------------------------------*\
+	MailRemoved( nref)
+		-	queues the given mail for being removed from the index
+		-	since the mail-monitor can't tell whether a removed node has been
+			a folder or a mail, we get the folders, too (which are ignored)
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::MailRemoved( const node_ref& nref) {
+	BAutolock lock( mLocker);
+	mTaskQueue.push_back( Task( TASK_REMOVE, nref.node));
+}
+
+/*------------------------------------------------------------------------------*\
+	Search( query, outNodes)
+		-	fills outNodes with the nodes of all mails that contain every word
+			of the given query
+		-	returns false if the index isn't ready yet
+\*------------------------------------------------------------------------------*/
+bool BmMailIndexer::Search( const BmString& query, set< ino_t>& outNodes) {
+	outNodes.clear();
+	if (!mIsReady)
+		return false;
+	BmTextIndex::DocKeyVect keys;
+	{
+		BAutolock lock( mIndexLocker);
+		mIndex.Search( query.String(), keys);
+	}
+	outNodes.insert( keys.begin(), keys.end());
+	BM_LOG2( BM_LogMailTracking,
+				BmString("MailIndexer: search for <") << query << "> yielded "
+					<< outNodes.size() << " mails");
+	return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailIndexer_h
+#define _BmMailIndexer_h
+
+#include <deque>
+#include <set>
+
+#include <Entry.h>
+#include <Locker.h>
+#include <Node.h>
+
+#include "BmMailKit.h"
+
+#include "BmString.h"
+#include "BmTextIndex.h"
+
+using std::deque;
+using std::set;
+
+/*------------------------------------------------------------------------------*\
+	BmMailIndexer
+		-	maintains the full-text index of all mails in the mailbox
+		-	the mail-monitor reports every mail that has been created, changed
+			or removed, the indexer collects these and updates the index from
+			within its own (low-priority) thread whenever the mail-monitor
+			is idle
+		-	on startup, the indexer walks the mailbox in order to pick up
+			any mails that have been added or removed while Beam wasn't
+			running
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailIndexer {
+
+	enum TaskKind {
+		TASK_ADD = 0,
+		TASK_UPDATE,
+		TASK_REMOVE
+	};
+	struct Task {
+		Task( TaskKind k, ino_t n, const entry_ref* e = NULL)
+			:	kind( k)
+			,	node( n)									{ if (e) eref = *e; }
+		TaskKind kind;
+		ino_t node;
+		entry_ref eref;
+	};
+	typedef deque< Task> TaskQueue;
+
+public:
+	static BmMailIndexer* CreateInstance();
+	~BmMailIndexer();
+
+	void Run();
+	void Quit();
+	//
+	void MailAdded( const node_ref& nref, const entry_ref& eref);
+	void MailChanged( const node_ref& nref);
+	void MailRemoved( const node_ref& nref);
+	//
+	bool Search( const BmString& query, set< ino_t>& outNodes);
+
+	// getters:
+	inline bool IsReady() const			{ return mIsReady; }
+
+	static BmMailIndexer* theInstance;
+
+private:
+	//	native methods:
+	BmMailIndexer();
+	void _Loop();
+	void _CatchUp();
+	void _CollectMails( const entry_ref& folderRef,
+							  BmTextIndex::DocKeyVect& nodes, int32 depth);
+	void _IndexMail( const entry_ref& eref, ino_t node);
+	void _HandleTask( const Task& task);
+	void _StoreIndex();
+	const BmString _IndexFileName() const;
+	//
+	static int32 _ThreadEntry(void* data);
+
+	BmTextIndex mIndex;
+	BLocker mIndexLocker;
+							// protects mIndex
+	TaskQueue mTaskQueue;
+	BLocker mLocker;
+							// protects mTaskQueue
+	volatile bool mShouldRun;
+	volatile bool mIsReady;
+							// set once the index has been loaded
+	thread_id mThreadId;
+	bigtime_t mLastStoreTime;
+
+	// Hide copy-constructor and assignment:
+	BmMailIndexer( const BmMailIndexer&);
+	BmMailIndexer operator=( const BmMailIndexer&);
+};
+
+#define TheMailIndexer BmMailIndexer::theInstance
+
+#endif
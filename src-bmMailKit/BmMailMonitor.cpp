@@ -16,10 +16,13 @@
 
 #include <deque>
 #include <map>
+#include <set>
+#include <vector>
 
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmMailFolderList.h"
+#include "BmMailIndexer.h"
 #include "BmMailMonitor.h"
 #include "BmMailRef.h"
 #include "BmStorageUtil.h"
@@ -28,6 +31,8 @@
 using std::deque;
 using std::map;
 using std::pair;
+using std::set;
+using std::vector;
 
 /********************************************************************************\
 	BmMailMonitorWorker
@@ -36,6 +41,7 @@ class BmMailMonitorWorker {
 
 public:
 	BmMailMonitorWorker();
+	~BmMailMonitorWorker();
 
 	void Run();
 	void Quit();
@@ -45,6 +51,8 @@ public:
 	void AddMessage(BMessage* msg);
 	//
 	void CacheRefToFolder( node_ref& nref, const BmString& fKey);
+	void IgnoreMailMove( const node_ref& nref);
+	void UnignoreMailMove( const node_ref& nref);
 
 private:
 	//	native methods:
@@ -64,6 +72,13 @@ private:
 						  BmMailFolder* oldParent, entry_ref& erefFrom);
 	void EntryChanged( node_ref& nref);
 
+	void _QueueCreation( BmMailFolder* parent, node_ref& nref,
+								entry_ref& eref, struct stat& st);
+	void _QueueRemoval( BmMailFolder* parent, node_ref& nref);
+	bool _CoalesceChange( node_ref& nref);
+	bool _IsIgnoredMove( const node_ref& nref);
+	void _FlushPendingChanges();
+
 	// When trying to handle B_ATTR_CHANGED events for a mail-ref whose
 	// ref-list isn't loaded, the given info isn't enough to find out the 
 	// folder this mail-ref lives in. In order to remedy this, we cache
@@ -77,15 +92,41 @@ private:
 	typedef map<BmString, FolderInfo> CachedRefToFolderMap;
 	CachedRefToFolderMap mCachedRefToFolderMap;
 
+	// Mails that are moved by Beam itself (see BmMailMover) have already
+	// been moved in the ref-lists when the corresponding move-events arrive,
+	// so the events are ignored. Entries whose event never arrives (the
+	// node-monitor may drop messages) expire after a while:
+	typedef map<BmString, bigtime_t> IgnoredMoveMap;
+	IgnoredMoveMap mIgnoredMoveMap;
+
+	// Mails that are created or removed while a batch of messages is being
+	// handled are collected per folder, such that each folder's ref-list
+	// only has to be locked once per batch. Creations and removals of the
+	// same node within one batch cancel each other out:
+	struct PendingChanges {
+		PendingChanges() : device(0) {}
+		BmRef<BmMailFolder> folder;
+		dev_t device;
+		map<ino_t, BmMailFileInfo> creations;
+		set<ino_t> removals;
+	};
+	typedef map<BmString, PendingChanges> PendingChangesMap;
+	PendingChangesMap mPendingChanges;
+	int32 mPendingCount;
+
 	// deque for incoming node-monitor messages:
 	typedef deque<BMessage*> MessageList;
 	MessageList mMessageList;
 
 	BLocker mLocker;
+	sem_id mWakeupSem;
+							// released whenever the message list stops being empty
 	bool mShouldRun;
+	bool mIsBusy;
+							// true while a batch of messages is being handled
+	bigtime_t mLastActivityTime;
 	thread_id mThreadId;
 	uint32 mCounter;
-	uint32 mIdleTimeInMSecs;
 
 	// Hide copy-constructor and assignment:
 	BmMailMonitorWorker( const BmMailMonitorWorker&);
@@ -97,14 +138,30 @@ private:
 		-	standard c'tor
 \*------------------------------------------------------------------------------*/
 BmMailMonitorWorker::BmMailMonitorWorker()
-	:	mLocker("MailMonitorWorkerLock")
+	:	mPendingCount(0)
+	,	mLocker("MailMonitorWorkerLock")
+	,	mWakeupSem(create_sem(0, "MailMonitorWorkerWakeup"))
 	,	mShouldRun(false)
+	,	mIsBusy(false)
+	,	mLastActivityTime(0)
 	,	mThreadId(-1)
 	,	mCounter(0)
-	,	mIdleTimeInMSecs(0)
 {
 }
 
+/*------------------------------------------------------------------------------*\
+	~BmMailMonitorWorker()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailMonitorWorker::~BmMailMonitorWorker()
+{
+	delete_sem(mWakeupSem);
+	// drop any messages that have arrived after the worker has quit:
+	for( MessageList::iterator iter = mMessageList.begin(); 
+		  iter != mMessageList.end(); ++iter)
+		delete *iter;
+}
+
 /*------------------------------------------------------------------------------*\
 	Run()
 		-	
@@ -128,6 +185,7 @@ void BmMailMonitorWorker::Run()
 void BmMailMonitorWorker::Quit()
 {
 	mShouldRun = false;
+	release_sem(mWakeupSem);
 	status_t exitVal;
 	wait_for_thread(mThreadId, &exitVal);
 }
@@ -146,28 +204,39 @@ int32 BmMailMonitorWorker::ThreadEntry(void* data)
 
 /*------------------------------------------------------------------------------*\
 	MessageLoop()
-		-	
+		-	sleeps until messages arrive and then handles all of the messages
+			that have arrived in the meantime as one batch
 \*------------------------------------------------------------------------------*/
 void BmMailMonitorWorker::MessageLoop()
 {
-	const int32 snoozeMSecs = 50;
-	BMessage* msg = NULL;
+	// the pending changes are flushed at the end of each batch, but we
+	// do not want to keep the user waiting for too long during huge batches:
+	const int32 maxPendingCount = 1000;
+	MessageList batch;
 	while(mShouldRun) {
+		status_t err = acquire_sem(mWakeupSem);
+		if (err == B_INTERRUPTED)
+			continue;
+		if (err != B_OK || !mShouldRun)
+			break;
 		if (mLocker.Lock()) {
-			if (!mMessageList.empty()) {
-				mIdleTimeInMSecs = 0;
-				msg = mMessageList.front();
-				mMessageList.pop_front();
-			} else
-				msg = NULL;
+			batch.swap(mMessageList);
+			mIsBusy = true;
 			mLocker.Unlock();
 		}
-		if (msg) {
+		while(!batch.empty()) {
+			BMessage* msg = batch.front();
+			batch.pop_front();
 			MessageReceived(msg);
 			delete msg;
-		} else {
-			snooze(snoozeMSecs*1000);
-			mIdleTimeInMSecs += snoozeMSecs;
+			if (mPendingCount >= maxPendingCount)
+				_FlushPendingChanges();
+		}
+		_FlushPendingChanges();
+		if (mLocker.Lock()) {
+			mIsBusy = false;
+			mLastActivityTime = system_time();
+			mLocker.Unlock();
 		}
 	}
 }
@@ -203,8 +272,13 @@ void BmMailMonitorWorker::MessageReceived( BMessage* msg) {
 \*------------------------------------------------------------------------------*/
 void BmMailMonitorWorker::AddMessage( BMessage* msg) {
 	if (mLocker.Lock()) {
+		// the worker takes all messages at once, so it only needs to be
+		// woken up for the first one:
+		bool wasEmpty = mMessageList.empty();
 		mMessageList.push_back(msg);
 		mLocker.Unlock();
+		if (wasEmpty)
+			release_sem(mWakeupSem);
 	}
 }
 
@@ -215,9 +289,11 @@ void BmMailMonitorWorker::AddMessage( BMessage* msg) {
 bool BmMailMonitorWorker::IsIdle(uint32 msecs) {
 	bool res = false;
 	if (mLocker.LockWithTimeout(20*1000) == B_OK) {
-		// Mailmonitor is idle if the message list is empty and if
-		// it has been so for the given amount of microseconds:
-		res = mMessageList.empty() && mIdleTimeInMSecs > msecs;
+		// Mailmonitor is idle if the message list is empty, no batch is
+		// being handled and the last batch has been finished at least the
+		// given amount of milliseconds ago:
+		res = mMessageList.empty() && !mIsBusy
+				&& system_time() - mLastActivityTime > bigtime_t(msecs) * 1000;
 		mLocker.Unlock();
 	}
 	return res;
@@ -330,6 +406,8 @@ void BmMailMonitorWorker::HandleMailMonitorMsg( BMessage* msg) {
 					BM_THROW_RUNTIME( "Field 'node' not found in msg !?!");
 				if ((err = msg->FindInt32( "device", &nref.device)) != B_OK)
 					BM_THROW_RUNTIME( "Field 'device' not found in msg !?!");
+				if (opcode == B_STAT_CHANGED && TheMailIndexer)
+					TheMailIndexer->MailChanged( nref);
 				EntryChanged( nref);
 				break;
 			}
@@ -356,6 +434,7 @@ void BmMailMonitorWorker::EntryCreated( BmMailFolder* parent, node_ref& nref,
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("New mail folder <") << eref.name 
 						<< "," << nref.node << "> detected.");
+		_FlushPendingChanges();
 		TheMailFolderList->AddMailFolder( eref, nref.node, parent, st.st_mtime);
 	} else {
 		// a new mail has been created, we add it to the 
@@ -363,7 +442,9 @@ void BmMailMonitorWorker::EntryCreated( BmMailFolder* parent, node_ref& nref,
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("New mail <") << eref.name 
 						<< "," << nref.node << "> detected.");
-		parent->AddMailRef( eref, st);
+		_QueueCreation( parent, nref, eref, st);
+		if (TheMailIndexer)
+			TheMailIndexer->MailAdded( nref, eref);
 	}
 }
 
@@ -390,6 +471,7 @@ void BmMailMonitorWorker::EntryRemoved( BmMailFolder* parent, node_ref& nref) {
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("Removal of mail folder <") 
 						<< nref.node << "> detected.");
+		_FlushPendingChanges();
 		BmAutolockCheckGlobal lock( TheMailFolderList->ModelLocker());
 		if (!lock.IsLocked())
 			BM_THROW_RUNTIME( "MailMonitor::EntryRemoved(): Unable to get lock");
@@ -406,7 +488,9 @@ void BmMailMonitorWorker::EntryRemoved( BmMailFolder* parent, node_ref& nref) {
 					BmString("Removal of mail <") << nref.node 
 						<< "> detected.");
 		if (parent)
-			parent->RemoveMailRef( nref);
+			_QueueRemoval( parent, nref);
+		if (TheMailIndexer)
+			TheMailIndexer->MailRemoved( nref);
 	}
 }
 
@@ -439,6 +523,7 @@ void BmMailMonitorWorker::EntryMoved( BmMailFolder* parent, node_ref& nref,
 	// ok, now do actual processing:
 	if (S_ISDIR(st.st_mode)) {
 		// it's a mail-folder, we check for type of change:
+		_FlushPendingChanges();
 		BmRef<BmMailFolder> folder;
 		folder = dynamic_cast<BmMailFolder*>( 
 			TheMailFolderList->FindItemByKey( BM_REFKEY( nref)).Get()
@@ -518,10 +603,31 @@ void BmMailMonitorWorker::EntryMoved( BmMailFolder* parent, node_ref& nref,
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("Move of mail <") << eref.name 
 						<< "," << nref.node << "> detected.");
+		if (_IsIgnoredMove( nref)) {
+			BM_LOG2( BM_LogMailTracking, 
+						"...mail has already been moved in the ref-lists.");
+			// the mail may have arrived just before it was moved:
+			PendingChangesMap::iterator pos 
+				= oldParent
+					? mPendingChanges.find( oldParent->Key())
+					: mPendingChanges.end();
+			if (pos != mPendingChanges.end()
+			&& pos->second.creations.erase( nref.node))
+				mPendingCount--;
+			return;
+		}
 		if (oldParent)
-			oldParent->RemoveMailRef( nref);
+			_QueueRemoval( oldParent, nref);
 		if (parent)
-			parent->AddMailRef( eref, st);
+			_QueueCreation( parent, nref, eref, st);
+		// the index only needs to know about mails that enter or leave
+		// the mailbox, moves within it don't change the node:
+		if (TheMailIndexer && !parent != !oldParent) {
+			if (parent)
+				TheMailIndexer->MailAdded( nref, eref);
+			else
+				TheMailIndexer->MailRemoved( nref);
+		}
 	}
 }
 
@@ -548,7 +654,16 @@ void BmMailMonitorWorker::EntryChanged( node_ref& nref) {
 	//	  is better than nothing.
 	BmString key( BM_REFKEY( nref));
 	CachedRefToFolderMap::iterator pos = mCachedRefToFolderMap.find( key);
-	if (pos != mCachedRefToFolderMap.end()) {
+	if (_CoalesceChange( nref)) {
+		// the mail-ref hasn't been added to (or removed from) its folder 
+		// yet, so there's nothing to update:
+		if (pos != mCachedRefToFolderMap.end()) {
+			if (pos->second.usedCount > 1)
+				pos->second.usedCount--;
+			else
+				mCachedRefToFolderMap.erase( pos);
+		}
+	} else if (pos != mCachedRefToFolderMap.end()) {
 		// mail-ref has a cached entry, we use the specified folder:
 		BmRef<BmListModelItem> folderItem 
 			= TheMailFolderList->FindItemByKey( pos->second.folderKey);
@@ -574,6 +689,126 @@ void BmMailMonitorWorker::EntryChanged( node_ref& nref) {
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	_QueueCreation()
+		-	remembers that a mail has been created in the given folder, the
+			mail-ref will be added by the next call to _FlushPendingChanges()
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::_QueueCreation( BmMailFolder* parent, 
+														node_ref& nref, entry_ref& eref, 
+														struct stat& st) {
+	PendingChanges& changes = mPendingChanges[parent->Key()];
+	changes.folder = parent;
+	changes.device = nref.device;
+	if (changes.creations.find( nref.node) == changes.creations.end())
+		mPendingCount++;
+	BmMailFileInfo& info = changes.creations[nref.node];
+	info.eref = eref;
+	info.st = st;
+}
+
+/*------------------------------------------------------------------------------*\
+	_QueueRemoval()
+		-	remembers that a mail has been removed from the given folder, the
+			mail-ref will be removed by the next call to _FlushPendingChanges()
+		-	if the mail has been created within the current batch, both
+			events are simply dropped
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::_QueueRemoval( BmMailFolder* parent, 
+													  node_ref& nref) {
+	PendingChanges& changes = mPendingChanges[parent->Key()];
+	changes.folder = parent;
+	changes.device = nref.device;
+	if (changes.creations.erase( nref.node)) {
+		BM_LOG2( BM_LogMailTracking, 
+					BmString("Creation and removal of mail <") << nref.node 
+						<< "> cancel each other out.");
+		mPendingCount--;
+		return;
+	}
+	if (changes.removals.insert( nref.node).second)
+		mPendingCount++;
+}
+
+/*------------------------------------------------------------------------------*\
+	_CoalesceChange()
+		-	checks whether the given node is a mail whose creation or removal
+			is still pending
+		-	a pending creation picks up the changed stat-info, since the
+			mail-ref will only be created when the pending changes are flushed
+		-	returns true if the change has been taken care of this way
+\*------------------------------------------------------------------------------*/
+bool BmMailMonitorWorker::_CoalesceChange( node_ref& nref) {
+	PendingChangesMap::iterator iter;
+	for( iter = mPendingChanges.begin(); iter != mPendingChanges.end(); ++iter) {
+		PendingChanges& changes = iter->second;
+		if (changes.device != nref.device)
+			continue;
+		map<ino_t, BmMailFileInfo>::iterator pos 
+			= changes.creations.find( nref.node);
+		if (pos != changes.creations.end()) {
+			BNode node( &pos->second.eref);
+			if (node.InitCheck() == B_OK)
+				node.GetStat( &pos->second.st);
+			return true;
+		}
+		if (changes.removals.find( nref.node) != changes.removals.end())
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	_FlushPendingChanges()
+		-	applies all pending creations and removals of mails, folder by
+			folder (removals first, such that a removed node that has been
+			reused by a new mail ends up in the list)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::_FlushPendingChanges() {
+	if (mPendingChanges.empty())
+		return;
+	PendingChangesMap pendingChanges;
+	pendingChanges.swap( mPendingChanges);
+	mPendingCount = 0;
+	PendingChangesMap::iterator iter;
+	for( iter = pendingChanges.begin(); iter != pendingChanges.end(); ++iter) {
+		PendingChanges& changes = iter->second;
+		BM_LOG2( BM_LogMailTracking, 
+					BmString("Flushing ") << int32(changes.removals.size()) 
+						<< " removals and " << int32(changes.creations.size())
+						<< " creations of mails in folder " 
+						<< changes.folder->Name());
+		try {
+			if (!changes.removals.empty()) {
+				vector<node_ref> nrefs;
+				nrefs.reserve( changes.removals.size());
+				node_ref nref;
+				nref.device = changes.device;
+				set<ino_t>::const_iterator rIter;
+				for( rIter = changes.removals.begin(); 
+					  rIter != changes.removals.end(); ++rIter) {
+					nref.node = *rIter;
+					nrefs.push_back( nref);
+				}
+				changes.folder->RemoveMailRefs( nrefs);
+			}
+			if (!changes.creations.empty()) {
+				BmMailFileInfoVect files;
+				files.reserve( changes.creations.size());
+				map<ino_t, BmMailFileInfo>::const_iterator cIter;
+				for( cIter = changes.creations.begin(); 
+					  cIter != changes.creations.end(); ++cIter)
+					files.push_back( cIter->second);
+				changes.folder->AddMailRefs( files);
+			}
+		} catch( BM_error &e) {
+			// a problem occurred, we tell the user and continue with the
+			// next folder:
+			BM_SHOWERR( BmString("MailMonitorWorker: ") << e.what());
+		}
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	CacheRefToFolder()
 		-	
@@ -593,6 +828,48 @@ void BmMailMonitorWorker::CacheRefToFolder( node_ref& nref,
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	IgnoreMailMove()
+		-	tells the worker to ignore the next move-event for the given mail
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::IgnoreMailMove( const node_ref& nref) {
+	// stale entries are dropped after a minute:
+	const bigtime_t expiryTime = 60*1000*1000;
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "MailMonitor::IgnoreMailMove(): Unable to get lock");
+	bigtime_t now = system_time();
+	IgnoredMoveMap::iterator iter = mIgnoredMoveMap.begin();
+	while( iter != mIgnoredMoveMap.end()) {
+		if (now - iter->second > expiryTime)
+			mIgnoredMoveMap.erase( iter++);
+		else
+			++iter;
+	}
+	mIgnoredMoveMap[BM_REFKEY( nref)] = now;
+}
+
+/*------------------------------------------------------------------------------*\
+	UnignoreMailMove()
+		-	tells the worker to handle the next move-event for the given mail
+			after all (used when the move has failed)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::UnignoreMailMove( const node_ref& nref) {
+	_IsIgnoredMove( nref);
+}
+
+/*------------------------------------------------------------------------------*\
+	_IsIgnoredMove()
+		-	returns whether the move-event for the given mail shall be ignored
+			(and forgets about the mail in that case)
+\*------------------------------------------------------------------------------*/
+bool BmMailMonitorWorker::_IsIgnoredMove( const node_ref& nref) {
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "MailMonitor::_IsIgnoredMove(): Unable to get lock");
+	return mIgnoredMoveMap.erase( BM_REFKEY( nref)) > 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	HandleQueryUpdateMsg()
 		-	
@@ -696,6 +973,22 @@ void BmMailMonitor::CacheRefToFolder( node_ref& nref, const BmString& fKey) {
 	mWorker->CacheRefToFolder(nref, fKey);
 }
 
+/*------------------------------------------------------------------------------*\
+	IgnoreMailMove()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMailMonitor::IgnoreMailMove( const node_ref& nref) {
+	mWorker->IgnoreMailMove(nref);
+}
+
+/*------------------------------------------------------------------------------*\
+	UnignoreMailMove()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMailMonitor::UnignoreMailMove( const node_ref& nref) {
+	mWorker->UnignoreMailMove(nref);
+}
+
 /*------------------------------------------------------------------------------*\
 	IsIdle()
 		-	
@@ -29,6 +29,8 @@ public:
 	~BmMailMonitor();
 
 	void CacheRefToFolder( node_ref& nref, const BmString& fKey);
+	void IgnoreMailMove( const node_ref& nref);
+	void UnignoreMailMove( const node_ref& nref);
 	bool IsIdle(uint32 msecs = 1000);
 
 	// overrides of looper base:
@@ -14,10 +14,12 @@
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
+#include "BmMailCompression.h"
 #include "BmMailFolderList.h"
 #include "BmMailMonitor.h"
 #include "BmMailRef.h"
 #include "BmMailRefList.h"
+#include "BmMailThreader.h"
 #include "BmPrefs.h"
 #include "BmRoster.h"
 #include "BmStorageUtil.h"
@@ -49,11 +51,146 @@ const char* const BmMailRef::MSG_IS_VALID = 	"bm:iv";
 const char* const BmMailRef::MSG_CLASSIFICATION = 	"bm:cl";
 const char* const BmMailRef::MSG_RATIO_SPAM= "bm:rs";
 const char* const BmMailRef::MSG_IMAP_UID =	"bm:ui";
-const int16 BmMailRef::nArchiveVersion = 6;
+const char* const BmMailRef::MSG_MESSAGE_ID = "bm:mi";
+const char* const BmMailRef::MSG_REFERENCES = "bm:rf";
+const char* const BmMailRef::MSG_THREAD_ID = "bm:ti";
+const char* const BmMailRef::MSG_THREAD_DEPTH = "bm:td";
+const int16 BmMailRef::nArchiveVersion = 7;
 
 const float BmMailRef::UNKNOWN_RATIO = 10.0;
 	// just anything outside of [0..1]
 
+/*------------------------------------------------------------------------------*\
+	the strings corresponding to the status- and classification-codes
+	(they must match BM_MAIL_STATUS_... and BM_MAIL_CLASS_...)
+\*------------------------------------------------------------------------------*/
+static const BmString nStatusStrings[BmMailRef::STATUS_OTHER] = {
+	"",
+	"Draft",
+	"Error",
+	"Forwarded",
+	"New",
+	"Pending",
+	"Read",
+	"Redirected",
+	"Replied",
+	"Sent"
+};
+
+static const BmString nClassStrings[BmMailRef::CLASS_OTHER] = {
+	"",
+	"Spam",
+	"Genuine"
+};
+
+/*------------------------------------------------------------------------------*\
+	SubjectCollationKey( subject)
+		-	returns the key used for sorting by the given subject: the subject
+			is folded to lowercase and any prefixes indicating a reply or a
+			forward (like "Re: ", "Fwd: ", "AW: " or "Re[2]: ") are removed
+\*------------------------------------------------------------------------------*/
+BmString BmMailRef::SubjectCollationKey( const BmString& subject) {
+	static const char* const prefixes[] = {
+		"fwd", "re", "aw", "fw", "wg", NULL
+	};
+	BmString key( subject);
+	key.ToLower();
+	const char* s = key.String();
+	int32 pos = 0;
+	while( 1) {
+		while( s[pos] == ' ' || s[pos] == '\t')
+			pos++;
+		int32 len = 0;
+		for( int i=0; prefixes[i]; ++i) {
+			int32 prefixLen = strlen( prefixes[i]);
+			if (!strncmp( s+pos, prefixes[i], prefixLen)) {
+				len = prefixLen;
+				break;
+			}
+		}
+		if (!len)
+			break;
+		int32 end = pos+len;
+		if (s[end] == '[') {
+			// skip reply-counter:
+			while( isdigit( s[++end]))
+				;
+			if (s[end] != ']')
+				break;
+			end++;
+		}
+		if (s[end] != ':')
+			break;
+		pos = end+1;
+	}
+	if (pos)
+		key.Remove( 0, pos);
+	return key;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddressCollationKey( address)
+		-	returns the key used for sorting by the given address(es): this is
+			the lowercased display-name (phrase) of the first address or the 
+			address itself, if there is no phrase
+		-	the first address ends at the first ',' that is neither quoted nor
+			part of a comment
+\*------------------------------------------------------------------------------*/
+BmString BmMailRef::AddressCollationKey( const BmString& address) {
+	const char* s = address.String();
+	int32 ltPos = -1;
+	int32 pos;
+	bool inQuotes = false;
+	int32 commentLevel = 0;
+	for( pos = 0; s[pos]; ++pos) {
+		if (s[pos] == '\\' && (inQuotes || commentLevel) && s[pos+1])
+			pos++;
+		else if (inQuotes) {
+			if (s[pos] == '"')
+				inQuotes = false;
+		} else if (s[pos] == '(')
+			commentLevel++;
+		else if (commentLevel) {
+			if (s[pos] == ')')
+				commentLevel--;
+		} else if (s[pos] == '"')
+			inQuotes = true;
+		else if (s[pos] == '<' && ltPos < 0)
+			ltPos = pos;
+		else if (s[pos] == ',')
+			break;
+	}
+	BmString key;
+	if (ltPos > 0) {
+		address.CopyInto( key, 0, ltPos);
+		key.Trim();
+		if (key.Length() > 1 && key[0] == '"' && key[key.Length()-1] == '"') {
+			key.Remove( key.Length()-1, 1);
+			key.Remove( 0, 1);
+		}
+	}
+	if (!key.Length()) {
+		address.CopyInto( key, 0, pos);
+		key.Trim();
+	}
+	key.ToLower();
+	return key;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadAtomAttr( node, attrName, atom)
+		-	reads the given string-attribute into the given atom
+		-	returns whether or not the value has changed
+\*------------------------------------------------------------------------------*/
+static bool ReadAtomAttr( const BNode* node, const char* attrName, 
+								  BmAtom& atom) {
+	BmString str = atom.String();
+	if (!BmReadStringAttr( node, attrName, str))
+		return false;
+	atom = str;
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	CreateInstance( )
 		-	static creator-func
@@ -132,6 +269,54 @@ BmRef<BmMailRef> BmMailRef::CreateInstance( BMessage* archive) {
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	CreateInstance( record, strings, stringsSize)
+		-	static creator-func that builds a mailref from the given record of a
+			binary mailref-cache
+		-	returns NULL if the record refers to strings outside the 
+			string-table (i.e. the cache is corrupt)
+		-	N.B.: In here, we lock the GlobalLocker manually (*not* BmAutolock),
+			because otherwise we may risk deadlocks
+\*------------------------------------------------------------------------------*/
+BmRef<BmMailRef> BmMailRef::CreateInstance( const BmMailRefCacheRecord& record,
+														  const char* strings, 
+														  uint32 stringsSize) {
+	if (record.trackerName >= stringsSize || record.imapUID >= stringsSize
+	|| record.account >= stringsSize || record.cc >= stringsSize
+	|| record.from >= stringsSize || record.name >= stringsSize
+	|| record.priority >= stringsSize || record.replyTo >= stringsSize
+	|| record.status >= stringsSize || record.subject >= stringsSize
+	|| record.to >= stringsSize || record.identity >= stringsSize
+	|| record.classification >= stringsSize
+	|| record.messageID >= stringsSize || record.references >= stringsSize) {
+		BM_LOGERR( BmString("BmMailRef: invalid string-offset in cache-record "
+								  "for inode ") << record.node);
+		return NULL;
+	}
+	node_ref nref;
+	nref.node = record.node;
+	nref.device = ThePrefs->MailboxVolume.Device();
+	BmString key( BM_REFKEY( nref));
+	GlobalLocker()->Lock();
+	if (!GlobalLocker()->IsLocked()) {
+		BM_SHOWERR("BmMailRef::CreateInstance(): Could not acquire global lock!");
+		return NULL;
+	}
+	BmRef<BmMailRef> mailRef( 
+		dynamic_cast<BmMailRef*>( 
+			BmRefObj::FetchObject( typeid(BmMailRef).name(), key)
+		)
+	);
+	GlobalLocker()->Unlock();
+	if (mailRef)
+		return mailRef;
+	else {
+		mailRef = new BmMailRef( record, strings, nref);
+		mailRef->Initialize();
+		return mailRef;
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	BmMailRef( eref, nref)
 		-	standard c'tor
@@ -142,9 +327,16 @@ BmMailRef::BmMailRef( entry_ref &eref, const node_ref& nref)
 	,	mWhen( 0)
 	,	mWhenCreated( 0)
 	,	mSize( 0)
-	,	mHasAttachments( false)
 	,	mRatioSpam( UNKNOWN_RATIO)
+	,	mThreadId( 0)
+	,	mThreadDepth( 0)
+	,	mStatusCode( STATUS_NONE)
+	,	mClassificationCode( CLASS_NONE)
+	,	mHasAttachments( false)
 	,	mInitCheck( B_NO_INIT)
+	,	mCollationKeys( NULL)
+	,	mCollationMask( 0)
+	,	mHeaderIDsChecked( false)
 {
 	mNodeRef = nref;
 }
@@ -159,9 +351,16 @@ BmMailRef::BmMailRef( entry_ref &eref, struct stat& st)
 	,	mWhen( 0)
 	,	mWhenCreated( 0)
 	,	mSize( 0)
-	,	mHasAttachments( false)
 	,	mRatioSpam( UNKNOWN_RATIO)
+	,	mThreadId( 0)
+	,	mThreadDepth( 0)
+	,	mStatusCode( STATUS_NONE)
+	,	mClassificationCode( CLASS_NONE)
+	,	mHasAttachments( false)
 	,	mInitCheck( B_NO_INIT)
+	,	mCollationKeys( NULL)
+	,	mCollationMask( 0)
+	,	mHeaderIDsChecked( false)
 {
 	mNodeRef.device = st.st_dev;
 	mNodeRef.node = st.st_ino;
@@ -173,13 +372,20 @@ BmMailRef::BmMailRef( entry_ref &eref, struct stat& st)
 \*------------------------------------------------------------------------------*/
 BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 	:	inherited( "", NULL, (BmListModelItem*)NULL)
+	,	mNodeRef( nref)
 	,	mWhen( 0)
 	,	mWhenCreated( 0)
 	,	mSize( 0)
-	,	mHasAttachments( false)
-	,	mNodeRef( nref)
 	,	mRatioSpam( UNKNOWN_RATIO)
+	,	mThreadId( 0)
+	,	mThreadDepth( 0)
+	,	mStatusCode( STATUS_NONE)
+	,	mClassificationCode( CLASS_NONE)
+	,	mHasAttachments( false)
 	,	mInitCheck( B_NO_INIT)
+	,	mCollationKeys( NULL)
+	,	mCollationMask( 0)
+	,	mHeaderIDsChecked( false)
 {
 	try {
 		status_t err;
@@ -200,7 +406,7 @@ BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 		mPriority = FindMsgString( archive, MSG_PRIORITY);
 		mReplyTo = FindMsgString( archive, MSG_REPLYTO);
 		mSize = FindMsgInt64( archive, MSG_SIZE);
-		mStatus = FindMsgString( archive, MSG_STATUS);
+		_SetStatus( FindMsgString( archive, MSG_STATUS));
 		mSubject = FindMsgString( archive, MSG_SUBJECT);
 		mTo = FindMsgString( archive, MSG_TO);
 		mWhen = FindMsgInt32( archive, MSG_WHEN);
@@ -219,7 +425,7 @@ BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 			mIsValid = FindMsgBool( archive, MSG_IS_VALID);
 
 		if (version >= 5) {
-			mClassification = FindMsgString( archive, MSG_CLASSIFICATION);
+			Classification( FindMsgString( archive, MSG_CLASSIFICATION));
 			mRatioSpam = FindMsgFloat( archive, MSG_RATIO_SPAM);
 		}
 
@@ -227,9 +433,12 @@ BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 			mImapUID = FindMsgString( archive, MSG_IMAP_UID);
 		}
 
-		mSizeString = BytesToString( int32(mSize), true);
-		if (mRatioSpam != UNKNOWN_RATIO)
-			mRatioSpamString << mRatioSpam;
+		if (version >= 7) {
+			mMessageID = FindMsgString( archive, MSG_MESSAGE_ID);
+			mReferences = FindMsgString( archive, MSG_REFERENCES);
+			mThreadId = FindMsgInt64( archive, MSG_THREAD_ID);
+			mThreadDepth = FindMsgInt16( archive, MSG_THREAD_DEPTH);
+		}
 
 		mInitCheck = B_OK;
 	} catch (BM_error &e) {
@@ -237,6 +446,49 @@ BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	BmMailRef( record, strings, nref)
+		-	c'tor that reads all data from a record of the binary cache
+		-	all string-offsets must have been checked by the caller
+\*------------------------------------------------------------------------------*/
+BmMailRef::BmMailRef( const BmMailRefCacheRecord& record, const char* strings,
+							 node_ref& nref)
+	:	inherited( BM_REFKEY( nref), NULL, (BmListModelItem*)NULL)
+	,	mNodeRef( nref)
+	,	mImapUID( strings + record.imapUID)
+	,	mAccount( strings + record.account)
+	,	mCc( strings + record.cc)
+	,	mFrom( strings + record.from)
+	,	mName( strings + record.name)
+	,	mPriority( strings + record.priority)
+	,	mReplyTo( strings + record.replyTo)
+	,	mSubject( strings + record.subject)
+	,	mTo( strings + record.to)
+	,	mIdentity( strings + record.identity)
+	,	mMessageID( strings + record.messageID)
+	,	mReferences( strings + record.references)
+	,	mWhen( record.when)
+	,	mWhenCreated( record.whenCreated)
+	,	mSize( record.size)
+	,	mRatioSpam( record.ratioSpam)
+	,	mThreadId( record.threadId)
+	,	mThreadDepth( record.threadDepth)
+	,	mStatusCode( STATUS_NONE)
+	,	mClassificationCode( CLASS_NONE)
+	,	mHasAttachments( record.hasAttachments != 0)
+	,	mInitCheck( B_OK)
+	,	mCollationKeys( NULL)
+	,	mCollationMask( 0)
+	,	mHeaderIDsChecked( false)
+{
+	mEntryRef.device = nref.device;
+	mEntryRef.directory = record.directory;
+	mEntryRef.set_name( strings + record.trackerName);
+	mIsValid = record.isValid != 0;
+	_SetStatus( strings + record.status);
+	Classification( strings + record.classification);
+}
+
 /*------------------------------------------------------------------------------*\
 	~BmMailRef()
 		-	d'tor
@@ -245,6 +497,62 @@ BmMailRef::~BmMailRef() {
 	BM_LOG3( BM_LogMailTracking, 
 				BmString("destructor of MailRef ") << Key() << " called");
 	WatchNode( &mNodeRef, B_STOP_WATCHING, TheMailMonitor);
+	delete [] mCollationKeys;
+}
+
+/*------------------------------------------------------------------------------*\
+	MemoryFootprint()
+		-	returns the (approximate) number of bytes occupied by this mailref
+\*------------------------------------------------------------------------------*/
+size_t BmMailRef::MemoryFootprint() const {
+	// N.B.: atoms are shared, so they do not count:
+	size_t footprint = sizeof( *this) + Key().Length() + mImapUID.Length() 
+		+ mCc.Length() + mFrom.Length() + mName.Length() + mReplyTo.Length() 
+		+ mSubject.Length() + mTo.Length() + mMessageID.Length() 
+		+ mReferences.Length();
+	if (mCollationKeys) {
+		for( int i=0; i<COLL_COUNT; ++i)
+			footprint += sizeof( BmString) + mCollationKeys[i].Length();
+	}
+	return footprint;
+}
+
+/*------------------------------------------------------------------------------*\
+	CollationKey( field)
+		-	returns the key that is used when sorting by the given field, 
+			comparing two of these keys is just a strcmp()
+		-	the keys are computed when they are used for the first time and
+			are cached until the corresponding field changes
+\*------------------------------------------------------------------------------*/
+const BmString& BmMailRef::CollationKey( BmCollationField field) const {
+	if (!mCollationKeys)
+		mCollationKeys = new BmString [COLL_COUNT];
+	BmString& key = mCollationKeys[field];
+	if (!(mCollationMask & (1 << field))) {
+		switch( field) {
+			case COLL_SUBJECT:
+				key = SubjectCollationKey( mSubject);
+				break;
+			case COLL_FROM:
+				key = AddressCollationKey( mFrom);
+				break;
+			case COLL_TO:
+				key = AddressCollationKey( mTo);
+				break;
+			case COLL_CC:
+				key = AddressCollationKey( mCc);
+				break;
+			case COLL_REPLY_TO:
+				key = AddressCollationKey( mReplyTo);
+				break;
+			default:
+				key = mName;
+				key.ToLower();
+				break;
+		}
+		mCollationMask |= 1 << field;
+	}
+	return key;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -255,38 +563,81 @@ status_t BmMailRef::Archive( BMessage* archive, bool) const {
 	status_t ret 
 		= archive->AddInt16( MSG_VERSION, nArchiveVersion)
 		|| archive->AddBool( MSG_IS_VALID, mIsValid)
-		|| archive->AddString( MSG_ACCOUNT, mAccount.String())
+		|| archive->AddString( MSG_ACCOUNT, Account().String())
 		|| archive->AddBool( MSG_ATTACHMENTS, mHasAttachments)
 		|| archive->AddString( MSG_CC, mCc.String())
 		|| archive->AddRef( MSG_ENTRYREF, &mEntryRef)
 		|| archive->AddString( MSG_FROM, mFrom.String())
 		|| archive->AddInt64( MSG_INODE, mNodeRef.node)
 		|| archive->AddString( MSG_NAME, mName.String())
-		|| archive->AddString( MSG_PRIORITY, mPriority.String())
+		|| archive->AddString( MSG_PRIORITY, Priority().String())
 		|| archive->AddInt64( MSG_WHEN_CREATED, mWhenCreated)
 		|| archive->AddString( MSG_REPLYTO, mReplyTo.String())
 		|| archive->AddInt64( MSG_SIZE, mSize)
-		|| archive->AddString( MSG_STATUS, mStatus.String())
+		|| archive->AddString( MSG_STATUS, Status().String())
 		|| archive->AddString( MSG_SUBJECT, mSubject.String())
 		|| archive->AddString( MSG_TO, mTo.String())
-		|| archive->AddString( MSG_IDENTITY, mIdentity.String())
+		|| archive->AddString( MSG_IDENTITY, Identity().String())
 		|| archive->AddInt32( MSG_WHEN, mWhen)
-		|| archive->AddString( MSG_CLASSIFICATION, mClassification.String())
+		|| archive->AddString( MSG_CLASSIFICATION, Classification().String())
 		|| archive->AddFloat( MSG_RATIO_SPAM, mRatioSpam)
-		|| archive->AddString( MSG_IMAP_UID, mImapUID.String());
+		|| archive->AddString( MSG_IMAP_UID, mImapUID.String())
+		|| archive->AddString( MSG_MESSAGE_ID, mMessageID.String())
+		|| archive->AddString( MSG_REFERENCES, mReferences.String())
+		|| archive->AddInt64( MSG_THREAD_ID, mThreadId)
+		|| archive->AddInt16( MSG_THREAD_DEPTH, mThreadDepth);
 	return ret;
 }
 
+/*------------------------------------------------------------------------------*\
+	FillCacheRecord( record, strings)
+		-	writes the data of this mailref into the given record of a binary 
+			cache, adding all strings to the given string-table
+\*------------------------------------------------------------------------------*/
+void BmMailRef::FillCacheRecord( BmMailRefCacheRecord& record, 
+											BmMailRefCacheStrings& strings) const {
+	memset( &record, 0, sizeof(record));
+	record.node = mNodeRef.node;
+	record.directory = mEntryRef.directory;
+	record.whenCreated = mWhenCreated;
+	record.size = mSize;
+	record.threadId = mThreadId;
+	record.when = mWhen;
+	record.ratioSpam = mRatioSpam;
+	record.trackerName = strings.Add( mEntryRef.name ? mEntryRef.name : "");
+	record.imapUID = strings.Add( mImapUID);
+	record.account = strings.Add( Account());
+	record.cc = strings.Add( mCc);
+	record.from = strings.Add( mFrom);
+	record.name = strings.Add( mName);
+	record.priority = strings.Add( Priority());
+	record.replyTo = strings.Add( mReplyTo);
+	record.status = strings.Add( Status());
+	record.subject = strings.Add( mSubject);
+	record.to = strings.Add( mTo);
+	record.identity = strings.Add( Identity());
+	record.classification = strings.Add( Classification());
+	record.messageID = strings.Add( mMessageID);
+	record.references = strings.Add( mReferences);
+	record.threadDepth = mThreadDepth;
+	record.hasAttachments = mHasAttachments ? 1 : 0;
+	record.isValid = mIsValid ? 1 : 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	Initialize()
 		-	unarchive c'tor
+		-	N.B.: the node is watched only after the attributes have been read,
+			since reading them may write the id-attributes of a mail that 
+			hasn't been written by Beam, which would otherwise come back
+			to us as B_ATTR_CHANGED events (two per mail)
 \*------------------------------------------------------------------------------*/
 void BmMailRef::Initialize() {
-	WatchNode( &mNodeRef, B_WATCH_STAT | B_WATCH_ATTR, TheMailMonitor);
 	if (mInitCheck != B_OK) {
 		if (ReadAttributes())
 			mInitCheck = B_OK;
 	}
+	WatchNode( &mNodeRef, B_WATCH_STAT | B_WATCH_ATTR, TheMailMonitor);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -335,7 +686,7 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 			updFlags |= UPD_NAME;
 		if (BmReadStringAttr( &node, BM_MAIL_ATTR_IMAP_UID, mImapUID))
 			updFlags |= UPD_IMAP_UID;
-		if (BmReadStringAttr( &node, BM_MAIL_ATTR_ACCOUNT, mAccount))
+		if (ReadAtomAttr( &node, BM_MAIL_ATTR_ACCOUNT, mAccount))
 			updFlags |= UPD_ACCOUNT;
 		if (BmReadStringAttr( &node, BM_MAIL_ATTR_CC, 		mCc))
 			updFlags |= UPD_CC;
@@ -343,19 +694,49 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 			updFlags |= UPD_FROM;
 		if (BmReadStringAttr( &node, BM_MAIL_ATTR_REPLY, 	mReplyTo))
 			updFlags |= UPD_REPLYTO;
-		if (BmReadStringAttr( &node, BM_MAIL_ATTR_STATUS, 	mStatus))
+		BmString status = Status();
+		if (BmReadStringAttr( &node, BM_MAIL_ATTR_STATUS, 	status)) {
+			_SetStatus( status);
 			updFlags |= UPD_STATUS;
+		}
 		if (BmReadStringAttr( &node, BM_MAIL_ATTR_SUBJECT, mSubject))
 			updFlags |= UPD_SUBJECT;
 		if (BmReadStringAttr( &node, BM_MAIL_ATTR_TO, 		mTo))
 			updFlags |= UPD_TO;
-		if (BmReadStringAttr( &node, BM_MAIL_ATTR_IDENTITY, mIdentity))
+		if (ReadAtomAttr( &node, BM_MAIL_ATTR_IDENTITY, mIdentity))
 			updFlags |= UPD_IDENTITY;
-		if (BmReadStringAttr( &node, BM_MAIL_ATTR_CLASSIFICATION, mClassification))
+		BmString classification = Classification();
+		if (BmReadStringAttr( &node, BM_MAIL_ATTR_CLASSIFICATION, 
+									 classification)) {
+			Classification( classification);
 			updFlags |= UPD_CLASSIFICATION;
+		}
 		BmString priority;
 		BmReadStringAttr( &node, BM_MAIL_ATTR_PRIORITY, priority);
 
+		BmString messageID, references;
+		attr_info attrInfo;
+		if (node.GetAttrInfo( BM_MAIL_ATTR_MESSAGE_ID, &attrInfo) == B_OK) {
+			BmReadStringAttr( &node, BM_MAIL_ATTR_MESSAGE_ID, messageID);
+			BmReadStringAttr( &node, BM_MAIL_ATTR_REFERENCES, references);
+		} else if (!mHeaderIDsChecked) {
+			// mail has not been written by Beam (or by an older version),
+			// so we have to fetch the ids from the header. The ids are
+			// written into the attributes, such that the header is read 
+			// only once (and not by every rescan):
+			_ReadIDsFromHeader( messageID, references);
+			_WriteIDAttributes( node, messageID, references);
+		} else {
+			messageID = mMessageID;
+			references = mReferences;
+		}
+		mHeaderIDsChecked = true;
+		if (messageID != mMessageID || references != mReferences) {
+			mMessageID.Adopt( messageID);
+			mReferences.Adopt( references);
+			updFlags |= UPD_MESSAGE_ID;
+		}
+
 		time_t when;
 		node.ReadAttr( BM_MAIL_ATTR_WHEN, B_TIME_TYPE, 0, 
 							&when, sizeof(time_t));
@@ -393,9 +774,19 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 			updFlags |= UPD_ATTACHMENTS;
 		}
 
-		if (mSize != st.st_size) {
-			mSize = st.st_size;
-			mSizeString = BytesToString( int32(mSize), true);
+		// compressed mail-files are smaller than the mail they contain, in
+		// that case we show the size of the mail-text (header + content):
+		off_t size = st.st_size;
+		int32 headerLength = 0, contentLength = 0;
+		if (node.ReadAttr( BM_MAIL_ATTR_HEADER, B_INT32_TYPE, 0, 
+								 &headerLength, sizeof(int32)) == sizeof(int32)
+		&& node.ReadAttr( BM_MAIL_ATTR_CONTENT, B_INT32_TYPE, 0, 
+								&contentLength, sizeof(int32)) == sizeof(int32)
+		&& headerLength >= 0 && contentLength >= 0
+		&& (off_t)headerLength + contentLength > size)
+			size = (off_t)headerLength + contentLength;
+		if (mSize != size) {
+			mSize = size;
 			updFlags |= UPD_SIZE;
 		}
 
@@ -430,7 +821,7 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 					priority = "3";
 			}
 		}
-		if (priority != mPriority) {
+		if (priority != mPriority.String()) {
 			mPriority = priority;
 			updFlags |= UPD_PRIORITY;
 		}
@@ -445,25 +836,28 @@ bool BmMailRef::ReadAttributes( const struct stat* statInfo,
 		mFrom = "";
 		mPriority = "";
 		mReplyTo = "";
-		mStatus = "";
+		_SetStatus( "");
 		mSubject = "";
 		mTo = "";
 		mIdentity = "";
+		mMessageID = "";
+		mReferences = "";
 		mWhen = 0;
 		mWhenCreated = 0;
 		mHasAttachments = false;
 		mSize = 0;
-		mSizeString = "";
-		mPriority = "";
-		mClassification = "";
+		Classification( "");
 		mRatioSpam = UNKNOWN_RATIO;
-		mRatioSpamString = "";
+		_InvalidateCollationKeys();
 
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("file <") << mEntryRef.name 
 						<< " is not a mail, invalidating it.");
 		IsValid( false);
 	}
+	if (updFlags & (UPD_SUBJECT | UPD_FROM | UPD_TO | UPD_CC | UPD_REPLYTO 
+						 | UPD_NAME))
+		_InvalidateCollationKeys();
 	if (updFlagsOut)
 		*updFlagsOut = updFlags;
 	return err == B_OK;
@@ -497,7 +891,7 @@ void BmMailRef::ResyncFromDisk( entry_ref* newRef,
 		-	
 \*------------------------------------------------------------------------------*/
 const bool BmMailRef::IsSpecial() const {
-	return mStatus == BM_MAIL_STATUS_NEW || mStatus == BM_MAIL_STATUS_PENDING;
+	return mStatusCode == STATUS_NEW || mStatusCode == STATUS_PENDING;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -505,12 +899,12 @@ const bool BmMailRef::IsSpecial() const {
 		-	
 \*------------------------------------------------------------------------------*/
 void BmMailRef::MarkAs( const char* status) {
-	if (InitCheck() != B_OK || mStatus == status)
+	if (InitCheck() != B_OK || Status() == status)
 		return;
 	try {
 		BNode mailNode;
 		status_t err;
-		mStatus = status;
+		_SetStatus( status);
 		if ((err = mailNode.SetTo( &mEntryRef)) != B_OK)
 			BM_THROW_RUNTIME( 
 				BmString( "Could not create node for current mail-file.\n\n"
@@ -546,9 +940,147 @@ void BmMailRef::MarkAs( const char* status) {
 \*------------------------------------------------------------------------------*/
 void BmMailRef::RatioSpam(float rs) {
 	mRatioSpam = rs;
-	mRatioSpamString = "";
+}
+
+/*------------------------------------------------------------------------------*\
+	ThreadInfo( threadId, depth)
+		-	sets the thread this mail belongs to (as determined by the threader
+			of the mailref-list) and the mail's depth within that thread
+\*------------------------------------------------------------------------------*/
+void BmMailRef::ThreadInfo( uint64 threadId, uint16 depth) {
+	mThreadId = threadId;
+	mThreadDepth = depth;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ReadIDsFromHeader( outMessageID, outReferences)
+		-	fetches message-id and references from the header of the mail-file
+\*------------------------------------------------------------------------------*/
+void BmMailRef::_ReadIDsFromHeader( BmString& outMessageID, 
+												BmString& outReferences) {
+	const int32 nMaxHeaderSize = 16*1024;
+	BFile mailFile( &mEntryRef, B_READ_ONLY);
+	if (mailFile.InitCheck() != B_OK)
+		return;
+	BmString header;
+	char* buf = header.LockBuffer( nMaxHeaderSize);
+	ssize_t size = mailFile.Read( buf, nMaxHeaderSize);
+	if (BmMailCompression::IsCompressed( buf, size > 0 ? size : 0)) {
+		// inflate just as much as is needed for the header:
+		vector< char> block( buf, buf+size);
+		BmMailInflater inflater( buf, nMaxHeaderSize);
+		inflater.Feed( &block[BmMailCompression::nHeaderSize],
+							size - BmMailCompression::nHeaderSize);
+		while( !inflater.IsDone() 
+		&& (size = mailFile.Read( &block[0], block.size())) > 0)
+			inflater.Feed( &block[0], size);
+		size = inflater.OutLength();
+	}
+	header.UnlockBuffer( size > 0 ? size : 0);
+	BmMailThreader::ExtractIDsFromHeader( header.String(), header.Length(),
+													  outMessageID, outReferences);
+}
+
+/*------------------------------------------------------------------------------*\
+	_WriteIDAttributes( node, messageID, references)
+		-	writes message-id and references into the attributes of the given
+			mail-node (empty ids are written, too, as they tell that the 
+			header has been checked)
+		-	failure is not a problem (the volume may be read-only), as the
+			ids are then just fetched from the header again
+\*------------------------------------------------------------------------------*/
+void BmMailRef::_WriteIDAttributes( BNode& node, const BmString& messageID,
+												const BmString& references) {
+	if (TheMailMonitor) {
+		// in order to allow proper handling of B_ATTR_CHANGED events, we
+		// tell the MailMonitor, which folder this mail-ref lives in:
+		node_ref folderNodeRef;
+		folderNodeRef.node = mEntryRef.directory;
+		folderNodeRef.device = mEntryRef.device;
+		BmString folderKey( BM_REFKEY( folderNodeRef));
+		TheMailMonitor->CacheRefToFolder( mNodeRef, folderKey);
+	}
+	if (node.WriteAttr( BM_MAIL_ATTR_REFERENCES, B_STRING_TYPE, 0, 
+							  references.String(), references.Length()+1) < 0)
+		return;
+	// the message-id is written last, as its existence tells that both ids
+	// are available:
+	node.WriteAttr( BM_MAIL_ATTR_MESSAGE_ID, B_STRING_TYPE, 0, 
+						 messageID.String(), messageID.Length()+1);
+}
+
+/*------------------------------------------------------------------------------*\
+	RatioSpamString()
+		-	returns the spam-ratio formatted for display (empty if unknown)
+\*------------------------------------------------------------------------------*/
+BmString BmMailRef::RatioSpamString() const {
+	BmString ratioSpamString;
 	if (mRatioSpam != UNKNOWN_RATIO)
-		mRatioSpamString << mRatioSpam;
+		ratioSpamString << mRatioSpam;
+	return ratioSpamString;
+}
+
+/*------------------------------------------------------------------------------*\
+	SizeString()
+		-	returns the size formatted for display
+\*------------------------------------------------------------------------------*/
+BmString BmMailRef::SizeString() const {
+	if (!mSize && !IsValid())
+		return BM_DEFAULT_STRING;
+	return BytesToString( int32(mSize), true);
+}
+
+/*------------------------------------------------------------------------------*\
+	Status()
+		-	returns the status of this mail as string
+\*------------------------------------------------------------------------------*/
+const BmString& BmMailRef::Status() const {
+	if (mStatusCode == STATUS_OTHER)
+		return mOtherStatus.String();
+	return nStatusStrings[mStatusCode];
+}
+
+/*------------------------------------------------------------------------------*\
+	_SetStatus( status)
+		-	sets the status of this mail, mapping it to a code if possible
+\*------------------------------------------------------------------------------*/
+void BmMailRef::_SetStatus( const BmString& status) {
+	for( uint8 i=STATUS_NONE; i<STATUS_OTHER; ++i) {
+		if (status == nStatusStrings[i]) {
+			mStatusCode = i;
+			mOtherStatus = BmAtom();
+			return;
+		}
+	}
+	mStatusCode = STATUS_OTHER;
+	mOtherStatus = status;
+}
+
+/*------------------------------------------------------------------------------*\
+	Classification()
+		-	returns the classification of this mail as string
+\*------------------------------------------------------------------------------*/
+const BmString& BmMailRef::Classification() const {
+	if (mClassificationCode == CLASS_OTHER)
+		return mOtherClassification.String();
+	return nClassStrings[mClassificationCode];
+}
+
+/*------------------------------------------------------------------------------*\
+	Classification( classification)
+		-	sets the classification of this mail, mapping it to a code if 
+			possible
+\*------------------------------------------------------------------------------*/
+void BmMailRef::Classification( const BmString& classification) {
+	for( uint8 i=CLASS_NONE; i<CLASS_OTHER; ++i) {
+		if (classification == nClassStrings[i]) {
+			mClassificationCode = i;
+			mOtherClassification = BmAtom();
+			return;
+		}
+	}
+	mClassificationCode = CLASS_OTHER;
+	mOtherClassification = classification;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -577,7 +1109,7 @@ void BmMailRef::MarkAsSpamOrTofu( bool asSpam) {
 	try {
 		BNode mailNode;
 		status_t err;
-		mClassification = asSpam ? BM_MAIL_CLASS_SPAM : BM_MAIL_CLASS_TOFU;
+		Classification( asSpam ? BM_MAIL_CLASS_SPAM : BM_MAIL_CLASS_TOFU);
 		if ((err = mailNode.SetTo( &mEntryRef)) != B_OK)
 			BM_THROW_RUNTIME( 
 				BmString( "Could not create node for current mail-file.\n\n"
@@ -596,7 +1128,8 @@ void BmMailRef::MarkAsSpamOrTofu( bool asSpam) {
 		// write it. Let's see if that helps...
 		mailNode.RemoveAttr( BM_MAIL_ATTR_CLASSIFICATION);
 		mailNode.WriteAttr( BM_MAIL_ATTR_CLASSIFICATION, B_STRING_TYPE, 0, 
-								  mClassification.String(), mClassification.Length()+1);
+								  Classification().String(), 
+								  Classification().Length()+1);
 		TellModelItemUpdated( UPD_CLASSIFICATION);
 		BmRef<BmListModel> listModel( ListModel());
 		BmMailRefList* refList = dynamic_cast< BmMailRefList*>( listModel.Get());
@@ -606,3 +1139,37 @@ void BmMailRef::MarkAsSpamOrTofu( bool asSpam) {
 		BM_SHOWERR(e.what());
 	}
 }
+
+
+
+//******************************************************************************
+// #pragma mark -	BmMailRefCacheStrings
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefCacheStrings( startLen)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailRefCacheStrings::BmMailRefCacheStrings( uint32 startLen)
+	:	mBuf( startLen, 2.0)
+{
+	// offset 0 is the empty string:
+	mBuf.Write( "", 1);
+	mOffsets[BM_DEFAULT_STRING] = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( str)
+		-	adds the given string to the table (unless it is already contained)
+		-	returns the offset of the string within the table
+\*------------------------------------------------------------------------------*/
+uint32 BmMailRefCacheStrings::Add( const BmString& str) {
+	OffsetMap::const_iterator pos = mOffsets.find( str);
+	if (pos != mOffsets.end())
+		return pos->second;
+	uint32 offset = mBuf.CurrPos();
+	mBuf.Write( str.String(), str.Length()+1);
+							// includes terminating null-byte
+	mOffsets[str] = offset;
+	return offset;
+}
@@ -11,16 +11,84 @@
 
 #include "BmMailKit.h"
 
+#include <map>
 #include <vector>
 
 #include <Entry.h>
 #include <Node.h>
 
+#include "BmAtom.h"
+#include "BmMemIO.h"
 #include "BmString.h"
 #include "BmDataModel.h"
 
+using std::map;
+
 class BmMail;
 class BmMailRefList;
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefCacheRecord
+		-	the fixed-size representation of a mailref within the binary cache
+			of a mailref-list (see BmMailRefList::Store())
+		-	all strings are stored as offsets into the string-table of the cache
+\*------------------------------------------------------------------------------*/
+struct BmMailRefCacheRecord {
+	int64 node;
+	int64 directory;
+	int64 whenCreated;
+	int64 size;
+	int64 threadId;
+	int32 when;
+	float ratioSpam;
+	uint32 trackerName;
+	uint32 imapUID;
+	uint32 account;
+	uint32 cc;
+	uint32 from;
+	uint32 name;
+	uint32 priority;
+	uint32 replyTo;
+	uint32 status;
+	uint32 subject;
+	uint32 to;
+	uint32 identity;
+	uint32 classification;
+	uint32 messageID;
+	uint32 references;
+	uint16 threadDepth;
+	uint8 hasAttachments;
+	uint8 isValid;
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefCacheStrings
+		-	collects the string-table for a binary mailref-cache
+		-	every distinct string is stored only once (most strings like status,
+			account or identity are shared by lots of mails)
+		-	offset 0 always refers to the empty string
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailRefCacheStrings {
+	typedef map< BmString, uint32> OffsetMap;
+
+public:
+	BmMailRefCacheStrings( uint32 startLen);
+
+	// native methods:
+	uint32 Add( const BmString& str);
+
+	// getters:
+	inline const char* Data() const		{ return mBuf.Buffer(); }
+	inline uint32 Size() const				{ return mBuf.CurrPos(); }
+
+private:
+	OffsetMap mOffsets;
+	BmStringOBuf mBuf;
+
+	// Hide copy-constructor and assignment:
+	BmMailRefCacheStrings( const BmMailRefCacheStrings&);
+	BmMailRefCacheStrings operator=( const BmMailRefCacheStrings&);
+};
 /*------------------------------------------------------------------------------*\
 	BmMailRef
 		-	class 
@@ -49,13 +117,52 @@ class IMPEXPBMMAILKIT BmMailRef : public BmListModelItem {
 	static const char* const MSG_CLASSIFICATION;
 	static const char* const MSG_RATIO_SPAM;
 	static const char* const MSG_IMAP_UID;
+	static const char* const MSG_MESSAGE_ID;
+	static const char* const MSG_REFERENCES;
+	static const char* const MSG_THREAD_ID;
+	static const char* const MSG_THREAD_DEPTH;
 	static const int16 nArchiveVersion;
 
 public:
+	// the known values of the status and the classification of a mail, 
+	// any other value is kept as an atom:
+	enum BmStatusCode {
+		STATUS_NONE = 0,
+		STATUS_DRAFT,
+		STATUS_ERROR,
+		STATUS_FORWARDED,
+		STATUS_NEW,
+		STATUS_PENDING,
+		STATUS_READ,
+		STATUS_REDIRECTED,
+		STATUS_REPLIED,
+		STATUS_SENT,
+		STATUS_OTHER
+	};
+	enum BmClassCode {
+		CLASS_NONE = 0,
+		CLASS_SPAM,
+		CLASS_TOFU,
+		CLASS_OTHER
+	};
+	// the fields that have a collation-key (used for sorting):
+	enum BmCollationField {
+		COLL_SUBJECT = 0,
+		COLL_FROM,
+		COLL_TO,
+		COLL_CC,
+		COLL_REPLY_TO,
+		COLL_NAME,
+		COLL_COUNT
+	};
+
 	// creator-funcs, c'tors and d'tor:
 	static BmRef<BmMailRef> CreateInstance( entry_ref &eref, 
 												 		 struct stat* st = NULL);
 	static BmRef<BmMailRef> CreateInstance( BMessage* archive);
+	static BmRef<BmMailRef> CreateInstance( const BmMailRefCacheRecord& record,
+														 const char* strings, 
+														 uint32 stringsSize);
 	virtual ~BmMailRef();
 
 	// native methods:
@@ -66,6 +173,13 @@ public:
 								const struct stat* statInfo = NULL);
 	void MarkAsSpam();
 	void MarkAsTofu();
+	void FillCacheRecord( BmMailRefCacheRecord& record, 
+								 BmMailRefCacheStrings& strings) const;
+	size_t MemoryFootprint() const;
+	const BmString& CollationKey( BmCollationField field) const;
+	//
+	static BmString SubjectCollationKey( const BmString& subject);
+	static BmString AddressCollationKey( const BmString& address);
 
 	// overrides of archivable base:
 	status_t Archive( BMessage* archive, bool deep = true) const;
@@ -84,16 +198,17 @@ public:
 	inline const BmString& ImapUID() const
 											 		{ return mImapUID; }
 	inline const BmString& Account() const
-											 		{ return mAccount; }
+											 		{ return mAccount.String(); }
 	inline const BmString& Cc() const 	{ return mCc; }
 	inline const BmString& From() const { return mFrom; }
 	inline const BmString& Name() const	{ return mName; }
 	inline const BmString& Priority() const
-											 		{ return mPriority; }
+											 		{ return mPriority.String(); }
 	inline const BmString& ReplyTo() const
 											 		{ return mReplyTo; }
-	inline const BmString& Status() const
-										 			{ return mStatus; }
+	const BmString& Status() const;
+	inline BmStatusCode StatusCode() const
+										 			{ return BmStatusCode( mStatusCode); }
 	inline const BmString& Subject() const
 											 		{ return mSubject; }
 	inline const BmString& To() const 	{ return mTo; }
@@ -101,26 +216,31 @@ public:
 	inline const bigtime_t& WhenCreated() const
 													{ return mWhenCreated; }
 	inline const off_t& Size() const 	{ return mSize; }
-	inline const BmString& SizeString() const
-												 	{ return mSizeString; }
+	BmString SizeString() const;
 	inline const bool HasAttachments() const
 												 	{ return mHasAttachments; }
 	const bool IsSpecial() const;
 	inline const BmString& Identity() const
-											 		{ return mIdentity; }
-	inline const BmString& Classification() const
-											 		{ return mClassification; }
+											 		{ return mIdentity.String(); }
+	const BmString& Classification() const;
+	inline BmClassCode ClassificationCode() const
+											 		{ return BmClassCode( mClassificationCode); }
 	inline float RatioSpam() const		{ return mRatioSpam; }
-	inline const BmString& RatioSpamString() const 
-													{ return mRatioSpamString; }
+	BmString RatioSpamString() const;
+	inline const BmString& MessageID() const
+											 		{ return mMessageID; }
+	inline const BmString& References() const
+											 		{ return mReferences; }
+	inline uint64 ThreadId() const		{ return mThreadId; }
+	inline uint16 ThreadDepth() const	{ return mThreadDepth; }
 
 	// setters:
 	inline void EntryRef( entry_ref &e) { mEntryRef = e; }
 	inline void WhenCreated( const bigtime_t& t)
 													{ mWhenCreated = t; }
-	inline void Classification( const BmString& c)
-													{ mClassification = c; }
+	void Classification( const BmString& c);
 	void RatioSpam( float rs);
+	void ThreadInfo( uint64 threadId, uint16 depth);
 
 	// flags indicating which parts are to be updated:
 	static const BmUpdFlags UPD_ACCOUNT			= 1<<2;
@@ -141,6 +261,10 @@ public:
 	static const BmUpdFlags UPD_CLASSIFICATION= 1<<17;
 	static const BmUpdFlags UPD_RATIO_SPAM		= 1<<18;
 	static const BmUpdFlags UPD_IMAP_UID		= 1<<19;
+	static const BmUpdFlags UPD_MESSAGE_ID		= 1<<20;
+							// message-id or references have changed
+	static const BmUpdFlags UPD_THREAD			= 1<<21;
+							// thread-id or thread-depth have changed
 
 							// indicates whether an item has been added or removed
 	static const float UNKNOWN_RATIO;
@@ -149,37 +273,60 @@ protected:
 	BmMailRef( entry_ref &eref, struct stat& st);
 	BmMailRef( entry_ref &eref, const node_ref& nref);
 	BmMailRef( BMessage* archive, node_ref& nref);
+	BmMailRef( const BmMailRefCacheRecord& record, const char* strings,
+				  node_ref& nref);
 	void Initialize();
 
 private:
 	void MarkAsSpamOrTofu(bool asSpam);
+	void _SetStatus( const BmString& status);
+	void _InvalidateCollationKeys()	{ mCollationMask = 0; }
+	void _ReadIDsFromHeader( BmString& outMessageID, BmString& outReferences);
+	void _WriteIDAttributes( BNode& node, const BmString& messageID,
+									const BmString& references);
 
 	// the following members will be archived as part of BmFolderList:
 	entry_ref mEntryRef;
 	node_ref mNodeRef;
 	BmString mImapUID;
-	BmString mAccount;
+	BmAtom mAccount;
 	BmString mCc;
 	BmString mFrom;
 	BmString mName;
-	BmString mPriority;
+	BmAtom mPriority;
 	BmString mReplyTo;
-	BmString mStatus;
 	BmString mSubject;
 	BmString mTo;
+	BmAtom mIdentity;
+	BmString mMessageID;
+	BmString mReferences;
+							// normalized, see BmMailThreader
+	BmAtom mOtherStatus;
+							// status, if it is not one of the known values
+	BmAtom mOtherClassification;
+							// classification, if it is not one of the known 
+							// values
 	time_t mWhen;
 	bigtime_t mWhenCreated;
 							// time (in microseconds) when mail has been received
 	off_t mSize;
-	BmString mSizeString;
-	bool mHasAttachments;
-	BmString mIdentity;
-	BmString mClassification;				// spam or genuine
 	float mRatioSpam;							// 0.00 (genuine) .. 1.0 (spam)
-	BmString mRatioSpamString;
+	uint64 mThreadId;
+							// determined by the threader of the mailref-list
+	uint16 mThreadDepth;
+	uint8 mStatusCode;
+	uint8 mClassificationCode;				// spam or genuine
+	bool mHasAttachments;
 
 	// the following members will not be archived at all:
 	status_t mInitCheck;
+	mutable BmString* mCollationKeys;
+							// the collation-keys, created on demand
+	mutable uint8 mCollationMask;
+							// bit i is set if collation-key i is up-to-date
+	bool mHeaderIDsChecked;
+							// set once the ids have been read from the mail-header
+							// (for mails lacking the corresponding attributes)
 
 	// Hide copy-constructor and assignment:
 	BmMailRef( const BmMailRef&);
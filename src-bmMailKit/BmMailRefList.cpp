@@ -10,6 +10,7 @@
 #include <Directory.h>
 #include <File.h>
 #include <NodeMonitor.h>
+#include <OS.h>
 #include <Path.h>
 #include <Query.h>
 
@@ -22,16 +23,48 @@ using namespace regexx;
 #include "BmMailRef.h"
 #include "BmMailRefFilter.h"
 #include "BmMailRefList.h"
+#include "BmMailRefTrigramIndex.h"
+#include "BmMailThreader.h"
 #include "BmPrefs.h"
+#include "BmProfiler.h"
 #include "BmRosterBase.h"
+#include "BmStorageUtil.h"
 #include "BmUtil.h"
 
 //******************************************************************************
 // #pragma mark -	BmMailRefList
 //******************************************************************************
-const int16 BmMailRefList::nArchiveVersion = 3;
+const int16 BmMailRefList::nArchiveVersion = 6;
 
 const char* const BmMailRefList::MSG_FILTER_ARCHIVE = "bm:fila";
+const char* const BmMailRefList::MSG_CACHE_DATA_SIZE = "bm:cdsz";
+
+/*------------------------------------------------------------------------------*\
+	The cache-file of a mailref-list consists of two parts:
+		-	a (flattened) header message containing the archive-version, the
+			filter, the number of mailrefs, the size of the binary part and
+			the sequence number of the last journal record contained
+		-	the binary part: a BmMailRefCacheHeader, followed by one 
+			BmMailRefCacheRecord per mailref, followed by the string-table
+	Actions that happen while the list is not loaded are written to the
+	journal by the stored-action-manager.
+	The binary part is read via a memory-mapping of the file, such that 
+	mailrefs are created directly from the records.
+\*------------------------------------------------------------------------------*/
+struct BmMailRefCacheHeader {
+	uint32 magic;
+	uint16 recordVersion;
+	uint16 recordSize;
+	uint32 recordCount;
+	uint32 stringsSize;
+};
+
+static const uint32 nCacheMagic = 'BmRc';
+static const uint16 nCacheRecordVersion = 2;
+
+// every mailref costs a node in the item-map, too:
+static const size_t nItemNodeSize 
+	= sizeof( BmModelItemMap::value_type) + 4 * sizeof( void*);
 
 /*------------------------------------------------------------------------------*\
 	BmMailRefList()
@@ -42,6 +75,10 @@ BmMailRefList::BmMailRefList( BmMailFolder* folder)
 							<< " (" << folder->Name()<<")", BM_LogMailTracking)
 	,	mFolder( folder)
 	,	mNeedsCacheUpdate( false)
+	,	mTrigramIndex( NULL)
+	,	mThreader( NULL)
+	,	mThreadsNeedUpdate( false)
+	,	mRefsFootprint( 0)
 {
 	if (folder) {
 		mSettingsFileName = BmString("folder_")
@@ -59,6 +96,8 @@ BmMailRefList::BmMailRefList( BmMailFolder* folder)
 \*------------------------------------------------------------------------------*/
 BmMailRefList::~BmMailRefList() {
 	StoreAndCleanup();
+	if (TheMailRefListResidency)
+		TheMailRefListResidency->Remove( this);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -75,6 +114,7 @@ void BmMailRefList::MarkCacheAsDirty() {
 		-	
 \*------------------------------------------------------------------------------*/
 void BmMailRefList::StoreAndCleanup() { 
+	BM_PROFILE_SPAN( ModelName());
 	BmAutolockCheckGlobal lock( ModelLocker());
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( 
@@ -86,6 +126,94 @@ void BmMailRefList::StoreAndCleanup() {
 	Cleanup();
 }
 
+/*------------------------------------------------------------------------------*\
+	StoreOnShutdown()
+		-	the list is no longer needed after being stored
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::StoreOnShutdown() { 
+	StoreAndCleanup();
+}
+
+/*------------------------------------------------------------------------------*\
+	MarkCacheAsStale()
+		-	makes sure that the cache-file of this list is not trusted the next
+			time the list is read, since the list has changed but could not be
+			stored (an empty cache-file is never trusted, so the mailrefs will 
+			be rebuilt from the folder)
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::MarkCacheAsStale() { 
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":MarkCacheAsStale(): Unable to get lock"
+		);
+	if (!ThePrefs->GetBool("CacheRefsOnDisk") || !mNeedsStore 
+	|| mNeedsCacheUpdate)
+		return;
+	BFile cacheFile( SettingsFileName().String(), B_WRITE_ONLY);
+	if (cacheFile.InitCheck() == B_OK)
+		cacheFile.SetSize( 0);
+	mStoredActionManager.RemoveJournal();
+	mNeedsCacheUpdate = true;
+							// keeps the d'tor from storing the list after all
+}
+
+/*------------------------------------------------------------------------------*\
+	MemoryFootprint()
+		-	returns the (approximate) number of bytes occupied by all mailrefs 
+			of this list
+		-	the footprint of the mailrefs themselves is tracked as they are 
+			added and removed, so this is cheap enough to be called whenever 
+			the list is used
+\*------------------------------------------------------------------------------*/
+size_t BmMailRefList::MemoryFootprint() const {
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":MemoryFootprint(): Unable to get lock"
+		);
+	size_t footprint = mRefsFootprint;
+	if (mTrigramIndex)
+		footprint += mTrigramIndex->MemoryFootprint();
+	if (mThreader)
+		footprint += mThreader->MemoryFootprint();
+	return footprint;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindFilterCandidates( text, outNodes)
+		-	fills outNodes with the nodes of all mailrefs that may contain the 
+			given text in their subject or in one of their address-fields
+			(the candidates still have to be checked by a real substring search)
+		-	the trigram-index is built when this method is called for the
+			first time (usually from within the job-thread of a view filter)
+			and is maintained along with the list from then on
+		-	returns false if no candidates could be determined (the list
+			hasn't been loaded or the text is too short), in which case 
+			all mailrefs have to be checked
+\*------------------------------------------------------------------------------*/
+bool BmMailRefList::FindFilterCandidates( const BmString& text, 
+														set< ino_t>& outNodes) {
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":FindFilterCandidates(): Unable to get lock"
+		);
+	if (InitCheck() != B_OK)
+		return false;
+	if (!mTrigramIndex) {
+		mTrigramIndex = new BmMailRefTrigramIndex();
+		BmModelItemMap::const_iterator iter;
+		for( iter = begin(); iter != end(); ++iter)
+			mTrigramIndex->AddMailRef( 
+				dynamic_cast< const BmMailRef*>( iter->second.Get())
+			);
+		BM_LOG2( BM_LogMailTracking, 
+					ModelNameNC() << ": trigram-index has been built");
+	}
+	return mTrigramIndex->FindCandidates( text, outNodes);
+}
+
 /*------------------------------------------------------------------------------*\
 	IsJobCompleted()
 		-	checks if this job has been completed
@@ -126,9 +254,29 @@ bool BmMailRefList::Store() {
 			BM_THROW_RUNTIME( 
 				ModelNameNC() << ":Store(): Unable to get lock"
 			);
-		BMallocIO memIO;
-		memIO.SetBlockSize( 1200 * MAX( size(), 1));
-			// acquire enough mem for complete archive, avoids realloc()
+		BM_LOG( BM_LogModelController, 
+				  BmString("ListModel <") << ModelName() 
+				  		<< "> begins to archive...");
+		// collect the records and strings first, as the header message needs
+		// to know the size of the binary part:
+		vector< BmMailRefCacheRecord> records( size());
+		BmMailRefCacheStrings strings( 64 * MAX( size(), 1));
+		uint32 count = 0;
+		BmModelItemMap::const_iterator iter;
+		for( iter = begin(); iter != end(); ++iter) {
+			BmMailRef* ref = dynamic_cast< BmMailRef*>( iter->second.Get());
+			if (ref)
+				ref->FillCacheRecord( records[count++], strings);
+		}
+		BmMailRefCacheHeader cacheHeader;
+		cacheHeader.magic = nCacheMagic;
+		cacheHeader.recordVersion = nCacheRecordVersion;
+		cacheHeader.recordSize = sizeof( BmMailRefCacheRecord);
+		cacheHeader.recordCount = count;
+		cacheHeader.stringsSize = strings.Size();
+		size_t recordsSize = count * sizeof( BmMailRefCacheRecord);
+		int64 dataSize 
+			= sizeof( cacheHeader) + recordsSize + cacheHeader.stringsSize;
 	
 		BmString filename = SettingsFileName();
 		if ((ret = cacheFile.SetTo( 
@@ -145,24 +293,31 @@ bool BmMailRefList::Store() {
 				ret = archive.AddMessage(MSG_FILTER_ARCHIVE, &filterArchive);
 		}
 		if (ret == B_OK) {
-			ret = archive.AddInt32( BmListModelItem::MSG_NUMCHILDREN, size())
-					| archive.Flatten( &memIO);
+			ret = archive.AddInt32( BmListModelItem::MSG_NUMCHILDREN, count)
+					| archive.AddInt64( MSG_CACHE_DATA_SIZE, dataSize)
+					| archive.AddInt64( MSG_JOURNAL_SEQ, 
+											  mStoredActionManager.LastSequence())
+					| archive.Flatten( &cacheFile);
 		}
 		if (ret == B_OK) {
-			BM_LOG( BM_LogModelController, 
-					  BmString("ListModel <") << ModelName() 
-					  		<< "> begins to archive...");
-			BmModelItemMap::const_iterator iter;
-			for( iter = begin(); iter != end() && ret == B_OK; ++iter) {
-				BMessage msg;
-				ret = iter->second->Archive( &msg, true);
-				if (ret == B_OK)
-					ret = msg.Flatten( &memIO);
-			}
 			BM_LOG( BM_LogModelController, 
 					  BmString("ListModel <") << ModelName() 
 					  		<< "> finished with archive, writing to file...");
-			cacheFile.Write( memIO.Buffer(), memIO.BufferLength());
+			if (cacheFile.Write( &cacheHeader, sizeof( cacheHeader)) 
+					!= (ssize_t)sizeof( cacheHeader)
+			|| (recordsSize 
+				&& cacheFile.Write( &records[0], recordsSize) 
+					!= (ssize_t)recordsSize)
+			|| cacheFile.Write( strings.Data(), strings.Size()) 
+					!= (ssize_t)strings.Size()) {
+				// leave an unusable cache behind, it will be rebuilt:
+				cacheFile.SetSize( 0);
+				BM_THROW_RUNTIME( BmString("Could not write settings-file\n\t<") 
+											<< filename << ">");
+			}
+			cacheFile.Sync();
+			// the cache-file contains all actions now, so the journal can go:
+			mStoredActionManager.RemoveJournal();
 			BM_LOG( BM_LogModelController, 
 					  BmString("ListModel <") << ModelName() 
 					  		<< "> finished with writing to file");
@@ -189,8 +344,11 @@ bool BmMailRefList::StartJob() {
 	if (!folder)
 		return false;
 		
-	if (InitCheck() == B_OK && !mNeedsCacheUpdate)
+	if (InitCheck() == B_OK && !mNeedsCacheUpdate) {
+		if (TheMailRefListResidency)
+			TheMailRefListResidency->Touch( this);
 		return true;
+	}
 	
 	Freeze();									// we shut up for better performance
 	try {
@@ -231,6 +389,13 @@ bool BmMailRefList::StartJob() {
 						BmString("Could not get mtime \nfor mail-folder <") << Name() 
 							<< "> \n\nError:" << strerror(err)
 					);
+				// changes to the folder that happened after the cache-file has
+				// been written are contained in the journal:
+				time_t journalMtime;
+				if (mStoredActionManager.GetJournalModificationTime( 
+						&journalMtime) == B_OK
+				&& journalMtime > mtime)
+					mtime = journalMtime;
 				if (!mNeedsCacheUpdate && !folder->CheckIfModifiedSince( mtime)) {
 					// archive up-to-date, but is it the correct format-version?
 					msg.Unflatten( &cacheFile);
@@ -244,34 +409,10 @@ bool BmMailRefList::StartJob() {
 		if (cacheFileUpToDate) {
 			// ...ok, cache-file should contain up-to-date info, 
 			// we fetch our data from it:
-#ifdef __HAIKU__
-			// On haiku, this is considerably faster than unflattening from a file.
-			// TODO: find out why haiku is much slower than R5 in this!
-			off_t sz = 0;
-			if ((err = cacheFile.GetSize(&sz)) != B_OK)
-				BM_THROW_RUNTIME( 
-					BmString("couldn't get size for cache-file <") << filename 
-						<< "> \n\nError:" << strerror(err)
-				);
-			sz -= cacheFile.Position();
-			std::auto_ptr<char> buf(new char [sz]);
-			if ((err = cacheFile.Read(buf.get(), size_t(sz))) < B_OK)
-				BM_THROW_RUNTIME( 
-					BmString("couldn't read from cache-file <") << filename 
-						<< "> \n\nError:" << strerror(err)
-				);
-			if (err < sz)
-				BM_THROW_RUNTIME( 
-					BmString("couldn't read ") << sz << " bytes from cache-file <"
-						<< filename << ">, read only " << err << " bytes"
-				);
-			BMemoryIO memIO(buf.get(), size_t(sz));
-			InstantiateItemsFromStream( &memIO, &msg);
-#else
-			InstantiateItemsFromStream( &cacheFile, &msg);
-#endif
-		} else {
-			// ...caching disabled or no cache file found or update 
+			InstantiateItemsFromCache( cacheFile, filename, &msg);
+		}
+		if (!cacheFileUpToDate || (InitCheck() != B_OK && ShouldContinue())) {
+			// ...caching disabled or no (valid) cache file found or update 
 			// required/requested, we fetch the existing mails from disk...
 			InitializeItems();
 		}
@@ -280,6 +421,8 @@ bool BmMailRefList::StartJob() {
 		BM_SHOWERR( e.what());
 	}
 	Thaw();
+	if (InitCheck() == B_OK && TheMailRefListResidency)
+		TheMailRefListResidency->Touch( this);
 	return InitCheck() == B_OK;
 }
 
@@ -350,6 +493,98 @@ BmRef<BmListModelItem> BmMailRefList::RemoveMailRef( const BmString& key) {
 	return removedRef;
 }
 
+/*------------------------------------------------------------------------------*\
+	AddMailRefs( files, outAddedRefs)
+		-	adds mailrefs for all the given mail-files, locking the list only once
+		-	the mailrefs that have actually been added are returned in 
+			outAddedRefs
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::AddMailRefs( const BmMailFileInfoVect& files,
+											vector< BmRef<BmMailRef> >& outAddedRefs) {
+	// creating a mailref reads all attributes of the mail-file, so we do that
+	// before locking the list:
+	vector< BmRef<BmMailRef> > newRefs;
+	newRefs.reserve( files.size());
+	for( uint32 i=0; i<files.size(); ++i) {
+		BmMailFileInfo info = files[i];
+		BmRef<BmMailRef> newMailRef( BmMailRef::CreateInstance( info.eref, 
+																				  &info.st));
+		if (newMailRef)
+			newRefs.push_back( newMailRef);
+	}
+	if (newRefs.empty())
+		return;
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":AddMailRefs(): Unable to get lock"
+		);
+	if (mInitCheck == B_OK) {
+		// ref-list has been read from disk,  so we can add to it:
+		for( uint32 i=0; i<newRefs.size(); ++i) {
+			if (AddItemToList( newRefs[i].Get()))
+				outAddedRefs.push_back( newRefs[i]);
+		}
+	} else {
+		// ref-list has not been read yet, we append info about the added
+		// items to the cache:
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("Storing created-actions for ") << int32(newRefs.size()) 
+				  	<< " refs");
+		int32 storedCount = 0;
+		for( uint32 i=0; i<newRefs.size(); ++i) {
+			BMessage action;
+			newRefs[i]->Archive( &action);
+			action.AddInt32( BmMailRef::MSG_OPCODE, B_ENTRY_CREATED);
+			if (StoreAction(&action)) {
+				outAddedRefs.push_back( newRefs[i]);
+				storedCount++;
+			}
+		}
+		BmRef<BmMailFolder> folder( mFolder.Get());
+			// hold a ref on the corresponding folder while we use it
+		if (folder && storedCount)
+			folder->BumpMailCount( storedCount);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMailRefs( keys)
+		-	removes the mailrefs with the given keys, locking the list only once
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::RemoveMailRefs( const vector< BmString>& keys) {
+	if (keys.empty())
+		return;
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":RemoveMailRefs(): Unable to get lock"
+		);
+	if (mInitCheck == B_OK) {
+		// ref-list has been read from disk, so we can remove from it:
+		for( uint32 i=0; i<keys.size(); ++i)
+			RemoveItemByKey( keys[i]);
+	} else {
+		// ref-list has not been read yet, we append info about the removed
+		// items to the cache:
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("Storing removed-actions for ") << int32(keys.size()) 
+				  	<< " refs");
+		int32 storedCount = 0;
+		for( uint32 i=0; i<keys.size(); ++i) {
+			BMessage action;
+			action.AddInt32( BmMailRef::MSG_OPCODE, B_ENTRY_REMOVED);
+			action.AddString( MSG_ITEMKEY, keys[i].String());
+			if (StoreAction(&action))
+				storedCount++;
+		}
+		BmRef<BmMailFolder> folder( mFolder.Get());
+			// hold a ref on the corresponding folder while we use it
+		if (folder && storedCount)
+			folder->BumpMailCount( -storedCount);
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	UpdateMailRef()
 		-	
@@ -379,12 +614,205 @@ void BmMailRefList::UpdateMailRef( const BmString& key) {
 }
 
 /*------------------------------------------------------------------------------*\
-	InitializeItems()
+	BmMailRefScanItem
+		-	a mail-file found by the directory scan, together with the mailref
+			that has been created for it by one of the scan-workers
+\*------------------------------------------------------------------------------*/
+struct BmMailRefScanItem {
+	entry_ref eref;
+	struct stat st;
+	BmRef<BmMailRef> ref;
+};
+
+typedef vector< BmMailRefScanItem> BmMailRefScanBatch;
+
+static const uint32 nScanBatchSize = 256;
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefScanPool
+		-	a pool of threads that create the mailrefs for a batch of scanned
+			mail-files (which means reading all the attributes of each file)
+		-	only one batch is processed at any time, but the caller may 
+			collect the next batch while the workers are busy
+\*------------------------------------------------------------------------------*/
+class BmMailRefScanPool {
+
+public:
+	BmMailRefScanPool( int32 threadCount);
+	~BmMailRefScanPool();
+
+	// native methods:
+	void StartBatch( BmMailRefScanBatch* batch);
+	void WaitForBatch();
+	void Cancel()								{ atomic_or( &mCancelled, 1); }
+
+private:
+	static int32 _ThreadEntry( void* data);
+	void _Work();
+
+	vector< thread_id> mThreads;
+	sem_id mWorkSem;
+	sem_id mDoneSem;
+	BmMailRefScanBatch* mBatch;
+	int32 mNextIndex;
+	int32 mCancelled;
+	bool mQuitting;
+	bool mBatchRunning;
+
+	// Hide copy-constructor and assignment:
+	BmMailRefScanPool( const BmMailRefScanPool&);
+	BmMailRefScanPool operator=( const BmMailRefScanPool&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefScanPool( threadCount)
+		-	c'tor, spawns the worker threads (which may be less than requested,
+			if the system refuses to spawn them all)
+\*------------------------------------------------------------------------------*/
+BmMailRefScanPool::BmMailRefScanPool( int32 threadCount)
+	:	mWorkSem( create_sem( 0, "bm_scan_work"))
+	,	mDoneSem( create_sem( 0, "bm_scan_done"))
+	,	mBatch( NULL)
+	,	mNextIndex( 0)
+	,	mCancelled( 0)
+	,	mQuitting( false)
+	,	mBatchRunning( false)
+{
+	if (mWorkSem < 0 || mDoneSem < 0)
+		return;
+	for( int32 i=0; i<threadCount; ++i) {
+		thread_id tid = spawn_thread( &_ThreadEntry, "bm_mailref_scanner", 
+												B_NORMAL_PRIORITY, this);
+		if (tid < 0)
+			break;
+		mThreads.push_back( tid);
+		resume_thread( tid);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailRefScanPool()
+		-	d'tor, waits for the current batch (if any) and stops all workers
+\*------------------------------------------------------------------------------*/
+BmMailRefScanPool::~BmMailRefScanPool() {
+	if (mBatchRunning) {
+		Cancel();
+		WaitForBatch();
+	}
+	mQuitting = true;
+	if (mThreads.size())
+		release_sem_etc( mWorkSem, mThreads.size(), 0);
+	status_t exitVal;
+	for( uint32 i=0; i<mThreads.size(); ++i)
+		wait_for_thread( mThreads[i], &exitVal);
+	if (mWorkSem >= 0)
+		delete_sem( mWorkSem);
+	if (mDoneSem >= 0)
+		delete_sem( mDoneSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	StartBatch( batch)
+		-	hands the given batch to the workers, which will fill in the ref
+			of every item
+		-	the batch must not be touched until WaitForBatch() has returned
+		-	if no workers could be spawned, the batch is processed right here
+\*------------------------------------------------------------------------------*/
+void BmMailRefScanPool::StartBatch( BmMailRefScanBatch* batch) {
+	if (mThreads.empty()) {
+		for( uint32 i=0; i<batch->size(); ++i) {
+			BmMailRefScanItem& item = (*batch)[i];
+			item.ref = BmMailRef::CreateInstance( item.eref, &item.st);
+		}
+		return;
+	}
+	mBatch = batch;
+	mNextIndex = 0;
+	mBatchRunning = true;
+	release_sem_etc( mWorkSem, mThreads.size(), 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	WaitForBatch()
+		-	blocks until all workers are done with the current batch
+\*------------------------------------------------------------------------------*/
+void BmMailRefScanPool::WaitForBatch() {
+	if (!mBatchRunning)
+		return;
+	while( acquire_sem_etc( mDoneSem, mThreads.size(), 0, B_INFINITE_TIMEOUT)
+				== B_INTERRUPTED)
+		;
+	mBatchRunning = false;
+	mBatch = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThreadEntry( data)
 		-	
 \*------------------------------------------------------------------------------*/
+int32 BmMailRefScanPool::_ThreadEntry( void* data) {
+	BmMailRefScanPool* pool = static_cast< BmMailRefScanPool*>( data);
+	if (pool)
+		pool->_Work();
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Work()
+		-	main loop of every worker: waits for a batch and then creates
+			mailrefs for items of that batch until none are left
+\*------------------------------------------------------------------------------*/
+void BmMailRefScanPool::_Work() {
+	while( 1) {
+		if (acquire_sem( mWorkSem) != B_OK)
+			return;
+		if (mQuitting)
+			return;
+		int32 count = mBatch->size();
+		int32 index;
+		while( !mCancelled && (index = atomic_add( &mNextIndex, 1)) < count) {
+			BmMailRefScanItem& item = (*mBatch)[index];
+			try {
+				item.ref = BmMailRef::CreateInstance( item.eref, &item.st);
+			} catch( BM_error &e) {
+				BM_LOGERR( BmString("Could not read mail <") << item.eref.name
+									<< ">\n\nError:" << e.what());
+			}
+		}
+		release_sem( mDoneSem);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	AddScannedRefs( list, batch)
+		-	adds all mailrefs of the given (finished) batch to the given list,
+			locking the list only once
+\*------------------------------------------------------------------------------*/
+static void AddScannedRefs( BmMailRefList* list, BmMailRefScanBatch& batch) {
+	if (batch.empty())
+		return;
+	BmAutolockCheckGlobal lock( list->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( list->ModelNameNC() << ": Unable to get lock");
+	for( uint32 i=0; i<batch.size(); ++i) {
+		if (batch[i].ref)
+			list->AddItemToList( batch[i].ref.Get());
+	}
+	batch.clear();
+}
+
+/*------------------------------------------------------------------------------*\
+	InitializeItems()
+		-	scans the folder's directory for mails and creates a mailref for
+			each of them
+		-	the directory is scanned by this thread, while the mailrefs (which
+			requires reading all attributes of every mail-file) are created by 
+			a pool of workers. The finished mailrefs are added to the list 
+			batch-wise, such that the list only needs to be locked once per 
+			batch.
+\*------------------------------------------------------------------------------*/
 void BmMailRefList::InitializeItems() {
 	BDirectory mailDir;
-	entry_ref eref;
 	dirent* dent;
 	struct stat st;
 	status_t err;
@@ -401,7 +829,18 @@ void BmMailRefList::InitializeItems() {
 	// we create a BDirectory from the given mail-folder...
 	mailDir.SetTo( folder->EntryRefPtr());
 
-	BmRef<BmMailRef> newRef;
+	int32 threadCount = ThePrefs->GetInt( "MailRefScanThreadCount", 0);
+	if (threadCount <= 0) {
+		system_info sysInfo;
+		get_system_info( &sysInfo);
+		threadCount = MAX( 2, MIN( sysInfo.cpu_count, 8));
+	}
+	// N.B.: the batches must outlive the pool, as the pool waits for a 
+	// running batch when being destructed:
+	BmMailRefScanBatch batches[2];
+	int32 current = 0;
+	BmMailRefScanPool pool( threadCount);
+
 	// ...and scan through all its entries for mails:
 	while (!stopped 
 	&& (count = mailDir.GetNextDirents((dirent* )buf, 4096)) > 0) {
@@ -414,15 +853,16 @@ void BmMailRefList::InitializeItems() {
 							<< dent->d_name << "> \n\nError:" << strerror(err)
 					);
 				if (S_ISREG( st.st_mode)) {
-					// we have found a new mail, so we add it to our list:
+					// we have found a new mail, so we queue it for the workers:
 					BM_LOG3( BM_LogMailTracking, 
 								BmString("Mail <") << dent->d_name << "," << dent->d_ino 
 									<< "> found ");
-					eref.device = dent->d_pdev;
-					eref.directory = dent->d_pino;
-					eref.set_name( dent->d_name);
-					newRef = BmMailRef::CreateInstance( eref, &st);
-					AddItemToList( newRef.Get());
+					BmMailRefScanItem item;
+					item.eref.device = dent->d_pdev;
+					item.eref.directory = dent->d_pino;
+					item.eref.set_name( dent->d_name);
+					item.st = st;
+					batches[current].push_back( item);
 				}
 			}
 			// Bump the dirent-pointer by length of the dirent just handled:
@@ -430,22 +870,42 @@ void BmMailRefList::InitializeItems() {
 
 			if (!ShouldContinue()) {
 				stopped = true;
+				pool.Cancel();
 				BM_LOG2( BM_LogMailTracking, 
 							BmString("InitializeMailRefs() stopped for folder ") 
 								<< folder->Name());
 			}
 		}
+		if (!stopped && batches[current].size() >= nScanBatchSize) {
+			// the current batch is full, so we hand it to the workers (once
+			// they are done with the previous one, which is then added to 
+			// the list) and start collecting the next one:
+			pool.WaitForBatch();
+			pool.StartBatch( &batches[current]);
+			current = 1-current;
+			AddScannedRefs( this, batches[current]);
+		}
+	}
+	if (!stopped) {
+		// handle the last (incomplete) batch:
+		pool.WaitForBatch();
+		AddScannedRefs( this, batches[1-current]);
+		pool.StartBatch( &batches[current]);
+		pool.WaitForBatch();
+		AddScannedRefs( this, batches[current]);
 	}
 	BM_LOG( BM_LogMailTracking, 
 			  BmString("End of InitializeMailRefs() for folder ") 
 			  		<< folder->Name());
 	if (stopped) {
+		pool.WaitForBatch();
 		Cleanup();
 	} else {
 		BmAutolockCheckGlobal lock( ModelLocker());
 		if (!lock.IsLocked())
 			BM_THROW_RUNTIME( ModelNameNC() << ": Unable to get lock");
 		folder->MailCount( ValidCount());
+		_BuildThreads();
 		mNeedsCacheUpdate = false;
 		mNeedsStore = true;
 		mInitCheck = B_OK;
@@ -453,10 +913,17 @@ void BmMailRefList::InitializeItems() {
 }
 
 /*------------------------------------------------------------------------------*\
-	InstantiateItemsFromStream( dataIO, headerMsg)
-		-	
+	InstantiateItemsFromCache( cacheFile, filename, headerMsg)
+		-	creates all mailrefs from the binary part of the given cache-file
+			(which must be positioned right behind the header message)
+		-	afterwards, all actions from the journal that are newer than the
+			cache-file are executed
+		-	if the cache turns out to be corrupt, the list is left 
+			uninitialized (such that the caller rebuilds it)
 \*------------------------------------------------------------------------------*/
-void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* headerMsg) {
+void BmMailRefList::InstantiateItemsFromCache( BFile& cacheFile, 
+															  const BmString& filename,
+															  BMessage* headerMsg) {
 	if (!headerMsg)
 		return;
 
@@ -466,47 +933,100 @@ void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* heade
 		SetFilter(filter);
 	}
 
+	int64 journalSeq;
+	if (headerMsg->FindInt64( MSG_JOURNAL_SEQ, &journalSeq) == B_OK)
+		mStoredActionManager.BaseSequence( journalSeq);
+
 	int32 numChildren 
 		= FindMsgInt32( headerMsg, BmListModelItem::MSG_NUMCHILDREN);
+	int64 dataSize = FindMsgInt64( headerMsg, MSG_CACHE_DATA_SIZE);
+	off_t dataStart = cacheFile.Position();
 	BmRef<BmMailFolder> folder( mFolder.Get());	
 							// hold a ref on the corresponding folder while we use it
 	BM_LOG( BM_LogMailTracking, 
 			  BmString("Start of InstantiateMailRefs() for folder ") 
 			  		<< folder->Name());
 	bool stopped = false;
-	BMessage msg;
-	for( int i=0; !stopped && i<numChildren; ++i) {
-		if (msg.Unflatten( dataIO) != B_OK) {
-			BM_SHOWERR( "Could not read all messages from cache file. "
-							"Please recreate cache.");
-			break;
+	{	// scope for mapping
+		BmMappedFile mappedFile;
+		status_t err = mappedFile.SetTo( filename.String());
+		if (err != B_OK) {
+			BM_LOGERR( BmString("Could not map cache-file <") << filename 
+								<< "> \n\nError:" << strerror(err));
+			return;
 		}
-		BmRef<BmMailRef> newRef( BmMailRef::CreateInstance( &msg));
-		BM_LOG3( BM_LogMailTracking, 
-					BmString("MailRef <") << newRef->TrackerName() << "," 
-						<< newRef->Key() << "> read");
-		AddItemToList( newRef.Get());
-
-		if (!ShouldContinue()) {
-			stopped = true;
-			BM_LOG2( BM_LogMailTracking, 
-						BmString("InstantiateMailRefs() stopped for folder ") 
-							<< folder->Name());
+		// N.B.: the binary part starts right behind the header message, so it
+		// is not necessarily aligned, which is why header and records are
+		// copied before being accessed.
+		BmMailRefCacheHeader cacheHeader;
+		if (dataStart < 0 || dataSize < (int64)sizeof( BmMailRefCacheHeader)
+		|| dataStart + dataSize > mappedFile.Size()) {
+			BM_LOGERR( BmString("Cache-file <") << filename 
+								<< "> is truncated, it will be recreated.");
+			return;
+		}
+		const char* data = mappedFile.Data() + dataStart;
+		memcpy( &cacheHeader, data, sizeof( cacheHeader));
+		if (cacheHeader.magic != nCacheMagic
+		|| cacheHeader.recordVersion != nCacheRecordVersion
+		|| cacheHeader.recordSize != sizeof( BmMailRefCacheRecord)
+		|| (int32)cacheHeader.recordCount != numChildren
+		|| sizeof( BmMailRefCacheHeader) 
+				+ (int64)cacheHeader.recordCount * sizeof( BmMailRefCacheRecord)
+				+ cacheHeader.stringsSize != dataSize) {
+			BM_LOGERR( BmString("Cache-file <") << filename 
+								<< "> has an invalid format, it will be recreated.");
+			return;
+		}
+		const char* records = data + sizeof( cacheHeader);
+		const char* strings 
+			= records + numChildren * sizeof( BmMailRefCacheRecord);
+		uint32 stringsSize = cacheHeader.stringsSize;
+		BmMailRefCacheRecord record;
+		if (!stringsSize || strings[stringsSize-1] != '\0') {
+			BM_LOGERR( BmString("Cache-file <") << filename 
+								<< "> has an invalid string-table, it will be "
+								"recreated.");
+			return;
+		}
+		for( int32 i=0; !stopped && i<numChildren; ++i) {
+			memcpy( &record, records + i * sizeof( record), sizeof( record));
+			BmRef<BmMailRef> newRef( 
+				BmMailRef::CreateInstance( record, strings, stringsSize)
+			);
+			if (!newRef) {
+				BM_LOGERR( BmString("Cache-file <") << filename 
+									<< "> contains invalid records, it will be "
+									"recreated.");
+				Cleanup();
+				return;
+			}
+			BM_LOG3( BM_LogMailTracking, 
+						BmString("MailRef <") << newRef->TrackerName() << "," 
+							<< newRef->Key() << "> read");
+			AddItemToList( newRef.Get());
+	
+			if (!ShouldContinue()) {
+				stopped = true;
+				BM_LOG2( BM_LogMailTracking, 
+							BmString("InstantiateMailRefs() stopped for folder ") 
+								<< folder->Name());
+			}
 		}
 	}
 	{  // now lock the list, as we must avoid the race condition where the 
-		// node monitor appends to the file while we fetch appended items 
-		// from it
+		// node monitor appends to the journal while we replay it
 		BmAutolockCheckGlobal lock( ModelLocker());
 		if (!lock.IsLocked())
 			BM_THROW_RUNTIME( ModelNameNC() << ": Unable to get lock");
-		bool needsStore = false;
 		if (!stopped) {
+			// the cached mailrefs know their threads, only the mailrefs 
+			// added or removed by the journal require an update:
+			mThreadsNeedUpdate = false;
 			BM_LOG( BM_LogMailTracking, 
-					  BmString("Fetching stored actions for folder ")
+					  BmString("Replaying journal for folder ")
 					  		<< folder->Name());
-			if (RestoreAndExecuteActionsFrom(dataIO))
-				needsStore = true;
+			ReplayJournal();
 		}
 		BM_LOG( BM_LogMailTracking, 
 				  BmString("End of InstantiateMailRefs() for folder ") 
@@ -516,8 +1036,13 @@ void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* heade
 		} else {
 			folder->MailCount( ValidCount());
 			mNeedsCacheUpdate = false;
-			mNeedsStore = needsStore;
+			mNeedsStore = false;
 				// overrule changes caused by reading the cache
+			// the cached mailrefs know their threads (unless the journal has
+			// changed them), but we build the threader right here in the 
+			// job-thread, such that changes reported later on (by the
+			// monitor-thread) are handled incrementally:
+			_BuildThreads( mThreadsNeedUpdate);
 			mInitCheck = B_OK;
 		}
 	}
@@ -527,10 +1052,35 @@ void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* heade
 	AddItemToList( item, parent)
 		-	extends base-method with automatic updating of the corresponding 
 			folder's mail-count 
+		-	the list is locked before the item is added, such that the 
+			trigram-index and the threads can never miss an item
 \*------------------------------------------------------------------------------*/
 bool BmMailRefList::AddItemToList( BmListModelItem* item, 
 											  BmListModelItem* parent) {
-	bool res = inherited::AddItemToList( item, parent);
+	bool res;
+	{	// scope for lock
+		BmAutolockCheckGlobal lock( ModelLocker());
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( 
+				ModelNameNC() << ":AddItemToList(): Unable to get lock"
+			);
+		res = inherited::AddItemToList( item, parent);
+		BmMailRef* ref = dynamic_cast< BmMailRef*>( item);
+		if (res && ref) {
+			mRefsFootprint += ref->MemoryFootprint() + nItemNodeSize;
+			if (mTrigramIndex)
+				mTrigramIndex->AddMailRef( ref);
+			if (mThreader) {
+				vector< ino_t> affected;
+				mThreader->AddMail( ref->NodeRef().node, ref->MessageID(),
+										  ref->References(), affected);
+				_UpdateThreadInfo( affected);
+			} else if (mInitCheck == B_OK)
+				_BuildThreads();
+			else
+				mThreadsNeedUpdate = true;
+		}
+	}
 	if (res && !Frozen()) {
 		BmRef<BmMailFolder> folder( mFolder.Get());
 			// hold a ref on the corresponding folder while we use it
@@ -544,9 +1094,36 @@ bool BmMailRefList::AddItemToList( BmListModelItem* item,
 	RemoveItemFromList( item)
 		-	extends base-method with automatic updating of the corresponding 
 			folder's mail-count 
+		-	the list is locked before the item is removed, such that the 
+			trigram-index and the threads can never keep a stale item
 \*------------------------------------------------------------------------------*/
 void BmMailRefList::RemoveItemFromList( BmListModelItem* item) {
-	inherited::RemoveItemFromList( item);
+	{	// scope for lock
+		BmAutolockCheckGlobal lock( ModelLocker());
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( 
+				ModelNameNC() << ":RemoveItemFromList(): Unable to get lock"
+			);
+		inherited::RemoveItemFromList( item);
+		BmMailRef* ref = dynamic_cast< BmMailRef*>( item);
+		if (ref) {
+			// the mailref may have grown since it has been added, so we take
+			// care not to wrap around:
+			size_t refFootprint = ref->MemoryFootprint() + nItemNodeSize;
+			mRefsFootprint 
+				= mRefsFootprint > refFootprint ? mRefsFootprint-refFootprint : 0;
+			if (mTrigramIndex)
+				mTrigramIndex->RemoveMailRef( ref);
+			if (mThreader) {
+				vector< ino_t> affected;
+				mThreader->RemoveMail( ref->NodeRef().node, affected);
+				_UpdateThreadInfo( affected);
+			} else if (mInitCheck == B_OK)
+				_BuildThreads();
+			else
+				mThreadsNeedUpdate = true;
+		}
+	}
 	if (!Frozen()) {
 		BmRef<BmMailFolder> folder( mFolder.Get());
 			// hold a ref on the corresponding folder while we use it
@@ -571,6 +1148,120 @@ void BmMailRefList::SetItemValidity( BmListModelItem* item, bool isValid) {
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	TellModelItemUpdated( item, flags, oldKey)
+		-	extends base-method with keeping the trigram-index and the threads
+			up-to-date
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::TellModelItemUpdated( BmListModelItem* item, 
+														BmUpdFlags flags,
+														const BmString oldKey) {
+	const BmUpdFlags indexedFlags = BmMailRef::UPD_SUBJECT 
+												| BmMailRef::UPD_FROM
+												| BmMailRef::UPD_TO 
+												| BmMailRef::UPD_CC;
+	BmMailRef* ref = dynamic_cast< BmMailRef*>( item);
+	if (ref && (flags & (indexedFlags | BmMailRef::UPD_MESSAGE_ID))) {
+		BmAutolockCheckGlobal lock( ModelLocker());
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( 
+				ModelNameNC() << ":TellModelItemUpdated(): Unable to get lock"
+			);
+		if (mTrigramIndex && (flags & indexedFlags))
+			mTrigramIndex->UpdateMailRef( ref);
+		if (flags & BmMailRef::UPD_MESSAGE_ID) {
+			if (mThreader) {
+				vector< ino_t> affected;
+				mThreader->AddMail( ref->NodeRef().node, ref->MessageID(),
+										  ref->References(), affected);
+				_UpdateThreadInfo( affected);
+			} else if (mInitCheck == B_OK)
+				_BuildThreads();
+			else
+				mThreadsNeedUpdate = true;
+		}
+	}
+	inherited::TellModelItemUpdated( item, flags, oldKey);
+}
+
+/*------------------------------------------------------------------------------*\
+	Cleanup()
+		-	extends base-method by dropping the trigram-index and the threader
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::Cleanup() {
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( ModelNameNC() << ":Cleanup(): Unable to get lock");
+	delete mTrigramIndex;
+	mTrigramIndex = NULL;
+	delete mThreader;
+	mThreader = NULL;
+	mThreadsNeedUpdate = false;
+	mRefsFootprint = 0;
+	inherited::Cleanup();
+}
+
+/*------------------------------------------------------------------------------*\
+	_BuildThreads( updateThreadInfo)
+		-	(re-)builds the threader from all mailrefs and (if requested) 
+			updates the thread-info of every mailref accordingly
+		-	from then on, the threader is updated incrementally whenever a
+			mailref is added, removed or has changed its ids
+		-	the list must be locked by the caller
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::_BuildThreads( bool updateThreadInfo) {
+	delete mThreader;
+	mThreader = new BmMailThreader();
+	vector< ino_t> affected;
+	vector< ino_t> nodes;
+	if (updateThreadInfo)
+		nodes.reserve( size());
+	BmModelItemMap::const_iterator iter;
+	for( iter = begin(); iter != end(); ++iter) {
+		const BmMailRef* ref 
+			= dynamic_cast< const BmMailRef*>( iter->second.Get());
+		if (!ref)
+			continue;
+		mThreader->AddMail( ref->NodeRef().node, ref->MessageID(),
+								  ref->References(), affected);
+		affected.clear();
+		if (updateThreadInfo)
+			nodes.push_back( ref->NodeRef().node);
+	}
+	_UpdateThreadInfo( nodes);
+	mThreadsNeedUpdate = false;
+	BM_LOG2( BM_LogMailTracking, 
+				ModelNameNC() << ": threads have been built (" 
+					<< mThreader->MailCount() << " mails in " 
+					<< mThreader->ContainerCount() << " containers)");
+}
+
+/*------------------------------------------------------------------------------*\
+	_UpdateThreadInfo( nodes)
+		-	fetches the thread-info for the mailrefs with the given nodes from
+			the threader and tells about every mailref whose info has changed
+		-	the list must be locked by the caller
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::_UpdateThreadInfo( const vector< ino_t>& nodes) {
+	node_ref nref;
+	nref.device = ThePrefs->MailboxVolume.Device();
+	for( uint32 i=0; i<nodes.size(); ++i) {
+		uint64 threadId;
+		uint16 depth;
+		if (!mThreader->ThreadInfo( nodes[i], threadId, depth))
+			continue;
+		nref.node = nodes[i];
+		BmRef<BmListModelItem> item( FindItemByKey( BM_REFKEY( nref)));
+		BmMailRef* ref = dynamic_cast< BmMailRef*>( item.Get());
+		if (!ref || (ref->ThreadId() == threadId && ref->ThreadDepth() == depth))
+			continue;
+		ref->ThreadInfo( threadId, depth);
+		mNeedsStore = true;
+		if (!Frozen())
+			TellModelItemUpdated( ref, BmMailRef::UPD_THREAD);
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	RemoveController()
 		-	deletes DataModel if it has no more controllers and if the 
@@ -618,3 +1309,164 @@ void BmMailRefList::ExecuteAction(BMessage* action) {
 		}
 	}
 }
+
+
+
+//******************************************************************************
+// #pragma mark -	BmMailRefListResidency
+//******************************************************************************
+BmMailRefListResidency* BmMailRefListResidency::theInstance = NULL;
+
+/*------------------------------------------------------------------------------*\
+	CreateInstance()
+		-	creator-func
+\*------------------------------------------------------------------------------*/
+BmMailRefListResidency* BmMailRefListResidency::CreateInstance() {
+	if (!theInstance)
+		theInstance = new BmMailRefListResidency();
+	return theInstance;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefListResidency()
+		-	standard c'tor
+\*------------------------------------------------------------------------------*/
+BmMailRefListResidency::BmMailRefListResidency()
+	:	mLocker( "MailRefListResidency")
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Touch( list)
+		-	marks the given list as most recently used and updates its footprint
+		-	afterwards, lists are evicted until the budget is met again
+\*------------------------------------------------------------------------------*/
+void BmMailRefListResidency::Touch( BmMailRefList* list) {
+	if (!list)
+		return;
+	// determine the footprint before locking, as this locks the list:
+	size_t footprint = list->MemoryFootprint();
+	{	// scope for lock
+		BmAutolockCheckGlobal lock( mLocker);
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( "MailRefListResidency::Touch(): Unable to get lock");
+		EntryList::iterator iter;
+		for( iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+			if (iter->refList == list) {
+				mEntries.erase( iter);
+				break;
+			}
+		}
+		mEntries.push_front( Entry( list, footprint));
+	}
+	_EnforceBudget();
+}
+
+/*------------------------------------------------------------------------------*\
+	Remove( list)
+		-	forgets about the given list (which is about to be deleted)
+\*------------------------------------------------------------------------------*/
+void BmMailRefListResidency::Remove( BmMailRefList* list) {
+	BmAutolockCheckGlobal lock( mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "MailRefListResidency::Remove(): Unable to get lock");
+	EntryList::iterator iter;
+	for( iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+		if (iter->refList == list) {
+			mEntries.erase( iter);
+			break;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	CollectLoadedLists( outLists)
+		-	appends all lists that are currently loaded to the given vector
+\*------------------------------------------------------------------------------*/
+void BmMailRefListResidency::CollectLoadedLists( 
+											vector< BmRef< BmListModel> >& outLists) {
+	BmAutolockCheckGlobal lock( mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			"MailRefListResidency::CollectLoadedLists(): Unable to get lock"
+		);
+	EntryList::const_iterator iter;
+	for( iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+		BmRef< BmMailRefList> refList( iter->refList.Get());
+		if (refList && refList->InitCheck() == B_OK)
+			outLists.push_back( refList.Get());
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_EnforceBudget()
+		-	evicts the least recently used lists until the memory used by all
+			loaded lists is within the budget (pref "MailRefListMemoryBudget", 
+			in MB)
+		-	only lists that nobody uses are evicted, the most recently used
+			list is always kept
+		-	N.B.: lists are only evicted if they are cached on disk, since 
+			otherwise reloading them would mean rescanning the folder
+\*------------------------------------------------------------------------------*/
+void BmMailRefListResidency::_EnforceBudget() {
+	int32 budgetMB = ThePrefs->GetInt( "MailRefListMemoryBudget", 64);
+	if (budgetMB <= 0 || !ThePrefs->GetBool( "CacheRefsOnDisk"))
+		return;
+	size_t budget = size_t(budgetMB) * 1024 * 1024;
+	vector< BmRef< BmMailRefList> > candidates;
+	size_t total = 0;
+	{	// scope for lock
+		BmAutolockCheckGlobal lock( mLocker);
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( 
+				"MailRefListResidency::_EnforceBudget(): Unable to get lock"
+			);
+		// drop all entries whose lists have been deleted or cleaned up:
+		EntryList::iterator iter = mEntries.begin();
+		while( iter != mEntries.end()) {
+			BmRef< BmMailRefList> refList( iter->refList.Get());
+			if (!refList || refList->InitCheck() != B_OK)
+				iter = mEntries.erase( iter);
+			else {
+				total += iter->footprint;
+				++iter;
+			}
+		}
+		if (total <= budget)
+			return;
+		// collect the coldest lists (except the one used most recently):
+		size_t excess = total - budget;
+		size_t collected = 0;
+		EntryList::reverse_iterator riter = mEntries.rbegin();
+		for( ; collected < excess && riter != mEntries.rend(); ++riter) {
+			if (&*riter == &mEntries.front())
+				break;
+			BmRef< BmMailRefList> refList( riter->refList.Get());
+			if (refList) {
+				candidates.push_back( refList);
+				collected += riter->footprint;
+			}
+		}
+	}
+	// now evict the candidates that are not in use (without holding our lock, 
+	// as the lists need to be locked for this):
+	for( uint32 i=0; i<candidates.size(); ++i) {
+		BmRef< BmMailRefList>& refList = candidates[i];
+		// the folder and we ourselves hold a reference, anybody else means 
+		// that the list is being used. The check is done while the list is 
+		// locked, such that nobody can start using the list before it has 
+		// been cleaned up:
+		BmAutolockCheckGlobal listLock( refList->ModelLocker());
+		if (!listLock.IsLocked())
+			continue;
+		if (refList->HasControllers() || refList->NeedsCacheUpdate()
+		|| refList->RefCount() > 2)
+			continue;
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("MailRefListResidency: evicting list-model <") 
+				  		<< refList->ModelName() << "> (total footprint is " 
+				  		<< total << " bytes)");
+		refList->StoreAndCleanup();
+		Remove( refList.Get());
+	}
+}
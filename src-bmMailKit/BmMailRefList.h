@@ -13,10 +13,33 @@
 
 #include <sys/stat.h>
 
+#include <list>
+#include <set>
+#include <vector>
+
+#include <Entry.h>
+
 #include "BmDataModel.h"
 
+class BFile;
 class BmMailFolder;
 class BmMailRef;
+class BmMailRefTrigramIndex;
+class BmMailThreader;
+
+using std::list;
+using std::set;
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	BmMailFileInfo
+		-	a mail-file that shall be added to a mailref-list
+\*------------------------------------------------------------------------------*/
+struct BmMailFileInfo {
+	entry_ref eref;
+	struct stat st;
+};
+typedef vector< BmMailFileInfo> BmMailFileInfoVect;
 
 /*------------------------------------------------------------------------------*\
 	BmMailRefList
@@ -28,6 +51,7 @@ class IMPEXPBMMAILKIT BmMailRefList : public BmListModel {
 	static const int16 nArchiveVersion;
 
 	static const char* const MSG_FILTER_ARCHIVE;
+	static const char* const MSG_CACHE_DATA_SIZE;
 
 public:
 
@@ -38,12 +62,19 @@ public:
 	// native methods:
 	BmRef<BmMailRef> AddMailRef( entry_ref& eref, struct stat& st);
 	BmRef<BmListModelItem> RemoveMailRef( const BmString& key);
+	void AddMailRefs( const BmMailFileInfoVect& files,
+							vector< BmRef<BmMailRef> >& outAddedRefs);
+	void RemoveMailRefs( const vector< BmString>& keys);
 	void UpdateMailRef( const BmString& key);
 	void MarkCacheAsDirty();
 	void StoreAndCleanup();
+	size_t MemoryFootprint() const;
+	bool FindFilterCandidates( const BmString& text, set< ino_t>& outNodes);
 
 	// overrides of list-model base:
 	bool Store();
+	void StoreOnShutdown();
+	void MarkCacheAsStale();
 	bool StartJob();
 	void RemoveController( BmController* controller);
 	bool IsJobCompleted() const;
@@ -54,6 +85,10 @@ public:
 	void RemoveItemFromList( BmListModelItem* item);
 	void SetItemValidity(  BmListModelItem* item, bool isValid);
 	void ExecuteAction( BMessage* action);
+	void Cleanup();
+	void TellModelItemUpdated( BmListModelItem* item, 
+										BmUpdFlags flags=UPD_ALL,
+										const BmString oldKey="");
 	
 	// getters:
 	inline bool NeedsCacheUpdate() const
@@ -64,18 +99,79 @@ protected:
 
 	// native methods:
 	void InitializeItems();
-	void InstantiateItemsFromStream( BDataIO* dataIO, BMessage* headerMsg = NULL);
+	void InstantiateItemsFromCache( BFile& cacheFile, const BmString& filename,
+											  BMessage* headerMsg);
 
 private:
 
+	// native methods:
+	void _BuildThreads( bool updateThreadInfo = true);
+	void _UpdateThreadInfo( const vector< ino_t>& nodes);
+
 	// the following members will NOT be archived at all:
 	BmWeakRef<BmMailFolder> mFolder;
 	bool mNeedsCacheUpdate;
 	BmString mSettingsFileName;
+	BmMailRefTrigramIndex* mTrigramIndex;
+							// built on demand by FindFilterCandidates()
+	BmMailThreader* mThreader;
+							// built when the list is read (the thread-info 
+							// itself is contained in the cache, too)
+	bool mThreadsNeedUpdate;
+							// set if mailrefs have been added or removed while
+							// there was no threader
+	size_t mRefsFootprint;
+							// memory occupied by the mailrefs (maintained
+							// by AddItemToList() and RemoveItemFromList())
 
 	// Hide copy-constructor and assignment:
 	BmMailRefList( const BmMailRefList&);
 	BmMailRefList operator=( const BmMailRefList&);
 };
 
+/*------------------------------------------------------------------------------*\
+	BmMailRefListResidency
+		-	keeps track of all mailref-lists that are loaded into memory (in 
+			least-recently-used order) together with their approximate memory
+			footprint
+		-	if the lists use more memory than the budget allows, the coldest
+			lists that are not in use are stored and cleaned up (they will be
+			reloaded from their cache-file when needed again)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailRefListResidency {
+
+	struct Entry {
+		Entry( BmMailRefList* l, size_t fp)
+			:	refList( l)
+			,	footprint( fp)						{}
+		BmWeakRef< BmMailRefList> refList;
+		size_t footprint;
+	};
+	typedef list< Entry> EntryList;
+
+public:
+	static BmMailRefListResidency* CreateInstance();
+
+	// native methods:
+	void Touch( BmMailRefList* list);
+	void Remove( BmMailRefList* list);
+	void CollectLoadedLists( vector< BmRef< BmListModel> >& outLists);
+
+	static BmMailRefListResidency* theInstance;
+
+private:
+	BmMailRefListResidency();
+	void _EnforceBudget();
+
+	EntryList mEntries;
+							// most recently used lists come first
+	BLocker mLocker;
+
+	// Hide copy-constructor and assignment:
+	BmMailRefListResidency( const BmMailRefListResidency&);
+	BmMailRefListResidency operator=( const BmMailRefListResidency&);
+};
+
+#define TheMailRefListResidency BmMailRefListResidency::theInstance
+
 #endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <algorithm>
+#include <ctype.h>
+#include <iterator>
+
+#include "BmMailRef.h"
+#include "BmMailRefTrigramIndex.h"
+
+using std::back_inserter;
+using std::set_intersection;
+using std::sort;
+using std::unique;
+
+/*------------------------------------------------------------------------------*\
+	ShorterPosting
+		-	orders postings by their length
+\*------------------------------------------------------------------------------*/
+struct ShorterPosting {
+	bool operator() ( const vector< uint32>* a, const vector< uint32>* b) const
+													{ return a->size() < b->size(); }
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMailRefTrigramIndex()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailRefTrigramIndex::BmMailRefTrigramIndex()
+	:	mDeadCount( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailRefTrigramIndex()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailRefTrigramIndex::~BmMailRefTrigramIndex() {
+}
+
+/*------------------------------------------------------------------------------*\
+	AddMailRef( ref)
+		-	adds the trigrams of the given mail-ref to the index
+\*------------------------------------------------------------------------------*/
+void BmMailRefTrigramIndex::AddMailRef( const BmMailRef* ref) {
+	if (!ref)
+		return;
+	ino_t node = ref->NodeRef().node;
+	if (mSlotForNode.find( node) != mSlotForNode.end())
+		return;
+	uint32 slot = mSlotNodes.size();
+	mSlotNodes.push_back( node);
+	mSlotIsDead.push_back( false);
+	mSlotForNode[node] = slot;
+
+	vector< uint32> trigrams;
+	_AddTrigrams( ref->Subject(), trigrams);
+	_AddTrigrams( ref->From(), trigrams);
+	_AddTrigrams( ref->To(), trigrams);
+	_AddTrigrams( ref->Cc(), trigrams);
+	sort( trigrams.begin(), trigrams.end());
+	trigrams.erase( unique( trigrams.begin(), trigrams.end()), trigrams.end());
+	for( uint32 i=0; i<trigrams.size(); ++i)
+		mPostings[trigrams[i]].push_back( slot);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMailRef( ref)
+		-	removes the given mail-ref from the index
+\*------------------------------------------------------------------------------*/
+void BmMailRefTrigramIndex::RemoveMailRef( const BmMailRef* ref) {
+	if (!ref)
+		return;
+	SlotMap::iterator iter = mSlotForNode.find( ref->NodeRef().node);
+	if (iter == mSlotForNode.end())
+		return;
+	mSlotIsDead[iter->second] = true;
+	mSlotForNode.erase( iter);
+	if (++mDeadCount > 256 && mDeadCount*2 > mSlotNodes.size())
+		_Compact();
+}
+
+/*------------------------------------------------------------------------------*\
+	UpdateMailRef( ref)
+		-	re-indexes the given mail-ref (after its subject or one of its
+			address-fields has changed)
+\*------------------------------------------------------------------------------*/
+void BmMailRefTrigramIndex::UpdateMailRef( const BmMailRef* ref) {
+	RemoveMailRef( ref);
+	AddMailRef( ref);
+}
+
+/*------------------------------------------------------------------------------*\
+	FindCandidates( text, outNodes)
+		-	fills outNodes with the nodes of all mail-refs that contain all the
+			trigrams of the given text (in any of their indexed fields)
+		-	returns false if the text is too short to be narrowed down by
+			the index, in which case every mail-ref is a candidate
+\*------------------------------------------------------------------------------*/
+bool BmMailRefTrigramIndex::FindCandidates( const BmString& text,
+														  set< ino_t>& outNodes) const {
+	outNodes.clear();
+	vector< uint32> trigrams;
+	_AddTrigrams( text, trigrams);
+	if (trigrams.empty())
+		return false;
+	sort( trigrams.begin(), trigrams.end());
+	trigrams.erase( unique( trigrams.begin(), trigrams.end()), trigrams.end());
+
+	// fetch all postings, starting with the shortest one, as that limits
+	// the candidates the most:
+	vector< const SlotVect*> postings;
+	for( uint32 i=0; i<trigrams.size(); ++i) {
+		PostingMap::const_iterator iter = mPostings.find( trigrams[i]);
+		if (iter == mPostings.end())
+			return true;
+		postings.push_back( &iter->second);
+	}
+	sort( postings.begin(), postings.end(), ShorterPosting());
+
+	SlotVect candidates( *postings[0]);
+	for( uint32 p=1; p<postings.size() && !candidates.empty(); ++p) {
+		SlotVect remaining;
+		set_intersection( candidates.begin(), candidates.end(),
+								postings[p]->begin(), postings[p]->end(),
+								back_inserter( remaining));
+		candidates.swap( remaining);
+	}
+	for( uint32 i=0; i<candidates.size(); ++i) {
+		if (!mSlotIsDead[candidates[i]])
+			outNodes.insert( mSlotNodes[candidates[i]]);
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	MemoryFootprint()
+		-	returns the (approximate) number of bytes occupied by the index
+\*------------------------------------------------------------------------------*/
+size_t BmMailRefTrigramIndex::MemoryFootprint() const {
+	const size_t nodeOverhead = 4 * sizeof( void*);
+	size_t footprint = sizeof( *this)
+		+ mSlotNodes.capacity() * sizeof( ino_t)
+		+ mSlotIsDead.capacity() / 8
+		+ mSlotForNode.size() * (sizeof( SlotMap::value_type) + nodeOverhead);
+	PostingMap::const_iterator iter;
+	for( iter = mPostings.begin(); iter != mPostings.end(); ++iter)
+		footprint += sizeof( PostingMap::value_type) + nodeOverhead
+						+ iter->second.capacity() * sizeof( uint32);
+	return footprint;
+}
+
+/*------------------------------------------------------------------------------*\
+	_AddTrigrams( field, outTrigrams)
+		-	appends all trigrams of the given field to outTrigrams
+		-	case is folded just like strcasestr() (which is used by
+			BmString::IFindFirst()) does it, so the index never misses a mail
+			that matches
+\*------------------------------------------------------------------------------*/
+void BmMailRefTrigramIndex::_AddTrigrams( const BmString& field,
+														vector< uint32>& outTrigrams) const {
+	const unsigned char* str
+		= reinterpret_cast< const unsigned char*>( field.String());
+	int32 len = field.Length();
+	for( int32 i=0; i+nTrigramLen <= len; ++i) {
+		outTrigrams.push_back(
+			(uint32)tolower( str[i]) << 16
+				| (uint32)tolower( str[i+1]) << 8
+				| (uint32)tolower( str[i+2])
+		);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_Compact()
+		-	drops all dead slots from the postings and renumbers the remaining
+			slots
+\*------------------------------------------------------------------------------*/
+void BmMailRefTrigramIndex::_Compact() {
+	const uint32 nNoSlot = 0xFFFFFFFF;
+	SlotVect newSlotFor( mSlotNodes.size(), nNoSlot);
+	vector< ino_t> newSlotNodes;
+	newSlotNodes.reserve( mSlotForNode.size());
+	for( uint32 i=0; i<mSlotNodes.size(); ++i) {
+		if (!mSlotIsDead[i]) {
+			newSlotFor[i] = newSlotNodes.size();
+			newSlotNodes.push_back( mSlotNodes[i]);
+		}
+	}
+	PostingMap::iterator iter = mPostings.begin();
+	while( iter != mPostings.end()) {
+		SlotVect& slots = iter->second;
+		uint32 count = 0;
+		for( uint32 i=0; i<slots.size(); ++i) {
+			if (newSlotFor[slots[i]] != nNoSlot)
+				slots[count++] = newSlotFor[slots[i]];
+		}
+		if (count) {
+			slots.resize( count);
+			++iter;
+		} else
+			mPostings.erase( iter++);
+	}
+	mSlotNodes.swap( newSlotNodes);
+	mSlotIsDead.assign( mSlotNodes.size(), false);
+	for( SlotMap::iterator s = mSlotForNode.begin(); s != mSlotForNode.end(); ++s)
+		s->second = newSlotFor[s->second];
+	mDeadCount = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailRefTrigramIndex_h
+#define _BmMailRefTrigramIndex_h
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <Node.h>
+
+#include "BmMailKit.h"
+
+#include "BmString.h"
+
+using std::map;
+using std::set;
+using std::vector;
+
+class BmMailRef;
+/*------------------------------------------------------------------------------*\
+	BmMailRefTrigramIndex
+		-	maps every trigram (three consecutive, case-folded bytes) of the
+			subject and the address-fields (from, to & cc) of the mail-refs of
+			one folder to the mail-refs containing it
+		-	a mail-ref can only contain a text if it contains all the text's
+			trigrams, so the index yields a (usually very small) set of
+			candidates, which then have to be verified by a real substring
+			search
+		-	every mail-ref gets a slot that is never reused, such that the
+			postings stay sorted; removed mail-refs just mark their slot as
+			dead, the postings are cleaned up once half of the slots are dead
+		-	the index does no locking itself, it is protected by the lock of
+			the mailref-list that owns it
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailRefTrigramIndex {
+
+	typedef vector< uint32> SlotVect;
+	typedef map< uint32, SlotVect> PostingMap;
+	typedef map< ino_t, uint32> SlotMap;
+
+public:
+	BmMailRefTrigramIndex();
+	~BmMailRefTrigramIndex();
+
+	// native methods:
+	void AddMailRef( const BmMailRef* ref);
+	void RemoveMailRef( const BmMailRef* ref);
+	void UpdateMailRef( const BmMailRef* ref);
+	bool FindCandidates( const BmString& text, set< ino_t>& outNodes) const;
+	size_t MemoryFootprint() const;
+
+	static const int32 nTrigramLen = 3;
+
+private:
+	void _AddTrigrams( const BmString& field,
+							 vector< uint32>& outTrigrams) const;
+	void _Compact();
+
+	PostingMap mPostings;
+	vector< ino_t> mSlotNodes;
+							// node of the mail-ref in every slot
+	vector< bool> mSlotIsDead;
+	SlotMap mSlotForNode;
+							// only contains live slots
+	uint32 mDeadCount;
+
+	// Hide copy-constructor and assignment:
+	BmMailRefTrigramIndex( const BmMailRefTrigramIndex&);
+	BmMailRefTrigramIndex operator=( const BmMailRefTrigramIndex&);
+};
+
+#endif
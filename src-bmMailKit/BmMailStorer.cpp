@@ -0,0 +1,209 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <unistd.h>
+
+#include <Autolock.h>
+
+#include "BmLogHandler.h"
+#include "BmMail.h"
+#include "BmMailStorer.h"
+
+/*------------------------------------------------------------------------------*\
+	Item( mail, uid)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailStorer::Item::Item( BmMail* m, const BmString& u)
+	:	mail( m)
+	,	uid( u)
+	,	size( m ? m->RawText().Length() : 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	BmMailStorer( name)
+		-	c'tor, starts the storing thread
+		-	if the thread can't be started, mails are stored synchronously
+\*------------------------------------------------------------------------------*/
+BmMailStorer::BmMailStorer( const BmString& name)
+	:	mUncommittedCount( 0)
+	,	mUncommittedSize( 0)
+	,	mLocker( "MailStorer")
+	,	mWorkSem( create_sem( 0, "bm_store_work"))
+	,	mCommitSem( create_sem( 0, "bm_store_commit"))
+	,	mThreadId( -1)
+	,	mShouldRun( true)
+	,	mHasFailed( false)
+{
+	if (mWorkSem < 0 || mCommitSem < 0)
+		return;
+	BmString tname = BmString("MailStorer_") << name;
+	mThreadId = spawn_thread( &_ThreadEntry, tname.String(),
+									  B_NORMAL_PRIORITY, this);
+	if (mThreadId < 0)
+		return;
+	resume_thread( mThreadId);
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailStorer()
+		-	d'tor, stores all mails that are still waiting and stops the thread
+\*------------------------------------------------------------------------------*/
+BmMailStorer::~BmMailStorer() {
+	if (mThreadId >= 0) {
+		Flush();
+		mShouldRun = false;
+		release_sem( mWorkSem);
+		status_t exitVal;
+		wait_for_thread( mThreadId, &exitVal);
+	}
+	if (mWorkSem >= 0)
+		delete_sem( mWorkSem);
+	if (mCommitSem >= 0)
+		delete_sem( mCommitSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( mail, uid)
+		-	queues the given mail for being stored, the given uid will be
+			reported by FetchCommittedUIDs() once the mail is safely on disk
+		-	if no mail is given (because it has been skipped), there's nothing 
+			to be stored, but the uid is still reported in order, i.e. not
+			before all mails that have been added earlier are on disk
+		-	blocks while too much mail-data is waiting to be stored
+		-	returns false if storing any mail has failed
+\*------------------------------------------------------------------------------*/
+bool BmMailStorer::Add( BmMail* mail, const BmString& uid) {
+	if (mThreadId < 0) {
+		// no thread, we store right away:
+		if (mail && !mail->Store())
+			mHasFailed = true;
+		else {
+			BAutolock lock( mLocker);
+			mCommittedUIDs.push_back( uid);
+		}
+		return !mHasFailed;
+	}
+	{	// scope for lock
+		BAutolock lock( mLocker);
+		mQueue.push_back( Item( mail, uid));
+		mUncommittedCount++;
+		mUncommittedSize += mQueue.back().size;
+	}
+	release_sem( mWorkSem);
+	while( !mHasFailed) {
+		{	// scope for lock
+			BAutolock lock( mLocker);
+			if (mUncommittedSize <= nMaxPendingSize
+			|| mUncommittedCount <= 1)
+				break;
+		}
+		_WaitForCommit();
+	}
+	return !mHasFailed;
+}
+
+/*------------------------------------------------------------------------------*\
+	Flush()
+		-	waits until all queued mails have been committed
+		-	returns false if storing any mail has failed
+\*------------------------------------------------------------------------------*/
+bool BmMailStorer::Flush() {
+	while( mThreadId >= 0) {
+		{	// scope for lock
+			BAutolock lock( mLocker);
+			if (!mUncommittedCount)
+				break;
+		}
+		_WaitForCommit();
+	}
+	return !mHasFailed;
+}
+
+/*------------------------------------------------------------------------------*\
+	FetchCommittedUIDs( outUIDs)
+		-	hands out the UIDs of all mails that have been committed since the
+			last call
+\*------------------------------------------------------------------------------*/
+void BmMailStorer::FetchCommittedUIDs( vector< BmString>& outUIDs) {
+	BAutolock lock( mLocker);
+	outUIDs.clear();
+	outUIDs.swap( mCommittedUIDs);
+}
+
+/*------------------------------------------------------------------------------*\
+	_WaitForCommit()
+		-	blocks until the next group has been committed
+\*------------------------------------------------------------------------------*/
+void BmMailStorer::_WaitForCommit() {
+	while( acquire_sem( mCommitSem) == B_INTERRUPTED)
+		;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThreadEntry( data)
+		-
+\*------------------------------------------------------------------------------*/
+int32 BmMailStorer::_ThreadEntry( void* data) {
+	BmMailStorer* storer = static_cast< BmMailStorer*>( data);
+	if (storer)
+		storer->_Loop();
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Loop()
+		-	main loop of the storing thread: takes all waiting mails (up to
+			the maximum group-size), stores them without syncing and then
+			commits the whole group with a single sync
+\*------------------------------------------------------------------------------*/
+void BmMailStorer::_Loop() {
+	while( 1) {
+		status_t err = acquire_sem( mWorkSem);
+		if (err == B_INTERRUPTED)
+			continue;
+		if (err != B_OK)
+			return;
+		ItemQueue group;
+		{	// scope for lock
+			BAutolock lock( mLocker);
+			while( !mQueue.empty() && (int32)group.size() < nMaxGroupSize) {
+				group.push_back( mQueue.front());
+				mQueue.pop_front();
+			}
+		}
+		if (group.empty()) {
+			// the semaphore has been released for mails that were part of
+			// an earlier group (or we should quit):
+			if (!mShouldRun)
+				return;
+			continue;
+		}
+		vector< BmString> storedUIDs;
+		int32 groupSize = 0;
+		for( uint32 i=0; i<group.size(); ++i) {
+			groupSize += group[i].size;
+			if (!group[i].mail || group[i].mail->Store( false))
+				storedUIDs.push_back( group[i].uid);
+			else
+				mHasFailed = true;
+		}
+		sync();
+		BM_LOG2( BM_LogRecv,
+					BmString("MailStorer: committed group of ") << group.size()
+						<< " mails (" << groupSize << " bytes)");
+		{	// scope for lock
+			BAutolock lock( mLocker);
+			mCommittedUIDs.insert( mCommittedUIDs.end(),
+										  storedUIDs.begin(), storedUIDs.end());
+			mUncommittedCount -= group.size();
+			mUncommittedSize -= groupSize;
+		}
+		release_sem( mCommitSem);
+	}
+}
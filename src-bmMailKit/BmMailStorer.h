@@ -0,0 +1,94 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailStorer_h
+#define _BmMailStorer_h
+
+#include <deque>
+#include <vector>
+
+#include <Locker.h>
+#include <OS.h>
+
+#include "BmMailKit.h"
+
+#include "BmRefManager.h"
+#include "BmString.h"
+
+using std::deque;
+using std::vector;
+
+class BmMail;
+
+/*------------------------------------------------------------------------------*\
+	BmMailStorer
+		-	stores received mails from within a thread of its own, such that
+			the receiving job can go on downloading in the meantime
+		-	all mails that are waiting when the thread gets to work are stored
+			as one group: the mail-files are written without being synced
+			individually, the whole group is synced with a single call to
+			sync() afterwards (group commit)
+		-	the receiving job should only consider a mail as received (mark
+			its UID as downloaded) once the mail's group has been committed,
+			which is what FetchCommittedUIDs() tells about
+		-	if too much mail-data is waiting to be stored, Add() blocks until
+			the next group has been committed
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailStorer {
+
+	struct Item {
+		Item( BmMail* m, const BmString& u);
+		BmRef< BmMail> mail;
+		BmString uid;
+		int32 size;
+	};
+	typedef deque< Item> ItemQueue;
+
+public:
+	BmMailStorer( const BmString& name);
+	~BmMailStorer();
+
+	// native methods:
+	bool Add( BmMail* mail, const BmString& uid);
+	bool Flush();
+	void FetchCommittedUIDs( vector< BmString>& outUIDs);
+
+	// getters:
+	inline bool HasFailed() const			{ return mHasFailed; }
+
+	static const int32 nMaxGroupSize = 100;
+	static const int32 nMaxPendingSize = 16*1024*1024;
+
+private:
+	void _WaitForCommit();
+	void _Loop();
+	//
+	static int32 _ThreadEntry( void* data);
+
+	ItemQueue mQueue;
+							// mails waiting to be stored
+	vector< BmString> mCommittedUIDs;
+							// UIDs of the mails that have been committed since
+							// the last call to FetchCommittedUIDs()
+	int32 mUncommittedCount;
+	int32 mUncommittedSize;
+							// number & size of mails queued or being stored
+	BLocker mLocker;
+							// protects all of the above
+	sem_id mWorkSem;
+	sem_id mCommitSem;
+	thread_id mThreadId;
+	volatile bool mShouldRun;
+	volatile bool mHasFailed;
+
+	// Hide copy-constructor and assignment:
+	BmMailStorer( const BmMailStorer&);
+	BmMailStorer operator=( const BmMailStorer&);
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "BmMailThreader.h"
+
+using std::sort;
+using std::unique;
+
+/*------------------------------------------------------------------------------*\
+	NextID( pos, end, outID)
+		-	fetches the next message-id (enclosed in angle brackets) from the
+			given range, pos is advanced behind that id
+		-	returns false if there is no further id
+\*------------------------------------------------------------------------------*/
+static bool NextID( const char*& pos, const char* end, BmString& outID) {
+	while( pos < end) {
+		const char* start = (const char*)memchr( pos, '<', end-pos);
+		if (!start)
+			break;
+		const char* stop = (const char*)memchr( start, '>', end-start);
+		if (!stop)
+			break;
+		pos = stop+1;
+		if (stop-start > 1) {
+			outID.SetTo( start, pos-start);
+			return true;
+		}
+	}
+	pos = end;
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmMailThreader()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailThreader::BmMailThreader() {
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailThreader()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailThreader::~BmMailThreader() {
+	ContainerMap::iterator iter;
+	for( iter = mContainers.begin(); iter != mContainers.end(); ++iter)
+		delete iter->second;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddMail( node, messageID, references, outAffected)
+		-	adds the mail with the given node to the threads, references must
+			be normalized (see NormalizedReferences())
+		-	a mail without a message-id (or with an id that is already used by
+			another mail of this folder) gets an id derived from its node
+		-	the nodes of all mails whose thread-info may have changed are
+			appended to outAffected
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::AddMail( ino_t node, const BmString& messageID,
+										const BmString& references,
+										vector< ino_t>& outAffected) {
+	if (mNodeMap.find( node) != mNodeMap.end())
+		RemoveMail( node, outAffected);
+
+	Container* container = NULL;
+	if (messageID.Length()) {
+		container = _ContainerFor( HashID( messageID.String(),
+													  messageID.Length()));
+		if (container->node)
+			container = NULL;
+	}
+	if (!container) {
+		BmString nodeID = BmString("<") << (int64)node << "@node.beam>";
+		container = _ContainerFor( HashID( nodeID.String(), nodeID.Length()));
+	}
+	container->node = node;
+	mNodeMap[node] = container;
+
+	// link the references to each other (unless they are linked already),
+	// avoiding any loops:
+	vector< Container*> moved;
+	vector< uint64> referenced;
+	moved.push_back( container);
+	Container* prev = NULL;
+	BmString id;
+	const char* pos = references.String();
+	const char* end = pos + references.Length();
+	while( NextID( pos, end, id)) {
+		Container* refContainer = _ContainerFor( HashID( id.String(),
+																		 id.Length()));
+		if (refContainer == container)
+			continue;
+		if (prev && !refContainer->parent
+		&& !_IsAncestorOrSelf( refContainer, prev)) {
+			_SetParent( refContainer, prev);
+			moved.push_back( refContainer);
+		}
+		referenced.push_back( refContainer->id);
+		prev = refContainer;
+	}
+	// the last reference is the parent of this mail (the mail knows better
+	// than any other mail that just refers to it):
+	Container* oldParent = container->parent;
+	if (prev && prev != oldParent && !_IsAncestorOrSelf( container, prev)) {
+		_SetParent( container, prev);
+		if (oldParent)
+			referenced.push_back( oldParent->id);
+	}
+
+	for( uint32 i=0; i<moved.size(); ++i)
+		_CollectNodes( moved[i], outAffected);
+	sort( outAffected.begin(), outAffected.end());
+	outAffected.erase( unique( outAffected.begin(), outAffected.end()),
+							 outAffected.end());
+	// placeholders that could not be linked are of no use (N.B.: dropping
+	// one placeholder may drop others, so we look them up again):
+	for( uint32 i=0; i<referenced.size(); ++i) {
+		ContainerMap::iterator iter = mContainers.find( referenced[i]);
+		if (iter != mContainers.end())
+			_DropIfUnused( iter->second);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMail( node, outAffected)
+		-	removes the mail with the given node from the threads, its container
+			stays as a placeholder if any other mail refers to it
+		-	the links that have been established by the references of this
+			mail are kept
+		-	the nodes of all mails whose thread-info may have changed are
+			appended to outAffected
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::RemoveMail( ino_t node, vector< ino_t>& outAffected) {
+	NodeMap::iterator iter = mNodeMap.find( node);
+	if (iter == mNodeMap.end())
+		return;
+	Container* container = iter->second;
+	mNodeMap.erase( iter);
+	container->node = 0;
+	_CollectNodes( container, outAffected);
+	_DropIfUnused( container);
+}
+
+/*------------------------------------------------------------------------------*\
+	ThreadInfo( node, outThreadId, outDepth)
+		-	determines the thread of the mail with the given node and its depth
+			within that thread (the number of mails above it, placeholders do
+			not count)
+		-	returns false if the mail is unknown
+\*------------------------------------------------------------------------------*/
+bool BmMailThreader::ThreadInfo( ino_t node, uint64& outThreadId,
+											uint16& outDepth) const {
+	NodeMap::const_iterator iter = mNodeMap.find( node);
+	if (iter == mNodeMap.end())
+		return false;
+	const Container* container = iter->second;
+	uint32 depth = 0;
+	while( container->parent) {
+		container = container->parent;
+		if (container->node)
+			depth++;
+	}
+	outThreadId = container->id;
+	outDepth = depth < nMaxDepth ? depth : nMaxDepth;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	MemoryFootprint()
+		-	returns the (approximate) number of bytes occupied by the threader
+\*------------------------------------------------------------------------------*/
+size_t BmMailThreader::MemoryFootprint() const {
+	const size_t nodeOverhead = 4 * sizeof( void*);
+	return sizeof( *this)
+		+ mContainers.size() * (sizeof( ContainerMap::value_type)
+										+ sizeof( Container) + 2*nodeOverhead)
+		+ mNodeMap.size() * (sizeof( NodeMap::value_type) + nodeOverhead);
+}
+
+/*------------------------------------------------------------------------------*\
+	NormalizedMessageID( messageID)
+		-	returns the given Message-ID-field without any surrounding
+			whitespace or comments
+\*------------------------------------------------------------------------------*/
+BmString BmMailThreader::NormalizedMessageID( const BmString& messageID) {
+	BmString id;
+	const char* pos = messageID.String();
+	if (NextID( pos, pos + messageID.Length(), id))
+		return id;
+	id = messageID;
+	return id.Trim();
+}
+
+/*------------------------------------------------------------------------------*\
+	NormalizedReferences( references, inReplyTo)
+		-	returns the message-ids of the given References-field, followed by
+			the (first) id of the given In-Reply-To-field, if that is not the
+			last reference already
+		-	only the first and the last few ids are kept, as the ids in
+			between do not matter much for threading
+\*------------------------------------------------------------------------------*/
+BmString BmMailThreader::NormalizedReferences( const BmString& references,
+															  const BmString& inReplyTo) {
+	vector< BmString> ids;
+	BmString id;
+	const char* pos = references.String();
+	const char* end = pos + references.Length();
+	while( NextID( pos, end, id))
+		ids.push_back( id);
+	pos = inReplyTo.String();
+	end = pos + inReplyTo.Length();
+	if (NextID( pos, end, id) && (ids.empty() || ids.back() != id))
+		ids.push_back( id);
+
+	BmString result;
+	uint32 count = ids.size();
+	for( uint32 i=0; i<count; ++i) {
+		if (i > 0 && i+nMaxReferences <= count)
+			continue;
+		if (result.Length())
+			result << " ";
+		result << ids[i];
+	}
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	ExtractIDsFromHeader( header, length, outMessageID, outReferences)
+		-	fetches the message-id and the (normalized) references from the
+			given mail-header (which may contain the start of the body, too)
+		-	this is used for mails that lack the corresponding attributes
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::ExtractIDsFromHeader( const char* header, int32 length,
+														 BmString& outMessageID,
+														 BmString& outReferences) {
+	BmString references, inReplyTo;
+	outMessageID.Truncate( 0);
+	const char* pos = header;
+	const char* end = header + length;
+	while( pos < end && *pos != '\r' && *pos != '\n') {
+		// find the end of this field (including any folded lines):
+		const char* fieldEnd = pos;
+		do {
+			const char* nl = (const char*)memchr( fieldEnd, '\n', end-fieldEnd);
+			fieldEnd = nl ? nl+1 : end;
+		} while( fieldEnd < end && (*fieldEnd == ' ' || *fieldEnd == '\t'));
+
+		const char* colon = (const char*)memchr( pos, ':', fieldEnd-pos);
+		if (colon) {
+			int32 nameLen = colon-pos;
+			BmString* value = NULL;
+			if (nameLen == 10 && !strncasecmp( pos, "Message-ID", 10))
+				value = &outMessageID;
+			else if (nameLen == 10 && !strncasecmp( pos, "References", 10))
+				value = &references;
+			else if (nameLen == 11 && !strncasecmp( pos, "In-Reply-To", 11))
+				value = &inReplyTo;
+			if (value)
+				value->SetTo( colon+1, fieldEnd-colon-1);
+		}
+		pos = fieldEnd;
+	}
+	outMessageID = NormalizedMessageID( outMessageID);
+	outReferences = NormalizedReferences( references, inReplyTo);
+}
+
+/*------------------------------------------------------------------------------*\
+	HashID( id, length)
+		-	returns the (64-bit FNV-1a) hash of the given message-id
+\*------------------------------------------------------------------------------*/
+uint64 BmMailThreader::HashID( const char* id, int32 length) {
+	uint64 hash = 14695981039346656037ULL;
+	for( int32 i=0; i<length; ++i) {
+		hash ^= (unsigned char)id[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ContainerFor( id)
+		-	returns the container for the given (hashed) message-id, creating
+			it if necessary
+\*------------------------------------------------------------------------------*/
+BmMailThreader::Container* BmMailThreader::_ContainerFor( uint64 id) {
+	ContainerMap::iterator iter = mContainers.find( id);
+	if (iter != mContainers.end())
+		return iter->second;
+	Container* container = new Container( id);
+	mContainers[id] = container;
+	return container;
+}
+
+/*------------------------------------------------------------------------------*\
+	_IsAncestorOrSelf( c, of)
+		-	returns whether c is the given container or one of its ancestors
+\*------------------------------------------------------------------------------*/
+bool BmMailThreader::_IsAncestorOrSelf( const Container* c,
+													 const Container* of) const {
+	for( ; of; of = of->parent) {
+		if (of == c)
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	_SetParent( c, parent)
+		-	makes c a child of the given parent (the caller has to make sure
+			that this does not introduce a loop)
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::_SetParent( Container* c, Container* parent) {
+	_Unlink( c);
+	if (parent) {
+		c->parent = parent;
+		c->nextSibling = parent->firstChild;
+		parent->firstChild = c;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_Unlink( c)
+		-	removes c from the children of its parent
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::_Unlink( Container* c) {
+	if (!c->parent)
+		return;
+	Container** link = &c->parent->firstChild;
+	while( *link && *link != c)
+		link = &(*link)->nextSibling;
+	if (*link)
+		*link = c->nextSibling;
+	c->parent = NULL;
+	c->nextSibling = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	_CollectNodes( c, outNodes)
+		-	appends the nodes of all mails in the subtree of c to outNodes
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::_CollectNodes( const Container* c,
+												vector< ino_t>& outNodes) const {
+	vector< const Container*> stack;
+	stack.push_back( c);
+	while( !stack.empty()) {
+		const Container* current = stack.back();
+		stack.pop_back();
+		if (current->node)
+			outNodes.push_back( current->node);
+		for( const Container* child = current->firstChild; child;
+			  child = child->nextSibling)
+			stack.push_back( child);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_DropIfUnused( c)
+		-	deletes c if it is a placeholder without any children, the same is
+			then done for its parent
+\*------------------------------------------------------------------------------*/
+void BmMailThreader::_DropIfUnused( Container* c) {
+	while( c && !c->node && !c->firstChild) {
+		Container* parent = c->parent;
+		_Unlink( c);
+		mContainers.erase( c->id);
+		delete c;
+		c = parent;
+	}
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailThreader_h
+#define _BmMailThreader_h
+
+#include <map>
+#include <vector>
+
+#include <Node.h>
+
+#include "BmMailKit.h"
+
+#include "BmString.h"
+
+using std::map;
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	BmMailThreader
+		-	groups the mails of one folder into conversation threads, following
+			the algorithm described by Jamie Zawinski
+			(http://www.jwz.org/doc/threading.html)
+		-	every message-id (seen as id of a mail or within the references of
+			a mail) gets a container, containers are linked to their parent
+			according to the references of the mails, containers without a
+			mail are placeholders for mails that are not in this folder
+		-	contrary to the original algorithm, the threads are maintained
+			incrementally: adding or removing a mail only touches the
+			containers of that mail and its references and reports the mails
+			whose thread-info may have changed
+		-	message-ids are kept as 64-bit hashes only, the id of a thread is
+			the hash of the message-id at the thread's root
+		-	the threader does no locking itself, it is protected by the lock of
+			the mailref-list that owns it
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailThreader {
+
+	struct Container {
+		Container( uint64 i)
+			:	id( i)
+			,	node( 0)
+			,	parent( NULL)
+			,	firstChild( NULL)
+			,	nextSibling( NULL)					{}
+		uint64 id;
+		ino_t node;
+							// 0 for a placeholder
+		Container* parent;
+		Container* firstChild;
+		Container* nextSibling;
+	};
+	typedef map< uint64, Container*> ContainerMap;
+	typedef map< ino_t, Container*> NodeMap;
+
+public:
+	BmMailThreader();
+	~BmMailThreader();
+
+	// native methods:
+	void AddMail( ino_t node, const BmString& messageID,
+					  const BmString& references, vector< ino_t>& outAffected);
+	void RemoveMail( ino_t node, vector< ino_t>& outAffected);
+	bool ThreadInfo( ino_t node, uint64& outThreadId,
+						  uint16& outDepth) const;
+	size_t MemoryFootprint() const;
+
+	// getters:
+	inline int32 MailCount() const		{ return mNodeMap.size(); }
+	inline int32 ContainerCount() const	{ return mContainers.size(); }
+
+	// static functions:
+	static BmString NormalizedMessageID( const BmString& messageID);
+	static BmString NormalizedReferences( const BmString& references,
+													  const BmString& inReplyTo);
+	static void ExtractIDsFromHeader( const char* header, int32 length,
+												 BmString& outMessageID,
+												 BmString& outReferences);
+	static uint64 HashID( const char* id, int32 length);
+
+	static const int32 nMaxReferences = 16;
+	static const uint16 nMaxDepth = 0xFFFF;
+
+private:
+	Container* _ContainerFor( uint64 id);
+	bool _IsAncestorOrSelf( const Container* c, const Container* of) const;
+	void _SetParent( Container* c, Container* parent);
+	void _Unlink( Container* c);
+	void _CollectNodes( const Container* c, vector< ino_t>& outNodes) const;
+	void _DropIfUnused( Container* c);
+
+	ContainerMap mContainers;
+	NodeMap mNodeMap;
+
+	// Hide copy-constructor and assignment:
+	BmMailThreader( const BmMailThreader&);
+	BmMailThreader operator=( const BmMailThreader&);
+};
+
+#endif
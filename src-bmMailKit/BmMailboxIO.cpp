@@ -0,0 +1,806 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "BmMailboxIO.h"
+
+// the line that separates mails in an mbox:
+static const char* const nFromLine = "From ";
+static const size_t nFromLineLen = 5;
+
+/*------------------------------------------------------------------------------*\
+	IsFromLine( line, start)
+		-	returns whether the given line (starting at the given position)
+			is an mbox-separator
+\*------------------------------------------------------------------------------*/
+static inline bool IsFromLine( const string& line, size_t start = 0)
+{
+	return line.compare( start, nFromLineLen, nFromLine) == 0;
+}
+
+static const char* const nWeekdays[] = {
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", NULL
+};
+static const char* const nMonths[] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec", NULL
+};
+
+/*------------------------------------------------------------------------------*\
+	NameIndex( names, str)
+		-	returns the index of the (three-letter) name the given string
+			starts with, or -1 if there is none
+\*------------------------------------------------------------------------------*/
+static int NameIndex( const char* const names[], const char* str)
+{
+	for( int i=0; names[i]; ++i) {
+		if (!strncasecmp( str, names[i], 3))
+			return i;
+	}
+	return -1;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsCtimeDate( str)
+		-	returns whether the given string starts with a date in the format
+			used by ctime(), i.e. "Www Mmm dd hh:mm", the rest (seconds,
+			timezone and year) is not checked
+\*------------------------------------------------------------------------------*/
+static bool IsCtimeDate( const char* str)
+{
+	if (NameIndex( nWeekdays, str) < 0 || str[3] != ' ')
+		return false;
+	str += 4;
+	if (NameIndex( nMonths, str) < 0 || str[3] != ' ')
+		return false;
+	str += 4;
+	while( *str == ' ')
+		str++;
+	if (!isdigit( str[0]))
+		return false;
+	str += isdigit( str[1]) ? 2 : 1;
+	return str[0] == ' ' && isdigit( str[1]) && isdigit( str[2])
+			&& str[3] == ':' && isdigit( str[4]) && isdigit( str[5]);
+}
+
+/*------------------------------------------------------------------------------*\
+	IsSeparatorLine( line)
+		-	returns whether the given line has the format of an mbox-separator,
+			i.e. "From " followed by the sender and a date in ctime()-format
+		-	as the sender may contain blanks (and some mailers even put a
+			timezone in front of the year), we just look for the date
+\*------------------------------------------------------------------------------*/
+static bool IsSeparatorLine( const string& line)
+{
+	if (!IsFromLine( line))
+		return false;
+	for( size_t pos = nFromLineLen-1; pos != string::npos; 
+		  pos = line.find( ' ', pos+1)) {
+		if (IsCtimeDate( line.c_str()+pos+1))
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	DaysFromCivil( year, month, day)
+		-	returns the number of days between 1970-01-01 and the given date
+			(of the proleptic gregorian calendar, month is 1-12)
+\*------------------------------------------------------------------------------*/
+static int64_t DaysFromCivil( int year, int month, int day)
+{
+	year -= month <= 2;
+	int64_t era = (year >= 0 ? year : year-399) / 400;
+	int64_t yearOfEra = year - era * 400;
+	int64_t dayOfYear = (153 * (month > 2 ? month-3 : month+9) + 2) / 5 + day-1;
+	int64_t dayOfEra 
+		= yearOfEra * 365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsQuotedFromLine( line)
+		-	returns whether the given line is a separator that has been quoted
+			with any number of '>'
+\*------------------------------------------------------------------------------*/
+static inline bool IsQuotedFromLine( const string& line)
+{
+	if (line.empty() || line[0] != '>')
+		return false;
+	size_t pos = line.find_first_not_of( '>');
+	return pos != string::npos && IsFromLine( line, pos);
+}
+
+//******************************************************************************
+// #pragma mark -	BmMailboxIO
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	ConvertToCRLF( text, outText)
+		-	converts all linebreaks of the given text into CRLF, which is
+			what Beam uses for its mail-files
+\*------------------------------------------------------------------------------*/
+void BmMailboxIO::ConvertToCRLF( const string& text, string& outText)
+{
+	outText.erase();
+	outText.reserve( text.size() + text.size()/32);
+	size_t len = text.size();
+	for( size_t i=0; i<len; ++i) {
+		char c = text[i];
+		if (c == '\r') {
+			if (i+1 < len && text[i+1] == '\n')
+				++i;
+			outText.append( "\r\n", 2);
+		} else if (c == '\n')
+			outText.append( "\r\n", 2);
+		else
+			outText += c;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvertToLF( text, outText)
+		-	converts all linebreaks of the given text into LF, which is
+			what mbox-files and Maildirs use
+\*------------------------------------------------------------------------------*/
+void BmMailboxIO::ConvertToLF( const string& text, string& outText)
+{
+	outText.erase();
+	outText.reserve( text.size());
+	size_t len = text.size();
+	for( size_t i=0; i<len; ++i) {
+		char c = text[i];
+		if (c == '\r') {
+			if (i+1 < len && text[i+1] == '\n')
+				++i;
+			outText += '\n';
+		} else
+			outText += c;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	HeaderLength( text)
+		-	returns the length of the header of the given mail-text, including
+			the linebreak of the last header-line (but not the empty line)
+\*------------------------------------------------------------------------------*/
+int32_t BmMailboxIO::HeaderLength( const string& text)
+{
+	size_t pos = 0;
+	while( pos < text.size()) {
+		if (text[pos] == '\n')
+			return pos;
+		if (text[pos] == '\r' && pos+1 < text.size() && text[pos+1] == '\n')
+			return pos;
+		size_t eol = text.find( '\n', pos);
+		if (eol == string::npos)
+			break;
+		pos = eol+1;
+	}
+	return text.size();
+}
+
+/*------------------------------------------------------------------------------*\
+	HeaderField( text, fieldName)
+		-	returns the (unfolded) value of the first header-field with the
+			given name, or an empty string if the mail has no such field
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::HeaderField( const string& text, const char* fieldName)
+{
+	size_t nameLen = strlen( fieldName);
+	size_t headerLen = HeaderLength( text);
+	size_t pos = 0;
+	while( pos < headerLen) {
+		size_t eol = text.find( '\n', pos);
+		if (eol == string::npos || eol > headerLen)
+			eol = headerLen;
+		if (eol - pos > nameLen && text[pos+nameLen] == ':'
+		&& !strncasecmp( text.c_str()+pos, fieldName, nameLen)) {
+			string value;
+			size_t start = pos+nameLen+1;
+			while( 1) {
+				value.append( text, start, eol-start);
+				// continuation lines start with whitespace:
+				if (eol+1 >= headerLen
+				|| (text[eol+1] != ' ' && text[eol+1] != '\t'))
+					break;
+				start = eol+1;
+				eol = text.find( '\n', start);
+				if (eol == string::npos || eol > headerLen)
+					eol = headerLen;
+			}
+			// unfold and trim:
+			string result;
+			for( size_t i=0; i<value.size(); ++i) {
+				char c = value[i];
+				if (c == '\r' || c == '\n' || c == '\t')
+					c = ' ';
+				if (c == ' ' && (result.empty() || result[result.size()-1] == ' '))
+					continue;
+				result += c;
+			}
+			if (!result.empty() && result[result.size()-1] == ' ')
+				result.erase( result.size()-1);
+			return result;
+		}
+		pos = eol+1;
+	}
+	return string();
+}
+
+/*------------------------------------------------------------------------------*\
+	StatusFromMaildirFlags( flags)
+		-	maps the flags of a Maildir-filename (the part behind ":2,") to
+			Beam's mail-status
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::StatusFromMaildirFlags( const string& flags)
+{
+	if (flags.find( 'D') != string::npos)
+		return "Draft";
+	if (flags.find( 'R') != string::npos)
+		return "Replied";
+	if (flags.find( 'P') != string::npos)
+		return "Forwarded";
+	if (flags.find( 'S') != string::npos)
+		return "Read";
+	return "New";
+}
+
+/*------------------------------------------------------------------------------*\
+	MaildirFlagsFromStatus( status)
+		-	maps Beam's mail-status to Maildir-flags (which have to be in
+			ASCII-order)
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::MaildirFlagsFromStatus( const string& status)
+{
+	if (status == "New" || status.empty())
+		return "";
+	if (status == "Draft" || status == "Pending")
+		return "D";
+	if (status == "Replied")
+		return "RS";
+	if (status == "Forwarded" || status == "Redirected")
+		return "PS";
+	return "S";
+}
+
+/*------------------------------------------------------------------------------*\
+	StatusFromMboxHeader( text)
+		-	determines the mail-status from the "Status:" & "X-Status:" fields
+			that mail-clients write into mbox-files
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::StatusFromMboxHeader( const string& text)
+{
+	string xStatus = HeaderField( text, "X-Status");
+	if (xStatus.find( 'T') != string::npos)
+		return "Draft";
+	if (xStatus.find( 'A') != string::npos)
+		return "Replied";
+	string status = HeaderField( text, "Status");
+	if (status.find( 'R') != string::npos)
+		return "Read";
+	return "New";
+}
+
+/*------------------------------------------------------------------------------*\
+	MboxSender( text)
+		-	returns the address that is used in the separator-line of the
+			given mail
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::MboxSender( const string& text)
+{
+	const char* fields[] = { "Return-Path", "From", NULL };
+	for( int i=0; fields[i]; ++i) {
+		string value = HeaderField( text, fields[i]);
+		size_t start = value.find( '<');
+		size_t end = value.find( '>', start);
+		string addr;
+		if (start != string::npos && end != string::npos)
+			addr = value.substr( start+1, end-start-1);
+		else {
+			// use the first word that looks like an address:
+			size_t at = value.find( '@');
+			if (at != string::npos) {
+				start = value.rfind( ' ', at);
+				start = (start == string::npos) ? 0 : start+1;
+				end = value.find( ' ', at);
+				addr = value.substr( start, end == string::npos
+													? string::npos : end-start);
+			}
+		}
+		if (!addr.empty() && addr.find_first_of( " \t") == string::npos)
+			return addr;
+	}
+	return "MAILER-DAEMON";
+}
+
+/*------------------------------------------------------------------------------*\
+	MailDate( text)
+		-	returns the date found in the "Date:" field of the given mail
+			(as in "Mon, 12 Jan 2004 10:11:12 +0100"), in seconds since the
+			epoch
+		-	returns 0 if the mail has no such field or it can't be parsed
+\*------------------------------------------------------------------------------*/
+time_t BmMailboxIO::MailDate( const string& text)
+{
+	string value = HeaderField( text, "Date");
+	const char* str = value.c_str();
+	// skip the weekday, if any:
+	const char* comma = strchr( str, ',');
+	if (comma)
+		str = comma+1;
+	int day, year, hour, minute, second = 0, used = 0;
+	char monthName[4];
+	if (sscanf( str, " %d %3s %d %d:%d%n", &day, monthName, &year, &hour,
+					&minute, &used) < 5 || !used)
+		return 0;
+	int month = NameIndex( nMonths, monthName);
+	if (month < 0 || day < 1 || day > 31 || hour > 23 || minute > 59)
+		return 0;
+	str += used;
+	if (*str == ':') {
+		char* end;
+		second = strtol( str+1, &end, 10);
+		if (second > 60)
+			return 0;
+		str = end;
+	}
+	// two- and three-digit years are obsolete, but still in use:
+	if (year < 50)
+		year += 2000;
+	else if (year < 1000)
+		year += 1900;
+	// timezone, either numerical or one of the obsolete names:
+	while( *str == ' ')
+		str++;
+	int offset = 0;
+	if ((*str == '+' || *str == '-') && isdigit( str[1]) && isdigit( str[2])
+	&& isdigit( str[3]) && isdigit( str[4])) {
+		offset = ((str[1]-'0')*10 + str[2]-'0') * 60
+					+ (str[3]-'0')*10 + str[4]-'0';
+		if (*str == '-')
+			offset = -offset;
+	} else {
+		static const char* const zones[] = {
+			"EDT", "EST", "CDT", "CST", "MDT", "MST", "PDT", "PST", NULL
+		};
+		static const int zoneHours[] = { -4, -5, -5, -6, -6, -7, -7, -8 };
+		int zone = NameIndex( zones, str);
+		if (zone >= 0)
+			offset = zoneHours[zone] * 60;
+	}
+	int64_t when = DaysFromCivil( year, month+1, day) * 24*60*60
+						+ hour*60*60 + minute*60 + second - offset*60;
+	return when > 0 ? when : 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	BeamFilename( when, counter)
+		-	returns a filename in the style Beam uses for new mails
+			(see BmMail::CreateBasicFilename())
+\*------------------------------------------------------------------------------*/
+string BmMailboxIO::BeamFilename( time_t when, uint32_t counter)
+{
+	char now[16];
+	strftime( now, sizeof(now), "%Y%m%d%H%M%S", localtime( &when));
+	char buf[64];
+	sprintf( buf, "mail-%s-%u", now, counter);
+	return buf;
+}
+
+//******************************************************************************
+// #pragma mark -	BmMailboxReader
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	Create( path)
+		-	returns NULL if the given path can't be opened
+\*------------------------------------------------------------------------------*/
+BmMailboxReader* BmMailboxReader::Create( const string& path)
+{
+	struct stat st;
+	if (stat( path.c_str(), &st) != 0)
+		return NULL;
+	if (S_ISDIR( st.st_mode))
+		return new BmMaildirReader( path);
+	FILE* file = fopen( path.c_str(), "rb");
+	if (!file)
+		return NULL;
+	return new BmMboxReader( file, true);
+}
+
+//******************************************************************************
+// #pragma mark -	BmMboxReader
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMboxReader( file, ownsFile)
+		-	c'tor, if ownsFile is set, the file will be closed by the d'tor
+\*------------------------------------------------------------------------------*/
+BmMboxReader::BmMboxReader( FILE* file, bool ownsFile)
+	:	mFile( file)
+	,	mOwnsFile( ownsFile)
+	,	mSeenFromLine( false)
+	,	mAfterEmptyLine( true)
+	,	mBufPos( 0)
+	,	mBufLen( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMboxReader()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMboxReader::~BmMboxReader()
+{
+	if (mOwnsFile && mFile)
+		fclose( mFile);
+}
+
+/*------------------------------------------------------------------------------*\
+	NextMail( outText, outStatus)
+		-	reads the next mail from the mbox
+		-	returns false when there are no more mails
+\*------------------------------------------------------------------------------*/
+bool BmMboxReader::NextMail( string& outText, string& outStatus)
+{
+	string line;
+	while( 1) {
+		if (!mSeenFromLine) {
+			// skip anything in front of the first separator:
+			while( _ReadLine( line)) {
+				if (_IsSeparator( line)) {
+					mSeenFromLine = true;
+					break;
+				}
+			}
+			if (!mSeenFromLine)
+				return false;
+		}
+		outText.erase();
+		mSeenFromLine = false;
+		while( _ReadLine( line)) {
+			if (_IsSeparator( line)) {
+				mSeenFromLine = true;
+				break;
+			}
+			if (IsQuotedFromLine( line))
+				outText.append( line, 1, string::npos);
+			else
+				outText += line;
+		}
+		// drop the empty line that separates this mail from the next:
+		size_t len = outText.size();
+		if (len >= 4 && !outText.compare( len-4, 4, "\r\n\r\n"))
+			outText.erase( len-2);
+		else if (len >= 2 && !outText.compare( len-2, 2, "\n\n"))
+			outText.erase( len-1);
+		if (!outText.empty())
+			break;
+		// empty mail, we skip it
+		if (!mSeenFromLine)
+			return false;
+	}
+	outStatus = BmMailboxIO::StatusFromMboxHeader( outText);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_IsSeparator( line)
+		-	returns whether the given line separates two mails, which it only
+			does at the start of the file or after an empty line
+		-	must be called for every line read, as it keeps track of the
+			empty lines
+\*------------------------------------------------------------------------------*/
+bool BmMboxReader::_IsSeparator( const string& line)
+{
+	bool isSeparator = mAfterEmptyLine && IsSeparatorLine( line);
+	mAfterEmptyLine = line == "\n" || line == "\r\n";
+	return isSeparator;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ReadLine( outLine)
+		-	reads the next line (including its linebreak)
+		-	returns false at the end of the file
+\*------------------------------------------------------------------------------*/
+bool BmMboxReader::_ReadLine( string& outLine)
+{
+	outLine.erase();
+	if (!mFile)
+		return false;
+	while( 1) {
+		if (mBufPos >= mBufLen) {
+			mBufLen = fread( mBuf, 1, sizeof(mBuf), mFile);
+			mBufPos = 0;
+			if (!mBufLen)
+				return !outLine.empty();
+		}
+		const char* start = mBuf + mBufPos;
+		const char* eol
+			= static_cast< const char*>( memchr( start, '\n', mBufLen-mBufPos));
+		if (eol) {
+			outLine.append( start, eol+1-start);
+			mBufPos += eol+1-start;
+			return true;
+		}
+		outLine.append( start, mBufLen-mBufPos);
+		mBufPos = mBufLen;
+	}
+}
+
+//******************************************************************************
+// #pragma mark -	BmMaildirReader
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMaildirReader( path)
+		-	c'tor, collects the names of all mails in the Maildir
+\*------------------------------------------------------------------------------*/
+BmMaildirReader::BmMaildirReader( const string& path)
+	:	mPath( path)
+	,	mIndex( 0)
+{
+	_CollectFiles( "cur");
+	_CollectFiles( "new");
+}
+
+/*------------------------------------------------------------------------------*\
+	NextMail( outText, outStatus)
+		-	reads the next mail from the Maildir, mails that can't be read
+			are skipped
+		-	returns false when there are no more mails
+\*------------------------------------------------------------------------------*/
+bool BmMaildirReader::NextMail( string& outText, string& outStatus)
+{
+	while( mIndex < mFiles.size()) {
+		const string& name = mFiles[mIndex++];
+		FILE* file = fopen( (mPath + "/" + name).c_str(), "rb");
+		if (!file)
+			continue;
+		outText.erase();
+		char buf[65536];
+		size_t len;
+		while( (len = fread( buf, 1, sizeof(buf), file)) > 0)
+			outText.append( buf, len);
+		bool failed = ferror( file) != 0;
+		fclose( file);
+		if (failed)
+			continue;
+		size_t flagPos = name.rfind( ":2,");
+		if (!name.compare( 0, 4, "new/") || flagPos == string::npos)
+			outStatus = "New";
+		else
+			outStatus = BmMailboxIO::StatusFromMaildirFlags(
+				name.substr( flagPos+3));
+		return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	_CollectFiles( subFolder)
+		-	adds the names of all mails in the given subfolder, sorted by name
+			(which usually is the order in which they have been delivered)
+\*------------------------------------------------------------------------------*/
+void BmMaildirReader::_CollectFiles( const string& subFolder)
+{
+	DIR* dir = opendir( (mPath + "/" + subFolder).c_str());
+	if (!dir)
+		return;
+	vector< string> names;
+	struct dirent* dirEntry;
+	while( (dirEntry = readdir( dir)) != NULL) {
+		if (dirEntry->d_name[0] == '.')
+			continue;
+		names.push_back( subFolder + "/" + dirEntry->d_name);
+	}
+	closedir( dir);
+	std::sort( names.begin(), names.end());
+	mFiles.insert( mFiles.end(), names.begin(), names.end());
+}
+
+//******************************************************************************
+// #pragma mark -	BmMailboxWriter
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	Create( path, format)
+		-	returns NULL if the format is unknown or the mailbox can't be
+			created
+\*------------------------------------------------------------------------------*/
+BmMailboxWriter* BmMailboxWriter::Create( const string& path,
+													 const string& format)
+{
+	if (format == "mbox") {
+		FILE* file = fopen( path.c_str(), "ab");
+		if (!file)
+			return NULL;
+		return new BmMboxWriter( file, true);
+	}
+	if (format == "maildir") {
+		BmMaildirWriter* writer = new BmMaildirWriter( path);
+		if (!writer->InitCheck()) {
+			delete writer;
+			return NULL;
+		}
+		return writer;
+	}
+	return NULL;
+}
+
+//******************************************************************************
+// #pragma mark -	BmMboxWriter
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMboxWriter( file, ownsFile)
+		-	c'tor, if ownsFile is set, the file will be closed by the d'tor
+\*------------------------------------------------------------------------------*/
+BmMboxWriter::BmMboxWriter( FILE* file, bool ownsFile)
+	:	mFile( file)
+	,	mOwnsFile( ownsFile)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMboxWriter()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMboxWriter::~BmMboxWriter()
+{
+	if (mOwnsFile && mFile)
+		fclose( mFile);
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteMail( text, status)
+		-	appends the given mail to the mbox, any "Status:" and "X-Status:"
+			fields of the mail are replaced by ones reflecting the given status
+		-	returns false if the mail could not be written
+\*------------------------------------------------------------------------------*/
+bool BmMboxWriter::WriteMail( const string& text, const string& status)
+{
+	if (!mFile)
+		return false;
+	string lfText;
+	BmMailboxIO::ConvertToLF( text, lfText);
+	size_t headerLen = BmMailboxIO::HeaderLength( lfText);
+
+	string data;
+	data.reserve( lfText.size() + 256);
+	char date[64];
+	time_t when = BmMailboxIO::MailDate( lfText);
+	if (!when)
+		when = time( NULL);
+	strftime( date, sizeof(date), "%a %b %d %H:%M:%S %Y", gmtime( &when));
+	data.append( nFromLine).append( BmMailboxIO::MboxSender( lfText))
+		 .append( " ").append( date).append( "\n");
+
+	// header, without the status-fields:
+	bool skipping = false;
+	size_t pos = 0;
+	while( pos < headerLen) {
+		size_t eol = lfText.find( '\n', pos);
+		eol = (eol == string::npos || eol >= headerLen) ? headerLen : eol+1;
+		if (lfText[pos] != ' ' && lfText[pos] != '\t')
+			skipping = !strncasecmp( lfText.c_str()+pos, "Status:", 7)
+							|| !strncasecmp( lfText.c_str()+pos, "X-Status:", 9);
+		if (!skipping)
+			data.append( lfText, pos, eol-pos);
+		pos = eol;
+	}
+	if (!data.empty() && data[data.size()-1] != '\n')
+		data += '\n';
+	if (status != "New" && !status.empty())
+		data.append( status == "Draft" ? "Status: O\n" : "Status: RO\n");
+	if (status == "Replied")
+		data.append( "X-Status: A\n");
+	else if (status == "Draft")
+		data.append( "X-Status: T\n");
+
+	// body, quoting any separators:
+	while( pos < lfText.size()) {
+		size_t eol = lfText.find( '\n', pos);
+		eol = (eol == string::npos) ? lfText.size() : eol+1;
+		if (IsFromLine( lfText, pos)
+		|| (lfText[pos] == '>' && IsQuotedFromLine( lfText.substr( pos,
+																			  eol-pos))))
+			data += '>';
+		data.append( lfText, pos, eol-pos);
+		pos = eol;
+	}
+	if (data[data.size()-1] != '\n')
+		data += '\n';
+	data += '\n';
+	return fwrite( data.data(), 1, data.size(), mFile) == data.size();
+}
+
+/*------------------------------------------------------------------------------*\
+	Finish()
+		-	flushes the mbox
+		-	returns false if any write has failed
+\*------------------------------------------------------------------------------*/
+bool BmMboxWriter::Finish()
+{
+	if (!mFile)
+		return false;
+	return fflush( mFile) == 0 && !ferror( mFile);
+}
+
+//******************************************************************************
+// #pragma mark -	BmMaildirWriter
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmMaildirWriter( path)
+		-	c'tor, creates the Maildir (if it doesn't exist yet)
+\*------------------------------------------------------------------------------*/
+BmMaildirWriter::BmMaildirWriter( const string& path)
+	:	mPath( path)
+	,	mCounter( 0)
+	,	mInitOK( true)
+{
+	const char* folders[] = { "", "/tmp", "/new", "/cur", NULL };
+	for( int i=0; folders[i]; ++i) {
+		if (mkdir( (mPath + folders[i]).c_str(), 0700) != 0 && errno != EEXIST)
+			mInitOK = false;
+	}
+	char host[256];
+	if (gethostname( host, sizeof(host)) != 0)
+		strcpy( host, "localhost");
+	host[sizeof(host)-1] = '\0';
+	// '/' and ':' are not allowed in the unique part:
+	for( char* p = host; *p; ++p) {
+		if (*p == '/' || *p == ':')
+			*p = '_';
+	}
+	char buf[300];
+	sprintf( buf, "%ld.%s", (long)getpid(), host);
+	mUniquePart = buf;
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteMail( text, status)
+		-	writes the given mail into the Maildir
+		-	returns false if the mail could not be written
+\*------------------------------------------------------------------------------*/
+bool BmMaildirWriter::WriteMail( const string& text, const string& status)
+{
+	if (!mInitOK)
+		return false;
+	char buf[64];
+	sprintf( buf, "%lu.%u_", (unsigned long)time( NULL), ++mCounter);
+	string name = string( buf) + mUniquePart;
+	string tmpPath = mPath + "/tmp/" + name;
+	FILE* file = fopen( tmpPath.c_str(), "wb");
+	if (!file)
+		return false;
+	string lfText;
+	BmMailboxIO::ConvertToLF( text, lfText);
+	bool ok = fwrite( lfText.data(), 1, lfText.size(), file) == lfText.size();
+	ok = fclose( file) == 0 && ok;
+	string flags = BmMailboxIO::MaildirFlagsFromStatus( status);
+	string newPath = (status == "New" || status.empty())
+								? mPath + "/new/" + name
+								: mPath + "/cur/" + name + ":2," + flags;
+	if (ok)
+		ok = rename( tmpPath.c_str(), newPath.c_str()) == 0;
+	if (!ok)
+		remove( tmpPath.c_str());
+	return ok;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailboxIO_h
+#define _BmMailboxIO_h
+
+/*
+ * This file (and BmMailboxIO.cpp) deliberately does not use any of the
+ * BeAPI or BmBase, such that mailboxes can be imported and exported on any
+ * POSIX-system (see src-tools/MailImporter.cpp & MailExporter.cpp).
+ */
+
+#if defined(__BEOS__) || defined(__HAIKU__)
+#include "BmMailKit.h"
+#else
+#define IMPEXPBMMAILKIT
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	class BmMailboxIO
+		-	a collection of static helpers that are shared by the mailbox
+			readers and writers
+		-	statuses are Beam's mail-statuses ("New", "Read", "Replied", ...)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailboxIO {
+
+public:
+	static void ConvertToCRLF( const string& text, string& outText);
+	static void ConvertToLF( const string& text, string& outText);
+	static int32_t HeaderLength( const string& text);
+	static string HeaderField( const string& text, const char* fieldName);
+	static string StatusFromMaildirFlags( const string& flags);
+	static string MaildirFlagsFromStatus( const string& status);
+	static string StatusFromMboxHeader( const string& text);
+	static string MboxSender( const string& text);
+	static time_t MailDate( const string& text);
+	static string BeamFilename( time_t when, uint32_t counter);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMailboxReader
+		-	reads one mail after the other from a mailbox, without ever keeping
+			more than the current mail in memory
+		-	the mail-texts are handed out just as they are found in the
+			mailbox (i.e. with whatever linebreaks are used in there)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailboxReader {
+
+public:
+	virtual ~BmMailboxReader()				{}
+
+	virtual bool NextMail( string& outText, string& outStatus) = 0;
+
+	// creates a Maildir-reader for folders and an mbox-reader for files:
+	static BmMailboxReader* Create( const string& path);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMboxReader
+		-	reads mails from an mbox-file, lines quoted as ">From " (with any
+			number of '>') are unquoted, i.e. both mboxo and mboxrd files
+			are supported (mboxrd is what BmMboxWriter writes)
+		-	a "From "-line only separates two mails if it is found at the
+			start of the file or after an empty line and if it is followed
+			by sender and date (as in "From a@b.org Mon Jan 12 10:11:12 2004"),
+			any other unquoted "From "-line is taken as part of the mail
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMboxReader : public BmMailboxReader {
+
+public:
+	BmMboxReader( FILE* file, bool ownsFile);
+	~BmMboxReader();
+
+	// overrides of BmMailboxReader:
+	bool NextMail( string& outText, string& outStatus);
+
+private:
+	bool _ReadLine( string& outLine);
+	bool _IsSeparator( const string& line);
+
+	FILE* mFile;
+	bool mOwnsFile;
+	bool mSeenFromLine;
+	bool mAfterEmptyLine;
+							// true at the start of the file, too
+	char mBuf[65536];
+	size_t mBufPos;
+	size_t mBufLen;
+
+	// Hide copy-constructor and assignment:
+	BmMboxReader( const BmMboxReader&);
+	BmMboxReader operator=( const BmMboxReader&);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMaildirReader
+		-	reads the mails from the "cur" and "new" subfolders of a Maildir,
+			mails from "new" are always considered "New", the status of the
+			others is taken from the flags in their filename
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMaildirReader : public BmMailboxReader {
+
+public:
+	BmMaildirReader( const string& path);
+
+	// overrides of BmMailboxReader:
+	bool NextMail( string& outText, string& outStatus);
+
+private:
+	void _CollectFiles( const string& subFolder);
+
+	string mPath;
+	vector< string> mFiles;
+							// paths relative to the Maildir
+	uint32_t mIndex;
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMailboxWriter
+		-	appends mails to a mailbox
+		-	the writers do no locking, that's up to the user
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailboxWriter {
+
+public:
+	virtual ~BmMailboxWriter()				{}
+
+	virtual bool WriteMail( const string& text, const string& status) = 0;
+	virtual bool Finish()					{ return true; }
+
+	// creates a writer for the given format ("mbox" or "maildir"):
+	static BmMailboxWriter* Create( const string& path, const string& format);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMboxWriter
+		-	writes mails into an mbox-file in mboxrd-format, the status of
+			each mail is kept in "Status:" & "X-Status:" header fields
+		-	the separator-line carries the date of the mail (or the current
+			time, if the mail has no usable "Date:" field)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMboxWriter : public BmMailboxWriter {
+
+public:
+	BmMboxWriter( FILE* file, bool ownsFile);
+	~BmMboxWriter();
+
+	// overrides of BmMailboxWriter:
+	bool WriteMail( const string& text, const string& status);
+	bool Finish();
+
+private:
+	FILE* mFile;
+	bool mOwnsFile;
+
+	// Hide copy-constructor and assignment:
+	BmMboxWriter( const BmMboxWriter&);
+	BmMboxWriter operator=( const BmMboxWriter&);
+};
+
+/*------------------------------------------------------------------------------*\
+	class BmMaildirWriter
+		-	writes mails into a Maildir, every mail is written to "tmp" first
+			and then moved to "cur" (or to "new" if its status is "New")
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMaildirWriter : public BmMailboxWriter {
+
+public:
+	BmMaildirWriter( const string& path);
+
+	// overrides of BmMailboxWriter:
+	bool WriteMail( const string& text, const string& status);
+
+	// getters:
+	inline bool InitCheck() const			{ return mInitOK; }
+
+private:
+	string mPath;
+	string mUniquePart;
+							// host & pid, used to create unique filenames
+	uint32_t mCounter;
+	bool mInitOK;
+};
+
+#endif
@@ -440,6 +440,9 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "CacheRefsInMem", false);
 	defaultsMsg.AddBool( "CacheRefsOnDisk", true);
 	defaultsMsg.AddBool( "CloseViewWinAfterMailAction", true);
+	defaultsMsg.AddInt32( "DedupIndexMaxAge", 60);
+	defaultsMsg.AddInt32( "DedupIndexMaxEntries", 20000);
+	defaultsMsg.AddBool( "DedupRetrievedMails", true);
 	defaultsMsg.AddString( "DefaultCharset", 
 									BmEncoding::DefaultCharset.String());
 	defaultsMsg.AddString( "DefaultForwardType", "Inline");
@@ -447,6 +450,7 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "DynamicStatusWin", true);
 	defaultsMsg.AddInt32( "ExpandCollapseDelay", 1000);
 	defaultsMsg.AddInt32( "FeedbackTimeout", 200);
+	defaultsMsg.AddInt32( "FilterThreads", 4);
 	defaultsMsg.AddString( "ForwardIntroStr", "On %d at %t, %f wrote:");
 	defaultsMsg.AddString( "ForwardSubjectRX", 
 									"^\\s*\\[?\\s*Fwd(\\[\\d+\\])?:");
@@ -460,6 +464,8 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddString( "IconPath", defaultIconPath.String());
 	defaultsMsg.AddBool( "InOutAlwaysAtTop", true);
 	defaultsMsg.AddBool( "ImportExportTextAsUtf8", true);
+	defaultsMsg.AddBool( "IndexMailText", true);
+	defaultsMsg.AddInt32( "JournalCompactionPercent", 25);
 	defaultsMsg.AddString( "ListFields", "Mail-Followup-To,Reply-To");
 	defaultsMsg.AddBool( "ListviewLikeTracker", false);
 	defaultsMsg.AddInt32( "ListviewFlatMinItemHeight", 16);
@@ -468,10 +474,13 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddInt32( "ListviewHierarchicalMinItemHeight", 16);
 	defaultsMsg.AddBool( "ListviewUsesStringSpacing", false);
 	defaultsMsg.AddBool( "LookForPeopleOnlyInPeopleFolder", true);
+	defaultsMsg.AddInt32( "MailRefListMemoryBudget", 64);
+	defaultsMsg.AddInt32( "MailRefScanThreadCount", 0);
 	// standard mail-box:
 	defaultsMsg.AddString( "MailboxPath", "/boot/home/mail");
 	defaultsMsg.AddBool( "MakeQPSafeForEBCDIC", true);
 	defaultsMsg.AddBool( "MapClassificationGenuineToTofu", true);
+	defaultsMsg.AddBool( "MapMailFilesIntoMemory", true);
 	defaultsMsg.AddInt32( "MarkAsReadDelay", 500);
 	defaultsMsg.AddInt32( "MaxLineLen", 76);
 	defaultsMsg.AddInt32( "MaxLineLenForHardWrap", 998);
@@ -515,6 +524,8 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "ShowToolbarIcons", true);
 	defaultsMsg.AddString( "ShowToolbarLabel", "Right");
 	defaultsMsg.AddBool( "ShowTooltips", true);
+	defaultsMsg.AddInt32( "ShutdownStoreDeadline", 5);
+	defaultsMsg.AddInt32( "ShutdownStoreThreads", 4);
 	defaultsMsg.AddString( "SignatureRX", "^---?\\s*\\n");
 	defaultsMsg.AddInt32( "SpacesPerTab", 4);
 	defaultsMsg.AddBool("SpecialHeaderForEachBcc", false);
@@ -525,6 +536,8 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 									"iso-8859-15,macroman,windows-1251,windows-1252,"
 									"cp866,cp850,iso-2022-jp,iso-2022-jp-2,"
 									"koi8-r,euc-kr,big-5,us-ascii,utf-8");
+	defaultsMsg.AddInt32( "StoredActionBacklogLimit", 4096);
+	defaultsMsg.AddInt32( "StoredActionFlushDeadline", 10);
 	defaultsMsg.AddBool( "StrictCharsetHandling", false);
 	defaultsMsg.AddBool( "StripedListView", true);
 	defaultsMsg.AddString( "TimeModeInHeaderView", "Local");
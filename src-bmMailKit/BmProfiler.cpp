@@ -0,0 +1,207 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <Autolock.h>
+#include <File.h>
+
+#include "BmBasics.h"
+#include "BmLogHandler.h"
+#include "BmProfiler.h"
+#include "BmRosterBase.h"
+
+BmProfiler* BmProfiler::theInstance = NULL;
+
+const char* const BmProfiler::STARTUP_PHASE = 	"startup";
+const char* const BmProfiler::SHUTDOWN_PHASE = 	"shutdown";
+
+const char* const BmProfiler::PROFILE_STARTUP_ARG = "--profile-startup";
+
+/*------------------------------------------------------------------------------*\
+	CreateInstance()
+		-	creator-func
+\*------------------------------------------------------------------------------*/
+BmProfiler* BmProfiler::CreateInstance() {
+	if (!theInstance)
+		theInstance = new BmProfiler();
+	return theInstance;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmProfiler()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmProfiler::BmProfiler()
+	:	mLocker( "ProfilerLock")
+	,	mPhaseStart( 0)
+	,	mPhaseNumber( 0)
+	,	mIsRecording( false)
+	,	mExitAfterStartup( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmProfiler()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmProfiler::~BmProfiler() {
+	theInstance = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	BeginPhase( name)
+		-	starts recording the spans of the phase with the given name
+		-	any spans of a phase that is still running are dropped
+\*------------------------------------------------------------------------------*/
+void BmProfiler::BeginPhase( const char* name) {
+	BAutolock lock( mLocker);
+	mPhaseName = name;
+	mPhaseStart = system_time();
+	mPhaseNumber++;
+	mSpans.clear();
+	mDepthMap.clear();
+	mIsRecording = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	EndPhase( name)
+		-	stops recording and reports all spans of the current phase
+		-	if a name is given, the current phase is only ended if it has that
+			name (a phase may have been replaced by another one meanwhile)
+		-	returns whether a phase has been ended
+\*------------------------------------------------------------------------------*/
+bool BmProfiler::EndPhase( const char* name) {
+	BmString report;
+	{	// scope for autolock
+		BAutolock lock( mLocker);
+		if (!mIsRecording || (name && mPhaseName != name))
+			return false;
+		report = _Report( system_time());
+		mIsRecording = false;
+		mSpans.clear();
+		mDepthMap.clear();
+	}
+	// the log-handler and the roster may need some locks of their own, so we
+	// write the report without holding ours:
+	BM_LOG( BM_LogApp, report);
+	_WriteReport( report);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	CancelPhase()
+		-	stops recording without reporting anything (e.g. if the user has
+			decided not to quit, after all)
+\*------------------------------------------------------------------------------*/
+void BmProfiler::CancelPhase() {
+	BAutolock lock( mLocker);
+	mIsRecording = false;
+	mSpans.clear();
+	mDepthMap.clear();
+}
+
+/*------------------------------------------------------------------------------*\
+	BeginSpan( name, outPhaseNumber)
+		-	opens a new span within the current thread
+		-	returns the index of the span (to be passed into EndSpan()) or -1
+			if no phase is being recorded
+\*------------------------------------------------------------------------------*/
+int32 BmProfiler::BeginSpan( const BmString& name, int32& outPhaseNumber) {
+	BAutolock lock( mLocker);
+	if (!mIsRecording)
+		return -1;
+	Span span;
+	span.name = name;
+	span.thread = find_thread( NULL);
+	span.depth = mDepthMap[span.thread]++;
+	span.start = system_time();
+	span.end = 0;
+	mSpans.push_back( span);
+	outPhaseNumber = mPhaseNumber;
+	return mSpans.size()-1;
+}
+
+/*------------------------------------------------------------------------------*\
+	EndSpan( index, phaseNumber)
+		-	closes the span with the given index
+		-	spans that belong to an earlier phase are ignored
+\*------------------------------------------------------------------------------*/
+void BmProfiler::EndSpan( int32 index, int32 phaseNumber) {
+	BAutolock lock( mLocker);
+	if (!mIsRecording || phaseNumber != mPhaseNumber
+	|| index >= (int32)mSpans.size())
+		return;
+	Span& span = mSpans[index];
+	span.end = system_time();
+	mDepthMap[span.thread]--;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Report( now)
+		-	returns the report for the current phase, which lists all spans
+			in the order they have been started, with their offset from the start
+			of the phase and their duration
+		-	spans that have been recorded by other threads than the one that
+			started the first span are marked with the thread's name
+\*------------------------------------------------------------------------------*/
+BmString BmProfiler::_Report( bigtime_t now) const {
+	BmString report("Profile of ");
+	report << mPhaseName << " (" << _Millis( now - mPhaseStart) << " ms):\n"
+			 << "   offset   duration  span\n";
+	thread_id mainThread = mSpans.empty() ? -1 : mSpans[0].thread;
+	for( uint32 i=0; i<mSpans.size(); ++i) {
+		const Span& span = mSpans[i];
+		BmString line = _Millis( span.start - mPhaseStart);
+		line.Prepend( ' ', 9 - line.Length());
+		BmString duration
+			= span.end ? _Millis( span.end - span.start) : BmString("?");
+		duration.Prepend( ' ', 11 - duration.Length());
+		line << duration << "  ";
+		line.Append( ' ', 2 * span.depth);
+		line << span.name;
+		if (span.thread != mainThread) {
+			thread_info info;
+			if (get_thread_info( span.thread, &info) == B_OK)
+				line << "  [" << info.name << "]";
+			else
+				line << "  [thread " << int32(span.thread) << "]";
+		}
+		if (!span.end)
+			line << "  (still running)";
+		report << line << "\n";
+	}
+	return report;
+}
+
+/*------------------------------------------------------------------------------*\
+	_WriteReport( report)
+		-	writes the given report into "Profile (<phase>)" inside the
+			settings-folder (overwriting the report of the previous run)
+\*------------------------------------------------------------------------------*/
+void BmProfiler::_WriteReport( const BmString& report) const {
+	if (!BeamRoster)
+		return;
+	BmString filename( BeamRoster->SettingsPath());
+	filename << "/Profile (" << mPhaseName << ")";
+	BFile file;
+	status_t err = file.SetTo( filename.String(),
+										B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	if (err == B_OK)
+		err = file.Write( report.String(), report.Length()) < 0 ? B_ERROR : B_OK;
+	if (err != B_OK)
+		BM_LOGERR( BmString("Could not write profile into\n\t<") << filename
+							<< ">\n\n Result: " << strerror( err));
+}
+
+/*------------------------------------------------------------------------------*\
+	_Millis( micros)
+		-	returns the given microseconds as milliseconds (with one decimal)
+\*------------------------------------------------------------------------------*/
+BmString BmProfiler::_Millis( bigtime_t micros) {
+	return BmString() << int32(micros / 1000) << "."
+							<< int32((micros / 100) % 10);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmProfiler_h
+#define _BmProfiler_h
+
+#include <map>
+#include <vector>
+
+#include <Locker.h>
+#include <OS.h>
+
+#include "BmMailKit.h"
+
+#include "BmString.h"
+
+using std::map;
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	BmProfiler
+		-	measures the time spent in the (possibly nested) spans of a phase,
+			like startup or shutdown
+		-	spans are only recorded while a phase is running, so the spans that
+			are sprinkled across the code cost next to nothing otherwise
+		-	when a phase ends, a report of all its spans is written to the log
+			and into a file within the settings-folder
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmProfiler {
+
+	struct Span {
+		BmString name;
+		thread_id thread;
+		int32 depth;
+		bigtime_t start;
+		bigtime_t end;
+	};
+	typedef vector< Span> SpanVect;
+	typedef map< thread_id, int32> DepthMap;
+
+public:
+	static BmProfiler* CreateInstance();
+	~BmProfiler();
+
+	// native methods:
+	void BeginPhase( const char* name);
+	bool EndPhase( const char* name = NULL);
+	void CancelPhase();
+	int32 BeginSpan( const BmString& name, int32& outPhaseNumber);
+	void EndSpan( int32 index, int32 phaseNumber);
+
+	// getters:
+	bool IsRecording() const				{ return mIsRecording; }
+	bool ExitAfterStartup() const			{ return mExitAfterStartup; }
+
+	// setters:
+	void ExitAfterStartup( bool b)		{ mExitAfterStartup = b; }
+
+	static BmProfiler* theInstance;
+
+	static const char* const STARTUP_PHASE;
+	static const char* const SHUTDOWN_PHASE;
+
+	// command-line argument that makes Beam quit after startup:
+	static const char* const PROFILE_STARTUP_ARG;
+
+private:
+	BmProfiler();
+	BmString _Report( bigtime_t now) const;
+	void _WriteReport( const BmString& report) const;
+	static BmString _Millis( bigtime_t micros);
+
+	mutable BLocker mLocker;
+	BmString mPhaseName;
+	bigtime_t mPhaseStart;
+	int32 mPhaseNumber;
+							// identifies the phase a span belongs to
+	bool mIsRecording;
+	bool mExitAfterStartup;
+							// quit as soon as startup is done (--profile-startup)
+	SpanVect mSpans;
+	DepthMap mDepthMap;
+							// number of open spans per thread
+
+	// Hide copy-constructor and assignment:
+	BmProfiler( const BmProfiler&);
+	BmProfiler operator=( const BmProfiler&);
+};
+
+#define TheProfiler BmProfiler::theInstance
+
+/*------------------------------------------------------------------------------*\
+	BmProfileSpan
+		-	measures the time spent within the current scope
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmProfileSpan {
+
+public:
+	BmProfileSpan( const BmString& name)
+		:	mIndex( -1)
+		,	mPhaseNumber( 0)
+	{
+		if (TheProfiler && TheProfiler->IsRecording())
+			mIndex = TheProfiler->BeginSpan( name, mPhaseNumber);
+	}
+	~BmProfileSpan()
+	{
+		if (mIndex >= 0 && TheProfiler)
+			TheProfiler->EndSpan( mIndex, mPhaseNumber);
+	}
+
+private:
+	int32 mIndex;
+	int32 mPhaseNumber;
+
+	// Hide copy-constructor and assignment:
+	BmProfileSpan( const BmProfileSpan&);
+	BmProfileSpan operator=( const BmProfileSpan&);
+};
+
+#define BM_PROFILE_SPAN( name) BmProfileSpan _bmProfileSpan( name)
+
+#endif
@@ -45,6 +45,9 @@ public:
 											BmRefObj* ptr = NULL);
 	BmString RefPrintHex() const;
 
+	// getters:
+	inline int32 RefCount() const			{ return mRefCount; }
+
 	// statics:
 	static BLocker* GlobalLocker();
 	static BmString RefPrintHex( const void* ptr);
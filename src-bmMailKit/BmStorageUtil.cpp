@@ -9,7 +9,11 @@
 #include <set>
 
 #include <errno.h> 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 
 #include <Directory.h> 
 #include <Messenger.h> 
@@ -328,6 +332,7 @@ BmString BmBackedFile::nBackupExt("-backup");
 \*------------------------------------------------------------------------------*/
 BmBackedFile::BmBackedFile( const char* filename, const char *mimetype,
 									 const BEntry* backupEntry)
+	:	mSyncOnFinish( true)
 {
 	SetTo( filename, mimetype, backupEntry);
 }
@@ -338,6 +343,7 @@ BmBackedFile::BmBackedFile( const char* filename, const char *mimetype,
 \*------------------------------------------------------------------------------*/
 BmBackedFile::BmBackedFile( const BEntry& entry, const char *mimetype,
 									 const BEntry* backupEntry)
+	:	mSyncOnFinish( true)
 {
 	SetTo( entry, mimetype, backupEntry);
 }
@@ -434,7 +440,7 @@ status_t BmBackedFile::Init() {
 		-	syncs the new file and removes the backup (if any)
 \*------------------------------------------------------------------------------*/
 void BmBackedFile::Finish() {
-	if (mFile.InitCheck() == B_OK)
+	if (mSyncOnFinish && mFile.InitCheck() == B_OK)
 		mFile.Sync();
 	if (mBackupEntry.InitCheck() == B_OK && mBackupEntry.Exists())
 		mBackupEntry.Remove();
@@ -458,6 +464,83 @@ ssize_t BmBackedFile::Write(const void *buffer, size_t size) {
 	return mFile.Write( buffer, size);
 }
 
+
+
+/*------------------------------------------------------------------------------*\
+	BmMappedFile()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMappedFile::BmMappedFile()
+	:	mData( NULL)
+	,	mSize( 0)
+	,	mInitCheck( B_NO_INIT)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMappedFile()
+		-	d'tor, removes the mapping (if any)
+\*------------------------------------------------------------------------------*/
+BmMappedFile::~BmMappedFile() {
+	Unset();
+}
+
+/*------------------------------------------------------------------------------*\
+	SetTo( eref)
+		-	maps the file referenced by the given entry_ref into memory
+		-	empty files are accepted, but yield no mapping (Data() is NULL)
+\*------------------------------------------------------------------------------*/
+status_t BmMappedFile::SetTo( const entry_ref* eref) {
+	Unset();
+	BPath path;
+	if ((mInitCheck = path.SetTo( eref)) != B_OK)
+		return mInitCheck;
+	return SetTo( path.Path());
+}
+
+/*------------------------------------------------------------------------------*\
+	SetTo( path)
+		-	maps the file at the given path into memory
+\*------------------------------------------------------------------------------*/
+status_t BmMappedFile::SetTo( const char* path) {
+	Unset();
+	int fd = open( path, O_RDONLY);
+	if (fd < 0)
+		return mInitCheck = errno;
+	struct stat st;
+	if (fstat( fd, &st) < 0) {
+		mInitCheck = errno;
+		close( fd);
+		return mInitCheck;
+	}
+	mSize = st.st_size;
+	if (mSize > 0) {
+		void* data = mmap( NULL, size_t(mSize), PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			mInitCheck = errno;
+			mSize = 0;
+			close( fd);
+			return mInitCheck;
+		}
+		mData = static_cast<const char*>( data);
+	}
+	// the mapping stays valid after the file descriptor has been closed:
+	close( fd);
+	return mInitCheck = B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	Unset()
+		-	removes the mapping
+\*------------------------------------------------------------------------------*/
+void BmMappedFile::Unset() {
+	if (mData)
+		munmap( const_cast<char*>( mData), size_t(mSize));
+	mData = NULL;
+	mSize = 0;
+	mInitCheck = B_NO_INIT;
+}
+
 /*------------------------------------------------------------------------------*\
 	SetupFolder( name, dir)
 		-	initializes the given BDirectory dir to the given path name
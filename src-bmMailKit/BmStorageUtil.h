@@ -76,7 +76,8 @@ extern IMPEXPBMMAILKIT BmTempFileList TheTempFileList;
 \*------------------------------------------------------------------------------*/
 class IMPEXPBMMAILKIT BmBackedFile {
 public:
-	BmBackedFile()								{}
+	BmBackedFile()
+		:	mSyncOnFinish( true)				{}
 	BmBackedFile( const char* filename, const char *mimetype = NULL,
 					  const BEntry* = NULL);
 	BmBackedFile( const BEntry& entry, const char *mimetype = NULL,
@@ -89,6 +90,7 @@ public:
 	ssize_t Write(const void *buffer, size_t size);
 	BFile& File()								{ return mFile; }
 	const BmString& BackupExtension()	{ return nBackupExt; }
+	void SyncOnFinish( bool b)				{ mSyncOnFinish = b; }
 
 	static BmString nBackupExt;
 private:
@@ -101,6 +103,34 @@ private:
 	BFile mFile;
 	BmString mBackupName;
 	BEntry mBackupEntry;
+	bool mSyncOnFinish;
+							// if false, syncing the file is left to the caller
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMappedFile
+		-	maps the complete contents of a file read-only into memory
+		-	the mapping lives as long as the object does (or until Unset())
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMappedFile {
+public:
+	BmMappedFile();
+	~BmMappedFile();
+	status_t SetTo( const entry_ref* eref);
+	status_t SetTo( const char* path);
+	void Unset();
+	//
+	inline status_t InitCheck() const	{ return mInitCheck; }
+	inline const char* Data() const		{ return mData; }
+	inline off_t Size() const				{ return mSize; }
+private:
+	const char* mData;
+	off_t mSize;
+	status_t mInitCheck;
+
+	// Hide copy-constructor and assignment:
+	BmMappedFile( const BmMappedFile&);
+	BmMappedFile operator=( const BmMappedFile&);
 };
 
 #endif
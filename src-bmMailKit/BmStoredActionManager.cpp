@@ -7,22 +7,42 @@
  */
 
 #include <Autolock.h>
+#include <Entry.h>
 #include <File.h>
 #include <Path.h>
 
+#include <queue>
+
 #include "BmBasics.h"
 #include "BmDataModel.h"
 #include "BmStoredActionManager.h"
 #include "BmLogHandler.h"
 #include "BmMailMonitor.h"
+#include "BmPrefs.h"
+#include "BmStorageUtil.h"
+
+using std::pair;
+using std::priority_queue;
 
 //******************************************************************************
 // #pragma mark -	BmStoredActionFlusher
 //		-	a class that runs in its own thread and flushes any stored actions
-//			to disk at an appropriate time (when the mail-monitor is idle).
+//			to disk at an appropriate time (when the mail-monitor is idle, or
+//			when the actions have been waiting for too long).
 //******************************************************************************
 BmStoredActionFlusher* BmStoredActionFlusher::theInstance = NULL;
 
+// the number of lists that are flushed per wakeup:
+static const uint32 nMaxListsPerWakeup = 8;
+
+// the mail-monitor doesn't tell us when it becomes idle, so we check 
+// this often while lists are waiting for it:
+static const bigtime_t nIdleCheckInterval = 1000*1000;
+
+// the longest time a list waits for the backlog to shrink when storing
+// an action:
+static const bigtime_t nMaxBackpressureWait = 50*1000;
+
 /*------------------------------------------------------------------------------*\
 	CreateInstance()
 		-	creator-func
@@ -38,7 +58,13 @@ BmStoredActionFlusher* BmStoredActionFlusher::CreateInstance() {
 		-	standard c'tor
 \*------------------------------------------------------------------------------*/
 BmStoredActionFlusher::BmStoredActionFlusher()
-	:	mLocker("StoredActionFlusher")
+	:	mPendingBytes(0)
+	,	mBacklogLimit(ThePrefs->GetInt("StoredActionBacklogLimit", 4096) * 1024LL)
+	,	mCurrentList(NULL)
+	,	mLocker("StoredActionFlusher")
+	,	mWakeupSem(create_sem(0, "StoredActionFlusherWakeup"))
+	,	mBackpressureSem(create_sem(0, "StoredActionFlusherBackpressure"))
+	,	mWaiterCount(0)
 	,	mShouldRun(false)
 	,	mThreadId(-1)
 {
@@ -67,9 +93,17 @@ void BmStoredActionFlusher::Run()
 \*------------------------------------------------------------------------------*/
 void BmStoredActionFlusher::Quit()
 {
-	mShouldRun = false;
+	if (mLocker.Lock()) {
+		mShouldRun = false;
+		mLocker.Unlock();
+	}
+	release_sem(mWakeupSem);
 	status_t exitVal;
 	wait_for_thread(mThreadId, &exitVal);
+	// any threads still waiting for the backlog to shrink are woken up by
+	// deleting the semaphore:
+	delete_sem(mBackpressureSem);
+	delete_sem(mWakeupSem);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -86,47 +120,156 @@ int32 BmStoredActionFlusher::_ThreadEntry(void* data)
 
 /*------------------------------------------------------------------------------*\
 	_Loop()
-		-	
+		-	sleeps until a list is added or the next list becomes due and then
+			flushes all lists that are due (up to nMaxListsPerWakeup of them)
 \*------------------------------------------------------------------------------*/
 void BmStoredActionFlusher::_Loop()
 {
-	BmRef< BmListModel> list;
+	bigtime_t timeout = B_INFINITE_TIMEOUT;
+	vector< BmRef<BmListModel> > lists;
 	while(mShouldRun) {
-		if (TheMailMonitor->IsIdle() && mLocker.Lock()) {
-			ListSet::iterator iter = mListSet.begin();
-			if (iter != mListSet.end()) {
-				list = *iter;
-				mListSet.erase(iter);
-				BM_LOG2( BM_LogMailTracking, 
-						   BmString("StoredActionFlusher: picked and removed "
-						   	"list-model ") << list->ModelName());
-			} else
-				list = NULL;
-			mLocker.Unlock();
+		status_t err 
+			= acquire_sem_etc(mWakeupSem, 1, B_RELATIVE_TIMEOUT, timeout);
+		if (err == B_INTERRUPTED)
+			continue;
+		if (err != B_OK && err != B_TIMED_OUT && err != B_WOULD_BLOCK)
+			break;
+		if (!mShouldRun)
+			break;
+		timeout = _PickLists(lists);
+		for( uint32 i=0; i<lists.size(); ++i) {
+			if (mLocker.Lock()) {
+				mCurrentList = lists[i].Get();
+				mLocker.Unlock();
+			}
+			_FlushList(lists[i]);
+			if (mLocker.Lock()) {
+				mCurrentList = NULL;
+				// let the lists that are waiting for the backlog to shrink
+				// check again:
+				if (mWaiterCount)
+					release_sem_etc(mBackpressureSem, mWaiterCount, 
+										 B_DO_NOT_RESCHEDULE);
+				mLocker.Unlock();
+			}
 		}
-		if (list)
-			_FlushList(list);
-		else
-			snooze(200*1000);
+		lists.clear();
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	AddList( list)
-		-	
+	_PickLists( outLists)
+		-	removes the lists that are due for flushing from the waiting lists
+			and returns them in outLists, the lists with the most pending bytes
+			come first
+		-	returns the time after which the remaining lists need to be 
+			checked again
 \*------------------------------------------------------------------------------*/
-void BmStoredActionFlusher::AddList( BmRef<BmListModel> list) {
-	if (mLocker.Lock()) {
+bigtime_t BmStoredActionFlusher::_PickLists( 
+	vector< BmRef<BmListModel> >& outLists)
+{
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked() || mListMap.empty())
+		return B_INFINITE_TIMEOUT;
+	mBacklogLimit = ThePrefs->GetInt("StoredActionBacklogLimit", 4096) * 1024LL;
+	bigtime_t deadline 
+		= ThePrefs->GetInt("StoredActionFlushDeadline", 10) * 1000000LL;
+	bigtime_t now = system_time();
+	bool monitorIsIdle = !TheMailMonitor || TheMailMonitor->IsIdle();
+	bool backlogged = mPendingBytes > mBacklogLimit;
+	typedef pair< int64, BmListModel*> QueueEntry;
+	priority_queue< QueueEntry> dueQueue;
+	bigtime_t timeout = B_INFINITE_TIMEOUT;
+	ListMap::iterator iter;
+	for( iter = mListMap.begin(); iter != mListMap.end(); ++iter) {
+		bigtime_t dueTime = iter->second.since + deadline;
+		if (monitorIsIdle || backlogged || dueTime <= now)
+			dueQueue.push( QueueEntry( iter->second.pendingBytes, 
+												iter->first.Get()));
+		else if (dueTime - now < timeout)
+			timeout = dueTime - now;
+	}
+	while( !dueQueue.empty() && outLists.size() < nMaxListsPerWakeup) {
+		iter = mListMap.find( dueQueue.top().second);
+		dueQueue.pop();
+		BM_LOG2( BM_LogMailTracking, 
+					BmString("StoredActionFlusher: picked list-model ") 
+						<< iter->first->ModelName() << " with " 
+						<< iter->second.pendingBytes << " pending bytes");
+		outLists.push_back( iter->first);
+		mPendingBytes -= iter->second.pendingBytes;
+		mListMap.erase( iter);
+	}
+	if (!dueQueue.empty())
+		// more lists are due, we continue right away:
+		return 0;
+	if (!mListMap.empty() && nIdleCheckInterval < timeout)
+		timeout = nIdleCheckInterval;
+	return timeout;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddList( list, actionSize)
+		-	tells the flusher that an action of the given size has been stored
+			for the given list
+\*------------------------------------------------------------------------------*/
+void BmStoredActionFlusher::AddList( BmRef<BmListModel> list, 
+												 int32 actionSize) {
+	if (!list || !mLocker.Lock())
+		return;
+	bool wasBacklogged = mPendingBytes > mBacklogLimit;
+	ListInfo& info = mListMap[list];
+	bool isNew = info.since == 0;
+	if (isNew) {
+		info.since = system_time();
 		BM_LOG( BM_LogMailTracking, 
-				  BmString("StoredActionFlusher: adding list-model <")	
-				  		<< list->ModelName());
-		if (mListSet.insert(list).second == true) {
-			BM_LOG( BM_LogMailTracking, 
-					  BmString("StoredActionFlusher: added list-model <")	
-					  		<< list->ModelName() 
-					  		<< ">\nnumber of lists to be flushed is " 
-					  		<< mListSet.size());
-		}
+				  BmString("StoredActionFlusher: added list-model <")	
+				  		<< list->ModelName() 
+				  		<< ">\nnumber of lists to be flushed is " 
+				  		<< mListMap.size());
+	}
+	info.pendingBytes += actionSize;
+	mPendingBytes += actionSize;
+	bool isBacklogged = mPendingBytes > mBacklogLimit;
+	mLocker.Unlock();
+	// the flusher only needs to be woken if there is something new to do:
+	if (isNew || isBacklogged != wasBacklogged)
+		release_sem(mWakeupSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	IsBacklogged()
+		-	returns whether the pending actions of all lists exceed the 
+			backlog limit (pref "StoredActionBacklogLimit", in KB)
+\*------------------------------------------------------------------------------*/
+bool BmStoredActionFlusher::IsBacklogged() {
+	BmAutolockCheckGlobal lock( &mLocker);
+	return lock.IsLocked() && mShouldRun && mPendingBytes > mBacklogLimit;
+}
+
+/*------------------------------------------------------------------------------*\
+	WaitForBacklog( list)
+		-	waits (for a short while at most) until the flusher has flushed
+			another list
+		-	the caller holds the lock of the given list, so there's no point
+			in waiting if the flusher is busy with that very list
+\*------------------------------------------------------------------------------*/
+void BmStoredActionFlusher::WaitForBacklog( BmListModel* list) {
+	if (!mLocker.Lock())
+		return;
+	if (!mShouldRun || mPendingBytes <= mBacklogLimit || mCurrentList == list) {
+		mLocker.Unlock();
+		return;
+	}
+	mWaiterCount++;
+	mLocker.Unlock();
+	status_t err;
+	do {
+		err = acquire_sem_etc(mBackpressureSem, 1, B_RELATIVE_TIMEOUT,
+									 nMaxBackpressureWait);
+	} while( err == B_INTERRUPTED);
+	if (mLocker.Lock()) {
+		mWaiterCount--;
 		mLocker.Unlock();
 	}
 }
@@ -143,6 +286,12 @@ void BmStoredActionFlusher::_FlushList( BmRef<BmListModel>& list) {
 				  BmString("StoredActionFlusher: flushing list-model ")	
 				  		<< list->ModelName());
 		list->FlushStoredActions();
+		if (list->JournalNeedsCompaction()) {
+			BM_LOG( BM_LogMailTracking, 
+					  BmString("StoredActionFlusher: compacting journal of "
+					  	"list-model ") << list->ModelName());
+			list->CompactJournal();
+		}
 	}
 	catch( BM_error &err) {
 		// a problem occurred, we tell the user:
@@ -156,12 +305,61 @@ void BmStoredActionFlusher::_FlushList( BmRef<BmListModel>& list) {
 // #pragma mark - BmStoredActionManager
 // 	-	a class that manages a set of stored actions
 //		-	actions are cached up to a specified maximum amount and are written
-//			to disk (appended to the settings-/cache-file) once this amount
+//			to disk (appended to the list's journal) once this amount
 //			is exceeded.
 //		-	every BmListModel delegates the writing of stored actions to its
 //			own BmStoredActionManager.
 //******************************************************************************
 
+/*------------------------------------------------------------------------------*\
+	every record in the journal consists of this header, followed by the 
+	flattened action (the payload)
+\*------------------------------------------------------------------------------*/
+struct BmJournalRecordHeader {
+	uint32 magic;
+	uint32 size;
+	int64 sequence;
+	uint32 checksum;
+	uint32 reserved;
+};
+
+static const uint32 nJournalRecordMagic = 'BmJr';
+
+// journals smaller than this are never compacted:
+static const off_t nMinCompactionSize = 64*1024;
+
+/*------------------------------------------------------------------------------*\
+	BmCrc32Table
+		-	the lookup-table for the CRC-32 (as used by zlib)
+		-	the table is built during static initialization, as flushes may
+			happen from several threads at once
+\*------------------------------------------------------------------------------*/
+struct BmCrc32Table {
+	BmCrc32Table() {
+		for( uint32 i=0; i<256; ++i) {
+			uint32 c = i;
+			for( int k=0; k<8; ++k)
+				c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+			entries[i] = c;
+		}
+	}
+	uint32 entries[256];
+};
+
+static const BmCrc32Table nCrc32Table;
+
+/*------------------------------------------------------------------------------*\
+	Crc32( data, len)
+		-	computes the CRC-32 (as used by zlib) of the given data
+\*------------------------------------------------------------------------------*/
+static uint32 Crc32( const void* data, size_t len) {
+	const uint8* bytes = static_cast<const uint8*>( data);
+	uint32 crc = 0xFFFFFFFFUL;
+	for( size_t i=0; i<len; ++i)
+		crc = nCrc32Table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFUL;
+}
+
 /*------------------------------------------------------------------------------*\
 	BmStoredActionManager()
 		-	
@@ -169,6 +367,10 @@ void BmStoredActionFlusher::_FlushList( BmRef<BmListModel>& list) {
 BmStoredActionManager::BmStoredActionManager(BmListModel* list)
 	:	mList(list)
 	,	mMaxCacheSize(1)
+	,	mBaseSequence(-1)
+	,	mBaseSequenceKnown(false)
+	,	mNextSequence(0)
+	,	mJournalChecked(false)
 {
 }
 
@@ -180,9 +382,20 @@ BmStoredActionManager::~BmStoredActionManager()
 {
 }
 
+/*------------------------------------------------------------------------------*\
+	_JournalFileName()
+		-	returns the name of the journal-file that belongs to our list
+\*------------------------------------------------------------------------------*/
+BmString BmStoredActionManager::_JournalFileName() const
+{
+	BmString journalName = mList->SettingsFileName();
+	return journalName << ".journal";
+}
+
 /*------------------------------------------------------------------------------*\
 	StoreAction()
-		-	adds given archive at end of settings-file
+		-	adds given archive to the actions that will be appended to the 
+			journal
 \*------------------------------------------------------------------------------*/
 bool BmStoredActionManager::StoreAction(BMessage* action)
 {
@@ -191,19 +404,27 @@ bool BmStoredActionManager::StoreAction(BMessage* action)
 		BM_THROW_RUNTIME( "StoreAction(): Unable to get lock");
 	bool result = true;
 	mActionVect.push_back(action);
-	if (mActionVect.size() >= mMaxCacheSize)
+	int32 actionSize = action->FlattenedSize();
+	// while the flusher can't keep up, we write through to the journal, 
+	// such that the cached actions do not pile up:
+	bool backlogged 
+		= TheStoredActionFlusher && TheStoredActionFlusher->IsBacklogged();
+	if (mActionVect.size() >= mMaxCacheSize || backlogged)
 		result = Flush();
-	else if (TheStoredActionFlusher) {
+	if (TheStoredActionFlusher) {
 		// add our list to the flusher, such that it will be flushed to disk
-		// automatically at an appropriate time:
-		TheStoredActionFlusher->AddList(mList);
+		// (and the journal will be compacted) automatically at an appropriate 
+		// time:
+		TheStoredActionFlusher->AddList(mList, actionSize);
+		if (backlogged)
+			TheStoredActionFlusher->WaitForBacklog(mList);
 	}		
 	return result;
 }
 
 /*------------------------------------------------------------------------------*\
 	Flush()
-		-	appends all stored actions to the settings-file
+		-	appends all stored actions to the journal
 \*------------------------------------------------------------------------------*/
 bool BmStoredActionManager::Flush()
 {
@@ -221,43 +442,225 @@ bool BmStoredActionManager::Flush()
 		BM_LOG( BM_LogMailTracking, 
 				  BmString("Flushing stored actions for list-model ")
 				  		<< mList->ModelName());
+		BmString filename = mList->SettingsFileName();
+		BEntry cacheEntry( filename.String());
+		if (!cacheEntry.Exists()) {
+			// cache-file does not exist yet, we try to create it through Store():
+			mList->Store();
+			if (!cacheEntry.Exists()) {
+				// Store() didn't create any file, so there's no point in keeping
+				// a journal. This is normal behaviour in case the list has not
+				// been read yet (which means that the list is incomplete, so we 
+				// won't write a (incomplete) cache-file:
+				for( uint32 i=0; i<mActionVect.size(); ++i)
+					delete mActionVect[i];
+				mActionVect.clear();
+				return false;
+			}
+		}
+		if (!mJournalChecked) {
+			// cut off any damaged records (left behind by a crash) and find
+			// out which sequence number to continue with:
+			_ProcessJournal( false);
+		}
+		int64 sequence = mNextSequence;
 		BMallocIO mallocIO;
 		mallocIO.SetBlockSize(mActionVect.size()*1024);
-		BMessage* action;
+		BMallocIO payloadIO;
+		BmJournalRecordHeader header;
 		for( uint32 i=0; i<mActionVect.size(); ++i) {
-			action = mActionVect[i];
-			if ((err = action->Flatten( &mallocIO)) != B_OK)
+			payloadIO.Seek( 0, SEEK_SET);
+			payloadIO.SetSize( 0);
+			if ((err = mActionVect[i]->Flatten( &payloadIO)) != B_OK)
 				BM_THROW_RUNTIME( 
 					BmString("Could not flatten stored actions\n\n Result: ") 
 						<< strerror(err)
 				);
-			delete action;
-		}
-		mActionVect.clear();
-		BmString filename = mList->SettingsFileName();
-		err = file.SetTo( filename.String(), B_WRITE_ONLY | B_OPEN_AT_END);
-		if (err == B_ENTRY_NOT_FOUND) {
-			// file does not exist yet, we try to create it through Store():
-			mList->Store();
-			if ((err = file.SetTo( 
-				filename.String(), 
-				B_WRITE_ONLY | B_OPEN_AT_END
-			))	!= B_OK) {
-				// Store() didn't create any file, so we can't append to it. This
-				// is normal behaviour in case the list has not been read yet (which
-				// means that the list is incomplete, so we won't write a (incomplete)
-				// cache-file:
-				return false;
-			}
+			header.magic = nJournalRecordMagic;
+			header.size = payloadIO.BufferLength();
+			header.sequence = sequence++;
+			header.checksum = Crc32( payloadIO.Buffer(), header.size);
+			header.reserved = 0;
+			mallocIO.Write( &header, sizeof( header));
+			mallocIO.Write( payloadIO.Buffer(), header.size);
 		}
+		BmString journalName = _JournalFileName();
+		err = file.SetTo( journalName.String(), 
+								B_WRITE_ONLY | B_CREATE_FILE | B_OPEN_AT_END);
+		if (err != B_OK)
+			BM_THROW_RUNTIME( BmString("Could not open journal\n\t<")
+									 	<< journalName << ">\n\n Result: " 
+									 	<< strerror(err));
 		ssize_t sz = file.Write( mallocIO.Buffer(), mallocIO.BufferLength());
-		if (sz < 0)
-			BM_THROW_RUNTIME( BmString("Could not write to settings-file\n\t<")
-									 	<< filename << ">\n\n Result: " 
-									 	<< strerror(sz));
+		if (sz != (ssize_t)mallocIO.BufferLength()) {
+			// the journal may have been damaged, so we have to check it before
+			// we write to it again:
+			mJournalChecked = false;
+			BM_THROW_RUNTIME( BmString("Could not write to journal\n\t<")
+									 	<< journalName << ">\n\n Result: " 
+									 	<< strerror(sz < 0 ? status_t(sz) : B_IO_ERROR));
+		}
+		for( uint32 i=0; i<mActionVect.size(); ++i)
+			delete mActionVect[i];
+		mActionVect.clear();
+		mNextSequence = sequence;
 		return true;
 	} catch( BM_error &e) {
 		BM_SHOWERR( e.what());
 		return false;
 	}
 }
+
+/*------------------------------------------------------------------------------*\
+	ReplayJournal()
+		-	executes all actions from the journal that are not yet contained
+			in the cache-file
+		-	returns the number of actions that have been executed
+\*------------------------------------------------------------------------------*/
+int32 BmStoredActionManager::ReplayJournal()
+{
+	BmAutolockCheckGlobal lock( mList->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "ReplayJournal(): Unable to get lock");
+	Flush();
+	return _ProcessJournal( true);
+}
+
+/*------------------------------------------------------------------------------*\
+	_ProcessJournal( execute)
+		-	walks through all records of the journal, checking each of them
+		-	if execute is true, the actions of all records with a sequence number 
+			beyond the one of the cache-file are executed
+		-	the journal is truncated behind the last intact record
+		-	returns the number of actions that have been executed
+\*------------------------------------------------------------------------------*/
+int32 BmStoredActionManager::_ProcessJournal(bool execute)
+{
+	BmString journalName = _JournalFileName();
+	if (!mBaseSequenceKnown)
+		_ReadBaseSequence();
+	int32 count = 0;
+	off_t validEnd = 0;
+	off_t size = 0;
+	int64 lastSequence = -1;
+	{	// scope for mapping
+		BmMappedFile journal;
+		if (journal.SetTo( journalName.String()) == B_OK) {
+			const char* data = journal.Data();
+			size = journal.Size();
+			BmJournalRecordHeader header;
+			BMessage action;
+			while( validEnd + (off_t)sizeof( header) <= size) {
+				memcpy( &header, data + validEnd, sizeof( header));
+				const char* payload = data + validEnd + sizeof( header);
+				if (header.magic != nJournalRecordMagic
+				|| header.size > size - validEnd - sizeof( header)
+				|| header.checksum != Crc32( payload, header.size)
+				|| (lastSequence >= 0 && header.sequence != lastSequence+1))
+					break;
+				if (execute && header.sequence > mBaseSequence) {
+					if (action.Unflatten( payload) != B_OK)
+						break;
+					mList->ExecuteAction( &action);
+					count++;
+				}
+				lastSequence = header.sequence;
+				validEnd += sizeof( header) + header.size;
+			}
+		}
+	}
+	if (lastSequence >= 0 && lastSequence <= mBaseSequence) {
+		// all records are contained in the cache-file already (we crashed
+		// after storing the list, but before the journal was removed), the
+		// journal is dropped, as new records would leave a gap otherwise:
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("Journal <") << journalName << "> is outdated, "
+				  		<< "removing it.");
+		BEntry( journalName.String()).Remove();
+		validEnd = size = 0;
+		lastSequence = -1;
+	}
+	if (validEnd < size) {
+		BM_LOGERR( BmString("Journal <") << journalName << "> is damaged, "
+						<< "cutting off the last " << size-validEnd << " bytes.");
+		BFile file( journalName.String(), B_WRITE_ONLY);
+		file.SetSize( validEnd);
+	}
+	// continue behind the last record, whether that lives in the journal or
+	// in the cache-file:
+	mNextSequence = MAX( lastSequence, mBaseSequence) + 1;
+	mJournalChecked = true;
+	BM_LOG( BM_LogMailTracking, 
+			  BmString("Journal of list-model ") << mList->ModelName() 
+			  		<< ": " << count << " actions replayed");
+	return count;
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveJournal()
+		-	removes the journal, which must be done right after the list has
+			been stored (as all actions are now contained in the cache-file)
+		-	the sequence numbers continue where they were, such that a crash
+			between the storing of the list and the removal of the journal 
+			does not do any harm
+\*------------------------------------------------------------------------------*/
+void BmStoredActionManager::RemoveJournal()
+{
+	BmAutolockCheckGlobal lock( mList->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "RemoveJournal(): Unable to get lock");
+	BEntry entry( _JournalFileName().String());
+	if (entry.Exists())
+		entry.Remove();
+	mBaseSequence = LastSequence();
+	mBaseSequenceKnown = true;
+	mJournalChecked = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ReadBaseSequence()
+		-	fetches the sequence number of the last record contained in the 
+			cache-file from the archive at the start of the cache-file
+		-	this is needed when actions are stored for a list that has not
+			been read yet (otherwise the list has told us about it already)
+\*------------------------------------------------------------------------------*/
+void BmStoredActionManager::_ReadBaseSequence()
+{
+	BFile cacheFile( mList->SettingsFileName().String(), B_READ_ONLY);
+	BMessage archive;
+	int64 baseSequence;
+	if (cacheFile.InitCheck() == B_OK
+	&& archive.Unflatten( &cacheFile) == B_OK
+	&& archive.FindInt64( BmListModel::MSG_JOURNAL_SEQ, &baseSequence) == B_OK)
+		BaseSequence( baseSequence);
+}
+
+/*------------------------------------------------------------------------------*\
+	GetJournalModificationTime( mtime)
+		-	determines the time when the journal has last been written to
+\*------------------------------------------------------------------------------*/
+status_t BmStoredActionManager::GetJournalModificationTime(time_t* mtime)
+{
+	BEntry journalEntry( _JournalFileName().String());
+	return journalEntry.GetModificationTime( mtime);
+}
+
+/*------------------------------------------------------------------------------*\
+	JournalNeedsCompaction()
+		-	returns whether or not the journal has grown large enough (in 
+			relation to the cache-file) to be folded into the cache-file
+\*------------------------------------------------------------------------------*/
+bool BmStoredActionManager::JournalNeedsCompaction()
+{
+	off_t journalSize = 0;
+	BEntry journalEntry( _JournalFileName().String());
+	if (journalEntry.GetSize( &journalSize) != B_OK 
+	|| journalSize < nMinCompactionSize)
+		return false;
+	off_t cacheSize = 0;
+	BEntry cacheEntry( mList->SettingsFileName().String());
+	if (cacheEntry.GetSize( &cacheSize) != B_OK)
+		return false;
+	int32 percent = ThePrefs->GetInt( "JournalCompactionPercent", 25);
+	return journalSize * 100 >= cacheSize * percent;
+}
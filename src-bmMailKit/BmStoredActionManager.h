@@ -11,17 +11,27 @@
 
 #include "BmMailKit.h"
 
-#include <set>
+#include <map>
 #include <vector>
 
 #include "BmRefManager.h"
+#include "BmString.h"
 
-using std::set;
+using std::map;
 using std::vector;
 
 class BmListModel;
 /*------------------------------------------------------------------------------*\
 	BmStoredActionFlusher
+		-	flushes the stored actions of lists to disk (and compacts their 
+			journals) in a thread of its own
+		-	lists are flushed when the mail-monitor is idle, when their oldest
+			unflushed action has reached the flush deadline, or when the 
+			pending actions of all lists exceed the backlog limit. Lists with
+			the most pending bytes are flushed first.
+		-	while the backlog limit is exceeded, lists write their actions 
+			through to the journal and wait a little for the flusher to 
+			catch up (backpressure)
 \*------------------------------------------------------------------------------*/
 class IMPEXPBMMAILKIT BmStoredActionFlusher {
 
@@ -31,21 +41,40 @@ public:
 	void Run();
 	void Quit();
 	//
-	void AddList( BmRef<BmListModel> list);
+	void AddList( BmRef<BmListModel> list, int32 actionSize);
+	bool IsBacklogged();
+	void WaitForBacklog( BmListModel* list);
 
 	static BmStoredActionFlusher* theInstance;
 private:
 	//	native methods:
 	BmStoredActionFlusher();
 	void _Loop();
+	bigtime_t _PickLists( vector< BmRef<BmListModel> >& outLists);
 	void _FlushList( BmRef<BmListModel>& list);
 	//
 	static int32 _ThreadEntry(void* data);
 
-	typedef set< BmRef< BmListModel> > ListSet;
-	ListSet mListSet;
+	struct ListInfo {
+		ListInfo() : pendingBytes(0), since(0) {}
+		int64 pendingBytes;
+							// size of the actions stored since the last flush
+		bigtime_t since;
+							// time when the oldest of these actions was stored
+	};
+	typedef map< BmRef< BmListModel>, ListInfo> ListMap;
+	ListMap mListMap;
+	int64 mPendingBytes;
+							// sum of pending bytes over all lists
+	int64 mBacklogLimit;
+	BmListModel* mCurrentList;
+							// the list that is being flushed right now
 
 	BLocker mLocker;
+	sem_id mWakeupSem;
+	sem_id mBackpressureSem;
+	int32 mWaiterCount;
+							// number of threads waiting for the backlog to shrink
 	bool mShouldRun;
 	thread_id mThreadId;
 
@@ -58,6 +87,15 @@ private:
 
 /*------------------------------------------------------------------------------*\
 	BmStoredActionManager
+		-	writes the stored actions of a list into a journal that lives next
+			to the list's cache-file (with the suffix ".journal")
+		-	every journal record carries a sequence number and a checksum, 
+			replaying stops at the first record that is damaged or out of 
+			sequence (which is what a crash in the middle of a write leaves 
+			behind)
+		-	the cache-file remembers the sequence number of the last record 
+			it contains, so records that have already been folded into the 
+			cache are skipped during replay
 \*------------------------------------------------------------------------------*/
 class IMPEXPBMMAILKIT BmStoredActionManager {
 	typedef vector<BMessage*> ActionVect;
@@ -68,12 +106,38 @@ public:
 	bool StoreAction(BMessage* action);
 	bool Flush();
 	//
+	int32 ReplayJournal();
+	void RemoveJournal();
+	bool JournalNeedsCompaction();
+	status_t GetJournalModificationTime(time_t* mtime);
+	//
 	void MaxCacheSize(uint32 maxCacheSize)
 													{ mMaxCacheSize = maxCacheSize; }
+	void BaseSequence(int64 baseSequence)
+													{ mBaseSequence = baseSequence;
+													  mBaseSequenceKnown = true; }
+	int64 LastSequence() const			{ return MAX( mNextSequence-1, 
+																	mBaseSequence); }
 private:
+	BmString _JournalFileName() const;
+	int32 _ProcessJournal(bool execute);
+	void _ReadBaseSequence();
+
 	ActionVect mActionVect;
 	BmListModel* mList;
 	uint32 mMaxCacheSize;
+	int64 mBaseSequence;
+							// sequence number of the last record contained
+							// in the cache-file
+	bool mBaseSequenceKnown;
+							// whether or not mBaseSequence has been read from
+							// the cache-file
+	int64 mNextSequence;
+							// sequence number of the next record to be written
+							// (only valid once the journal has been checked)
+	bool mJournalChecked;
+							// whether or not the journal has been checked
+							// (and repaired if necessary) since it was opened
 };
 	
 #endif
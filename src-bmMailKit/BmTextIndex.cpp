@@ -0,0 +1,855 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "BmTextIndex.h"
+
+using std::back_inserter;
+using std::set_intersection;
+using std::sort;
+using std::unique;
+
+static const char nIndexMagic[] = "BmTi";
+static const char nIndexEndMagic[] = "BmTe";
+static const uint32_t nIndexVersion = 1;
+
+static const uint32_t nMaxPartDepth = 20;
+
+//******************************************************************************
+// #pragma mark - static helpers
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	AppendVarint( str, value)
+		-	appends the given value as a varint (7 bits per byte, the high bit
+			indicates that more bytes follow)
+\*------------------------------------------------------------------------------*/
+static void AppendVarint( string& str, uint64_t value) {
+	while( value >= 0x80) {
+		str += (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	str += (char)value;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadVarint( data, len, pos, outValue)
+		-	reads a varint from the given position, advancing it
+		-	returns false if the data ends prematurely
+\*------------------------------------------------------------------------------*/
+static bool ReadVarint( const char* data, size_t len, size_t& pos,
+								uint64_t& outValue) {
+	outValue = 0;
+	for( uint32_t shift=0; pos < len && shift < 64; shift += 7) {
+		unsigned char c = (unsigned char)data[pos++];
+		outValue |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	AppendUint64( str, value)
+		-	appends the given value in little-endian byte-order
+\*------------------------------------------------------------------------------*/
+static void AppendUint64( string& str, uint64_t value) {
+	for( int i=0; i<8; ++i) {
+		str += (char)(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadUint64( data, len, pos, outValue)
+		-	reads a little-endian value from the given position, advancing it
+\*------------------------------------------------------------------------------*/
+static bool ReadUint64( const char* data, size_t len, size_t& pos,
+								uint64_t& outValue) {
+	if (len - pos < 8)
+		return false;
+	outValue = 0;
+	for( int i=7; i>=0; --i)
+		outValue = (outValue << 8) | (unsigned char)data[pos+i];
+	pos += 8;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ToLower( str)
+		-	returns the given string with all ASCII-letters in lowercase
+\*------------------------------------------------------------------------------*/
+static string ToLower( const string& str) {
+	string result( str);
+	for( size_t i=0; i<result.size(); ++i) {
+		if (result[i] >= 'A' && result[i] <= 'Z')
+			result[i] += 'a' - 'A';
+	}
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	Trim( str)
+		-	returns the given string without leading and trailing whitespace
+\*------------------------------------------------------------------------------*/
+static string Trim( const string& str) {
+	size_t start = str.find_first_not_of( " \t\r\n");
+	if (start == string::npos)
+		return string();
+	size_t end = str.find_last_not_of( " \t\r\n");
+	return str.substr( start, end-start+1);
+}
+
+/*------------------------------------------------------------------------------*\
+	DecodeBase64( in, out)
+		-	decodes the given base64-text, ignoring any invalid characters
+\*------------------------------------------------------------------------------*/
+static void DecodeBase64( const string& in, string& out) {
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for( size_t i=0; i<in.size(); ++i) {
+		char c = in[i];
+		int val;
+		if (c >= 'A' && c <= 'Z')
+			val = c - 'A';
+		else if (c >= 'a' && c <= 'z')
+			val = c - 'a' + 26;
+		else if (c >= '0' && c <= '9')
+			val = c - '0' + 52;
+		else if (c == '+')
+			val = 62;
+		else if (c == '/')
+			val = 63;
+		else if (c == '=')
+			break;
+		else
+			continue;
+		bits = (bits << 6) | val;
+		bitCount += 6;
+		if (bitCount >= 8) {
+			bitCount -= 8;
+			out += (char)((bits >> bitCount) & 0xFF);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	HexValue( c)
+		-	returns the value of the given hex-digit or -1
+\*------------------------------------------------------------------------------*/
+static int HexValue( char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+/*------------------------------------------------------------------------------*\
+	DecodeQuotedPrintable( in, out, underscoreIsSpace)
+		-	decodes the given quoted-printable text (underscores are converted
+			to spaces when decoding encoded-words)
+\*------------------------------------------------------------------------------*/
+static void DecodeQuotedPrintable( const string& in, string& out,
+											  bool underscoreIsSpace) {
+	for( size_t i=0; i<in.size(); ++i) {
+		char c = in[i];
+		if (c == '=') {
+			if (i+2 < in.size() && HexValue( in[i+1]) >= 0
+			&& HexValue( in[i+2]) >= 0) {
+				out += (char)(HexValue( in[i+1])*16 + HexValue( in[i+2]));
+				i += 2;
+			} else {
+				// soft line-break:
+				while( i+1 < in.size() && (in[i+1] == ' ' || in[i+1] == '\t'))
+					++i;
+				if (i+1 < in.size() && in[i+1] == '\r')
+					++i;
+				if (i+1 < in.size() && in[i+1] == '\n')
+					++i;
+			}
+		} else if (c == '_' && underscoreIsSpace)
+			out += ' ';
+		else
+			out += c;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	AppendInUtf8( in, charset, out)
+		-	appends the given text to out, converting it to UTF-8 if it is
+			in one of the latin-1 charsets (which cover most of the mails that
+			aren't UTF-8 already)
+		-	text in any other charset is appended unchanged, the index works
+			on the raw bytes
+\*------------------------------------------------------------------------------*/
+static void AppendInUtf8( const string& in, const string& charset,
+								  string& out) {
+	string cs = ToLower( charset);
+	if (cs != "iso-8859-1" && cs != "iso-8859-15" && cs != "latin1"
+	&& cs != "windows-1252") {
+		out += in;
+		return;
+	}
+	for( size_t i=0; i<in.size(); ++i) {
+		unsigned char c = (unsigned char)in[i];
+		if (c < 0x80)
+			out += (char)c;
+		else {
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	DecodeEncodedWords( in)
+		-	returns the given header-value with all encoded-words decoded
+\*------------------------------------------------------------------------------*/
+static string DecodeEncodedWords( const string& in) {
+	string out;
+	size_t pos = 0;
+	while( pos < in.size()) {
+		size_t start = in.find( "=?", pos);
+		if (start == string::npos)
+			break;
+		size_t encPos = in.find( '?', start+2);
+		size_t textPos = encPos == string::npos
+								? string::npos
+								: in.find( '?', encPos+1);
+		size_t end = textPos == string::npos
+								? string::npos
+								: in.find( "?=", textPos+1);
+		if (end == string::npos || textPos != encPos+2)
+			break;
+		out.append( in, pos, start-pos);
+		string charset = in.substr( start+2, encPos-start-2);
+		string text = in.substr( textPos+1, end-textPos-1);
+		string decoded;
+		char enc = in[encPos+1];
+		if (enc == 'b' || enc == 'B')
+			DecodeBase64( text, decoded);
+		else
+			DecodeQuotedPrintable( text, decoded, true);
+		AppendInUtf8( decoded, charset, out);
+		pos = end+2;
+	}
+	out.append( in, pos, string::npos);
+	return out;
+}
+
+/*------------------------------------------------------------------------------*\
+	StripHtml( in, out)
+		-	appends the text contained in the given html to out, tags are
+			replaced by spaces and the most common entities are decoded
+\*------------------------------------------------------------------------------*/
+static void StripHtml( const string& in, string& out) {
+	bool inTag = false;
+	for( size_t i=0; i<in.size(); ++i) {
+		char c = in[i];
+		if (inTag) {
+			if (c == '>') {
+				inTag = false;
+				out += ' ';
+			}
+		} else if (c == '<')
+			inTag = true;
+		else if (c == '&') {
+			size_t semi = in.find( ';', i);
+			if (semi != string::npos && semi-i <= 8) {
+				string entity = ToLower( in.substr( i+1, semi-i-1));
+				if (entity == "amp")
+					out += '&';
+				else if (entity == "lt")
+					out += '<';
+				else if (entity == "gt")
+					out += '>';
+				else
+					out += ' ';
+				i = semi;
+			} else
+				out += c;
+		} else
+			out += c;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	HeaderParam( value, name)
+		-	returns the given parameter of a structured header-value
+			(e.g. the boundary of a content-type)
+\*------------------------------------------------------------------------------*/
+static string HeaderParam( const string& value, const string& name) {
+	string lowerValue = ToLower( value);
+	size_t pos = 0;
+	while( (pos = lowerValue.find( name, pos)) != string::npos) {
+		size_t eq = pos + name.size();
+		while( eq < value.size() && (value[eq] == ' ' || value[eq] == '\t'))
+			++eq;
+		bool atStart = pos == 0 || value[pos-1] == ';' || value[pos-1] == ' '
+							|| value[pos-1] == '\t';
+		if (!atStart || eq >= value.size() || value[eq] != '=') {
+			pos = eq;
+			continue;
+		}
+		++eq;
+		while( eq < value.size() && (value[eq] == ' ' || value[eq] == '\t'))
+			++eq;
+		if (eq < value.size() && value[eq] == '"') {
+			size_t end = value.find( '"', eq+1);
+			return value.substr( eq+1,
+										end == string::npos ? string::npos : end-eq-1);
+		}
+		size_t end = value.find_first_of( "; \t\r\n", eq);
+		return value.substr( eq, end == string::npos ? string::npos : end-eq);
+	}
+	return string();
+}
+
+/*------------------------------------------------------------------------------*\
+	SplitHeader( part, outHeaders, outBody)
+		-	splits the given part into its (unfolded) header-fields and its body
+		-	header-names are lowercased, only the first occurrence of every
+			field is kept
+\*------------------------------------------------------------------------------*/
+static void SplitHeader( const string& part, map< string, string>& outHeaders,
+								 string& outBody) {
+	size_t pos = 0;
+	string lastName;
+	while( pos < part.size()) {
+		size_t eol = part.find( '\n', pos);
+		size_t lineEnd = eol == string::npos ? part.size() : eol;
+		string line = part.substr( pos, lineEnd-pos);
+		if (!line.empty() && line[line.size()-1] == '\r')
+			line.erase( line.size()-1);
+		pos = eol == string::npos ? part.size() : eol+1;
+		if (line.empty())
+			break;
+		if (line[0] == ' ' || line[0] == '\t') {
+			// continuation of the previous field:
+			if (!lastName.empty())
+				outHeaders[lastName] += " " + Trim( line);
+			continue;
+		}
+		size_t colon = line.find( ':');
+		if (colon == string::npos) {
+			lastName.erase();
+			continue;
+		}
+		string name = ToLower( Trim( line.substr( 0, colon)));
+		if (outHeaders.find( name) != outHeaders.end()) {
+			lastName.erase();
+			continue;
+		}
+		outHeaders[name] = Trim( line.substr( colon+1));
+		lastName = name;
+	}
+	outBody = part.substr( pos);
+}
+
+static void ExtractPartText( const string& part, bool isMessage,
+									  uint32_t depth, string& outText);
+
+/*------------------------------------------------------------------------------*\
+	ExtractMultipartText( body, boundary, depth, outText)
+		-	extracts the text of all sub-parts of the given multipart-body
+\*------------------------------------------------------------------------------*/
+static void ExtractMultipartText( const string& body, const string& boundary,
+											 uint32_t depth, string& outText) {
+	string delimiter = "--" + boundary;
+	size_t partStart = string::npos;
+	size_t pos = 0;
+	while( pos < body.size()) {
+		size_t eol = body.find( '\n', pos);
+		size_t lineEnd = eol == string::npos ? body.size() : eol;
+		if (body.compare( pos, delimiter.size(), delimiter) == 0) {
+			if (partStart != string::npos)
+				ExtractPartText( body.substr( partStart, pos-partStart), false,
+									  depth+1, outText);
+			if (body.compare( pos+delimiter.size(), 2, "--") == 0)
+				return;
+			partStart = eol == string::npos ? body.size() : eol+1;
+		}
+		pos = lineEnd+1;
+	}
+	// no closing delimiter, we take what we have:
+	if (partStart != string::npos && partStart < body.size())
+		ExtractPartText( body.substr( partStart), false, depth+1, outText);
+}
+
+/*------------------------------------------------------------------------------*\
+	ExtractPartText( part, isMessage, depth, outText)
+		-	appends the decoded text contained in the given part to outText
+		-	for messages (top-level or message/rfc822), the subject and the
+			address-fields are included, too
+\*------------------------------------------------------------------------------*/
+static void ExtractPartText( const string& part, bool isMessage,
+									  uint32_t depth, string& outText) {
+	if (depth > nMaxPartDepth)
+		return;
+	map< string, string> headers;
+	string body;
+	SplitHeader( part, headers, body);
+	if (isMessage) {
+		const char* fields[] = { "subject", "from", "to", "cc", NULL };
+		for( int i=0; fields[i]; ++i) {
+			map< string, string>::const_iterator iter = headers.find( fields[i]);
+			if (iter != headers.end())
+				outText += DecodeEncodedWords( iter->second) + "\n";
+		}
+	}
+	string contentType = ToLower( headers["content-type"]);
+	string mimeType = Trim( contentType.substr( 0, contentType.find( ';')));
+	if (mimeType.empty())
+		mimeType = "text/plain";
+	if (mimeType.compare( 0, 10, "multipart/") == 0) {
+		string boundary = HeaderParam( headers["content-type"], "boundary");
+		if (!boundary.empty())
+			ExtractMultipartText( body, boundary, depth, outText);
+		return;
+	}
+	if (mimeType == "message/rfc822") {
+		ExtractPartText( body, true, depth+1, outText);
+		return;
+	}
+	if (mimeType.compare( 0, 5, "text/") != 0)
+		return;
+	string encoding = ToLower( Trim( headers["content-transfer-encoding"]));
+	string decoded;
+	if (encoding == "base64")
+		DecodeBase64( body, decoded);
+	else if (encoding == "quoted-printable")
+		DecodeQuotedPrintable( body, decoded, false);
+	else
+		decoded = body;
+	string charset = HeaderParam( headers["content-type"], "charset");
+	if (mimeType == "text/html") {
+		string stripped;
+		StripHtml( decoded, stripped);
+		AppendInUtf8( stripped, charset, outText);
+	} else
+		AppendInUtf8( decoded, charset, outText);
+	outText += "\n";
+}
+
+//******************************************************************************
+// #pragma mark - BmTextIndex
+//******************************************************************************
+
+/*------------------------------------------------------------------------------*\
+	BmTextIndex()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmTextIndex::BmTextIndex()
+	:	mLiveDocCount( 0)
+	,	mModified( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmTextIndex()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmTextIndex::~BmTextIndex() {
+}
+
+/*------------------------------------------------------------------------------*\
+	AddDocument( key, text)
+		-	adds the words of the given text to the index, such that searching
+			for them yields the given key
+		-	if a document with the given key exists, it is replaced
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::AddDocument( DocKey key, const string& text) {
+	RemoveDocument( key);
+	uint32_t docId = mDocKeys.size();
+	mDocKeys.push_back( key);
+	mDocIsDead.push_back( false);
+	mDocIdForKey[key] = docId;
+	mLiveDocCount++;
+	mModified = true;
+
+	vector< string> tokens;
+	Tokenize( text, tokens);
+	sort( tokens.begin(), tokens.end());
+	tokens.erase( unique( tokens.begin(), tokens.end()), tokens.end());
+	for( uint32_t i=0; i<tokens.size(); ++i)
+		_AddTerm( tokens[i], docId);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveDocument( key)
+		-	removes the document with the given key from the index
+		-	returns false if there was no such document
+\*------------------------------------------------------------------------------*/
+bool BmTextIndex::RemoveDocument( DocKey key) {
+	DocIdMap::iterator iter = mDocIdForKey.find( key);
+	if (iter == mDocIdForKey.end())
+		return false;
+	mDocIsDead[iter->second] = true;
+	mDocIdForKey.erase( iter);
+	mLiveDocCount--;
+	mModified = true;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	UpdateDocument( key, text)
+		-	replaces the text of the document with the given key
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::UpdateDocument( DocKey key, const string& text) {
+	AddDocument( key, text);
+}
+
+/*------------------------------------------------------------------------------*\
+	HasDocument( key)
+		-	returns whether or not a document with the given key is indexed
+\*------------------------------------------------------------------------------*/
+bool BmTextIndex::HasDocument( DocKey key) const {
+	return mDocIdForKey.find( key) != mDocIdForKey.end();
+}
+
+/*------------------------------------------------------------------------------*\
+	AllDocuments( outKeys)
+		-	fills outKeys with the keys of all indexed documents
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::AllDocuments( DocKeyVect& outKeys) const {
+	outKeys.clear();
+	outKeys.reserve( mDocIdForKey.size());
+	DocIdMap::const_iterator iter;
+	for( iter = mDocIdForKey.begin(); iter != mDocIdForKey.end(); ++iter)
+		outKeys.push_back( iter->first);
+}
+
+/*------------------------------------------------------------------------------*\
+	Search( query, outKeys)
+		-	fills outKeys with the keys of all documents that contain every
+			word of the given query
+		-	a word ending in '*' matches all words starting with it
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::Search( const string& query, DocKeyVect& outKeys) const {
+	outKeys.clear();
+	DocIdVect result;
+	bool first = true;
+	size_t pos = 0;
+	while( pos < query.size()) {
+		size_t start = query.find_first_not_of( " \t\r\n", pos);
+		if (start == string::npos)
+			break;
+		size_t end = query.find_first_of( " \t\r\n", start);
+		if (end == string::npos)
+			end = query.size();
+		pos = end;
+		string word = query.substr( start, end-start);
+		bool isPrefix = word[word.size()-1] == '*';
+		vector< string> tokens;
+		Tokenize( word, tokens);
+		for( uint32_t i=0; i<tokens.size(); ++i) {
+			DocIdVect ids;
+			_CollectTerm( tokens[i], isPrefix && i == tokens.size()-1, ids);
+			if (first) {
+				result.swap( ids);
+				first = false;
+			} else {
+				DocIdVect intersection;
+				set_intersection( result.begin(), result.end(),
+										ids.begin(), ids.end(),
+										back_inserter( intersection));
+				result.swap( intersection);
+			}
+			if (result.empty())
+				return;
+		}
+	}
+	for( uint32_t i=0; i<result.size(); ++i) {
+		if (!mDocIsDead[result[i]])
+			outKeys.push_back( mDocKeys[result[i]]);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	NeedsCompaction()
+		-	returns whether or not the dead documents make up a quarter of the
+			index (and are numerous enough to bother)
+\*------------------------------------------------------------------------------*/
+bool BmTextIndex::NeedsCompaction() const {
+	uint32_t deadCount = DeadDocumentCount();
+	return deadCount >= 64 && deadCount*4 >= mDocKeys.size();
+}
+
+/*------------------------------------------------------------------------------*\
+	Compact()
+		-	drops all dead documents from the postings and renumbers the
+			remaining ones
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::Compact() {
+	const uint32_t nNoId = 0xFFFFFFFF;
+	DocIdVect newIdFor( mDocKeys.size(), nNoId);
+	DocKeyVect newDocKeys;
+	newDocKeys.reserve( mLiveDocCount);
+	for( uint32_t i=0; i<mDocKeys.size(); ++i) {
+		if (!mDocIsDead[i]) {
+			newIdFor[i] = newDocKeys.size();
+			newDocKeys.push_back( mDocKeys[i]);
+		}
+	}
+	PostingMap::iterator iter = mPostings.begin();
+	while( iter != mPostings.end()) {
+		DocIdVect ids;
+		_DecodePosting( iter->second, ids);
+		Posting newPosting;
+		for( uint32_t i=0; i<ids.size(); ++i) {
+			uint32_t newId = newIdFor[ids[i]];
+			if (newId == nNoId)
+				continue;
+			AppendVarint( newPosting.deltas, newId - newPosting.lastDocId);
+			newPosting.lastDocId = newId;
+			newPosting.count++;
+		}
+		if (newPosting.count)
+			(iter++)->second = newPosting;
+		else
+			mPostings.erase( iter++);
+	}
+	mDocKeys.swap( newDocKeys);
+	mDocIsDead.assign( mDocKeys.size(), false);
+	mDocIdForKey.clear();
+	for( uint32_t i=0; i<mDocKeys.size(); ++i)
+		mDocIdForKey[mDocKeys[i]] = i;
+	mModified = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	MakeEmpty()
+		-	removes everything from the index
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::MakeEmpty() {
+	mPostings.clear();
+	mDocKeys.clear();
+	mDocIsDead.clear();
+	mDocIdForKey.clear();
+	mLiveDocCount = 0;
+	mModified = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	Store( filename)
+		-	writes the index into the given file
+		-	the index is written into a temporary file first, which is then
+			renamed, such that a crash can't leave a half-written index behind
+\*------------------------------------------------------------------------------*/
+bool BmTextIndex::Store( const string& filename) const {
+	string data( nIndexMagic, 4);
+	AppendVarint( data, nIndexVersion);
+	AppendVarint( data, mDocKeys.size());
+	for( uint32_t i=0; i<mDocKeys.size(); ++i) {
+		AppendUint64( data, mDocKeys[i]);
+		data += (char)(mDocIsDead[i] ? 1 : 0);
+	}
+	AppendVarint( data, mPostings.size());
+	PostingMap::const_iterator iter;
+	for( iter = mPostings.begin(); iter != mPostings.end(); ++iter) {
+		AppendVarint( data, iter->first.size());
+		data += iter->first;
+		AppendVarint( data, iter->second.count);
+		AppendVarint( data, iter->second.lastDocId);
+		AppendVarint( data, iter->second.deltas.size());
+		data += iter->second.deltas;
+	}
+	data.append( nIndexEndMagic, 4);
+
+	string tmpName = filename + ".tmp";
+	FILE* file = fopen( tmpName.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite( data.data(), 1, data.size(), file) == data.size();
+	ok = fclose( file) == 0 && ok;
+	if (ok)
+		ok = rename( tmpName.c_str(), filename.c_str()) == 0;
+	if (!ok)
+		remove( tmpName.c_str());
+	return ok;
+}
+
+/*------------------------------------------------------------------------------*\
+	Load( filename)
+		-	replaces the index by the one contained in the given file
+		-	if the file can't be read or is damaged, the index is left empty
+			and false is returned
+\*------------------------------------------------------------------------------*/
+bool BmTextIndex::Load( const string& filename) {
+	MakeEmpty();
+	mModified = false;
+	FILE* file = fopen( filename.c_str(), "rb");
+	if (!file)
+		return false;
+	string data;
+	char buf[65536];
+	size_t readLen;
+	while( (readLen = fread( buf, 1, sizeof(buf), file)) > 0)
+		data.append( buf, readLen);
+	fclose( file);
+
+	const char* ptr = data.data();
+	size_t len = data.size();
+	size_t pos = 4;
+	uint64_t version, docCount, termCount;
+	bool ok = len >= 8 && memcmp( ptr, nIndexMagic, 4) == 0
+				&& memcmp( ptr+len-4, nIndexEndMagic, 4) == 0
+				&& ReadVarint( ptr, len, pos, version)
+				&& version == nIndexVersion
+				&& ReadVarint( ptr, len, pos, docCount)
+				&& docCount <= len;
+	for( uint64_t i=0; ok && i<docCount; ++i) {
+		uint64_t key;
+		ok = ReadUint64( ptr, len, pos, key) && pos < len;
+		if (ok) {
+			bool isDead = ptr[pos++] != 0;
+			mDocKeys.push_back( key);
+			mDocIsDead.push_back( isDead);
+			if (!isDead) {
+				mDocIdForKey[key] = i;
+				mLiveDocCount++;
+			}
+		}
+	}
+	ok = ok && ReadVarint( ptr, len, pos, termCount);
+	for( uint64_t i=0; ok && i<termCount; ++i) {
+		uint64_t termLen, count, lastDocId, deltaLen;
+		ok = ReadVarint( ptr, len, pos, termLen) && termLen <= len-pos;
+		if (!ok)
+			break;
+		string term( ptr+pos, termLen);
+		pos += termLen;
+		ok = ReadVarint( ptr, len, pos, count)
+				&& ReadVarint( ptr, len, pos, lastDocId)
+				&& lastDocId < docCount
+				&& ReadVarint( ptr, len, pos, deltaLen)
+				&& deltaLen <= len-pos;
+		if (!ok)
+			break;
+		Posting& posting = mPostings[term];
+		posting.count = count;
+		posting.lastDocId = lastDocId;
+		posting.deltas.assign( ptr+pos, deltaLen);
+		pos += deltaLen;
+	}
+	ok = ok && pos == len-4;
+	if (!ok) {
+		MakeEmpty();
+		mModified = false;
+	}
+	return ok;
+}
+
+/*------------------------------------------------------------------------------*\
+	Tokenize( text, outTokens)
+		-	splits the given text into words, which are case-folded
+		-	a word is a run of ASCII letters and digits or of non-ASCII bytes
+			(which keeps UTF-8 characters intact), words that are shorter than
+			nMinTokenLen or longer than nMaxTokenLen are dropped (the latter
+			are usually encoded binary data and would just bloat the index)
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::Tokenize( const string& text, vector< string>& outTokens) {
+	string token;
+	bool tooLong = false;
+	for( size_t i=0; i<=text.size(); ++i) {
+		unsigned char c = i < text.size() ? (unsigned char)text[i] : 0;
+		if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+			if (token.size() < nMaxTokenLen)
+				token += (char)c;
+			else
+				tooLong = true;
+		} else if (c >= 'A' && c <= 'Z') {
+			if (token.size() < nMaxTokenLen)
+				token += (char)(c + 'a' - 'A');
+			else
+				tooLong = true;
+		} else {
+			if (!tooLong && token.size() >= nMinTokenLen)
+				outTokens.push_back( token);
+			token.erase();
+			tooLong = false;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ExtractMailText( mailText, outText)
+		-	extracts the text that should be indexed from the given raw mail:
+			the subject, the address-fields and all decoded text-parts
+			(html is stripped of its tags)
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::ExtractMailText( const string& mailText, string& outText) {
+	outText.erase();
+	ExtractPartText( mailText, true, 0, outText);
+}
+
+/*------------------------------------------------------------------------------*\
+	_AddTerm( term, docId)
+		-	appends the given document-id to the postings of the given term
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::_AddTerm( const string& term, uint32_t docId) {
+	Posting& posting = mPostings[term];
+	if (posting.count && posting.lastDocId >= docId)
+		return;
+	AppendVarint( posting.deltas, docId - posting.lastDocId);
+	posting.lastDocId = docId;
+	posting.count++;
+}
+
+/*------------------------------------------------------------------------------*\
+	_DecodePosting( posting, outIds)
+		-	appends the document-ids of the given posting to outIds
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::_DecodePosting( const Posting& posting,
+											 DocIdVect& outIds) const {
+	const char* data = posting.deltas.data();
+	size_t len = posting.deltas.size();
+	size_t pos = 0;
+	uint64_t delta;
+	uint32_t docId = 0;
+	outIds.reserve( outIds.size() + posting.count);
+	while( pos < len && ReadVarint( data, len, pos, delta)) {
+		docId += delta;
+		outIds.push_back( docId);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_CollectTerm( term, isPrefix, outIds)
+		-	fills outIds with the (sorted) ids of all documents containing the
+			given term (or any term starting with it, if isPrefix is set)
+\*------------------------------------------------------------------------------*/
+void BmTextIndex::_CollectTerm( const string& term, bool isPrefix,
+										  DocIdVect& outIds) const {
+	outIds.clear();
+	if (!isPrefix) {
+		PostingMap::const_iterator iter = mPostings.find( term);
+		if (iter != mPostings.end())
+			_DecodePosting( iter->second, outIds);
+		return;
+	}
+	PostingMap::const_iterator iter = mPostings.lower_bound( term);
+	uint32_t termCount = 0;
+	for( ; iter != mPostings.end()
+			&& iter->first.compare( 0, term.size(), term) == 0; ++iter) {
+		_DecodePosting( iter->second, outIds);
+		termCount++;
+	}
+	if (termCount > 1) {
+		sort( outIds.begin(), outIds.end());
+		outIds.erase( unique( outIds.begin(), outIds.end()), outIds.end());
+	}
+}
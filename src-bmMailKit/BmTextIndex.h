@@ -0,0 +1,121 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmTextIndex_h
+#define _BmTextIndex_h
+
+/*
+ * This file (and BmTextIndex.cpp) deliberately does not use any of the
+ * BeAPI or BmBase, such that the index can be built and tested on any
+ * POSIX-system (see src-tools/TextIndexTool.cpp).
+ */
+
+#if defined(__BEOS__) || defined(__HAIKU__)
+#include "BmMailKit.h"
+#else
+#define IMPEXPBMMAILKIT
+#endif
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	class BmTextIndex
+		-	an inverted index that maps case-folded words to the documents
+			containing them
+		-	documents are identified by a 64-bit key chosen by the caller
+			(Beam uses the inode of the mail-file), internally every document
+			gets a document-id that is never reused
+		-	the postings of every term are kept as delta-encoded varints in
+			ascending order of document-id (which is cheap, since new
+			documents always get the highest id)
+		-	removing a document just marks its id as dead, the postings are
+			cleaned up by Compact(), which should be called once the dead
+			documents make up a considerable part of the index
+		-	the class does no locking, that's up to the user
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmTextIndex {
+
+public:
+	typedef uint64_t DocKey;
+	typedef vector< DocKey> DocKeyVect;
+
+	BmTextIndex();
+	~BmTextIndex();
+
+	// native methods:
+	void AddDocument( DocKey key, const string& text);
+	bool RemoveDocument( DocKey key);
+	void UpdateDocument( DocKey key, const string& text);
+	bool HasDocument( DocKey key) const;
+	void AllDocuments( DocKeyVect& outKeys) const;
+	void Search( const string& query, DocKeyVect& outKeys) const;
+	void Compact();
+	void MakeEmpty();
+	//
+	bool Store( const string& filename) const;
+	bool Load( const string& filename);
+
+	// getters:
+	inline uint32_t DocumentCount() const	{ return mLiveDocCount; }
+	inline uint32_t DeadDocumentCount() const
+													{ return mDocKeys.size()-mLiveDocCount; }
+	inline uint32_t TermCount() const		{ return mPostings.size(); }
+	inline bool IsModified() const			{ return mModified; }
+	bool NeedsCompaction() const;
+
+	// setters:
+	inline void ResetModified()				{ mModified = false; }
+
+	// static helpers:
+	static void Tokenize( const string& text, vector< string>& outTokens);
+	static void ExtractMailText( const string& mailText, string& outText);
+
+	static const uint32_t nMinTokenLen = 2;
+	static const uint32_t nMaxTokenLen = 64;
+
+private:
+	struct Posting {
+		Posting()
+			:	lastDocId( 0)
+			,	count( 0)								{}
+		string deltas;
+		uint32_t lastDocId;
+		uint32_t count;
+	};
+	typedef map< string, Posting> PostingMap;
+	typedef map< DocKey, uint32_t> DocIdMap;
+	typedef vector< uint32_t> DocIdVect;
+
+	void _AddTerm( const string& term, uint32_t docId);
+	void _DecodePosting( const Posting& posting, DocIdVect& outIds) const;
+	void _CollectTerm( const string& term, bool isPrefix,
+							 DocIdVect& outIds) const;
+
+	PostingMap mPostings;
+	DocKeyVect mDocKeys;
+							// key for every document-id ever handed out
+	vector< bool> mDocIsDead;
+	DocIdMap mDocIdForKey;
+							// only contains live documents
+	uint32_t mLiveDocCount;
+	bool mModified;
+
+	// Hide copy-constructor and assignment:
+	BmTextIndex( const BmTextIndex&);
+	BmTextIndex operator=( const BmTextIndex&);
+};
+
+#endif
@@ -64,7 +64,6 @@ BmFilterAddonPrefsView* InstantiateFilterPrefs( float minx, float miny,
 const char* const BmSieveFilter::MSG_VERSION = 		"bm:version";
 const char* const BmSieveFilter::MSG_CONTENT = 		"bm:content";
 const int16 BmSieveFilter::nArchiveVersion = 1;
-BLocker* BmSieveFilter::nSieveLock = NULL;
 
 // standard logfile-name for this class:
 #undef BM_LOGNAME
@@ -87,6 +86,48 @@ static const BmString BmNotifyStopProcessing = "BeamStopProcessing";
 static const BmString BmNotifySetSpamTofu = "BeamSetSpamTofu";
 static const BmString BmNotifySetListId = "BeamSetListId";
 
+/*------------------------------------------------------------------------------*\
+	BmSieveExecContext
+		-	the message-context that is handed to SIEVE for a single execution
+			of a script, such that the callbacks need no static state and
+			several mails can be filtered at once
+		-	the compiled scripts are shared between filters (by the script-cache),
+			so this is where the callbacks find the filter being executed, too
+\*------------------------------------------------------------------------------*/
+struct BmSieveExecContext {
+	BmSieveExecContext( BmSieveFilter* f, BmMsgContext* mc)
+		:	filter( f)
+		,	msgContext( mc)
+	{
+		fakes[0] = fakes[1] = NULL;
+	}
+	BmSieveFilter* filter;
+	BmMsgContext* msgContext;
+	const char* fakes[2];
+							// values of the fake header-fields (Status, etc.)
+};
+
+/*------------------------------------------------------------------------------*\
+	MsgContextOf( message_context)
+		-	returns the BmMsgContext of the given SIEVE message-context
+\*------------------------------------------------------------------------------*/
+static inline BmMsgContext* MsgContextOf( void* message_context) {
+	return message_context
+		? static_cast< BmSieveExecContext*>( message_context)->msgContext
+		: NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	FilterOf( message_context)
+		-	returns the filter that is executed with the given SIEVE 
+			message-context
+\*------------------------------------------------------------------------------*/
+static inline BmSieveFilter* FilterOf( void* message_context) {
+	return message_context
+		? static_cast< BmSieveExecContext*>( message_context)->filter
+		: NULL;
+}
+
 /*------------------------------------------------------------------------------*\
 	BmSieveFilter( archive)
 		-	c'tor
@@ -94,8 +135,8 @@ static const BmString BmNotifySetListId = "BeamSetListId";
 \*------------------------------------------------------------------------------*/
 BmSieveFilter::BmSieveFilter( const BmString& name, const BMessage* archive) 
 	:	mName( name)
-	,	mCompiledScript( NULL)
-	,	mSieveInterp( NULL)
+	,	mScriptEntry( NULL)
+	,	mScriptLocker( "SieveScriptLock")
 {
 	int16 version;
 	if (archive->FindInt16( MSG_VERSION, &version) != B_OK)
@@ -108,19 +149,8 @@ BmSieveFilter::BmSieveFilter( const BmString& name, const BMessage* archive)
 		-	standard d'tor
 \*------------------------------------------------------------------------------*/
 BmSieveFilter::~BmSieveFilter() {
-	if (mCompiledScript)
-		sieve_script_free( &mCompiledScript);
-	if (mSieveInterp)
-		sieve_interp_free( &mSieveInterp);
-}
-
-/*------------------------------------------------------------------------------*\
-	SieveLock()
-\*------------------------------------------------------------------------------*/
-BLocker* BmSieveFilter::SieveLock() {
-	if (!nSieveLock)
-		nSieveLock = new BLocker( "SieveLock", true);
-	return nSieveLock;
+	if (mScriptEntry)
+		BmSieveScriptCache::Instance()->Release( mScriptEntry);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -136,7 +166,9 @@ status_t BmSieveFilter::Archive( BMessage* archive, bool) const {
 
 /*------------------------------------------------------------------------------*\
 	Execute()
-		-	
+		-	executes the compiled script on the mail of the given context
+		-	the script is only read-locked while executing, so any number of
+			mails can be filtered by the same filter at once
 \*------------------------------------------------------------------------------*/
 bool 
 BmSieveFilter::Execute( BmMsgContext* msgContext, const BMessage* /*jobSpecs*/)
@@ -148,110 +180,96 @@ BmSieveFilter::Execute( BmMsgContext* msgContext, const BMessage* /*jobSpecs*/)
 									<< Name() 
 									<< "> on mail with Id <" << mailId << ">");
 
-	// set lock to serialize SIEVE-calls:
-	BAutolock lock( SieveLock());
-	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SIEVE-lock";
+	if (!mScriptLocker.ReadLock())
 		return false;
-	}
-
-	if (!mCompiledScript) {
-		bool scriptOK = CompileScript();
-		if (!scriptOK || !mCompiledScript) {
+	while (!mScriptEntry) {
+		// compilation needs the write-lock, which we can't get while we are
+		// holding a read-lock (if another thread is trying the same):
+		mScriptLocker.ReadUnlock();
+		if (!CompileScript()) {
+			mScriptLocker.WriteLock();
 			BmString errString = LastErr() + "\n" 
 										<< "Error: " 
 										<< sieve_strerror(LastErrVal()) 
 										<< "\n"
 										<< LastSieveErr();
+			mScriptLocker.WriteUnlock();
 			BM_LOGERR( BmString("Sieve-Addon: compilation failed.\n")<<errString);
 			return false;
 		}
+		if (!mScriptLocker.ReadLock())
+			return false;
 	}
+	BmSieveExecContext execContext( this, msgContext);
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: starting execution of script...");
-	int res = sieve_execute_script( mCompiledScript, msgContext);
+	int res = sieve_execute_script( mScriptEntry->script, &execContext);
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: done with script.");
+	mScriptLocker.ReadUnlock();
 	return res == SIEVE_OK;
 }
 
 /*------------------------------------------------------------------------------*\
 	CompileScript()
-		-	
+		-	compiles the script of this filter (unless it has been compiled 
+			already)
+		-	if the same script has been compiled before (by any filter), the
+			compiled script is taken from the script-cache
 \*------------------------------------------------------------------------------*/
 bool BmSieveFilter::CompileScript() {
-	bool ret = false;
-	FILE* scriptFile = NULL;
-	BmString scriptFileName;
-	status_t err;
-	BFile scriptBFile;
-
-	BM_LOG( BM_LogFilter, 
-			  BmString("Sieve-Addon: compiling SIEVE-script of filter ") 
-					<< Name()); 
-
-	// set lock to serialize SIEVE-calls:
-	BAutolock lock( SieveLock());
-	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SIEVE-lock";
+	if (!mScriptLocker.WriteLock())
 		return false;
-	}
-	if (mCompiledScript)
+	if (mScriptEntry) {
 		// script has already been compiled
+		mScriptLocker.WriteUnlock();
 		return true;
+	}
 
 	mLastErr = mLastSieveErr = "";
+	mLastErrVal = SIEVE_OK;
+
+	BmSieveScriptCache* cache = BmSieveScriptCache::Instance();
+	mScriptEntry = cache->Acquire( mContent);
+	if (mScriptEntry) {
+		BM_LOG2( BM_LogFilter, 
+					BmString("Sieve-Addon: found compiled SIEVE-script of filter ")
+						<< Name() << " in cache");
+		mScriptLocker.WriteUnlock();
+		return true;
+	}
 
-	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...register");
+	BM_LOG( BM_LogFilter, 
+			  BmString("Sieve-Addon: compiling SIEVE-script of filter ") 
+					<< Name()); 
 
-	// create sieve interpreter:
-	int res = sieve_interp_alloc( &mSieveInterp, this);
+	bool ret = false;
+	BmSieveScriptCache::Entry* entry = new BmSieveScriptCache::Entry( mContent);
+	// create sieve interpreter (it is only needed during compilation, as the
+	// compiled script carries a copy of it):
+	sieve_interp_t* interp = NULL;
+	int res = sieve_interp_alloc( &interp, NULL);
 	if (res != SIEVE_OK) {
 		mLastErr = BmString(Name()) << ": Could not create SIEVE-interpreter";
-		goto cleanup;
-	}
-	RegisterCallbacks( mSieveInterp);
-
-	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...create tmpfile");
-	// create temporary file with script-contents 
-	// (since SIEVE parses from file only):
-	scriptFileName = "/tmp/bm_sieve_script";
-	err = scriptBFile.SetTo( scriptFileName.String(), 
-									 B_CREATE_FILE | B_ERASE_FILE | B_WRITE_ONLY);
-	if (err != B_OK) {
-		mLastErr = BmString(Name()) << ":\nCould not create temporary file\n\t<" 
-											 << scriptFileName << ">\n\n Result: " 
-											 << strerror(err);
-		goto cleanup;
-	}
-	scriptBFile.Write( mContent.String(), mContent.Length());
-	scriptBFile.Unset();
-
-	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...open tmpfile for sieve");
-	// open script file for sieve...
-	scriptFile = fopen( scriptFileName.String(), "r");
-	if (!scriptFile) {
-		mLastErr = BmString(Name()) << ":\nCould not re-open file \n\t<" 
-											 << scriptFileName << ">";
-		goto cleanup;
-	}
-	// ...and compile the script:	
-	if (mCompiledScript) {
-		sieve_script_free( &mCompiledScript);
-		mCompiledScript = NULL;
-	}
-	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...parsing");
-	res = sieve_script_parse( mSieveInterp, scriptFile, this, &mCompiledScript);
-	if (res != SIEVE_OK) {
-		mLastErr = BmString(Name()) 
-							<< ":\nThe script could not be parsed correctly";
-		goto cleanup;
+	} else {
+		RegisterCallbacks( interp);
+		// compile the script, any parse-errors are collected by the entry:
+		res = sieve_script_parse_string( interp, mContent.String(), 
+													mContent.Length(), entry, 
+													&entry->script);
+		if (res != SIEVE_OK) {
+			mLastErr = BmString(Name()) 
+								<< ":\nThe script could not be parsed correctly";
+			mLastSieveErr = entry->parseErr;
+		} else {
+			BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...done");
+			mScriptEntry = cache->Add( entry);
+			entry = NULL;
+			ret = true;
+		}
+		sieve_interp_free( &interp);
 	}
-	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...done");
-	ret = true;
-
-cleanup:
+	delete entry;
 	mLastErrVal = res;
-	if (scriptFile)
-		fclose( scriptFile);
+	mScriptLocker.WriteUnlock();
 	return ret;
 }
 
@@ -261,11 +279,14 @@ cleanup:
 \*------------------------------------------------------------------------------*/
 void BmSieveFilter::Content( const BmString &s)
 {
+	if (!mScriptLocker.WriteLock())
+		return;
 	mContent = s;
-	if (mCompiledScript) {
-		sieve_script_free(&mCompiledScript);
-		mCompiledScript = NULL; 
+	if (mScriptEntry) {
+		BmSieveScriptCache::Instance()->Release( mScriptEntry);
+		mScriptEntry = NULL; 
 	}
+	mScriptLocker.WriteUnlock();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -295,11 +316,10 @@ void BmSieveFilter::RegisterCallbacks( sieve_interp_t* interp) {
 \*------------------------------------------------------------------------------*/
 int BmSieveFilter::sieve_parse_error( int lineno, const char* msg, 
 												  void*, void* script_context) {
-	if (script_context) {
-		BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
-		if (filter)
-			filter->mLastSieveErr = BmString("Line ")<<lineno<<": "<<msg;
-	}
+	BmSieveScriptCache::Entry* entry 
+		= static_cast< BmSieveScriptCache::Entry*>( script_context);
+	if (entry)
+		entry->parseErr = BmString("Line ")<<lineno<<": "<<msg;
 	return SIEVE_OK;
 }
 
@@ -374,7 +394,7 @@ int BmSieveFilter::sieve_keep( void* action_context, void*,
 			   				  		 void*, void* message_context, 
 			   				  		 const char**) {
 	BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_keep called")); 
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	sieve_keep_context* keepContext 
 		= static_cast< sieve_keep_context*>( action_context);
 	if (msgContext && keepContext)
@@ -390,7 +410,7 @@ int BmSieveFilter::sieve_discard( void* /*action_context*/, void*,
 			   				  		    void*, void* message_context, 
 			   				  		    const char**) {
 	BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_discard called")); 
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	if (msgContext)
 		msgContext->SetBool("MoveToTrash", true);
 	return SIEVE_OK;
@@ -400,13 +420,13 @@ int BmSieveFilter::sieve_discard( void* /*action_context*/, void*,
 	sieve_fileinto()
 		-	
 \*------------------------------------------------------------------------------*/
-int BmSieveFilter::sieve_fileinto( void* action_context, void* script_context, 
+int BmSieveFilter::sieve_fileinto( void* action_context, void*, 
 			   				  			 void*, void* message_context, 
 			   				 			 const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	sieve_fileinto_context* fileintoContext 
 		= static_cast< sieve_fileinto_context*>( action_context);
-	BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
+	BmSieveFilter* filter = FilterOf( message_context);
 	if (msgContext && filter && fileintoContext) {
 		BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_fileinto called "
 												  "with folder ")
@@ -440,13 +460,13 @@ int BmSieveFilter::sieve_fileinto( void* action_context, void* script_context,
 	sieve_reject()
 		-	
 \*------------------------------------------------------------------------------*/
-int BmSieveFilter::sieve_reject( void* action_context, void* script_context, 
+int BmSieveFilter::sieve_reject( void* action_context, void*, 
 			   				  			void*, void* message_context, 
 			   				 			const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	sieve_reject_context* rejectContext 
 		= static_cast< sieve_reject_context*>( action_context);
-	BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
+	BmSieveFilter* filter = FilterOf( message_context);
 	if (msgContext && filter && rejectContext) {
 		BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_reject called "
 												  "with msg ")
@@ -463,7 +483,7 @@ int BmSieveFilter::sieve_reject( void* action_context, void* script_context,
 int BmSieveFilter::sieve_notify( void* action_context, void*, 
 			   				  		   void*, void* message_context, 
 			   				  		   const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	sieve_notify_context* notifyContext 
 		= static_cast< sieve_notify_context*>( action_context);
 	if (msgContext && notifyContext) {
@@ -506,7 +526,7 @@ int BmSieveFilter::sieve_notify( void* action_context, void*,
 		-	
 \*------------------------------------------------------------------------------*/
 int BmSieveFilter::sieve_get_size( void* message_context, int* sizePtr) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	if (msgContext && sizePtr)
 		*sizePtr = msgContext->mail->RawText().Length();
 	BM_LOG3( BM_LogFilter, 
@@ -524,8 +544,11 @@ int BmSieveFilter::sieve_get_header( void* message_context, const char* header,
 	BM_LOG3( BM_LogFilter, 
 				BmString("Sieve-Addon: sieve_get_header called for header ")
 					<< header);
-	static const char* fakes[2] = { NULL, NULL };
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextOf( message_context);
+	const char** fakes 
+		= msgContext 
+			? static_cast< BmSieveExecContext*>( message_context)->fakes 
+			: NULL;
 	if (msgContext && contentsPtr && header) {
 		*contentsPtr = NULL;
 		BmString headerName( header);
@@ -562,17 +585,14 @@ int BmSieveFilter::sieve_get_header( void* message_context, const char* header,
 	execute_error()
 		-	
 \*------------------------------------------------------------------------------*/
-int BmSieveFilter::sieve_execute_error( const char* msg, void*,
-													 void* script_context, 
+int BmSieveFilter::sieve_execute_error( const char* msg, void*, void*, 
 													 void* message_context) {
 	BmString filterName = "<unknown>";
 	BmString mailName = "<unknown>";
-	if (script_context) {
-		BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
-		if (filter)
-			filterName = filter->Name();
-	}
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmSieveFilter* filter = FilterOf( message_context);
+	if (filter)
+		filterName = filter->Name();
+	BmMsgContext* msgContext = MsgContextOf( message_context);
 	if (msgContext)
 		mailName = msgContext->mail->Name();
 	BmString err("An error occurred during execution of a mail-filter.");
@@ -585,6 +605,175 @@ int BmSieveFilter::sieve_execute_error( const char* msg, void*,
 
 
 
+/********************************************************************************\
+	BmSieveScriptCache
+\********************************************************************************/
+
+// the cache is created up front, as filters may be compiled by several 
+// (filter-)threads at once. It lives as long as the add-on is loaded, such
+// that the compiled scripts are freed when the add-on is unloaded:
+BmSieveScriptCache BmSieveScriptCache::theInstance;
+
+const int32 BmSieveScriptCache::nMaxUnusedScripts = 50;
+
+/*------------------------------------------------------------------------------*\
+	Entry( content)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::Entry::Entry( const BmString& c)
+	:	key( BmSieveScriptCache::Key( c))
+	,	content( c)
+	,	script( NULL)
+	,	refCount( 0)
+	,	lastUsed( 0)
+	,	cached( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~Entry()
+		-	d'tor, frees the compiled script
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::Entry::~Entry() {
+	if (script)
+		sieve_script_free( &script);
+}
+
+/*------------------------------------------------------------------------------*\
+	Instance()
+		-	returns the one and only script-cache
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache* BmSieveScriptCache::Instance() {
+	return &theInstance;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmSieveScriptCache()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::BmSieveScriptCache()
+	:	mLocker( "SieveScriptCache")
+	,	mUseCounter( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmSieveScriptCache()
+		-	d'tor, frees all cached scripts
+		-	N.B.: this runs when the add-on is unloaded, which happens only
+			after the filter-list has deleted all filters, so none of the
+			entries is in use anymore
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::~BmSieveScriptCache()
+{
+	EntryMap::iterator iter;
+	for( iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+		delete iter->second;
+	mEntries.clear();
+}
+
+/*------------------------------------------------------------------------------*\
+	Key( content)
+		-	returns the hash (FNV-1a) of the given script-content
+\*------------------------------------------------------------------------------*/
+uint64 BmSieveScriptCache::Key( const BmString& content) {
+	uint64 hash = 14695981039346656037ULL;
+	const char* end = content.String() + content.Length();
+	for( const char* p = content.String(); p < end; ++p) {
+		hash ^= (uint8)*p;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*------------------------------------------------------------------------------*\
+	Acquire( content)
+		-	returns the cached entry for the given script-content (with a new 
+			reference for the caller) or NULL if the script hasn't been compiled
+			yet
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::Entry* BmSieveScriptCache::Acquire( 
+	const BmString& content)
+{
+	BAutolock lock( mLocker);
+	EntryMap::iterator iter = mEntries.find( Key( content));
+	if (iter == mEntries.end() || iter->second->content != content)
+		return NULL;
+	iter->second->refCount++;
+	return iter->second;
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( entry)
+		-	adds the given entry (holding a freshly compiled script) to the cache
+		-	if another thread has added the same script in the meantime, the 
+			given entry is deleted and the existing one is used instead
+		-	returns the entry that should be used by the caller (who owns a
+			reference to it)
+\*------------------------------------------------------------------------------*/
+BmSieveScriptCache::Entry* BmSieveScriptCache::Add( Entry* entry)
+{
+	BAutolock lock( mLocker);
+	EntryMap::iterator iter = mEntries.find( entry->key);
+	if (iter == mEntries.end()) {
+		entry->cached = true;
+		mEntries[entry->key] = entry;
+	} else if (iter->second->content == entry->content) {
+		delete entry;
+		entry = iter->second;
+	}
+	// else: a different script with the same hash is cached already, so this
+	// entry is only used by the caller (and deleted when released)
+	entry->refCount++;
+	return entry;
+}
+
+/*------------------------------------------------------------------------------*\
+	Release( entry)
+		-	drops a reference to the given entry
+		-	unused entries are kept in the cache, unless there are too many
+\*------------------------------------------------------------------------------*/
+void BmSieveScriptCache::Release( Entry* entry)
+{
+	BAutolock lock( mLocker);
+	if (--entry->refCount > 0)
+		return;
+	if (!entry->cached) {
+		delete entry;
+		return;
+	}
+	entry->lastUsed = ++mUseCounter;
+	_PurgeUnused();
+}
+
+/*------------------------------------------------------------------------------*\
+	_PurgeUnused()
+		-	removes the least recently used of the unused entries, until no more
+			than nMaxUnusedScripts are left
+\*------------------------------------------------------------------------------*/
+void BmSieveScriptCache::_PurgeUnused()
+{
+	while( 1) {
+		int32 unusedCount = 0;
+		EntryMap::iterator oldest = mEntries.end();
+		EntryMap::iterator iter;
+		for( iter = mEntries.begin(); iter != mEntries.end(); ++iter) {
+			if (iter->second->refCount > 0)
+				continue;
+			unusedCount++;
+			if (oldest == mEntries.end() 
+			|| iter->second->lastUsed < oldest->second->lastUsed)
+				oldest = iter;
+		}
+		if (unusedCount <= nMaxUnusedScripts)
+			break;
+		delete oldest->second;
+		mEntries.erase( oldest);
+	}
+}
+
+
+
 /********************************************************************************\
 	BmGraphicalSieveFilter
 \********************************************************************************/
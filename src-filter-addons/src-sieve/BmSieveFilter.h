@@ -9,8 +9,11 @@
 #ifndef _BmSieveFilter_h
 #define _BmSieveFilter_h
 
+#include <map>
+
 #include <Archivable.h>
 #include <Autolock.h>
+#include <Locker.h>
 
 extern "C" {
 	#include "sieve_interface.h"
@@ -18,9 +21,68 @@ extern "C" {
 
 #include "BmFilterAddon.h"
 #include "BmFilterAddonPrefs.h"
+#include "BmMultiLocker.h"
+
+using std::map;
 
 const int BM_MAX_MATCH_COUNT = 20;
 
+/*------------------------------------------------------------------------------*\
+	BmSieveScriptCache 
+		-	keeps the compiled SIEVE-scripts of all filters, keyed by a hash of 
+			their content, such that a script is only compiled once, even if the
+			filter-list is reloaded (or several filters share the same script)
+		-	scripts that are no longer used by any filter are kept around (up to
+			nMaxUnusedScripts), since reloading the filter-list drops all 
+			filters and creates them anew
+\*------------------------------------------------------------------------------*/
+class BmSieveScriptCache {
+
+public:
+	struct Entry {
+		Entry( const BmString& c);
+		~Entry();
+		uint64 key;
+		BmString content;
+		sieve_script_t* script;
+		int32 refCount;
+		uint32 lastUsed;
+							// value of the use-counter when it was last released
+		bool cached;
+							// false if another script with the same hash is cached
+		BmString parseErr;
+							// the last parse-error (only set during compilation)
+	};
+
+	static BmSieveScriptCache* Instance();
+
+	~BmSieveScriptCache();
+
+	// native methods:
+	Entry* Acquire( const BmString& content);
+	Entry* Add( Entry* entry);
+	void Release( Entry* entry);
+
+	static uint64 Key( const BmString& content);
+
+private:
+	BmSieveScriptCache();
+	void _PurgeUnused();
+
+	typedef map< uint64, Entry*> EntryMap;
+
+	BLocker mLocker;
+	EntryMap mEntries;
+	uint32 mUseCounter;
+
+	static BmSieveScriptCache theInstance;
+	static const int32 nMaxUnusedScripts;
+
+	// Hide copy-constructor and assignment:
+	BmSieveScriptCache( const BmSieveScriptCache&);
+	BmSieveScriptCache operator=( const BmSieveScriptCache&);
+};
+
 /*------------------------------------------------------------------------------*\
 	BmSieveFilter 
 		-	implements filtering through SIEVE
@@ -36,7 +98,6 @@ public:
 	
 	// native methods:
 	bool CompileScript();
-	BLocker* SieveLock();
 	virtual bool AskBeforeFileInto()		{ return false; }
 
 	// implementations for abstract BmFilterAddon-methods:
@@ -46,6 +107,11 @@ public:
 	bool SanityCheck( BmString& complaint, BmString& fieldName);
 	status_t Archive( BMessage* archive, bool deep = true) const;
 	BmString ErrorString() const;
+	bool IsReentrant() const				{ return false; }
+							// the reentrant SIEVE-parsers have not been
+							// verified on the target yet, so filters are
+							// serialized until SieveTest::ConcurrencyTest
+							// has passed there
 
 	// SIEVE-callbacks:
 	static int sieve_redirect( void* action_context, void* interp_context, 
@@ -104,17 +170,18 @@ protected:
 							// the name of this filter-implementation
 	BmString mContent;
 							// the SIEVE-script represented by this filter
-	sieve_script_t* mCompiledScript;
-							// the compiled SIEVE-script, ready to be thrown at mails
-	sieve_interp_t* mSieveInterp;
-							// the interpreter that compiled the SIEVE-script
+	BmSieveScriptCache::Entry* mScriptEntry;
+							// the compiled SIEVE-script, ready to be thrown at 
+							// mails (owned by the script-cache)
 	int mLastErrVal;
 							// last error-value we got
 	BmString mLastErr;
 							// the last (general) error that occurred
 	BmString mLastSieveErr;
 							// the last SIEVE-error that occurred
-	static BLocker* nSieveLock;
+	BmMultiLocker mScriptLocker;
+							// executions of the script hold a read-lock, 
+							// (re-)compiling it requires the write-lock
 
 private:
 	BmSieveFilter();									// hide default constructor
@@ -29,15 +29,31 @@ OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <stdlib.h>
 #include <string.h>
 
-#include "addr.h"
 #include "xmalloc.h"
+#include "script.h"
+
+#include "addr.h"
 
-extern int addrerror(const char *msg);
-extern int addrlex(void);
+int addrerror(struct addr_parse_state *state, void *scanner, const char *msg);
+int addrlex(YYSTYPE *lvalp, void *scanner);
+
+int addrlex_init(void **scanner);
+int addrlex_destroy(void *scanner);
+void addrset_extra(struct addr_parse_state *state, void *scanner);
 
 #define YYERROR_VERBOSE /* i want better error messages! */
 %}
 
+%code requires {
+/* addr.h declares addrparse() with a pointer to it */
+struct addr_parse_state;
+}
+
+%define api.pure
+%parse-param {struct addr_parse_state *state}
+%parse-param {void *scanner}
+%lex-param {void *scanner}
+
 %token ATOM QTEXT DTEXT
 
 %start sieve_address
@@ -82,11 +98,43 @@ qstring: '"' QTEXT '"'
 
 %%
 
-/* copy address error message into buffer provided by sieve parser */
-int addrerror(const char *s)
+/* copy address error message into the parse-state */
+int addrerror(struct addr_parse_state *state, void *scanner, const char *s)
 {
-    extern char *addrerr;
-
-    addrerr = xstrdup(s);
+    if (state->addrerr)
+	free(state->addrerr);
+    state->addrerr = xstrdup(s);
     return 0;
 }
+
+/* checks whether the given string is a valid address, returns 0 if so.
+   Otherwise *err is set to the (malloc'ed) error message.
+   Each call uses its own parser- and lexer-state, so addresses can be 
+   verified by several threads at once. */
+int addr_verify(const char *addr, char **err)
+{
+    struct addr_parse_state state;
+    void *scanner;
+    int res;
+
+    state.addrptr = addr;
+    state.addrerr = NULL;
+    state.ncom = 0;
+    if (addrlex_init(&scanner) != 0) {
+	*err = xstrdup("unable to create address lexer");
+	return 1;
+    }
+    addrset_extra(&state, scanner);
+    res = addrparse(&state, scanner);
+    addrlex_destroy(scanner);
+
+    /* the lexer stops the parser on unbalanced comments, which would
+       otherwise look like a valid end of the address */
+    if (!res && state.addrerr)
+	res = 1;
+
+    if (res && !state.addrerr)
+	state.addrerr = xstrdup("address parse error");
+    *err = state.addrerr;
+    return res;
+}
@@ -116,13 +116,14 @@ int script_require(sieve_script_t *s, char *req)
     return 0;
 }
 
-/* given an interpretor and a script, produce an executable script */
-int sieve_script_parse(sieve_interp_t *interp, FILE *script,
-		       void *script_context, sieve_script_t **ret)
+/* given an interpretor and a script (either a file or a string of the
+   given length), produce an executable script */
+static int script_parse(sieve_interp_t *interp, FILE *script, 
+			const char *text, int len,
+			void *script_context, sieve_script_t **ret)
 {
     sieve_script_t *s;
     int res = SIEVE_OK;
-    extern int sievelineno;
 
     res = interp_verify(interp);
     if (res != SIEVE_OK) {
@@ -137,8 +138,10 @@ int sieve_script_parse(sieve_interp_t *interp, FILE *script,
 
     s->err = 0;
 
-    sievelineno = 1;		/* reset line number */
-    s->cmds = sieve_parse(s, script);
+    if (script)
+	s->cmds = sieve_parse(s, script);
+    else
+	s->cmds = sieve_parse_string(s, text, len);
     if (s->err > 0) {
 	if (s->cmds) {
 	    free_tree(s->cmds);
@@ -151,6 +154,19 @@ int sieve_script_parse(sieve_interp_t *interp, FILE *script,
     return res;
 }
 
+int sieve_script_parse(sieve_interp_t *interp, FILE *script,
+		       void *script_context, sieve_script_t **ret)
+{
+    return script_parse(interp, script, NULL, 0, script_context, ret);
+}
+
+int sieve_script_parse_string(sieve_interp_t *interp, const char *script,
+			      int len, void *script_context, 
+			      sieve_script_t **ret)
+{
+    return script_parse(interp, NULL, script, len, script_context, ret);
+}
+
 char **stringlist_to_chararray(stringlist_t **list)
 /* [zooey]:
 	I changed the semantics of this function to NOT destroy the
@@ -882,6 +898,15 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
     notify_list_t *notify_list = NULL;
     char actions_string[BUF_SZ+1] = "";
     const char *errmsg = NULL;
+    sieve_interp_t interp;
+
+    /* the imapflags are the only state that is changed by executing the 
+       script, so we work on a private copy of the interpretor (with its own
+       flags), which allows the script to be executed by several threads 
+       at once */
+    interp = s->interp;
+    interp.curflags.flag = NULL;
+    interp.curflags.nflags = 0;
 
     if (s->support.notify) {
 	notify_list = new_notify_list();
@@ -895,11 +920,11 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	goto error;
     }
  
-    free_imapflags(&s->interp.curflags);
- 
-    if (eval(&s->interp, s->cmds, message_context, actions,
-	     notify_list, &errmsg) < 0)
+    if (eval(&interp, s->cmds, message_context, actions,
+	     notify_list, &errmsg) < 0) {
+	free_imapflags(&interp.curflags);
 	return SIEVE_RUN_ERROR;
+    }
   
     strcpy(actions_string,"Action(s) taken:\n");
   
@@ -913,10 +938,10 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	switch (a->a) {
 	case ACTION_REJECT:
 	    implicit_keep = 0;
-	    if (!s->interp.reject)
+	    if (!interp.reject)
 		return SIEVE_INTERNAL_ERROR;
-	    ret = s->interp.reject(&a->u.rej,
-				   s->interp.interp_context,
+	    ret = interp.reject(&a->u.rej,
+				   interp.interp_context,
 				   s->script_context,
 				   message_context,
 				   &errmsg);
@@ -936,10 +961,10 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	    break;
 	case ACTION_FILEINTO:
 	    implicit_keep = 0;
-	    if (!s->interp.fileinto)
+	    if (!interp.fileinto)
 		return SIEVE_INTERNAL_ERROR;
-	    ret = s->interp.fileinto(&a->u.fil,
-				     s->interp.interp_context,
+	    ret = interp.fileinto(&a->u.fil,
+				     interp.interp_context,
 				     s->script_context,
 				     message_context,
 				     &errmsg);
@@ -958,10 +983,10 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	    break;
 	case ACTION_KEEP:
 	    implicit_keep = 0;
-	    if (!s->interp.keep)
+	    if (!interp.keep)
 		return SIEVE_INTERNAL_ERROR;
-	    ret = s->interp.keep(&a->u.keep,
-				 s->interp.interp_context,
+	    ret = interp.keep(&a->u.keep,
+				 interp.interp_context,
 				 s->script_context,
 				 message_context,
 				 &errmsg);
@@ -977,10 +1002,10 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	    break;
 	case ACTION_REDIRECT:
 	    implicit_keep = 0;
-	    if (!s->interp.redirect)
+	    if (!interp.redirect)
 		return SIEVE_INTERNAL_ERROR;
-	    ret = s->interp.redirect(&a->u.red,
-				     s->interp.interp_context,
+	    ret = interp.redirect(&a->u.red,
+				     interp.interp_context,
 				     s->script_context,
 				     message_context,
 				     &errmsg);
@@ -998,8 +1023,8 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	    break;
 	case ACTION_DISCARD:
 	    implicit_keep = 0;
-	    if (s->interp.discard) /* discard is optional */
-		ret = s->interp.discard(NULL, s->interp.interp_context,
+	    if (interp.discard) /* discard is optional */
+		ret = interp.discard(NULL, interp.interp_context,
 					s->script_context,
 					message_context,
 					&errmsg);
@@ -1018,7 +1043,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	    {
 		unsigned char hash[HASHSIZE];
 
-		if (!s->interp.vacation)
+		if (!interp.vacation)
 		    return SIEVE_INTERNAL_ERROR;
 
 		/* first, let's figure out if we should respond to this */
@@ -1027,16 +1052,16 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 		if (ret == SIEVE_OK) {
 		    a->u.vac.autoresp.hash = hash;
 		    a->u.vac.autoresp.len = HASHSIZE;
-		    ret = s->interp.vacation->autorespond(&a->u.vac.autoresp,
-							  s->interp.interp_context,
+		    ret = interp.vacation->autorespond(&a->u.vac.autoresp,
+							  interp.interp_context,
 							  s->script_context,
 							  message_context,
 							  &errmsg);
 		}
 		if (ret == SIEVE_OK) {
 		    /* send the response */
-		    ret = s->interp.vacation->send_response(&a->u.vac.send,
-							    s->interp.interp_context,
+		    ret = interp.vacation->send_response(&a->u.vac.send,
+							    interp.interp_context,
 							    s->script_context, 
 							    message_context,
 							    &errmsg);
@@ -1069,34 +1094,34 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
  
 	case ACTION_SETFLAG:
-	    free_imapflags(&s->interp.curflags);
-	    ret = sieve_addflag(&s->interp.curflags, a->u.fla.flag);
+	    free_imapflags(&interp.curflags);
+	    ret = sieve_addflag(&interp.curflags, a->u.fla.flag);
 	    break;
 	case ACTION_ADDFLAG:
-	    ret = sieve_addflag(&s->interp.curflags, a->u.fla.flag);
+	    ret = sieve_addflag(&interp.curflags, a->u.fla.flag);
 	    break;
 	case ACTION_REMOVEFLAG:
-	    ret = sieve_removeflag(&s->interp.curflags, a->u.fla.flag);
+	    ret = sieve_removeflag(&interp.curflags, a->u.fla.flag);
 	    break;
 	case ACTION_MARK:
 	    {
-		int n = s->interp.markflags->nflags;
+		int n = interp.markflags->nflags;
 
 		ret = SIEVE_OK;
 		while (n && ret == SIEVE_OK) {
-		    ret = sieve_addflag(&s->interp.curflags,
-					s->interp.markflags->flag[--n]);
+		    ret = sieve_addflag(&interp.curflags,
+					interp.markflags->flag[--n]);
 		}
 		break;
 	    }
 	case ACTION_UNMARK:
 	    {
-		int n = s->interp.markflags->nflags;
+		int n = interp.markflags->nflags;
 
 		ret = SIEVE_OK;
 		while (n && ret == SIEVE_OK) {
-		    ret = sieve_removeflag(&s->interp.curflags,
-					   s->interp.markflags->flag[--n]);
+		    ret = sieve_removeflag(&interp.curflags,
+					   interp.markflags->flag[--n]);
 		}
 		break;
 	    }
@@ -1148,7 +1173,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 #endif
     }
  
-    if ((ret != SIEVE_OK) && s->interp.err) {
+    if ((ret != SIEVE_OK) && interp.err) {
 	char buf[BUF_SZ+1];
 	if (lastaction == -1) /* we never executed an action */
 #ifdef __MWERKS__
@@ -1167,7 +1192,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
                      errmsg ? errmsg : sieve_errstr(ret));
 #endif
  
-	ret |= s->interp.execute_err(buf, s->interp.interp_context,
+	ret |= interp.execute_err(buf, interp.interp_context,
 				     s->script_context, message_context);
     }
 
@@ -1177,10 +1202,10 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
 	implicit_keep = 0;	/* don't try an implicit keep again */
 
-	keep_context.imapflags = &s->interp.curflags;
+	keep_context.imapflags = &interp.curflags;
  
 	lastaction = ACTION_KEEP;
-	keep_ret = s->interp.keep(&keep_context, s->interp.interp_context,
+	keep_ret = interp.keep(&keep_context, interp.interp_context,
 			     s->script_context, message_context, &errmsg);
 	ret |= keep_ret;
         if (keep_ret == SIEVE_OK)
@@ -1222,6 +1247,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
  
     if (actions)
 	free_action_list(actions);
+    free_imapflags(&interp.curflags);
   
     return ret;
 }
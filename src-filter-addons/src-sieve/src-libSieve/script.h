@@ -54,8 +54,35 @@ struct sieve_script {
     int err;
 };
 
+/* the state of a single run of the sieve parser. the parsers (and lexers)
+   don't use any global variables, so several scripts can be parsed at once
+   (by different threads) */
+struct sieve_parse_state {
+    sieve_script_t *script;	/* the script being parsed */
+    commandlist_t *ret;		/* the commands of the parsed script */
+    void *scanner;		/* the (reentrant) lexer */
+
+    /* buffer for the (quoted or multiline) string being lexed */
+    char *mlbuf;
+    size_t mlbufsz, mlcur;
+};
+
+/* the state of a single run of the address parser */
+struct addr_parse_state {
+    const char *addrptr;	/* current position in the address string */
+    char *addrerr;		/* error message, if the address is invalid */
+    int ncom;			/* number of open comments */
+};
+
 /* generated by the yacc script */
 commandlist_t *sieve_parse(sieve_script_t *interp, FILE *f);
+commandlist_t *sieve_parse_string(sieve_script_t *interp, const char *text,
+				  int len);
 int script_require(sieve_script_t *s, char *req);
 
+/* generated by the address yacc script, returns 0 if the given address is
+   valid, otherwise *err is set to the error message (to be freed by the
+   caller) */
+int addr_verify(const char *addr, char **err);
+
 #endif
@@ -43,8 +43,6 @@ OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include "imparse.h"
 
 /* definitions */
-int addrparse(void);
-void reset_sieve_lexer( FILE* sievein);
 
 struct vtags {
     int days;
@@ -81,12 +79,12 @@ struct dtags {
     char *priority;
 };
 
-static commandlist_t *ret;
-static sieve_script_t *parse_script;
-static int check_reqs(stringlist_t *sl);
-static test_t *build_address(int t, struct aetags *ae,
+static int check_reqs(struct sieve_parse_state *state, stringlist_t *sl);
+static test_t *build_address(struct sieve_parse_state *state,
+			     int t, struct aetags *ae,
 			     stringlist_t *sl, patternlist_t *pl);
-static test_t *build_header(int t, struct htags *h,
+static test_t *build_header(struct sieve_parse_state *state,
+			    int t, struct htags *h,
 			    stringlist_t *sl, patternlist_t *pl);
 static commandlist_t *build_vacation(int t, struct vtags *h, char *s);
 static commandlist_t *build_notify(int t, struct ntags *n);
@@ -98,7 +96,8 @@ static struct htags *new_htags(void);
 static struct htags *canon_htags(struct htags *h);
 static void free_htags(struct htags *h);
 static struct vtags *new_vtags(void);
-static struct vtags *canon_vtags(struct vtags *v);
+static struct vtags *canon_vtags(struct sieve_parse_state *state,
+				 struct vtags *v);
 static void free_vtags(struct vtags *v);
 static struct ntags *new_ntags(void);
 static struct ntags *canon_ntags(struct ntags *n);
@@ -106,24 +105,46 @@ static void free_ntags(struct ntags *n);
 static struct dtags *new_dtags(void);
 static void free_dtags(struct dtags *d);
 
-static int verify_stringlist(stringlist_t *sl, int (*verify)(char *));
-static int verify_mailbox(char *s);
-static int verify_address(char *s);
-static int verify_header(char *s);
-static int verify_flag(char *s);
-static int verify_relat(char *s);
+static int verify_stringlist(struct sieve_parse_state *state, stringlist_t *sl,
+			     int (*verify)(struct sieve_parse_state *, char *));
+static int verify_mailbox(struct sieve_parse_state *state, char *s);
+static int verify_address(struct sieve_parse_state *state, char *s);
+static int verify_header(struct sieve_parse_state *state, char *s);
+static int verify_flag(struct sieve_parse_state *state, char *s);
+static int verify_relat(struct sieve_parse_state *state, char *s);
 #ifdef ENABLE_REGEX
-static regex_t *verify_regex(char *s, int cflags);
-static patternlist_t *verify_regexs(stringlist_t *sl, char *comp);
+static regex_t *verify_regex(struct sieve_parse_state *state, char *s,
+			     int cflags);
+static patternlist_t *verify_regexs(struct sieve_parse_state *state,
+				    stringlist_t *sl, char *comp);
 #endif
 static int ok_header(char *s);
 
-extern int sieveerror(const char *msg);
-extern int sievelex(void);
+static int parse_error(struct sieve_parse_state *state, const char *msg);
+int sieveerror(struct sieve_parse_state *state, void *scanner, 
+	       const char *msg);
+
+/* the reentrant lexer (generated by flex) */
+int sievelex_init(void **scanner);
+int sievelex_destroy(void *scanner);
+void sieveset_extra(struct sieve_parse_state *state, void *scanner);
+void sieveset_in(FILE *in, void *scanner);
+void *sieve_scan_bytes(const char *bytes, int len, void *scanner);
+int sieveget_lineno(void *scanner);
 
 #define YYERROR_VERBOSE /* i want better error messages! */
 %}
 
+%code requires {
+/* sieve.h declares sieveparse() with a pointer to it */
+struct sieve_parse_state;
+}
+
+%define api.pure
+%parse-param {struct sieve_parse_state *state}
+%parse-param {void *scanner}
+%lex-param {void *scanner}
+
 %union {
     int nval;
     char *sval;
@@ -138,6 +159,11 @@ extern int sievelex(void);
     struct dtags *dtag;
 }
 
+%{
+/* (needs YYSTYPE, so it has to be declared after the %union) */
+int sievelex(YYSTYPE *lvalp, void *scanner);
+%}
+
 %token <nval> NUMBER
 %token <sval> STRING
 %token IF ELSIF ELSE
@@ -165,16 +191,16 @@ extern int sievelex(void);
 
 %%
 
-start: /* empty */		{ ret = NULL; }
-	| reqs commands		{ ret = $2; }
+start: /* empty */		{ state->ret = NULL; }
+	| reqs commands		{ state->ret = $2; }
 	;
 
 reqs: /* empty */
 	| require reqs
 	;
 
-require: REQUIRE stringlist ';'	{ if (!check_reqs($2)) {
-                                    sieveerror("unsupported feature");
+require: REQUIRE stringlist ';'	{ if (!check_reqs(state, $2)) {
+                                    parse_error(state, "unsupported feature");
 				    YYERROR; 
                                   } }
 	;
@@ -193,84 +219,84 @@ elsif: /* empty */               { $$ = NULL; }
 	| ELSE block             { $$ = $2; }
 	;
 
-action: REJCT STRING             { if (!parse_script->support.reject) {
-				     sieveerror("reject not required");
+action: REJCT STRING             { if (!state->script->support.reject) {
+				     parse_error(state, "reject not required");
 				     YYERROR;
 				   }
 				   $$ = new_command(REJCT); $$->u.str = $2; }
-	| FILEINTO STRING	 { if (!parse_script->support.fileinto) {
-				     sieveerror("fileinto not required");
+	| FILEINTO STRING	 { if (!state->script->support.fileinto) {
+				     parse_error(state, "fileinto not required");
 	                             YYERROR;
                                    }
-				   if (!verify_mailbox($2)) {
-				     YYERROR; /* vm should call sieveerror() */
+				   if (!verify_mailbox(state, $2)) {
+				     YYERROR; /* vm should call parse_error() */
 				   }
 	                           $$ = new_command(FILEINTO);
 				   $$->u.str = $2; }
 	| REDIRECT STRING         { $$ = new_command(REDIRECT);
-				   if (!verify_address($2)) {
-				     YYERROR; /* va should call sieveerror() */
+				   if (!verify_address(state, $2)) {
+				     YYERROR; /* va should call parse_error() */
 				   }
 				   $$->u.str = $2; }
 	| KEEP			 { $$ = new_command(KEEP); }
 	| STOP			 { $$ = new_command(STOP); }
 	| DISCARD		 { $$ = new_command(DISCARD); }
-	| VACATION vtags STRING  { if (!parse_script->support.vacation) {
-				     sieveerror("vacation not required");
+	| VACATION vtags STRING  { if (!state->script->support.vacation) {
+				     parse_error(state, "vacation not required");
 				     $$ = new_command(VACATION);
 				     YYERROR;
 				   } else {
   				     $$ = build_vacation(VACATION,
-					    canon_vtags($2), $3);
+					    canon_vtags(state, $2), $3);
 				   } }
-        | SETFLAG stringlist     { if (!parse_script->support.imapflags) {
-                                    sieveerror("imapflags not required");
+        | SETFLAG stringlist     { if (!state->script->support.imapflags) {
+                                    parse_error(state, "imapflags not required");
                                     YYERROR;
                                    }
-                                  if (!verify_stringlist($2, verify_flag)) {
-                                    YYERROR; /* vf should call sieveerror() */
+                                  if (!verify_stringlist(state, $2, verify_flag)) {
+                                    YYERROR; /* vf should call parse_error() */
                                   }
                                   $$ = new_command(SETFLAG);
                                   $$->u.sl = $2; }
-         | ADDFLAG stringlist     { if (!parse_script->support.imapflags) {
-                                    sieveerror("imapflags not required");
+         | ADDFLAG stringlist     { if (!state->script->support.imapflags) {
+                                    parse_error(state, "imapflags not required");
                                     YYERROR;
                                     }
-                                  if (!verify_stringlist($2, verify_flag)) {
-                                    YYERROR; /* vf should call sieveerror() */
+                                  if (!verify_stringlist(state, $2, verify_flag)) {
+                                    YYERROR; /* vf should call parse_error() */
                                   }
                                   $$ = new_command(ADDFLAG);
                                   $$->u.sl = $2; }
-         | REMOVEFLAG stringlist  { if (!parse_script->support.imapflags) {
-                                    sieveerror("imapflags not required");
+         | REMOVEFLAG stringlist  { if (!state->script->support.imapflags) {
+                                    parse_error(state, "imapflags not required");
                                     YYERROR;
                                     }
-                                  if (!verify_stringlist($2, verify_flag)) {
-                                    YYERROR; /* vf should call sieveerror() */
+                                  if (!verify_stringlist(state, $2, verify_flag)) {
+                                    YYERROR; /* vf should call parse_error() */
                                   }
                                   $$ = new_command(REMOVEFLAG);
                                   $$->u.sl = $2; }
-         | MARK                   { if (!parse_script->support.imapflags) {
-                                    sieveerror("imapflags not required");
+         | MARK                   { if (!state->script->support.imapflags) {
+                                    parse_error(state, "imapflags not required");
                                     YYERROR;
                                     }
                                   $$ = new_command(MARK); }
-         | UNMARK                 { if (!parse_script->support.imapflags) {
-                                    sieveerror("imapflags not required");
+         | UNMARK                 { if (!state->script->support.imapflags) {
+                                    parse_error(state, "imapflags not required");
                                     YYERROR;
                                     }
                                   $$ = new_command(UNMARK); }
 
-         | NOTIFY ntags           { if (!parse_script->support.notify) {
-				       sieveerror("notify not required");
+         | NOTIFY ntags           { if (!state->script->support.notify) {
+				       parse_error(state, "notify not required");
 				       $$ = new_command(NOTIFY); 
 				       YYERROR;
 	 			    } else {
 				      $$ = build_notify(NOTIFY,
 				             canon_ntags($2));
 				    } }
-         | DENOTIFY dtags         { if (!parse_script->support.notify) {
-                                       sieveerror("notify not required");
+         | DENOTIFY dtags         { if (!state->script->support.notify) {
+                                       parse_error(state, "notify not required");
 				       $$ = new_command(DENOTIFY);
 				       YYERROR;
 				    } else {
@@ -280,28 +306,28 @@ action: REJCT STRING             { if (!parse_script->support.reject) {
 
 ntags: /* empty */		 { $$ = new_ntags(); }
 	| ntags ID STRING	 { if ($$->id != NULL) { 
-					sieveerror("duplicate :method"); YYERROR; }
+					parse_error(state, "duplicate :method"); YYERROR; }
 				   else { $$->id = $3; } }
 	| ntags METHOD STRING	 { if ($$->method != NULL) { 
-					sieveerror("duplicate :method"); YYERROR; }
+					parse_error(state, "duplicate :method"); YYERROR; }
 				   else { $$->method = $3; } }
 	| ntags OPTIONS stringlist { if ($$->options != NULL) { 
-					sieveerror("duplicate :options"); YYERROR; }
+					parse_error(state, "duplicate :options"); YYERROR; }
 				     else { $$->options = $3; } }
 	| ntags priority	 { if ($$->priority != NULL) { 
-					sieveerror("duplicate :priority"); YYERROR; }
+					parse_error(state, "duplicate :priority"); YYERROR; }
 				   else { $$->priority = $2; } }
 	| ntags MESSAGE STRING	 { if ($$->message != NULL) { 
-					sieveerror("duplicate :message"); YYERROR; }
+					parse_error(state, "duplicate :message"); YYERROR; }
 				   else { $$->message = $3; } }
 	;
 
 dtags: /* empty */		 { $$ = new_dtags(); }
 	| dtags priority	 { if ($$->priority != NULL) { 
-				sieveerror("duplicate priority level"); YYERROR; }
+				parse_error(state, "duplicate priority level"); YYERROR; }
 				   else { $$->priority = $2; } }
 	| dtags comptag STRING 	 { if ($$->comptag != -1) { 
-			sieveerror("duplicate comparator type tag"); YYERROR;
+			parse_error(state, "duplicate comparator type tag"); YYERROR;
 				   } else {
 				       $$->comptag = $2;
 #ifdef ENABLE_REGEX
@@ -309,7 +335,7 @@ dtags: /* empty */		 { $$ = new_dtags(); }
 					   int cflags = REG_EXTENDED |
 					       REG_NOSUB | REG_ICASE;
 					   $$->pattern =
-					       (void*) verify_regex($3, cflags);
+					       (void*) verify_regex(state, $3, cflags);
 					   if (!$$->pattern) { YYERROR; }
 				       }
 				       else
@@ -319,13 +345,13 @@ dtags: /* empty */		 { $$ = new_dtags(); }
 				}
 	| dtags relcomp STRING  { $$ = $1;
 				  if ($$->comptag != -1) { 
-				      sieveerror("duplicate comparator type tag"); YYERROR; 
+				      parse_error(state, "duplicate comparator type tag"); YYERROR; 
 				  } else {
 				      $$->comptag = $2;
-				      $$->relation = verify_relat($3);
+				      $$->relation = verify_relat(state, $3);
 				      if ($$->relation==-1) 
 				      {
-				      	  YYERROR; /*vr called sieveerror()*/ 
+				      	  YYERROR; /*vr called parse_error()*/ 
 				      }
 				  } 
 				}
@@ -338,24 +364,24 @@ priority: LOW    { $$ = "low"; }
 
 vtags: /* empty */		 { $$ = new_vtags(); }
 	| vtags DAYS NUMBER	 { if ($$->days != -1) { 
-					sieveerror("duplicate :days"); YYERROR; }
+					parse_error(state, "duplicate :days"); YYERROR; }
 				   else { $$->days = $3; } }
 	| vtags ADDRESSES stringlist { if ($$->addresses != NULL) { 
-					sieveerror("duplicate :addresses"); 
+					parse_error(state, "duplicate :addresses"); 
 					YYERROR;
-				       } else if (!verify_stringlist($3,
+				       } else if (!verify_stringlist(state, $3,
 							verify_address)) {
 					  YYERROR;
 				       } else {
 					 $$->addresses = $3; } }
 	| vtags SUBJECT STRING	 { if ($$->subject != NULL) { 
-					sieveerror("duplicate :subject"); 
+					parse_error(state, "duplicate :subject"); 
 					YYERROR;
 				   } else if (!ok_header($3)) {
 					YYERROR;
 				   } else { $$->subject = $3; } }
 	| vtags MIME		 { if ($$->mime != -1) { 
-					sieveerror("duplicate :mime"); 
+					parse_error(state, "duplicate :mime"); 
 					YYERROR; }
 				   else { $$->mime = MIME; } }
 	;
@@ -379,39 +405,39 @@ test: ANYOF testlist		 { $$ = new_test(ANYOF); $$->u.tl = $2; }
 	| STRUE			 { $$ = new_test(STRUE); }
 	| HEADER htags stringlist stringlist
 				 { patternlist_t *pl;
-                                   if (!verify_stringlist($3, verify_header)) {
-                                     YYERROR; /* vh should call sieveerror() */
+                                   if (!verify_stringlist(state, $3, verify_header)) {
+                                     YYERROR; /* vh should call parse_error() */
                                    }
 
 				   $2 = canon_htags($2);
 #ifdef ENABLE_REGEX
 				   if ($2->comptag == REGEX) {
-				     pl = verify_regexs($4, $2->comparator);
+				     pl = verify_regexs(state, $4, $2->comparator);
 				     if (!pl) { YYERROR; }
 				   }
 				   else
 #endif
 				     pl = (patternlist_t *) $4;
 				       
-				   $$ = build_header(HEADER, $2, $3, pl);
+				   $$ = build_header(state, HEADER, $2, $3, pl);
 				   if ($$ == NULL) { YYERROR; } }
 	| addrorenv aetags stringlist stringlist
 				 { patternlist_t *pl;
-                                   if (!verify_stringlist($3, verify_header)) {
-                                     YYERROR; /* vh should call sieveerror() */
+                                   if (!verify_stringlist(state, $3, verify_header)) {
+                                     YYERROR; /* vh should call parse_error() */
                                    }
 
 				   $2 = canon_aetags($2);
 #ifdef ENABLE_REGEX
 				   if ($2->comptag == REGEX) {
-				     pl = verify_regexs($4, $2->comparator);
+				     pl = verify_regexs(state, $4, $2->comparator);
 				     if (!pl) { YYERROR; }
 				   }
 				   else
 #endif
 				     pl = (patternlist_t *) $4;
 				       
-				   $$ = build_address($1, $2, $3, pl);
+				   $$ = build_address(state, $1, $2, $3, pl);
 				   if ($$ == NULL) { YYERROR; } }
 	| NOT test		 { $$ = new_test(NOT); $$->u.t = $2; }
 	| SIZE sizetag NUMBER    { $$ = new_test(SIZE); $$->u.sz.t = $2;
@@ -426,7 +452,7 @@ addrorenv: ADDRESS		 { $$ = ADDRESS; }
 aetags: /* empty */              { $$ = new_aetags(); }
         | aetags addrparttag	 { $$ = $1;
 				   if ($$->addrtag != -1) { 
-				       sieveerror("duplicate or conflicting address part tag");
+				       parse_error(state, "duplicate or conflicting address part tag");
 			               YYERROR; 
 			           } else {
 			               $$->addrtag = $2; 
@@ -434,29 +460,29 @@ aetags: /* empty */              { $$ = new_aetags(); }
 			         }
 	| aetags comptag         { $$ = $1;
 				   if ($$->comptag != -1) { 
-				       sieveerror("duplicate comparator type tag"); YYERROR; 
+				       parse_error(state, "duplicate comparator type tag"); YYERROR; 
 				   } else { 
 				       $$->comptag = $2; 
 				   } 
 				 }
 	| aetags relcomp STRING  { $$ = $1;
 				   if ($$->comptag != -1) { 
-				       sieveerror("duplicate comparator type tag"); YYERROR; 
+				       parse_error(state, "duplicate comparator type tag"); YYERROR; 
 				   } else { 
 				       $$->comptag = $2;
-				       $$->relation = verify_relat($3);
+				       $$->relation = verify_relat(state, $3);
 				       if ($$->relation==-1) {
-				       	   YYERROR; /*vr called sieveerror()*/ 
+				       	   YYERROR; /*vr called parse_error()*/ 
 				       }
 				   } 
 				 }
 	| aetags COMPARATOR STRING { $$ = $1;
 				   if ($$->comparator != NULL) { 
-				       sieveerror("duplicate comparator tag"); 
+				       parse_error(state, "duplicate comparator tag"); 
 				       YYERROR; 
 				   } else if (!strcmp($3, "i;ascii-numeric") 
-				   && !parse_script->support.i_ascii_numeric) {
-				       sieveerror("comparator-i;ascii-numeric not required");
+				   && !state->script->support.i_ascii_numeric) {
+				       parse_error(state, "comparator-i;ascii-numeric not required");
 				       YYERROR; 
 				   }
 				   else { $$->comparator = $3; } }
@@ -465,26 +491,26 @@ aetags: /* empty */              { $$ = new_aetags(); }
 htags: /* empty */		 { $$ = new_htags(); }
 	| htags comptag		 { $$ = $1;
 				   if ($$->comptag != -1) { 
-			sieveerror("duplicate comparator type tag"); YYERROR; }
+			parse_error(state, "duplicate comparator type tag"); YYERROR; }
 				   else { $$->comptag = $2; } }
 	| htags relcomp STRING 	 { $$ = $1;
 				   if ($$->comptag != -1) { 
-				       sieveerror("duplicate comparator type tag"); YYERROR; 
+				       parse_error(state, "duplicate comparator type tag"); YYERROR; 
 				   } else {
 				       $$->comptag = $2;
-				       $$->relation = verify_relat($3);
+				       $$->relation = verify_relat(state, $3);
 				       if ($$->relation==-1) {
-				           YYERROR; /*vr called sieveerror()*/ 
+				           YYERROR; /*vr called parse_error()*/ 
 				       }
 				   } 
 				 }
 	| htags COMPARATOR STRING { $$ = $1;
 				   if ($$->comparator != NULL) { 
-				       sieveerror("duplicate comparator tag"); 
+				       parse_error(state, "duplicate comparator tag"); 
 				       YYERROR; 
 				   } else if (!strcmp($3, "i;ascii-numeric") 
-				   && !parse_script->support.i_ascii_numeric) {
-				       sieveerror("comparator-i;ascii-numeric not required");
+				   && !state->script->support.i_ascii_numeric) {
+				       parse_error(state, "comparator-i;ascii-numeric not required");
 				       YYERROR; 
 				   }
 				   else { $$->comparator = $3; } }
@@ -493,13 +519,13 @@ htags: /* empty */		 { $$ = new_htags(); }
 addrparttag: ALL                 { $$ = ALL; }
 	| LOCALPART		 { $$ = LOCALPART; }
 	| DOMAIN                 { $$ = DOMAIN; }
-	| USER                   { if (!parse_script->support.subaddress) {
-				     sieveerror("subaddress not required");
+	| USER                   { if (!state->script->support.subaddress) {
+				     parse_error(state, "subaddress not required");
 				     YYERROR;
 				   }
 				   $$ = USER; }
-	| DETAIL                { if (!parse_script->support.subaddress) {
-				     sieveerror("subaddress not required");
+	| DETAIL                { if (!state->script->support.subaddress) {
+				     parse_error(state, "subaddress not required");
 				     YYERROR;
 				   }
 				   $$ = DETAIL; }
@@ -508,21 +534,21 @@ addrparttag: ALL                 { $$ = ALL; }
 comptag: IS			 { $$ = IS; }
 	| CONTAINS		 { $$ = CONTAINS; }
 	| MATCHES		 { $$ = MATCHES; }
-	| REGEX			 { if (!parse_script->support.regex) {
-				     sieveerror("regex not required");
+	| REGEX			 { if (!state->script->support.regex) {
+				     parse_error(state, "regex not required");
 				     YYERROR;
 				   }
 				   $$ = REGEX; }
 	;
 
-relcomp: COUNT			 { if (!parse_script->support.relational) {
-				     sieveerror("relational not required");
+relcomp: COUNT			 { if (!state->script->support.relational) {
+				     parse_error(state, "relational not required");
 				     YYERROR;
 				   }
 				   $$ = COUNT; 
 				 }
-	| VALUE			 { if (!parse_script->support.relational) {
-				     sieveerror("relational not required");
+	| VALUE			 { if (!state->script->support.relational) {
+				     parse_error(state, "relational not required");
 				     YYERROR;
 				   }
 				   $$ = VALUE; 
@@ -541,41 +567,68 @@ tests: test                      { $$ = new_testlist($1, NULL); }
 	;
 
 %%
-commandlist_t *sieve_parse(sieve_script_t *script, FILE *f)
+/* parses the script either from the given file or from the given text */
+static commandlist_t *sieve_parse_input(sieve_script_t *script, FILE *f, 
+					const char *text, int len)
 {
-    commandlist_t *t;
-    extern FILE *sievein;
+    struct sieve_parse_state state;
+    commandlist_t *t = NULL;
 
-    sievein = f;
-    parse_script = script;
-    
-    reset_sieve_lexer( f);
-    
-    if (sieveparse()) {
-	t = NULL;
-    } else {
-	t = ret;
+    memset(&state, 0, sizeof(state));
+    state.script = script;
+    if (sievelex_init(&state.scanner) != 0) {
+	script->err++;
+	return NULL;
+    }
+    sieveset_extra(&state, state.scanner);
+    if (f)
+	sieveset_in(f, state.scanner);
+    else
+	sieve_scan_bytes(text, len, state.scanner);
+
+    if (sieveparse(&state, state.scanner) == 0) {
+	t = state.ret;
     }
-    ret = NULL;
+
+    /* a string may have been left unfinished by an error: */
+    free(state.mlbuf);
+    sievelex_destroy(state.scanner);
     return t;
 }
 
-int sieveerror(const char *msg)
+commandlist_t *sieve_parse(sieve_script_t *script, FILE *f)
 {
-    extern int sievelineno;
-    int ret;
+    return sieve_parse_input(script, f, NULL, 0);
+}
+
+commandlist_t *sieve_parse_string(sieve_script_t *script, const char *text,
+				  int len)
+{
+    return sieve_parse_input(script, NULL, text, len);
+}
 
-    parse_script->err++;
-    if (parse_script->interp.err) {
-	ret = parse_script->interp.err(sievelineno, msg, 
-				       parse_script->interp.interp_context,
-				       parse_script->script_context);
+/* called by the parser (and the lexer) */
+int sieveerror(struct sieve_parse_state *state, 
+	       void *scanner __attribute__((unused)), const char *msg)
+{
+    return parse_error(state, msg);
+}
+
+static int parse_error(struct sieve_parse_state *state, const char *msg)
+{
+    sieve_script_t *script = state->script;
+
+    script->err++;
+    if (script->interp.err) {
+	script->interp.err(sieveget_lineno(state->scanner), msg, 
+			   script->interp.interp_context,
+			   script->script_context);
     }
 
     return 0;
 }
 
-static int check_reqs(stringlist_t *sl)
+static int check_reqs(struct sieve_parse_state *state, stringlist_t *sl)
 {
     int i = 1;
     stringlist_t *s;
@@ -584,7 +637,7 @@ static int check_reqs(stringlist_t *sl)
 	s = sl;
 	sl = sl->next;
 
-	i &= script_require(parse_script, s->s);
+	i &= script_require(state->script, s->s);
 
 	if (s->s) free(s->s);
 	free(s);
@@ -592,7 +645,8 @@ static int check_reqs(stringlist_t *sl)
     return i;
 }
 
-static test_t *build_address(int t, struct aetags *ae,
+static test_t *build_address(struct sieve_parse_state *state,
+			     int t, struct aetags *ae,
 			     stringlist_t *sl, patternlist_t *pl)
 {
     test_t *ret = new_test(t);	/* can be either ADDRESS or ENVELOPE */
@@ -604,7 +658,7 @@ static test_t *build_address(int t, struct aetags *ae,
 	ret->u.ae.relation = ae->relation;
 	ret->u.ae.comp = lookup_comp(ae->comparator, ae->comptag, ae->relation);
 	if (!ret->u.ae.comp) {
-   	    sieveerror("unknown comparator tag");
+   	    parse_error(state, "unknown comparator tag");
 	    return NULL;
 	}
 	ret->u.ae.sl = sl;
@@ -619,7 +673,8 @@ static test_t *build_address(int t, struct aetags *ae,
     return ret;
 }
 
-static test_t *build_header(int t, struct htags *h,
+static test_t *build_header(struct sieve_parse_state *state,
+			    int t, struct htags *h,
 			    stringlist_t *sl, patternlist_t *pl)
 {
     test_t *ret = new_test(t);	/* can be HEADER */
@@ -631,7 +686,7 @@ static test_t *build_header(int t, struct htags *h,
 	ret->u.h.relation = h->relation;
 	ret->u.h.comp = lookup_comp(h->comparator, h->comptag, h->relation);
 	if (!ret->u.h.comp) {
-   	    sieveerror("unknown comparator tag");
+   	    parse_error(state, "unknown comparator tag");
 	    return NULL;
 	}
 	ret->u.h.sl = sl;
@@ -755,15 +810,16 @@ static struct vtags *new_vtags(void)
     return r;
 }
 
-static struct vtags *canon_vtags(struct vtags *v)
+static struct vtags *canon_vtags(struct sieve_parse_state *state,
+				 struct vtags *v)
 {
-    assert(parse_script->interp.vacation != NULL);
+    assert(state->script->interp.vacation != NULL);
 
     if (v->days == -1) { v->days = 7; }
-    if (v->days < parse_script->interp.vacation->min_response) 
-       { v->days = parse_script->interp.vacation->min_response; }
-    if (v->days > parse_script->interp.vacation->max_response)
-       { v->days = parse_script->interp.vacation->max_response; }
+    if (v->days < state->script->interp.vacation->min_response) 
+       { v->days = state->script->interp.vacation->min_response; }
+    if (v->days > state->script->interp.vacation->max_response)
+       { v->days = state->script->interp.vacation->max_response; }
     if (v->mime == -1) { v->mime = 0; }
 
     return v;
@@ -823,24 +879,21 @@ static void free_dtags(struct dtags *d)
     free(d);
 }
 
-static int verify_stringlist(stringlist_t *sl, int (*verify)(char *))
+static int verify_stringlist(struct sieve_parse_state *state, stringlist_t *sl,
+			     int (*verify)(struct sieve_parse_state *, char *))
 {
-    for (; sl != NULL && verify(sl->s); sl = sl->next) ;
+    for (; sl != NULL && verify(state, sl->s); sl = sl->next) ;
     return (sl == NULL);
 }
 
-char *addrptr;		/* pointer to address string for address lexer */
-char *addrerr;		/* buffer for address parser error messages */
-
-static int verify_address(char *s)
+static int verify_address(struct sieve_parse_state *state, char *s)
 {
     char *err;
+    char *addrerr = NULL;
 
-    addrptr = s;
-    addrerr = NULL;
-    if (addrparse()) {
+    if (addr_verify(s, &addrerr)) {
 	err = xstrconcat("address '", s, "': ", addrerr, NULL);
-	sieveerror(err);
+	parse_error(state, err);
 	free(addrerr);
 	free(err);
 	return 0;
@@ -848,13 +901,14 @@ static int verify_address(char *s)
     return 1;
 }
 
-static int verify_mailbox(char *s __attribute__((unused)))
+static int verify_mailbox(struct sieve_parse_state *state __attribute__((unused)),
+			  char *s __attribute__((unused)))
 {
     /* xxx if not a mailbox, call sieveerror */
     return 1;
 }
 
-static int verify_header(char *hdr)
+static int verify_header(struct sieve_parse_state *state, char *hdr)
 {
     char *h = hdr;
     char *err;
@@ -867,7 +921,7 @@ static int verify_header(char *hdr)
 	   ;  ":". */
 	if (!((*h >= 33 && *h <= 57) || (*h >= 59 && *h <= 126))) {
 	    err = xstrconcat("header '", hdr, "': not a valid header", NULL);
-	    sieveerror(err);
+	    parse_error(state, err);
 	    free(err);
 	    return 0;
 	}
@@ -876,7 +930,7 @@ static int verify_header(char *hdr)
     return 1;
 }
  
-static int verify_flag(char *f)
+static int verify_flag(struct sieve_parse_state *state, char *f)
 {
     char *err;
  
@@ -886,7 +940,7 @@ static int verify_flag(char *f)
 	    strcmp(f, "\\flagged") && strcmp(f, "\\draft") &&
 	    strcmp(f, "\\deleted")) {
             err = xstrconcat("flag '", f, "': not a system flag", NULL);
-	    sieveerror(err);
+	    parse_error(state, err);
 	    free(err);
 	    return 0;
 	}
@@ -894,14 +948,14 @@ static int verify_flag(char *f)
     }
     if (!imparse_isatom(f)) {
 	err = xstrconcat("flag '", f, "': not a valid keyword", NULL);
-	sieveerror(err);
+	parse_error(state, err);
 	free(err);
 	return 0;
     }
     return 1;
 }
  
-static int verify_relat(char *r)
+static int verify_relat(struct sieve_parse_state *state, char *r)
 {/* this really should have been a token to begin with.*/
     char errbuf[100];
     lcase(r);
@@ -918,13 +972,14 @@ static int verify_relat(char *r)
       snprintf(errbuf, sizeof(errbuf), 
       	   "flag '%s': not a valid relational operation", r);
 #endif
-      sieveerror(errbuf);
+      parse_error(state, errbuf);
       return -1;
     }
 }
 
 #ifdef ENABLE_REGEX
-static regex_t *verify_regex(char *s, int cflags)
+static regex_t *verify_regex(struct sieve_parse_state *state, char *s,
+			     int cflags)
 {
     int ret;
     char errbuf[100];
@@ -932,14 +987,15 @@ static regex_t *verify_regex(char *s, int cflags)
 
     if ((ret = regcomp(reg, s, cflags)) != 0) {
 	(void) regerror(ret, reg, errbuf, sizeof(errbuf));
-	sieveerror(errbuf);
+	parse_error(state, errbuf);
 	free(reg);
 	return NULL;
     }
     return reg;
 }
 
-static patternlist_t *verify_regexs(stringlist_t *sl, char *comp)
+static patternlist_t *verify_regexs(struct sieve_parse_state *state,
+				    stringlist_t *sl, char *comp)
 {
     stringlist_t *sl2;
     patternlist_t *pl = NULL;
@@ -951,7 +1007,7 @@ static patternlist_t *verify_regexs(stringlist_t *sl, char *comp)
     }
 
     for (sl2 = sl; sl2 != NULL; sl2 = sl2->next) {
-	if ((reg = verify_regex(sl2->s, cflags)) == NULL) {
+	if ((reg = verify_regex(state, sl2->s, cflags)) == NULL) {
 	    free_pl(pl, REGEX);
 	    break;
 	}
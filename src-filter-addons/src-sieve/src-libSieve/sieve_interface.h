@@ -141,9 +141,17 @@ extern int sieve_register_execute_error(sieve_interp_t *interp,
 extern int sieve_script_parse(sieve_interp_t *interp, FILE *script,
 		       void *script_context, sieve_script_t **ret);
 
+/* the same, but the script is read from the given string of len bytes */
+extern int sieve_script_parse_string(sieve_interp_t *interp, 
+			      const char *script, int len,
+			      void *script_context, sieve_script_t **ret);
+
 extern int sieve_script_free(sieve_script_t **s);
 
-/* execute a script on a message, producing side effects via callbacks */
+/* execute a script on a message, producing side effects via callbacks.
+   a parsed script is never changed by executing it, so it may be executed
+   on several messages (by several threads) at once, as long as the 
+   callbacks are thread-safe. parsing is reentrant, too. */
 extern int sieve_execute_script(sieve_script_t *script, 
 			 void *message_context);
 
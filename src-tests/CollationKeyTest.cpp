@@ -0,0 +1,85 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include "CollationKeyTest.h"
+#include "TestBeam.h"
+
+#include "BmMailRef.h"
+
+// setUp
+void
+CollationKeyTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+CollationKeyTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void CollationKeyTest::SubjectKeyTest() {
+	// subjects are folded to lowercase:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::SubjectCollationKey( "Hello World") 
+							== "hello world");
+
+	// reply- and forward-prefixes are removed, even if nested:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::SubjectCollationKey( "Re: Hello") == "hello");
+	CPPUNIT_ASSERT( BmMailRef::SubjectCollationKey( "AW: Fwd: RE: Hello") 
+							== "hello");
+	CPPUNIT_ASSERT( BmMailRef::SubjectCollationKey( "Re[2]: Hello") 
+							== "hello");
+
+	// but words starting like a prefix are kept:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::SubjectCollationKey( "Report") == "report");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void CollationKeyTest::AddressKeyTest() {
+	// the phrase is used if there is one, the address otherwise:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "Bob <bob@x.org>") 
+							== "bob");
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "\"Bob Smith\" <bob@x.org>")
+							== "bob smith");
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "Bob@X.org") 
+							== "bob@x.org");
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "<bob@x.org>") 
+							== "<bob@x.org>");
+
+	// only the first address counts:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "a@b.com, Bob <bob@x>") 
+							== "a@b.com");
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "Al <a@b.com>, Bob <bob@x>")
+							== "al");
+
+	// commas within quotes or comments do not end the first address:
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "\"Doe, John\" <j@x>, k@y")
+							== "doe, john");
+	CPPUNIT_ASSERT( BmMailRef::AddressCollationKey( "j@x (Doe, John), k@y")
+							== "j@x (doe, john)");
+}
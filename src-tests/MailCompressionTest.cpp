@@ -0,0 +1,105 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <algorithm>
+
+#include "MailCompressionTest.h"
+#include "TestBeam.h"
+
+#include "BmMailCompression.h"
+
+// setUp
+void
+MailCompressionTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+MailCompressionTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailCompressionTest::RoundTripTest() {
+	string mail = "From: Alice <alice@example.org>\r\nSubject: test\r\n\r\n";
+	for( int i=0; i<1000; ++i)
+		mail += "This line is repeated over and over again.\r\n";
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmMailCompression::IsCompressed( mail.data(), mail.size()));
+	string compressed;
+	CPPUNIT_ASSERT( BmMailCompression::Compress( mail.data(), mail.size(),
+																compressed));
+	CPPUNIT_ASSERT( compressed.size() < mail.size() / 10);
+	CPPUNIT_ASSERT( BmMailCompression::IsCompressed( compressed.data(),
+																	 compressed.size()));
+	CPPUNIT_ASSERT( BmMailCompression::UncompressedSize( compressed.data(),
+																		  compressed.size())
+							== mail.size());
+
+	NextSubTest();
+	string text;
+	CPPUNIT_ASSERT( BmMailCompression::Decompress( compressed.data(),
+																  compressed.size(), text));
+	CPPUNIT_ASSERT( text == mail);
+
+	NextSubTest();
+	// truncated and damaged files must not be accepted:
+	CPPUNIT_ASSERT( !BmMailCompression::Decompress( compressed.data(),
+																	compressed.size()-4, text));
+	string damaged = compressed;
+	damaged[damaged.size()/2] ^= 0x5A;
+	CPPUNIT_ASSERT( !BmMailCompression::Decompress( damaged.data(),
+																	damaged.size(), text));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailCompressionTest::InflaterTest() {
+	string mail = "Subject: test\r\n\r\n";
+	for( int i=0; i<1000; ++i)
+		mail += "Another line of text for the inflater.\r\n";
+	string compressed;
+	BmMailCompression::Compress( mail.data(), mail.size(), compressed);
+
+	NextSubTest();
+	// feed the inflater in small chunks, just like when reading a file:
+	string text( mail.size(), '\0');
+	BmMailInflater inflater( &text[0], text.size());
+	for( size_t pos = BmMailCompression::nHeaderSize; 
+		  pos < compressed.size(); pos += 100) {
+		size_t len = std::min( (size_t)100, compressed.size() - pos);
+		CPPUNIT_ASSERT( inflater.Feed( compressed.data() + pos, len));
+	}
+	CPPUNIT_ASSERT( inflater.IsDone());
+	CPPUNIT_ASSERT( inflater.OutLength() == mail.size());
+	CPPUNIT_ASSERT( text == mail);
+
+	NextSubTest();
+	// a smaller buffer just receives the start of the mail:
+	char header[16];
+	BmMailInflater headerInflater( header, sizeof(header));
+	headerInflater.Feed( compressed.data() + BmMailCompression::nHeaderSize,
+								compressed.size() - BmMailCompression::nHeaderSize);
+	CPPUNIT_ASSERT( headerInflater.IsDone());
+	CPPUNIT_ASSERT( headerInflater.OutLength() == sizeof(header));
+	CPPUNIT_ASSERT( mail.compare( 0, sizeof(header), header, sizeof(header)) 
+							== 0);
+}
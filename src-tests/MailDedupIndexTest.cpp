@@ -0,0 +1,148 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "MailDedupIndexTest.h"
+#include "TestBeam.h"
+
+#include "BmMail.h"
+#include "BmMailDedupIndex.h"
+
+// setUp
+void
+MailDedupIndexTest::setUp()
+{
+	inherited::setUp();
+	BmMailDedupIndex::CreateInstance();
+}
+
+// tearDown
+void
+MailDedupIndexTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static bool Key( const char* text, uint64& key) {
+	const char* body = strstr( text, "\r\n\r\n");
+	int32 headerLength = body ? body - text + 2 : strlen( text);
+	return BmMailDedupIndex::ContentKey( text, strlen( text), headerLength,
+													 key);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailDedupIndexTest::ContentKeyTest() {
+	uint64 key1 = 0, key2 = 0;
+	// mails without message-id have no key:
+	NextSubTest();
+	CPPUNIT_ASSERT( !Key( "Subject: test\r\n\r\nbody\r\n", key1));
+
+	// different headers and trailing whitespace do not matter:
+	NextSubTest();
+	CPPUNIT_ASSERT( Key( "Message-ID: <a@x>\r\nSubject: test\r\n\r\n"
+								"line1\r\nline2\r\n", key1));
+	CPPUNIT_ASSERT( Key( "Received: from somewhere\r\n"
+								"Subject: [list] test\r\nMessage-ID: <a@x>\r\n"
+								"\r\nline1\nline2\n\n  ", key2));
+	CPPUNIT_ASSERT( key1 == key2);
+
+	// but different bodies and different message-ids do:
+	NextSubTest();
+	CPPUNIT_ASSERT( Key( "Message-ID: <a@x>\r\n\r\nline1\r\nline3\r\n", 
+								key2));
+	CPPUNIT_ASSERT( key1 != key2);
+	CPPUNIT_ASSERT( Key( "Message-ID: <b@x>\r\n\r\nline1\r\nline2\r\n", 
+								key2));
+	CPPUNIT_ASSERT( key1 != key2);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailDedupIndexTest::RetrievalTest() {
+	CPPUNIT_ASSERT( TheMailDedupIndex);
+	BmString text 
+		= BmString("Message-ID: <") << system_time() << "@dedup.test>\r\n"
+			<< "Subject: dedup\r\n\r\nbody\r\n";
+	BmRef<BmMail> mail = new BmMail( text, "dedup");
+	CPPUNIT_ASSERT( mail->InitCheck() == B_OK);
+
+	// checking a retrieved mail must not add it to the index, as storing
+	// the mail may still fail:
+	NextSubTest();
+	CPPUNIT_ASSERT( !TheMailDedupIndex->Contains( mail.Get()));
+	CPPUNIT_ASSERT( !TheMailDedupIndex->Contains( mail.Get()));
+
+	// once the mail has been stored, it is known:
+	NextSubTest();
+	TheMailDedupIndex->Add( mail.Get());
+	CPPUNIT_ASSERT( TheMailDedupIndex->Contains( mail.Get()));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailDedupIndexTest::AgingTest() {
+	CPPUNIT_ASSERT( TheMailDedupIndex);
+	uint32 now = time( NULL);
+	uint64 oldKey = 0xDEDA000000000001ULL;
+	uint64 recentKey = 0xDEDA000000000002ULL;
+	TheMailDedupIndex->AddKey( oldKey, now - TheMailDedupIndex->MaxAge() - 60);
+	TheMailDedupIndex->AddKey( recentKey, now - TheMailDedupIndex->MaxAge()/2);
+
+	// entries are only dropped when the index is pruned:
+	NextSubTest();
+	CPPUNIT_ASSERT( TheMailDedupIndex->ContainsKey( oldKey));
+	CPPUNIT_ASSERT( TheMailDedupIndex->ContainsKey( recentKey));
+
+	// storing the index prunes it:
+	NextSubTest();
+	CPPUNIT_ASSERT( TheMailDedupIndex->Store());
+	CPPUNIT_ASSERT( !TheMailDedupIndex->ContainsKey( oldKey));
+	CPPUNIT_ASSERT( TheMailDedupIndex->ContainsKey( recentKey));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailDedupIndexTest::PruningTest() {
+	CPPUNIT_ASSERT( TheMailDedupIndex);
+	int32 maxEntries = TheMailDedupIndex->MaxEntries();
+	int32 count = maxEntries + maxEntries/8 + 1;
+	uint32 base = time( NULL) - TheMailDedupIndex->MaxAge()/2;
+	uint64 firstKey = 0xDEDB000000000000ULL;
+
+	// exceeding the limit by more than an eighth prunes the index, storing
+	// it trims it down to the limit, dropping the oldest entries first:
+	NextSubTest();
+	for( int32 i=0; i<count; ++i)
+		TheMailDedupIndex->AddKey( firstKey + i, base + i);
+	CPPUNIT_ASSERT( TheMailDedupIndex->EntryCount() <= count);
+	CPPUNIT_ASSERT( TheMailDedupIndex->Store());
+	CPPUNIT_ASSERT( TheMailDedupIndex->EntryCount() <= maxEntries);
+	CPPUNIT_ASSERT( !TheMailDedupIndex->ContainsKey( firstKey));
+	CPPUNIT_ASSERT( !TheMailDedupIndex->ContainsKey( firstKey + count/16));
+	CPPUNIT_ASSERT( TheMailDedupIndex->ContainsKey( firstKey + count-1));
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <OS.h>
+
+#include "MailLoadTest.h"
+#include "TestBeam.h"
+
+#include "BmMail.h"
+#include "BmMailCompression.h"
+#include "BmMailRef.h"
+#include "BmPrefs.h"
+
+using std::string;
+
+static const char* const nTestFolder = "/tmp/BmMailLoadTest";
+
+/*------------------------------------------------------------------------------*\
+	WriteMailFile( name, text)
+		-	writes the given text into a mail-file of the test-folder and returns
+			its entry_ref
+\*------------------------------------------------------------------------------*/
+static entry_ref WriteMailFile( const char* name, const string& text)
+{
+	BmString path = BmString(nTestFolder) << "/" << name;
+	BFile file( path.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	file.Write( text.data(), text.size());
+	entry_ref eref;
+	get_ref_for_path( path.String(), &eref);
+	return eref;
+}
+
+/*------------------------------------------------------------------------------*\
+	LoadMail( eref, mapped, outDuration)
+		-	loads the mail from the given file (through a mapping or by reading
+			it) and returns its raw text
+		-	outDuration is the time it took until the mail was ready for display
+\*------------------------------------------------------------------------------*/
+static BmString LoadMail( entry_ref& eref, bool mapped, 
+								  bigtime_t& outDuration)
+{
+	ThePrefs->SetBool( "MapMailFilesIntoMemory", mapped);
+	bigtime_t start = system_time();
+	BmRef<BmMailRef> ref = BmMailRef::CreateInstance( eref);
+	BmRef<BmMail> mail = BmMail::CreateInstance( ref.Get());
+	mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+	outDuration = system_time() - start;
+	ThePrefs->SetBool( "MapMailFilesIntoMemory", true);
+	return mail->InitCheck() == B_OK ? mail->RawText() : BmString();
+}
+
+/*------------------------------------------------------------------------------*\
+	MakeMailText( size)
+		-	returns a (canonical) mail-text of about the given size
+\*------------------------------------------------------------------------------*/
+static string MakeMailText( size_t size)
+{
+	string text = "From: Alice <alice@example.org>\r\n"
+					  "To: Bob <bob@example.org>\r\n"
+					  "Subject: a rather large mail\r\n"
+					  "\r\n";
+	const string line = "All work and no play makes Jack a dull boy. "
+							  "All work and no play makes Jack a dull boy.\r\n";
+	while( text.size() < size)
+		text += line;
+	return text;
+}
+
+// setUp
+void
+MailLoadTest::setUp()
+{
+	inherited::setUp();
+	create_directory( nTestFolder, 0755);
+}
+
+// tearDown
+void
+MailLoadTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	BinaryNullTest()
+		-	binary nulls must neither cut a mail short nor survive loading,
+			independent of how the mail-file is read
+\*------------------------------------------------------------------------------*/
+void MailLoadTest::BinaryNullTest() {
+	string text = "From: Alice <alice@example.org>\r\n"
+					  "Subject: nulls\r\n"
+					  "\r\n"
+					  "before";
+	text += '\0';
+	text += "after\r\n";
+	string compressed;
+	BmMailCompression::Compress( text.data(), text.size(), compressed);
+	const char* names[] = { "null-plain", "null-compressed" };
+	const string* contents[] = { &text, &compressed };
+	for( int f=0; f<2; ++f) {
+		for( int mapped=0; mapped<2; ++mapped) {
+			NextSubTest();
+			BmString name = BmString(names[f]) << "-" << mapped;
+			entry_ref eref = WriteMailFile( name.String(), *contents[f]);
+			bigtime_t duration;
+			BmString rawText = LoadMail( eref, mapped != 0, duration);
+			CPPUNIT_ASSERT( rawText.Length() == int32(text.size()));
+			CPPUNIT_ASSERT( rawText.FindFirst( "before after") != B_ERROR);
+			CPPUNIT_ASSERT( memchr( rawText.String(), 0, rawText.Length()) 
+									== NULL);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	LoadTimeTest()
+		-	measures the time-to-first-display for large mails, with and without
+			mapping the mail-file into memory
+\*------------------------------------------------------------------------------*/
+void MailLoadTest::LoadTimeTest() {
+	const size_t sizes[] = { 1024*1024, 50*1024*1024 };
+	for( int s=0; s<2; ++s) {
+		string text = MakeMailText( sizes[s]);
+		BmString name = BmString("large-") << int32(sizes[s] / (1024*1024));
+		for( int mapped=0; mapped<2; ++mapped) {
+			NextSubTest();
+			// every load needs a file of its own, since the mail would
+			// otherwise be served from memory:
+			BmString fileName = name + (mapped ? "-mapped" : "-read");
+			entry_ref eref = WriteMailFile( fileName.String(), text);
+			bigtime_t duration;
+			BmString rawText = LoadMail( eref, mapped != 0, duration);
+			CPPUNIT_ASSERT( rawText.Length() == int32(text.size()));
+			printf( "\n\t%s: %ld ms", fileName.String(), 
+					  int32(duration / 1000));
+			fflush( stdout);
+		}
+	}
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <string.h>
+
+#include "MailThreaderTest.h"
+#include "TestBeam.h"
+
+#include "BmMailThreader.h"
+
+// setUp
+void
+MailThreaderTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+MailThreaderTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+static uint16 Depth( const BmMailThreader& threader, ino_t node) {
+	uint64 threadId;
+	uint16 depth = 0xFFFF;
+	threader.ThreadInfo( node, threadId, depth);
+	return depth;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+static uint64 Thread( const BmMailThreader& threader, ino_t node) {
+	uint64 threadId = 0;
+	uint16 depth;
+	threader.ThreadInfo( node, threadId, depth);
+	return threadId;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void MailThreaderTest::ThreadingTest() {
+	BmMailThreader threader;
+	vector< ino_t> affected;
+	// replies arrive before the mail they refer to:
+	NextSubTest();
+	threader.AddMail( 2, "<b@x>", "<a@x>", affected);
+	threader.AddMail( 3, "<c@x>", "<a@x> <b@x>", affected);
+	threader.AddMail( 4, "<d@x>", "", affected);
+	CPPUNIT_ASSERT( Thread( threader, 2) == Thread( threader, 3));
+	CPPUNIT_ASSERT( Thread( threader, 2) != Thread( threader, 4));
+	CPPUNIT_ASSERT( Depth( threader, 2) == 0);
+	CPPUNIT_ASSERT( Depth( threader, 3) == 1);
+
+	// the missing mail fills the placeholder at the root:
+	NextSubTest();
+	affected.clear();
+	threader.AddMail( 1, "<a@x>", "", affected);
+	CPPUNIT_ASSERT( affected.size() == 3);
+	CPPUNIT_ASSERT( Thread( threader, 1) == Thread( threader, 3));
+	CPPUNIT_ASSERT( Depth( threader, 1) == 0);
+	CPPUNIT_ASSERT( Depth( threader, 2) == 1);
+	CPPUNIT_ASSERT( Depth( threader, 3) == 2);
+	CPPUNIT_ASSERT( threader.ContainerCount() == 4);
+
+	// a mail without id and a duplicate id each get a container of their own:
+	NextSubTest();
+	threader.AddMail( 5, "", "<d@x>", affected);
+	threader.AddMail( 6, "<d@x>", "<a@x>", affected);
+	CPPUNIT_ASSERT( Thread( threader, 5) == Thread( threader, 4));
+	CPPUNIT_ASSERT( Depth( threader, 5) == 1);
+	CPPUNIT_ASSERT( Thread( threader, 6) == Thread( threader, 1));
+	CPPUNIT_ASSERT( Depth( threader, 6) == 1);
+	CPPUNIT_ASSERT( threader.MailCount() == 6);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void MailThreaderTest::RemovalTest() {
+	BmMailThreader threader;
+	vector< ino_t> affected;
+	threader.AddMail( 1, "<a@x>", "", affected);
+	threader.AddMail( 2, "<b@x>", "<a@x>", affected);
+	threader.AddMail( 3, "<c@x>", "<a@x> <b@x>", affected);
+	uint64 thread = Thread( threader, 1);
+
+	// removing a mail in the middle keeps its container as placeholder:
+	NextSubTest();
+	affected.clear();
+	threader.RemoveMail( 2, affected);
+	CPPUNIT_ASSERT( affected.size() == 1 && affected[0] == 3);
+	CPPUNIT_ASSERT( Thread( threader, 3) == thread);
+	CPPUNIT_ASSERT( Depth( threader, 3) == 1);
+	CPPUNIT_ASSERT( threader.ContainerCount() == 3);
+
+	// unused placeholders are dropped:
+	NextSubTest();
+	threader.RemoveMail( 3, affected);
+	CPPUNIT_ASSERT( threader.ContainerCount() == 1);
+	threader.RemoveMail( 1, affected);
+	CPPUNIT_ASSERT( threader.ContainerCount() == 0);
+	CPPUNIT_ASSERT( threader.MailCount() == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void MailThreaderTest::LoopTest() {
+	BmMailThreader threader;
+	vector< ino_t> affected;
+	// mails referring to each other must not produce a loop:
+	NextSubTest();
+	threader.AddMail( 1, "<a@x>", "<b@x>", affected);
+	threader.AddMail( 2, "<b@x>", "<a@x>", affected);
+	threader.AddMail( 3, "<c@x>", "<c@x>", affected);
+	CPPUNIT_ASSERT( Thread( threader, 1) == Thread( threader, 2));
+	CPPUNIT_ASSERT( Depth( threader, 1) + Depth( threader, 2) == 1);
+	CPPUNIT_ASSERT( Depth( threader, 3) == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void MailThreaderTest::HeaderTest() {
+	BmString messageID, references;
+	NextSubTest();
+	const char* header =
+		"From: Alice <alice@example.org>\r\n"
+		"message-id:\r\n"
+		"\t<m1@example.org> (comment)\r\n"
+		"References: <r1@example.org>\r\n"
+		" <r2@example.org>\r\n"
+		"In-Reply-To: <r3@example.org>\r\n"
+		"\r\n"
+		"References: <body@example.org>\r\n";
+	BmMailThreader::ExtractIDsFromHeader( header, strlen( header),
+													  messageID, references);
+	CPPUNIT_ASSERT( messageID == "<m1@example.org>");
+	CPPUNIT_ASSERT( references
+							== "<r1@example.org> <r2@example.org> <r3@example.org>");
+
+	// in-reply-to is not repeated, long references are shortened:
+	NextSubTest();
+	BmString longRefs;
+	for( int i=0; i<40; ++i)
+		longRefs << "<" << i << "@x> ";
+	references = BmMailThreader::NormalizedReferences( longRefs, "<39@x>");
+	CPPUNIT_ASSERT( references.FindFirst( "<0@x> <25@x> ") == 0);
+	CPPUNIT_ASSERT( references.FindFirst( "<24@x>") < 0);
+	CPPUNIT_ASSERT( references.FindFirst( "<38@x> <39@x>") > 0);
+	CPPUNIT_ASSERT( references.FindFirst( "<39@x> ") < 0);
+}
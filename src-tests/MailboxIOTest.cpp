@@ -0,0 +1,132 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MailboxIOTest.h"
+#include "TestBeam.h"
+
+#include "BmMailboxIO.h"
+
+// setUp
+void
+MailboxIOTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+MailboxIOTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailboxIOTest::HeaderTest() {
+	string mail = "From: Alice\r\n <alice@example.org>\r\n"
+					  "status: RO\r\nX-Status: A\r\n\r\nFrom: not a field\r\n";
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailboxIO::HeaderLength( mail) == 60);
+	CPPUNIT_ASSERT( BmMailboxIO::HeaderField( mail, "from")
+							== "Alice <alice@example.org>");
+	CPPUNIT_ASSERT( BmMailboxIO::MboxSender( mail) == "alice@example.org");
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailboxIO::StatusFromMboxHeader( mail) == "Replied");
+	CPPUNIT_ASSERT( BmMailboxIO::StatusFromMaildirFlags( "FS") == "Read");
+	CPPUNIT_ASSERT( BmMailboxIO::MaildirFlagsFromStatus( "Replied") == "RS");
+	CPPUNIT_ASSERT( BmMailboxIO::MaildirFlagsFromStatus( "New") == "");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailboxIOTest::MboxTest() {
+	FILE* file = tmpfile();
+	CPPUNIT_ASSERT( file != NULL);
+	// separators within the body are quoted (mboxrd):
+	NextSubTest();
+	BmMboxWriter writer( file, false);
+	CPPUNIT_ASSERT( writer.WriteMail( "From: a@x\r\nStatus: O\r\n\r\n"
+												 "From here\r\n>From there\r\n", 
+												 "Read"));
+	CPPUNIT_ASSERT( writer.WriteMail( "From: b@x\r\n\r\nbody", "New"));
+	CPPUNIT_ASSERT( writer.Finish());
+
+	// ...and unquoted when reading:
+	NextSubTest();
+	rewind( file);
+	BmMboxReader reader( file, true);
+	string text, status;
+	CPPUNIT_ASSERT( reader.NextMail( text, status));
+	CPPUNIT_ASSERT( text == "From: a@x\nStatus: RO\n\nFrom here\n>From there\n");
+	CPPUNIT_ASSERT( status == "Read");
+	CPPUNIT_ASSERT( reader.NextMail( text, status));
+	CPPUNIT_ASSERT( text == "From: b@x\n\nbody\n");
+	CPPUNIT_ASSERT( status == "New");
+	CPPUNIT_ASSERT( !reader.NextMail( text, status));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void MailboxIOTest::SeparatorTest() {
+	// the separator carries the date of the mail:
+	NextSubTest();
+	string mail = "Date: Mon, 12 Jan 2004 10:11:12 +0100\r\n\r\nbody\r\n";
+	CPPUNIT_ASSERT( BmMailboxIO::MailDate( mail) == 1073898672);
+	CPPUNIT_ASSERT( BmMailboxIO::MailDate( "Date: 1 Feb 99 00:00 EST\n\n")
+							== 917845200);
+	CPPUNIT_ASSERT( BmMailboxIO::MailDate( "Date: someday\n\n") == 0);
+	FILE* file = tmpfile();
+	CPPUNIT_ASSERT( file != NULL);
+	BmMboxWriter writer( file, false);
+	CPPUNIT_ASSERT( writer.WriteMail( mail, "New"));
+	CPPUNIT_ASSERT( writer.Finish());
+	rewind( file);
+	char line[128];
+	CPPUNIT_ASSERT( fgets( line, sizeof(line), file) != NULL);
+	CPPUNIT_ASSERT( !strcmp( line, 
+									"From MAILER-DAEMON Mon Jan 12 09:11:12 2004\n"));
+	fclose( file);
+
+	// unquoted "From "-lines (mboxo) only separate mails after an empty
+	// line and if they carry a sender and a date:
+	NextSubTest();
+	file = tmpfile();
+	CPPUNIT_ASSERT( file != NULL);
+	fputs( "From a@x Mon Jan 12 09:11:12 2004\n"
+			 "Subject: 1\n\nFrom me to you\nFrom a@x Mon Jan 12 09:11:12 2004\n\n"
+			 "From b@x Tue Jan 13 09:11:12 2004\n"
+			 "Subject: 2\n\nbody\n\nFrom nowhere\n\n"
+			 "From \"c d\"@x Wed Jan  7 01:02:03 PST 2004\n"
+			 "Subject: 3\n\nbody\n", file);
+	rewind( file);
+	BmMboxReader reader( file, true);
+	string text, status;
+	CPPUNIT_ASSERT( reader.NextMail( text, status));
+	CPPUNIT_ASSERT( text == "Subject: 1\n\nFrom me to you\n"
+									"From a@x Mon Jan 12 09:11:12 2004\n");
+	CPPUNIT_ASSERT( reader.NextMail( text, status));
+	CPPUNIT_ASSERT( text == "Subject: 2\n\nbody\n\nFrom nowhere\n");
+	CPPUNIT_ASSERT( reader.NextMail( text, status));
+	CPPUNIT_ASSERT( text == "Subject: 3\n\nbody\n");
+	CPPUNIT_ASSERT( !reader.NextMail( text, status));
+}
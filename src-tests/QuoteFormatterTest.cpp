@@ -0,0 +1,183 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include "QuoteFormatterTest.h"
+#include "TestBeam.h"
+
+#include "BmMailFactory.h"
+#include "BmPrefs.h"
+
+// setUp
+void
+QuoteFormatterTest::setUp()
+{
+	inherited::setUp();
+	mOldQuoteFormatting = ThePrefs->GetString( "QuoteFormatting");
+}
+
+// tearDown
+void
+QuoteFormatterTest::tearDown()
+{
+	ThePrefs->SetString( "QuoteFormatting", mOldQuoteFormatting);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	CheckQuote( style, maxLineLen, in, expected, expectedLineLen)
+		-	quotes the given text with the given formatting style and compares
+			the result against the output of the former (regex-based) 
+			implementation
+\*------------------------------------------------------------------------------*/
+void QuoteFormatterTest::CheckQuote( const char* style, int maxLineLen, 
+												const char* in, const char* expected,
+												int32 expectedLineLen) {
+	ThePrefs->SetString( "QuoteFormatting", style);
+	BmQuoteFormatter formatter( "> ", maxLineLen);
+	BmString out;
+	int32 lineLen = formatter.Quote( in, out);
+	CPPUNIT_ASSERT( out == expected);
+	CPPUNIT_ASSERT( lineLen == expectedLineLen);
+}
+
+/*------------------------------------------------------------------------------*\
+	NestedQuoteTest()
+		-	every quoting level must be kept, no matter whether the quote-chars
+			are separated by spaces or not
+\*------------------------------------------------------------------------------*/
+void QuoteFormatterTest::NestedQuoteTest() {
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_PUSH_MARGIN, 76,
+					"Hi there,\n"
+					"> first level\n"
+					"> > second level\n"
+					">> compact second level\n"
+					">>> third level\n"
+					"> back to first\n"
+					"\n"
+					"bye\n",
+					"> Hi there,\n"
+					"> > first level\n"
+					"> > > second level\n"
+					"> >> compact second level\n"
+					"> >>> third level\n"
+					"> > back to first\n"
+					"> \n"
+					"> bye\n",
+					76);
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_SIMPLE, 40,
+					"> > word word word word word word word word word word word word word word word word word word word word \n"
+					"> short\n",
+					"> > > word word word word word word \n"
+					"> > > word word word word word word \n"
+					"> > > word word word word word word \n"
+					"> > > word word\n"
+					"> > short\n",
+					40);
+}
+
+/*------------------------------------------------------------------------------*\
+	SignatureTest()
+		-	the signature-separator must stay on a line of its own (and must not
+			be joined with the signature when rewrapping)
+\*------------------------------------------------------------------------------*/
+void QuoteFormatterTest::SignatureTest() {
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_PUSH_MARGIN, 76,
+					"see you tomorrow\n"
+					"\n"
+					"-- \n"
+					"Alice Example\n"
+					"http://alice.example.org/\n",
+					"> see you tomorrow\n"
+					"> \n"
+					"> --\n"
+					"> Alice Example\n"
+					"> http://alice.example.org/\n",
+					76);
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_AUTO_WRAP, 76,
+					"Let us meet at the usual place tomorrow afternoon, if that suits you,\n"
+					"and discuss the rest of the plan there.\n"
+					"-- \n"
+					"Alice Example\n",
+					"> Let us meet at the usual place tomorrow afternoon, if that suits you, and \n"
+					"> discuss the rest of the plan there.\n"
+					"> -- \n"
+					"> Alice Example\n",
+					76);
+}
+
+/*------------------------------------------------------------------------------*\
+	WrapTest()
+		-	words longer than a line are split, URLs are never wrapped
+\*------------------------------------------------------------------------------*/
+void QuoteFormatterTest::WrapTest() {
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_SIMPLE, 30,
+					"a xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx b\n",
+					"> a \n"
+					"> xxxxxxxxxxxxxxxxxxxxxxxxxxxx\n"
+					"> xxxxxxxxxxxxxxxxxxxxxx b\n",
+					30);
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_SIMPLE, 30,
+					"see http://www.example.org/a/very/long/path/that/exceeds/the/margin.html for details\n",
+					"> see \n"
+					"> http://www.example.org/a/very/long/path/that/exceeds/the/margin.html \n"
+					"> for details\n",
+					71);
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_SIMPLE, 30,
+					"http://www.example.org/a/very/long/path/that/exceeds/the/margin.html and more text\n",
+					"> http://www.example.org/a/very/long/path/that/exceeds/the/margin.html \n"
+					"> and more text\n",
+					71);
+}
+
+/*------------------------------------------------------------------------------*\
+	FlowedTest()
+		-	format=flowed input (soft line-breaks marked by a trailing space) is
+			joined into paragraphs and rewrapped, lists are left intact
+\*------------------------------------------------------------------------------*/
+void QuoteFormatterTest::FlowedTest() {
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_AUTO_WRAP, 76,
+					"This paragraph was sent with format=flowed, so each of its lines \n"
+					"ends with a space to mark a soft line-break that may be joined \n"
+					"by the recipient when reformatting.\n"
+					"\n"
+					"> And this is a quoted flowed paragraph, again with soft breaks \n"
+					"> at the end of each line, which should be joined as well.\n",
+					"> This paragraph was sent with format=flowed, so each of its lines ends \n"
+					"> with a space to mark a soft line-break that may be joined by the \n"
+					"> recipient when reformatting.\n"
+					"> \n"
+					"> > And this is a quoted flowed paragraph, again with soft breaks at the \n"
+					"> > end of each line, which should be joined as well.\n",
+					76);
+	NextSubTest();
+	CheckQuote( BmMailFactory::BM_QUOTE_AUTO_WRAP, 76,
+					"Things to do, most of which have to be done by tomorrow evening:\n"
+					"* buy milk\n"
+					"* fix the bike\n"
+					"1. first\n"
+					"2. second\n",
+					"> Things to do, most of which have to be done by tomorrow evening:\n"
+					"> * buy milk\n"
+					"> * fix the bike\n"
+					"> 1. first\n"
+					"> 2. second\n",
+					76);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+
+#ifndef _QuoteFormatterTest_h
+#define _QuoteFormatterTest_h
+
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <TestCase.h>
+
+#include "BmString.h"
+
+class QuoteFormatterTest : public BTestCase
+{
+	typedef TestCase inherited;
+	CPPUNIT_TEST_SUITE( QuoteFormatterTest );
+	CPPUNIT_TEST( NestedQuoteTest);
+	CPPUNIT_TEST( SignatureTest);
+	CPPUNIT_TEST( WrapTest);
+	CPPUNIT_TEST( FlowedTest);
+	CPPUNIT_TEST_SUITE_END();
+public:
+//	static CppUnit::Test* Suite();
+	
+	// This function called before *each* test added in Suite()
+	void setUp();
+	
+	// This function called after *each* test added in Suite()
+	void tearDown();
+
+	//------------------------------------------------------------
+	// Test functions
+	//------------------------------------------------------------
+	void NestedQuoteTest();
+	void SignatureTest();
+	void WrapTest();
+	void FlowedTest();
+
+private:
+	void CheckQuote( const char* style, int maxLineLen, const char* in,
+						 const char* expected, int32 expectedLineLen);
+
+	BmString mOldQuoteFormatting;
+};
+
+
+#endif
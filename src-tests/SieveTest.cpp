@@ -151,6 +151,9 @@ void
 SieveTest::tearDown()
 {
 	mail = NULL;
+	// release the compiled script, such that the static filter doesn't
+	// outlive the script-cache's entries on exit:
+	filter.Content( "");
 	inherited::tearDown();
 }
 
@@ -1510,3 +1513,157 @@ SieveTest::NumericRelationalCountTestsTest(void)
 	CPPUNIT_ASSERT( filter.Execute(msgContext));
 	CPPUNIT_ASSERT( Result() == RES_KEEP);
 }
+
+static const int32 nConcurrencyThreads = 8;
+static const int32 nConcurrencyRounds = 200;
+
+struct ConcurrencyJob {
+	BmSieveFilter* sharedFilter;
+	BmMail* mail;
+	int32 index;
+	bool compile;
+							// compile a filter of our own in every round
+	int32 failures;
+};
+
+/*------------------------------------------------------------------------------*\
+	ConcurrencyThread( data)
+		-	executes the shared filter (or compiles and executes its own filter)
+			over and over, checking the results of every execution
+\*------------------------------------------------------------------------------*/
+static int32
+ConcurrencyThread( void* data)
+{
+	ConcurrencyJob* job = static_cast< ConcurrencyJob*>( data);
+	bool odd = (job->index % 2) != 0;
+	BmMsgContext context;
+	context.mail = job->mail;
+	BmSieveFilter ownFilter( BmString("TestFilter-") << job->index, &msg);
+	for( int32 round=0; round<nConcurrencyRounds; ++round) {
+		BmSieveFilter* currFilter = job->sharedFilter;
+		BmString expectedFolder = odd ? "odd-folder" : "even-folder";
+		BmString expectedStatus = odd ? "" : "Read";
+		if (job->compile) {
+			// a different script in every round, such that nothing can be
+			// reused from the previous compilation:
+			expectedFolder = BmString("folder-") << job->index << "-" << round;
+			expectedStatus = "";
+			ownFilter.Content( BmString("require \"fileinto\";\n")
+										<< "fileinto \"" << expectedFolder << "\";\n");
+			currFilter = &ownFilter;
+		}
+		if (!currFilter->Execute( &context)) {
+			job->failures++;
+			continue;
+		}
+		BmString folder = context.GetString( "FolderName");
+		BmString status = context.GetString( "Status");
+		if (folder != expectedFolder || status != expectedStatus)
+			job->failures++;
+		context.ResetData();
+		context.ResetChanges();
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	ConcurrencyTest()
+		-	executes and compiles scripts in several threads at once
+		-	half of the threads share a filter which files the mails depending
+			on their (faked) account-header and sets flags, such that any
+			state leaking between the executions would show up
+\*------------------------------------------------------------------------------*/
+void 
+SieveTest::ConcurrencyTest(void)
+{
+	NextSubTest();
+	BmSieveFilter sharedFilter( "SharedTestFilter", &msg);
+	sharedFilter.Content( "\
+require [\"fileinto\", \"imapflags\"];\n\
+if header :is \"Account\" \"even\" {\n\
+	addflag \"\\Seen\";\n\
+	fileinto \"even-folder\";\n\
+} else {\n\
+	fileinto \"odd-folder\";\n\
+}\n\
+");
+	CPPUNIT_ASSERT( sharedFilter.CompileScript());
+
+	// the mails are created up front, each thread only works on its own:
+	BmRef<BmMail> mails[nConcurrencyThreads];
+	ConcurrencyJob jobs[nConcurrencyThreads];
+	thread_id threads[nConcurrencyThreads];
+	for( int32 i=0; i<nConcurrencyThreads; ++i) {
+		mails[i] = new BmMail( mailText, (i % 2) ? "odd" : "even");
+		jobs[i].sharedFilter = &sharedFilter;
+		jobs[i].mail = mails[i].Get();
+		jobs[i].index = i;
+		jobs[i].compile = i >= nConcurrencyThreads/2;
+		jobs[i].failures = 0;
+		threads[i] = spawn_thread( ConcurrencyThread, "SieveTestThread",
+											B_NORMAL_PRIORITY, &jobs[i]);
+		CPPUNIT_ASSERT( threads[i] >= 0);
+	}
+	for( int32 i=0; i<nConcurrencyThreads; ++i)
+		resume_thread( threads[i]);
+	for( int32 i=0; i<nConcurrencyThreads; ++i) {
+		status_t exitValue;
+		wait_for_thread( threads[i], &exitValue);
+	}
+
+	NextSubTest();
+	for( int32 i=0; i<nConcurrencyThreads; ++i)
+		CPPUNIT_ASSERT( jobs[i].failures == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	ScriptCacheTest()
+		-	checks that compiled scripts are shared by filters with the same
+			script and survive the filters that compiled them
+\*------------------------------------------------------------------------------*/
+void 
+SieveTest::ScriptCacheTest(void)
+{
+	BmString script( "require \"fileinto\";\nfileinto \"cached-folder\";\n");
+
+	// filters with the same script share the compiled script
+	NextSubTest();
+	BmSieveFilter* filter1 = new BmSieveFilter( "CacheTestFilter1", &msg);
+	BmSieveFilter* filter2 = new BmSieveFilter( "CacheTestFilter2", &msg);
+	filter1->Content( script);
+	filter2->Content( script);
+	CPPUNIT_ASSERT( filter1->CompileScript());
+	CPPUNIT_ASSERT( filter2->CompileScript());
+	CPPUNIT_ASSERT( filter1->mScriptEntry != NULL 
+						 && filter1->mScriptEntry == filter2->mScriptEntry);
+	BmSieveScriptCache::Entry* entry = filter1->mScriptEntry;
+
+	// the compiled script is kept when the filters are gone (as happens when
+	// the filter-list is reloaded)
+	NextSubTest();
+	delete filter1;
+	delete filter2;
+	BmSieveFilter* filter3 = new BmSieveFilter( "CacheTestFilter3", &msg);
+	filter3->Content( script);
+	CPPUNIT_ASSERT( filter3->CompileScript());
+	CPPUNIT_ASSERT( filter3->mScriptEntry == entry);
+	CPPUNIT_ASSERT( filter3->Execute( msgContext));
+	CPPUNIT_ASSERT( Result() == RES_FILEINTO && targetFolder == "cached-folder");
+
+	// changing the script only affects the changed filter
+	NextSubTest();
+	filter3->Content( "keep;");
+	CPPUNIT_ASSERT( filter3->CompileScript());
+	CPPUNIT_ASSERT( filter3->mScriptEntry != entry);
+	CPPUNIT_ASSERT( filter3->Execute( msgContext));
+	CPPUNIT_ASSERT( Result() == RES_KEEP);
+	delete filter3;
+
+	// scripts that fail to compile are not cached, so they keep failing
+	NextSubTest();
+	filter.Content( "fileinto \"a_folder\";\n");
+	CPPUNIT_ASSERT( !filter.CompileScript());
+	CPPUNIT_ASSERT( !filter.CompileScript() 
+						 && filter.ErrorString()
+						 		.FindFirst("fileinto not required") != B_ERROR);
+}
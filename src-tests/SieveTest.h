@@ -33,6 +33,8 @@ class SieveTest : public BTestCase
 	CPPUNIT_TEST( RelationalValueTestsTest);
 	CPPUNIT_TEST( NumericRelationalValueTestsTest);
 	CPPUNIT_TEST( NumericRelationalCountTestsTest);
+	CPPUNIT_TEST( ConcurrencyTest);
+	CPPUNIT_TEST( ScriptCacheTest);
 	CPPUNIT_TEST_SUITE_END();
 public:
 //	static CppUnit::Test* Suite();
@@ -55,6 +57,8 @@ public:
 	void RelationalValueTestsTest();
 	void NumericRelationalValueTestsTest();
 	void NumericRelationalCountTestsTest();
+	void ConcurrencyTest();
+	void ScriptCacheTest();
 };
 
 
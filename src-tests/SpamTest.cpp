@@ -0,0 +1,184 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <vector>
+
+#include "SpamTest.h"
+
+#include "BmSpamFilter.h"
+#include "BmMail.h"
+#include "BmPrefs.h"
+
+static BMessage msg;
+static BmSpamFilter filter("SpamTestFilter",&msg);
+static BMessage resetJob;
+static BMessage classifyJob;
+static BMessage learnAsSpamJob;
+static BMessage learnAsTofuJob;
+
+static const int32 nMails = 600;
+static const int32 nPerfMails = 100;
+							// the error-rate is measured over the last mails
+static const int32 nVocabularySize = 200;
+
+static uint32 randomSeed;
+
+struct Learning {
+	BmRef<BmMail> mail;
+							// the mail that has been classified wrongly
+	bool isSpam;
+	int32 index;
+							// the position of the mail in the stream of mails
+};
+
+/*------------------------------------------------------------------------------*\
+	Random( n)
+		-	returns a pseudo-random number in [0..n), the sequence only depends
+			on randomSeed, such that every run sees the same mails
+\*------------------------------------------------------------------------------*/
+static uint32
+Random( uint32 n)
+{
+	randomSeed = randomSeed * 1103515245 + 12345;
+	return (randomSeed >> 16) % n;
+}
+
+/*------------------------------------------------------------------------------*\
+	RandomWords( count, isSpam)
+		-	returns count words, most of them from the vocabulary of the given
+			class, the rest from a vocabulary shared by spam and tofu
+\*------------------------------------------------------------------------------*/
+static BmString
+RandomWords( int32 count, bool isSpam)
+{
+	BmString words;
+	for( int32 w=0; w<count; ++w) {
+		if (Random( 10) < 6)
+			words << (isSpam ? "offer" : "project") << Random( nVocabularySize);
+		else
+			words << "word" << Random( 2*nVocabularySize);
+		words << ((w % 12 == 11) ? "\r\n" : " ");
+	}
+	return words;
+}
+
+/*------------------------------------------------------------------------------*\
+	MailText( index, isSpam)
+		-	
+\*------------------------------------------------------------------------------*/
+static BmString
+MailText( int32 index, bool isSpam)
+{
+	BmString text("Date: Mon, 25 Feb 2003 08:51:06 -0500\r\n");
+	text << "From: sender" << Random( 50) << "@"
+		  << (isSpam ? "offers" : "projects") << ".org\r\n";
+	text << "To: you@test.org\r\n";
+	text << "Subject: " << RandomWords( 5, isSpam) << index << "\r\n";
+	text << "\r\n";
+	text << RandomWords( 60, isSpam) << "\r\n";
+	return text;
+}
+
+/*------------------------------------------------------------------------------*\
+	TrainOnErrors( learningLag)
+		-	classifies fresh mails and trains the filter on every mistake,
+			as the user would do
+		-	the learning of a mail only reaches the filter once the given
+			number of following mails have been classified (which is what
+			happens when the parallel mail-filter commits its results)
+		-	returns the number of mistakes within the last nPerfMails mails
+\*------------------------------------------------------------------------------*/
+static int32
+TrainOnErrors( int32 learningLag)
+{
+	std::vector<Learning> pending;
+	int32 mistakes = 0;
+	randomSeed = 4711;
+	filter.Execute( NULL, &resetJob);
+	for( int32 i=0; i<nMails; ++i) {
+		// hand over the learnings that have been committed by now:
+		while( pending.size() && pending[0].index < i - learningLag) {
+			BmMsgContext learnContext;
+			learnContext.mail = pending[0].mail.Get();
+			learnContext.SetBool( "ForceLearning", true);
+			filter.Execute( &learnContext,
+								 pending[0].isSpam ? &learnAsSpamJob : &learnAsTofuJob);
+			pending.erase( pending.begin());
+		}
+		bool isSpam = (i % 2) != 0;
+		BmRef<BmMail> mail = new BmMail( MailText( i, isSpam), "spamtest");
+		BmMsgContext msgContext;
+		msgContext.mail = mail.Get();
+		CPPUNIT_ASSERT( filter.Execute( &msgContext, &classifyJob));
+		double overallPr = msgContext.GetDouble( "OverallPr");
+		if (isSpam ? overallPr >= 0 : overallPr < 0) {
+			if (i >= nMails - nPerfMails)
+				mistakes++;
+			Learning learning;
+			learning.mail = mail;
+			learning.isSpam = isSpam;
+			learning.index = i;
+			pending.push_back( learning);
+		}
+	}
+	return mistakes;
+}
+
+// setUp
+void
+SpamTest::setUp()
+{
+	inherited::setUp();
+	if (resetJob.IsEmpty()) {
+		resetJob.AddString( "jobSpecifier", "Reset");
+		classifyJob.AddString( "jobSpecifier", "Classify");
+		// neither reinforce nor leave anything unsure, such that the
+		// classifier only learns the mistakes we hand it:
+		classifyJob.AddInt32( "ThresholdForSpam", 0);
+		classifyJob.AddInt32( "ThresholdForTofu", 0);
+		classifyJob.AddInt32( "UnsureForSpam", 0);
+		classifyJob.AddInt32( "UnsureForTofu", 0);
+		learnAsSpamJob.AddString( "jobSpecifier", "LearnAsSpam");
+		learnAsTofuJob.AddString( "jobSpecifier", "LearnAsTofu");
+	}
+}
+
+// tearDown
+void
+SpamTest::tearDown()
+{
+	filter.Execute( NULL, &resetJob);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	ConvergenceTest()
+		-	checks that training-on-error converges, both when the learnings
+			reach the filter at once and when they lag behind the
+			classification by as many mails as the parallel mail-filter has
+			slots (FilterThreads*4)
+\*------------------------------------------------------------------------------*/
+void
+SpamTest::ConvergenceTest(void)
+{
+	// learning at once
+	NextSubTest();
+	int32 mistakes = TrainOnErrors( 0);
+	CPPUNIT_ASSERT( mistakes <= nPerfMails/20);
+
+	// learning lagging behind the parallel mail-filter
+	NextSubTest();
+	int32 threadCount = ThePrefs->GetInt( "FilterThreads", 4);
+	int32 laggedMistakes = TrainOnErrors( threadCount*4);
+	CPPUNIT_ASSERT( laggedMistakes <= nPerfMails/20);
+}
@@ -38,17 +38,27 @@ using namespace regexx;
 #include "Base64EncoderTest.h"
 #include "BinaryDecoderTest.h"
 #include "BinaryEncoderTest.h"
+#include "CollationKeyTest.h"
 #include "EncodedWordEncoderTest.h"
 #include "FoldedLineEncoderTest.h"
 #include "LinebreakDecoderTest.h"
 #include "LinebreakEncoderTest.h"
+#include "MailboxIOTest.h"
+#include "MailCompressionTest.h"
+#include "MailDedupIndexTest.h"
+#include "MailLoadTest.h"
 #include "MailMonitorTest.h"
+#include "MailThreaderTest.h"
 #include "MemIoTest.h"
 #include "MultiLockerTest.h"
 #include "QuotedPrintableDecoderTest.h"
 #include "QuotedPrintableEncoderTest.h"
+#include "QuoteFormatterTest.h"
 #include "SieveTest.h"
+#include "SpamTest.h"
 #include "StringTest.h"
+#include "TextIndexTest.h"
+#include "TrigramIndexTest.h"
 #include "Utf8DecoderTest.h"
 #include "Utf8EncoderTest.h"
 
@@ -117,8 +127,26 @@ BTestSuite* CreateMailTrackerTestSuite() {
 	BTestSuite *suite = new BTestSuite("MailTracker");
 
 	// ##### Add test suites here #####
+	suite->addTest("MailTracker::CollationKey", 
+						CollationKeyTest::suite());
+	suite->addTest("MailTracker::MailboxIO", 
+						MailboxIOTest::suite());
+	suite->addTest("MailTracker::MailCompression", 
+						MailCompressionTest::suite());
+	suite->addTest("MailTracker::MailDedupIndex", 
+						MailDedupIndexTest::suite());
+	suite->addTest("MailTracker::MailLoad", 
+						MailLoadTest::suite());
 	suite->addTest("MailTracker::MailMonitor", 
 						MailMonitorTest::suite());
+	suite->addTest("MailTracker::MailThreader", 
+						MailThreaderTest::suite());
+	suite->addTest("MailTracker::QuoteFormatter", 
+						QuoteFormatterTest::suite());
+	suite->addTest("MailTracker::TextIndex", 
+						TextIndexTest::suite());
+	suite->addTest("MailTracker::TrigramIndex", 
+						TrigramIndexTest::suite());
 	return suite;
 }
 
@@ -167,6 +195,8 @@ BTestSuite* CreateFilterAddonsTestSuite() {
 	// ##### Add test suites here #####
 	suite->addTest("FilterAddons::Sieve", 
 						SieveTest::suite());
+	suite->addTest("FilterAddons::Spam", 
+						SpamTest::suite());
 	return suite;
 }
 
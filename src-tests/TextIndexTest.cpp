@@ -0,0 +1,195 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "TextIndexTest.h"
+#include "TestBeam.h"
+
+#include "BmTextIndex.h"
+
+// setUp
+void
+TextIndexTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+TextIndexTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+static string Hits( const BmTextIndex& index, const char* query) {
+	BmTextIndex::DocKeyVect keys;
+	index.Search( query, keys);
+	string result;
+	for( uint32 i=0; i<keys.size(); ++i) {
+		char buf[32];
+		sprintf( buf, i ? ",%u" : "%u", (uint32)keys[i]);
+		result += buf;
+	}
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void TextIndexTest::TokenizeTest() {
+	vector< string> tokens;
+	// words are case-folded, single chars are dropped:
+	NextSubTest();
+	BmTextIndex::Tokenize( "Hello, World! A test-case 42", tokens);
+	CPPUNIT_ASSERT( tokens.size() == 5);
+	CPPUNIT_ASSERT( tokens[0] == "hello");
+	CPPUNIT_ASSERT( tokens[1] == "world");
+	CPPUNIT_ASSERT( tokens[2] == "test");
+	CPPUNIT_ASSERT( tokens[3] == "case");
+	CPPUNIT_ASSERT( tokens[4] == "42");
+
+	// UTF-8 characters are part of words:
+	NextSubTest();
+	tokens.clear();
+	BmTextIndex::Tokenize( "Gr\xC3\xBC\xC3\x9F" "e", tokens);
+	CPPUNIT_ASSERT( tokens.size() == 1);
+	CPPUNIT_ASSERT( tokens[0] == "gr\xC3\xBC\xC3\x9F" "e");
+
+	// overlong words are dropped:
+	NextSubTest();
+	tokens.clear();
+	BmTextIndex::Tokenize( string( 65, 'x') + " ok", tokens);
+	CPPUNIT_ASSERT( tokens.size() == 1);
+	CPPUNIT_ASSERT( tokens[0] == "ok");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void TextIndexTest::SearchTest() {
+	BmTextIndex index;
+	index.AddDocument( 10, "The quarterly report is attached");
+	index.AddDocument( 20, "Lunch tomorrow? Reporting back later");
+	index.AddDocument( 30, "quarterly lunch");
+
+	NextSubTest();
+	CPPUNIT_ASSERT( Hits( index, "report") == "10");
+	CPPUNIT_ASSERT( Hits( index, "REPORT*") == "10,20");
+	CPPUNIT_ASSERT( Hits( index, "quarterly") == "10,30");
+	CPPUNIT_ASSERT( Hits( index, "quarterly lunch") == "30");
+	CPPUNIT_ASSERT( Hits( index, "missing") == "");
+	CPPUNIT_ASSERT( Hits( index, "") == "");
+
+	// removal and update:
+	NextSubTest();
+	CPPUNIT_ASSERT( index.RemoveDocument( 30));
+	CPPUNIT_ASSERT( !index.RemoveDocument( 30));
+	CPPUNIT_ASSERT( Hits( index, "quarterly") == "10");
+	index.UpdateDocument( 10, "nothing quarterly left");
+	CPPUNIT_ASSERT( Hits( index, "report") == "");
+	CPPUNIT_ASSERT( Hits( index, "quarterly left") == "10");
+	CPPUNIT_ASSERT( index.DocumentCount() == 2);
+	CPPUNIT_ASSERT( index.DeadDocumentCount() == 2);
+
+	// compaction must not change the results:
+	NextSubTest();
+	index.Compact();
+	CPPUNIT_ASSERT( index.DeadDocumentCount() == 0);
+	CPPUNIT_ASSERT( Hits( index, "quarterly") == "10");
+	CPPUNIT_ASSERT( Hits( index, "lunch") == "20");
+	CPPUNIT_ASSERT( !index.HasDocument( 30));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void TextIndexTest::StoreLoadTest() {
+	const char* filename = "/tmp/TextIndexTest.idx";
+	BmTextIndex index;
+	for( uint32 i=0; i<1000; ++i) {
+		char buf[64];
+		sprintf( buf, "mail number%u %s", i, i%2 ? "odd" : "even");
+		index.AddDocument( 5000000000LL + i, buf);
+	}
+	index.RemoveDocument( 5000000000LL);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( index.Store( filename));
+	BmTextIndex loaded;
+	CPPUNIT_ASSERT( loaded.Load( filename));
+	CPPUNIT_ASSERT( loaded.DocumentCount() == 999);
+	CPPUNIT_ASSERT( loaded.TermCount() == index.TermCount());
+	BmTextIndex::DocKeyVect keys;
+	loaded.Search( "number999 odd", keys);
+	CPPUNIT_ASSERT( keys.size() == 1 && keys[0] == 5000000999LL);
+	loaded.Search( "even", keys);
+	CPPUNIT_ASSERT( keys.size() == 499);
+
+	// a truncated index must not be accepted:
+	NextSubTest();
+	truncate( filename, 100);
+	CPPUNIT_ASSERT( !loaded.Load( filename));
+	CPPUNIT_ASSERT( loaded.DocumentCount() == 0);
+	unlink( filename);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-
+\*------------------------------------------------------------------------------*/
+void TextIndexTest::MailTextTest() {
+	BmTextIndex index;
+	string text;
+	NextSubTest();
+	BmTextIndex::ExtractMailText(
+		"Subject: =?iso-8859-1?Q?Gr=FC=DFe?= from Berlin\r\n"
+		"From: Alice <alice@example.org>\r\n"
+		"Content-Type: multipart/alternative;\r\n"
+		"\tboundary=\"XYZ\"\r\n"
+		"\r\n"
+		"preamble\r\n"
+		"--XYZ\r\n"
+		"Content-Type: text/plain\r\n"
+		"Content-Transfer-Encoding: quoted-printable\r\n"
+		"\r\n"
+		"The quarterly rep=\r\n"
+		"ort is attached.\r\n"
+		"--XYZ\r\n"
+		"Content-Type: text/html\r\n"
+		"Content-Transfer-Encoding: base64\r\n"
+		"\r\n"
+		"PHA+SGVsbG8gPGI+Qm9iPC9iPiAmYW1wOyBmcmllbmRzPC9wPg==\r\n"
+		"--XYZ\r\n"
+		"Content-Type: application/octet-stream\r\n"
+		"\r\n"
+		"binarygarbage\r\n"
+		"--XYZ--\r\n",
+		text
+	);
+	index.AddDocument( 1, text);
+	CPPUNIT_ASSERT( Hits( index, "gr\xC3\xBC\xC3\x9F" "e berlin") == "1");
+	CPPUNIT_ASSERT( Hits( index, "alice") == "1");
+	CPPUNIT_ASSERT( Hits( index, "report") == "1");
+	CPPUNIT_ASSERT( Hits( index, "bob friends") == "1");
+	CPPUNIT_ASSERT( Hits( index, "preamble") == "");
+	CPPUNIT_ASSERT( Hits( index, "binarygarbage") == "");
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <string.h>
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <Node.h>
+
+#include "TrigramIndexTest.h"
+#include "TestBeam.h"
+
+#include "BmMail.h"
+#include "BmMailRef.h"
+#include "BmMailRefTrigramIndex.h"
+
+static const char* const nTestFolder = "/tmp/BmTrigramIndexTest";
+
+/*------------------------------------------------------------------------------*\
+	WriteAttr( node, name, value)
+		-	writes the given string-attribute
+\*------------------------------------------------------------------------------*/
+static void WriteAttr( BNode& node, const char* name, const char* value)
+{
+	node.WriteAttr( name, B_STRING_TYPE, 0, value, strlen( value)+1);
+}
+
+/*------------------------------------------------------------------------------*\
+	CreateMailRef( name, subject, from, to)
+		-	writes a mail-file with the given attributes into the test-folder 
+			and returns a mailref for it
+\*------------------------------------------------------------------------------*/
+static BmRef<BmMailRef> CreateMailRef( const char* name, const char* subject,
+													const char* from, const char* to)
+{
+	BmString path = BmString(nTestFolder) << "/" << name;
+	{	// scope for file
+		BFile file( path.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+		BmString text = BmString("From: ") << from << "\r\nTo: " << to
+								<< "\r\nSubject: " << subject << "\r\n\r\ntext\r\n";
+		file.Write( text.String(), text.Length());
+		WriteAttr( file, "BEOS:TYPE", "text/x-email");
+		WriteAttr( file, BM_MAIL_ATTR_SUBJECT, subject);
+		WriteAttr( file, BM_MAIL_ATTR_FROM, from);
+		WriteAttr( file, BM_MAIL_ATTR_TO, to);
+	}
+	entry_ref eref;
+	get_ref_for_path( path.String(), &eref);
+	return BmMailRef::CreateInstance( eref);
+}
+
+/*------------------------------------------------------------------------------*\
+	Node( ref)
+		-	returns the inode of the given mailref
+\*------------------------------------------------------------------------------*/
+static ino_t Node( const BmRef<BmMailRef>& ref)
+{
+	return ref->NodeRef().node;
+}
+
+// setUp
+void
+TrigramIndexTest::setUp()
+{
+	inherited::setUp();
+	create_directory( nTestFolder, 0755);
+}
+
+// tearDown
+void
+TrigramIndexTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	NarrowingTest()
+		-	the index must yield exactly the mailrefs that contain all trigrams
+			of the searched text (in any of the indexed fields, ignoring case),
+			too short texts can not be narrowed down
+\*------------------------------------------------------------------------------*/
+void TrigramIndexTest::NarrowingTest() {
+	BmRef<BmMailRef> meeting 
+		= CreateMailRef( "meeting", "Meeting tomorrow", 
+							  "Alice <alice@example.org>", "bob@example.org");
+	BmRef<BmMailRef> invoice 
+		= CreateMailRef( "invoice", "Invoice for March", 
+							  "billing@shop.example.com", "bob@example.org");
+	BmRef<BmMailRef> notes 
+		= CreateMailRef( "notes", "Notes of the MEETING", 
+							  "Carol <carol@example.org>", "alice@example.org");
+	BmMailRefTrigramIndex index;
+	index.AddMailRef( meeting.Get());
+	index.AddMailRef( invoice.Get());
+	index.AddMailRef( notes.Get());
+	set< ino_t> nodes;
+
+	NextSubTest();
+	CPPUNIT_ASSERT( index.FindCandidates( "meeting", nodes));
+	CPPUNIT_ASSERT( nodes.size() == 2);
+	CPPUNIT_ASSERT( nodes.count( Node( meeting)) == 1);
+	CPPUNIT_ASSERT( nodes.count( Node( notes)) == 1);
+
+	NextSubTest();
+	// address-fields are indexed, too:
+	CPPUNIT_ASSERT( index.FindCandidates( "alice", nodes));
+	CPPUNIT_ASSERT( nodes.size() == 2);
+	CPPUNIT_ASSERT( nodes.count( Node( invoice)) == 0);
+	CPPUNIT_ASSERT( index.FindCandidates( "shop.example", nodes));
+	CPPUNIT_ASSERT( nodes.size() == 1);
+	CPPUNIT_ASSERT( nodes.count( Node( invoice)) == 1);
+
+	NextSubTest();
+	// a text that no mailref contains yields no candidates at all:
+	CPPUNIT_ASSERT( index.FindCandidates( "xylophone", nodes));
+	CPPUNIT_ASSERT( nodes.empty());
+
+	NextSubTest();
+	// texts shorter than a trigram do not narrow anything down:
+	CPPUNIT_ASSERT( !index.FindCandidates( "me", nodes));
+}
+
+/*------------------------------------------------------------------------------*\
+	RemovalTest()
+		-	removed mailrefs must never be yielded again, re-added ones must
+			be found again
+\*------------------------------------------------------------------------------*/
+void TrigramIndexTest::RemovalTest() {
+	BmRef<BmMailRef> first 
+		= CreateMailRef( "first", "Quarterly report", 
+							  "dave@example.org", "team@example.org");
+	BmRef<BmMailRef> second 
+		= CreateMailRef( "second", "Re: Quarterly report", 
+							  "erin@example.org", "team@example.org");
+	BmMailRefTrigramIndex index;
+	index.AddMailRef( first.Get());
+	index.AddMailRef( second.Get());
+	set< ino_t> nodes;
+
+	NextSubTest();
+	index.RemoveMailRef( first.Get());
+	CPPUNIT_ASSERT( index.FindCandidates( "quarterly", nodes));
+	CPPUNIT_ASSERT( nodes.size() == 1);
+	CPPUNIT_ASSERT( nodes.count( Node( second)) == 1);
+
+	NextSubTest();
+	index.AddMailRef( first.Get());
+	CPPUNIT_ASSERT( index.FindCandidates( "quarterly", nodes));
+	CPPUNIT_ASSERT( nodes.size() == 2);
+	CPPUNIT_ASSERT( nodes.count( Node( first)) == 1);
+}
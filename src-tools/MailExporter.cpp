@@ -0,0 +1,355 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * MailExporter writes all mail-files found in a folder (and its subfolders)
+ * into an mbox-file or a Maildir.
+ * Usage:
+ *			MailExporter [-j <threads>] [-b <batch_size>] [-f mbox|maildir]
+ *							 <folder> <mbox_or_maildir>
+ *
+ * A pool of worker threads reads the mail-files in batches, the main thread
+ * appends the batches to the mailbox in the order of the mail-files.
+ * On BeOS/Haiku, the status of each mail is taken from its attributes, on
+ * other systems from the "Status:" & "X-Status:" fields of the mail (if
+ * any).
+ *
+ * Mail-files from compressed folders are inflated before being written.
+ *
+ * Since it only uses the portable part of the mail kit (apart from the
+ * attributes), the tool can be built on other systems, too:
+ *			g++ -O2 -pthread -I../src-bmMailKit -o MailExporter MailExporter.cpp \
+ *				../src-bmMailKit/BmMailboxIO.cpp \
+ *				../src-bmMailKit/BmMailCompression.cpp -lz
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "BmMailboxIO.h"
+#include "BmMailCompression.h"
+
+#if defined(__BEOS__) || defined(__HAIKU__)
+#define READ_ATTRIBUTES
+#include <Node.h>
+#include <TypeConstants.h>
+#endif
+
+struct ExportBatch {
+	ExportBatch()
+		:	ready( false)							{}
+	vector< string> texts;
+	vector< string> statuses;
+	bool ready;
+};
+
+struct ExportState {
+	const vector< string>* paths;
+	uint32_t batchSize;
+	vector< ExportBatch> batches;
+	uint32_t nextBatch;
+	uint32_t writtenBatches;
+	uint32_t maxAhead;
+	uint32_t errorCount;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/*------------------------------------------------------------------------------*\
+	Now()
+		-	returns the current time in seconds
+\*------------------------------------------------------------------------------*/
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*------------------------------------------------------------------------------*\
+	NaturalLess( a, b)
+		-	compares the given names such that runs of digits are compared by
+			their numerical value (so "mail-2" comes before "mail-10", which 
+			keeps the order in which Beam has created the mails)
+\*------------------------------------------------------------------------------*/
+static bool NaturalLess( const string& a, const string& b)
+{
+	size_t i = 0, j = 0;
+	while( i < a.size() && j < b.size()) {
+		if (isdigit( a[i]) && isdigit( b[j])) {
+			size_t iEnd = a.find_first_not_of( "0123456789", i);
+			size_t jEnd = b.find_first_not_of( "0123456789", j);
+			if (iEnd == string::npos)
+				iEnd = a.size();
+			if (jEnd == string::npos)
+				jEnd = b.size();
+			// skip leading zeros:
+			while( i+1 < iEnd && a[i] == '0')
+				i++;
+			while( j+1 < jEnd && b[j] == '0')
+				j++;
+			if (iEnd-i != jEnd-j)
+				return iEnd-i < jEnd-j;
+			int cmp = a.compare( i, iEnd-i, b, j, jEnd-j);
+			if (cmp)
+				return cmp < 0;
+			i = iEnd;
+			j = jEnd;
+		} else {
+			if (a[i] != b[j])
+				return (unsigned char)a[i] < (unsigned char)b[j];
+			i++;
+			j++;
+		}
+	}
+	return a.size()-i < b.size()-j;
+}
+
+/*------------------------------------------------------------------------------*\
+	CollectMailFiles( folder, paths)
+		-	collects all regular files in the given folder (recursively)
+\*------------------------------------------------------------------------------*/
+static void CollectMailFiles( const string& folder, vector< string>& paths)
+{
+	DIR* dir = opendir( folder.c_str());
+	if (!dir) {
+		fprintf(stderr, "can't open folder %s\n", folder.c_str());
+		return;
+	}
+	vector< string> names;
+	struct dirent* dirEntry;
+	while( (dirEntry = readdir( dir)) != NULL) {
+		if (dirEntry->d_name[0] == '.')
+			continue;
+		names.push_back( dirEntry->d_name);
+	}
+	closedir( dir);
+	std::sort( names.begin(), names.end(), NaturalLess);
+	for( uint32_t i=0; i<names.size(); ++i) {
+		string path = folder + "/" + names[i];
+		struct stat st;
+		if (stat( path.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR( st.st_mode))
+			CollectMailFiles( path, paths);
+		else if (S_ISREG( st.st_mode))
+			paths.push_back( path);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadMail( path, outText, outStatus)
+		-
+\*------------------------------------------------------------------------------*/
+static bool ReadMail( const string& path, string& outText, string& outStatus)
+{
+	FILE* file = fopen( path.c_str(), "rb");
+	if (!file)
+		return false;
+	outText.erase();
+	char buf[65536];
+	size_t len;
+	while( (len = fread( buf, 1, sizeof(buf), file)) > 0)
+		outText.append( buf, len);
+	bool failed = ferror( file) != 0;
+	fclose( file);
+	if (BmMailCompression::IsCompressed( outText.data(), outText.size())) {
+		string inflatedText;
+		if (!BmMailCompression::Decompress( outText.data(), outText.size(),
+														inflatedText))
+			return false;
+		outText.swap( inflatedText);
+	}
+#ifdef READ_ATTRIBUTES
+	outStatus = "Read";
+	BNode node( path.c_str());
+	char status[64];
+	ssize_t size = node.ReadAttr( "MAIL:status", B_STRING_TYPE, 0, status,
+											sizeof(status)-1);
+	if (size > 0) {
+		status[size] = '\0';
+		outStatus = status;
+	}
+#else
+	// no attributes, so the status fields of the mail are all we've got:
+	outStatus = BmMailboxIO::StatusFromMboxHeader( outText);
+#endif
+	return !failed;
+}
+
+/*------------------------------------------------------------------------------*\
+	WorkerThread( data)
+		-	reads batches of mail-files until all have been handed out
+\*------------------------------------------------------------------------------*/
+static void* WorkerThread( void* data)
+{
+	ExportState* state = static_cast< ExportState*>( data);
+	while( 1) {
+		pthread_mutex_lock( &state->lock);
+		// don't read too far ahead of the writer:
+		while( state->nextBatch < state->batches.size()
+		&& state->nextBatch >= state->writtenBatches + state->maxAhead)
+			pthread_cond_wait( &state->cond, &state->lock);
+		if (state->nextBatch >= state->batches.size()) {
+			pthread_mutex_unlock( &state->lock);
+			break;
+		}
+		uint32_t batchNr = state->nextBatch++;
+		pthread_mutex_unlock( &state->lock);
+
+		ExportBatch& batch = state->batches[batchNr];
+		uint32_t first = batchNr * state->batchSize;
+		uint32_t last = std::min( first + state->batchSize,
+										  (uint32_t)state->paths->size());
+		uint32_t errorCount = 0;
+		string text, status;
+		for( uint32_t i=first; i<last; ++i) {
+			const string& path = (*state->paths)[i];
+			if (!ReadMail( path, text, status)) {
+				fprintf(stderr, "unable to read %s\n", path.c_str());
+				errorCount++;
+				continue;
+			}
+			batch.texts.push_back( text);
+			batch.statuses.push_back( status);
+		}
+
+		pthread_mutex_lock( &state->lock);
+		batch.ready = true;
+		state->errorCount += errorCount;
+		pthread_cond_broadcast( &state->cond);
+		pthread_mutex_unlock( &state->lock);
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Export( paths, writer, threadCount, batchSize)
+		-	writes all the given mail-files with the given writer
+		-	returns the number of mails that could not be exported
+\*------------------------------------------------------------------------------*/
+static uint32_t Export( const vector< string>& paths, BmMailboxWriter* writer,
+								uint32_t threadCount, uint32_t batchSize)
+{
+	ExportState state;
+	state.paths = &paths;
+	state.batchSize = batchSize;
+	state.batches.resize( (paths.size() + batchSize - 1) / batchSize);
+	state.nextBatch = 0;
+	state.writtenBatches = 0;
+	state.maxAhead = 2 * threadCount;
+	state.errorCount = 0;
+	pthread_mutex_init( &state.lock, NULL);
+	pthread_cond_init( &state.cond, NULL);
+
+	vector< pthread_t> threads( threadCount);
+	for( uint32_t t=0; t<threadCount; ++t)
+		pthread_create( &threads[t], NULL, WorkerThread, &state);
+
+	double startTime = Now();
+	double lastReport = startTime;
+	uint32_t okCount = 0;
+	uint32_t writeErrors = 0;
+	for( uint32_t b=0; b<state.batches.size(); ++b) {
+		ExportBatch& batch = state.batches[b];
+		pthread_mutex_lock( &state.lock);
+		while( !batch.ready)
+			pthread_cond_wait( &state.cond, &state.lock);
+		pthread_mutex_unlock( &state.lock);
+
+		for( uint32_t i=0; i<batch.texts.size(); ++i) {
+			if (writer->WriteMail( batch.texts[i], batch.statuses[i]))
+				okCount++;
+			else
+				writeErrors++;
+		}
+		// free the memory of this batch:
+		vector< string>().swap( batch.texts);
+		vector< string>().swap( batch.statuses);
+
+		pthread_mutex_lock( &state.lock);
+		state.writtenBatches = b+1;
+		pthread_cond_broadcast( &state.cond);
+		pthread_mutex_unlock( &state.lock);
+
+		double now = Now();
+		if (now - lastReport >= 2.0) {
+			printf("%u mails exported (%.0f mails/sec)\n", okCount,
+					 okCount / (now - startTime));
+			lastReport = now;
+		}
+	}
+	if (!writer->Finish()) {
+		fprintf(stderr, "unable to finish writing the mailbox\n");
+		writeErrors++;
+	}
+
+	for( uint32_t t=0; t<threadCount; ++t)
+		pthread_join( threads[t], NULL);
+	double duration = Now() - startTime;
+	if (duration <= 0)
+		duration = 0.001;
+	printf("%u mails exported in %.2f seconds (%.0f mails/sec)\n",
+			 okCount, duration, okCount / duration);
+	uint32_t errorCount = state.errorCount + writeErrors;
+	if (errorCount)
+		printf("%u mails could not be exported!\n", errorCount);
+
+	pthread_cond_destroy( &state.cond);
+	pthread_mutex_destroy( &state.lock);
+	return errorCount;
+}
+
+/*------------------------------------------------------------------------------*\
+	main()
+		-
+\*------------------------------------------------------------------------------*/
+int main( int argc, char** argv)
+{
+	const char* usage
+		= "usage: MailExporter [-j <threads>] [-b <batch_size>] "
+				"[-f mbox|maildir] <folder> <mbox_or_maildir>\n";
+	uint32_t threadCount = 4;
+	uint32_t batchSize = 100;
+	string format( "mbox");
+	int arg = 1;
+	for( ; arg+1 < argc && argv[arg][0] == '-'; arg += 2) {
+		int value = atoi( argv[arg+1]);
+		if (!strcmp( argv[arg], "-j") && value > 0)
+			threadCount = value;
+		else if (!strcmp( argv[arg], "-b") && value > 0)
+			batchSize = value;
+		else if (!strcmp( argv[arg], "-f"))
+			format = argv[arg+1];
+		else {
+			fprintf(stderr, "%s", usage);
+			return 5;
+		}
+	}
+	if (argc - arg != 2) {
+		fprintf(stderr, "%s", usage);
+		return 5;
+	}
+	vector< string> paths;
+	CollectMailFiles( argv[arg], paths);
+	BmMailboxWriter* writer = BmMailboxWriter::Create( argv[arg+1], format);
+	if (!writer) {
+		fprintf(stderr, "can't create %s-mailbox %s\n", format.c_str(),
+				  argv[arg+1]);
+		return 10;
+	}
+	uint32_t errorCount = Export( paths, writer, threadCount, batchSize);
+	delete writer;
+	return errorCount ? 10 : 0;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * MailImporter reads all mails from an mbox-file or a Maildir and writes
+ * them as Beam mail-files into a folder.
+ * Usage:
+ *			MailImporter [-j <threads>] [-b <batch_size>] <mbox_or_maildir> <folder>
+ *
+ * The mailbox is streamed by the main thread, which hands batches of mails
+ * to a pool of worker threads. These convert the mails and write them; each
+ * batch is committed with a single sync().
+ * On BeOS/Haiku, the workers parse every mail with the mail kit and write
+ * all the attributes Beam needs (just like MailConverter does), Beam builds
+ * the mail-ref cache of the folder from these when it is opened.
+ *
+ * Since the rest only uses the portable part of the mail kit, the tool can
+ * be built on other systems, too (e.g. to test an import of a local corpus
+ * on Linux, where no attributes are written):
+ *			g++ -O2 -pthread -I../src-bmMailKit -o MailImporter MailImporter.cpp \
+ *				../src-bmMailKit/BmMailboxIO.cpp
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <deque>
+
+#include "BmMailboxIO.h"
+
+#if defined(__BEOS__) || defined(__HAIKU__)
+#define STAMP_ATTRIBUTES
+#include <File.h>
+#include <NodeInfo.h>
+
+#include "BmApp.h"
+#include "BmMail.h"
+#include "BmMailHeader.h"
+
+class ImportedMail : public BmMail {
+public:
+	ImportedMail()
+		:	BmMail(BM_DEFAULT_STRING, "")
+	{
+	}
+	void SetTo(const BmString &msgText)
+	{
+		BmMail::SetTo(msgText, "imported");
+	}
+	void StoreAttributes( BFile& mailFile, const BmString& status,
+								 bigtime_t whenCreated)
+	{
+		BmMail::StoreAttributes(mailFile, status, whenCreated);
+		Header()->StoreAttributes(mailFile);
+	}
+};
+#endif
+
+using std::deque;
+
+struct MailBatch {
+	uint32_t firstNr;
+	vector< string> texts;
+	vector< string> statuses;
+};
+
+struct ImportState {
+	string folder;
+	time_t startTime;
+	deque< MailBatch*> queue;
+	bool readerDone;
+	uint32_t maxQueued;
+	uint32_t okCount;
+	uint32_t errorCount;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/*------------------------------------------------------------------------------*\
+	Now()
+		-	returns the current time in seconds
+\*------------------------------------------------------------------------------*/
+static double Now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteMail( state, nr, text, status)
+		-	writes a single mail into the destination folder
+\*------------------------------------------------------------------------------*/
+static bool WriteMail( ImportState* state, uint32_t nr, const string& text,
+							  const string& status)
+{
+	string crlfText;
+	BmMailboxIO::ConvertToCRLF( text, crlfText);
+	string path = state->folder + "/"
+						+ BmMailboxIO::BeamFilename( state->startTime, nr);
+	FILE* file = fopen( path.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "unable to create %s\n", path.c_str());
+		return false;
+	}
+	bool ok = fwrite( crlfText.data(), 1, crlfText.size(), file)
+					== crlfText.size();
+	ok = fclose( file) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "unable to write %s\n", path.c_str());
+		remove( path.c_str());
+		return false;
+	}
+#ifdef STAMP_ATTRIBUTES
+	ImportedMail mail;
+	BmString str;
+	str.SetTo( crlfText.data(), crlfText.size());
+	mail.SetTo( str);
+	BFile mailFile( path.c_str(), B_READ_WRITE);
+	if (mailFile.InitCheck() != B_OK) {
+		fprintf(stderr, "unable to stamp attributes of %s\n", path.c_str());
+		return false;
+	}
+	mail.StoreAttributes( mailFile, status.c_str(),
+								 ((bigtime_t)state->startTime) * 1000*1000);
+	BNodeInfo nodeInfo( &mailFile);
+	nodeInfo.SetType( "text/x-email");
+#else
+	// without attributes, there's nowhere to keep the status:
+	(void)status;
+#endif
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	WorkerThread( data)
+		-	writes all the batches it can get hold of
+\*------------------------------------------------------------------------------*/
+static void* WorkerThread( void* data)
+{
+	ImportState* state = static_cast< ImportState*>( data);
+	while( 1) {
+		pthread_mutex_lock( &state->lock);
+		while( state->queue.empty() && !state->readerDone)
+			pthread_cond_wait( &state->cond, &state->lock);
+		if (state->queue.empty()) {
+			pthread_mutex_unlock( &state->lock);
+			break;
+		}
+		MailBatch* batch = state->queue.front();
+		state->queue.pop_front();
+		// there's room in the queue now:
+		pthread_cond_broadcast( &state->cond);
+		pthread_mutex_unlock( &state->lock);
+
+		uint32_t okCount = 0;
+		uint32_t errorCount = 0;
+		for( uint32_t i=0; i<batch->texts.size(); ++i) {
+			if (WriteMail( state, batch->firstNr+i, batch->texts[i],
+								batch->statuses[i]))
+				okCount++;
+			else
+				errorCount++;
+		}
+		// commit the whole batch at once:
+		sync();
+		delete batch;
+
+		pthread_mutex_lock( &state->lock);
+		state->okCount += okCount;
+		state->errorCount += errorCount;
+		pthread_mutex_unlock( &state->lock);
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Import( reader, folder, threadCount, batchSize)
+		-	streams all mails from the given reader into the folder
+		-	returns the number of mails that could not be imported
+\*------------------------------------------------------------------------------*/
+static uint32_t Import( BmMailboxReader* reader, const string& folder,
+								uint32_t threadCount, uint32_t batchSize)
+{
+	ImportState state;
+	state.folder = folder;
+	state.startTime = time( NULL);
+	state.readerDone = false;
+	state.maxQueued = 2 * threadCount;
+	state.okCount = 0;
+	state.errorCount = 0;
+	pthread_mutex_init( &state.lock, NULL);
+	pthread_cond_init( &state.cond, NULL);
+
+	vector< pthread_t> threads( threadCount);
+	for( uint32_t t=0; t<threadCount; ++t)
+		pthread_create( &threads[t], NULL, WorkerThread, &state);
+
+	double startTime = Now();
+	double lastReport = startTime;
+	uint32_t mailNr = 1;
+	string text, status;
+	bool haveMore = true;
+	while( haveMore) {
+		MailBatch* batch = new MailBatch;
+		batch->firstNr = mailNr;
+		while( batch->texts.size() < batchSize
+		&& (haveMore = reader->NextMail( text, status))) {
+			batch->texts.push_back( text);
+			batch->statuses.push_back( status);
+		}
+		mailNr += batch->texts.size();
+		pthread_mutex_lock( &state.lock);
+		// don't read too far ahead of the workers:
+		while( state.queue.size() >= state.maxQueued)
+			pthread_cond_wait( &state.cond, &state.lock);
+		if (batch->texts.empty())
+			delete batch;
+		else
+			state.queue.push_back( batch);
+		if (!haveMore)
+			state.readerDone = true;
+		pthread_cond_broadcast( &state.cond);
+		uint32_t done = state.okCount + state.errorCount;
+		pthread_mutex_unlock( &state.lock);
+
+		double now = Now();
+		if (now - lastReport >= 2.0) {
+			printf("%u mails imported (%.0f mails/sec)\n", done,
+					 done / (now - startTime));
+			lastReport = now;
+		}
+	}
+
+	for( uint32_t t=0; t<threadCount; ++t)
+		pthread_join( threads[t], NULL);
+	double duration = Now() - startTime;
+	if (duration <= 0)
+		duration = 0.001;
+	printf("%u mails imported in %.2f seconds (%.0f mails/sec)\n",
+			 state.okCount, duration, state.okCount / duration);
+	if (state.errorCount)
+		printf("%u mails could not be imported!\n", state.errorCount);
+
+	pthread_cond_destroy( &state.cond);
+	pthread_mutex_destroy( &state.lock);
+	return state.errorCount;
+}
+
+/*------------------------------------------------------------------------------*\
+	main()
+		-
+\*------------------------------------------------------------------------------*/
+int main( int argc, char** argv)
+{
+	const char* usage
+		= "usage: MailImporter [-j <threads>] [-b <batch_size>] "
+				"<mbox_or_maildir> <folder>\n";
+	uint32_t threadCount = 4;
+	uint32_t batchSize = 100;
+	int arg = 1;
+	for( ; arg+1 < argc && argv[arg][0] == '-'; arg += 2) {
+		int value = atoi( argv[arg+1]);
+		if (!strcmp( argv[arg], "-j") && value > 0)
+			threadCount = value;
+		else if (!strcmp( argv[arg], "-b") && value > 0)
+			batchSize = value;
+		else {
+			fprintf(stderr, "%s", usage);
+			return 5;
+		}
+	}
+	if (argc - arg != 2) {
+		fprintf(stderr, "%s", usage);
+		return 5;
+	}
+	string folder( argv[arg+1]);
+	mkdir( folder.c_str(), 0755);
+	struct stat st;
+	if (stat( folder.c_str(), &st) != 0 || !S_ISDIR( st.st_mode)) {
+		fprintf(stderr, "can't use folder %s\n", folder.c_str());
+		return 10;
+	}
+	BmMailboxReader* reader = BmMailboxReader::Create( argv[arg]);
+	if (!reader) {
+		fprintf(stderr, "can't open mailbox %s\n", argv[arg]);
+		return 10;
+	}
+#ifdef STAMP_ATTRIBUTES
+	BmApplication* app
+		= new BmApplication( "application/x-vnd.zooey-mailimporter", true);
+#endif
+	uint32_t errorCount = Import( reader, folder, threadCount, batchSize);
+	delete reader;
+#ifdef STAMP_ATTRIBUTES
+	delete app;
+#endif
+	return errorCount ? 10 : 0;
+}
@@ -352,6 +352,8 @@ void SpamOMeter( const char* pathfileName, ResInfo& ri)
 		fprintf(stderr,"\tfalse positives:  %6.2f   false negatives:   %6.2f\n", ri.falsePos, ri.falseNeg);
 		fprintf(stderr,"\tunsure:           %6.2f\n", ri.unsure);
 		fprintf(stderr,"\tcorrectness (FP): %6.2f   correctness (all): %6.2f\n", ri.totalFalsePos, ri.totalOverall);
+		fprintf(stderr,"\tparse-arenas:     %s\n", 
+							BmArena::StatsString( BmArena::GlobalStats()).String());
 	}
 	delete [] resultBuf;
 }
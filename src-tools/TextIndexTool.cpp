@@ -0,0 +1,167 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * TextIndexTool maintains and queries a full-text index (the same kind of
+ * index Beam keeps of the mailbox) over all the mail-files found in a
+ * folder (and its subfolders). Mails are identified by their inode, just
+ * like Beam does it.
+ * Usage:
+ *			TextIndexTool index <index_file> <mail_folder>
+ *				-	brings the index up-to-date with the given folder, new mails
+ *					are added, removed ones are dropped
+ *			TextIndexTool search <index_file> <mail_folder> <query>
+ *				-	prints the paths of all mails that contain every word of
+ *					the query (words ending in '*' are prefixes)
+ *			TextIndexTool stats <index_file>
+ *
+ * Since it only uses the portable part of the index, the tool can be built
+ * on other systems, too (e.g. to test the index against a folder of .eml
+ * files on Linux):
+ *			g++ -O2 -I../src-bmMailKit -o TextIndexTool TextIndexTool.cpp \
+ *				../src-bmMailKit/BmTextIndex.cpp
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "BmTextIndex.h"
+
+typedef map< BmTextIndex::DocKey, string> PathMap;
+
+/*------------------------------------------------------------------------------*\
+	CollectMailFiles( folder, pathMap)
+		-	collects all regular files in the given folder (recursively)
+\*------------------------------------------------------------------------------*/
+static void CollectMailFiles( const string& folder, PathMap& pathMap)
+{
+	DIR* dir = opendir( folder.c_str());
+	if (!dir) {
+		fprintf(stderr, "can't open folder %s\n", folder.c_str());
+		return;
+	}
+	struct dirent* dirEntry;
+	while( (dirEntry = readdir( dir)) != NULL) {
+		if (!strcmp( dirEntry->d_name, ".") || !strcmp( dirEntry->d_name, ".."))
+			continue;
+		string path = folder + "/" + dirEntry->d_name;
+		struct stat st;
+		if (stat( path.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR( st.st_mode))
+			CollectMailFiles( path, pathMap);
+		else if (S_ISREG( st.st_mode))
+			pathMap[st.st_ino] = path;
+	}
+	closedir( dir);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadFile( path, outText)
+		-
+\*------------------------------------------------------------------------------*/
+static bool ReadFile( const string& path, string& outText)
+{
+	FILE* file = fopen( path.c_str(), "rb");
+	if (!file)
+		return false;
+	outText.erase();
+	char buf[65536];
+	size_t len;
+	while( (len = fread( buf, 1, sizeof(buf), file)) > 0)
+		outText.append( buf, len);
+	fclose( file);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	IndexFolder( index, pathMap)
+		-
+\*------------------------------------------------------------------------------*/
+static void IndexFolder( BmTextIndex& index, const PathMap& pathMap)
+{
+	int addCount = 0;
+	int errorCount = 0;
+	string mailText, text;
+	PathMap::const_iterator iter;
+	for( iter = pathMap.begin(); iter != pathMap.end(); ++iter) {
+		if (index.HasDocument( iter->first))
+			continue;
+		if (!ReadFile( iter->second, mailText)) {
+			fprintf(stderr, "unable to read %s\n", iter->second.c_str());
+			errorCount++;
+			continue;
+		}
+		BmTextIndex::ExtractMailText( mailText, text);
+		index.AddDocument( iter->first, text);
+		addCount++;
+	}
+	// drop all mails that have gone:
+	BmTextIndex::DocKeyVect keys;
+	int removeCount = 0;
+	index.AllDocuments( keys);
+	for( uint32_t i=0; i<keys.size(); ++i) {
+		if (pathMap.find( keys[i]) == pathMap.end()) {
+			index.RemoveDocument( keys[i]);
+			removeCount++;
+		}
+	}
+	if (index.NeedsCompaction())
+		index.Compact();
+	printf("%d mails added, %d removed, %d errors\n",
+			 addCount, removeCount, errorCount);
+}
+
+/*------------------------------------------------------------------------------*\
+	main()
+		-
+\*------------------------------------------------------------------------------*/
+int main( int argc, char** argv)
+{
+	const char* usage
+		= "usage: TextIndexTool index <index_file> <mail_folder>\n"
+		  "       TextIndexTool search <index_file> <mail_folder> <query>\n"
+		  "       TextIndexTool stats <index_file>\n";
+	if (argc < 3) {
+		fprintf(stderr, "%s", usage);
+		return 5;
+	}
+	string command( argv[1]);
+	string indexFile( argv[2]);
+	BmTextIndex index;
+	if (!index.Load( indexFile))
+		fprintf(stderr, "starting with an empty index\n");
+	if (command == "index" && argc == 4) {
+		PathMap pathMap;
+		CollectMailFiles( argv[3], pathMap);
+		IndexFolder( index, pathMap);
+		if (index.IsModified() && !index.Store( indexFile)) {
+			fprintf(stderr, "unable to write index %s\n", indexFile.c_str());
+			return 10;
+		}
+	} else if (command == "search" && argc == 5) {
+		PathMap pathMap;
+		CollectMailFiles( argv[3], pathMap);
+		BmTextIndex::DocKeyVect hits;
+		index.Search( argv[4], hits);
+		for( uint32_t i=0; i<hits.size(); ++i) {
+			PathMap::const_iterator iter = pathMap.find( hits[i]);
+			if (iter != pathMap.end())
+				printf("%s\n", iter->second.c_str());
+		}
+	} else if (command == "stats" && argc == 3) {
+		printf("%u mails, %u dead entries, %u terms\n",
+				 index.DocumentCount(), index.DeadDocumentCount(),
+				 index.TermCount());
+	} else {
+		fprintf(stderr, "%s", usage);
+		return 5;
+	}
+	return 0;
+}